@@ -248,6 +248,7 @@ cdef extern from "<datoviz/datoviz.h>":
         DVZ_CANVAS_FLAGS_NONE = 0x0000
         DVZ_CANVAS_FLAGS_IMGUI = 0x0001
         DVZ_CANVAS_FLAGS_FPS = 0x0003
+        DVZ_CANVAS_FLAGS_ON_DEMAND = 0x0008
         DVZ_CANVAS_FLAGS_DPI_SCALE_050 = 0x1000
         DVZ_CANVAS_FLAGS_DPI_SCALE_100 = 0x2000
         DVZ_CANVAS_FLAGS_DPI_SCALE_150 = 0x3000
@@ -328,6 +329,8 @@ cdef extern from "<datoviz/datoviz.h>":
         DVZ_EVENT_PRE_SEND = 20
         DVZ_EVENT_POST_SEND = 21
         DVZ_EVENT_DESTROY = 22
+        DVZ_EVENT_DOWNLOAD = 23
+        DVZ_EVENT_COUNT = 24
 
     ctypedef enum DvzEventMode:
         DVZ_EVENT_MODE_SYNC = 0
@@ -733,6 +736,21 @@ cdef extern from "<datoviz/datoviz.h>":
         DVZ_PANEL_UNIT_FRAMEBUFFER = 1
         DVZ_PANEL_UNIT_SCREEN = 2
 
+    # from file: profile.h
+
+    ctypedef enum DvzProfilePhase:
+        DVZ_PROFILE_INTERACT = 0
+        DVZ_PROFILE_FRAME = 1
+        DVZ_PROFILE_TIMER = 2
+        DVZ_PROFILE_TRANSFERS = 3
+        DVZ_PROFILE_REFILL = 4
+        DVZ_PROFILE_FENCE_WAIT = 5
+        DVZ_PROFILE_ACQUIRE = 6
+        DVZ_PROFILE_SUBMIT = 7
+        DVZ_PROFILE_VISUAL_UPDATE = 8
+        DVZ_PROFILE_BAKE = 9
+        DVZ_PROFILE_COUNT = 10
+
     # from file: scene.h
 
     ctypedef enum DvzControllerType:
@@ -874,6 +892,7 @@ cdef extern from "<datoviz/datoviz.h>":
 
     ctypedef enum DvzSourceFlags:
         DVZ_SOURCE_FLAG_MAPPABLE = 0x0001
+        DVZ_SOURCE_FLAG_CIRCULAR = 0x0002
 
     ctypedef enum DvzVisualRequest:
         DVZ_VISUAL_REQUEST_NOT_SET = 0x0000
@@ -904,7 +923,9 @@ cdef extern from "<datoviz/datoviz.h>":
         DVZ_BUFFER_TYPE_UNIFORM = 4
         DVZ_BUFFER_TYPE_STORAGE = 5
         DVZ_BUFFER_TYPE_UNIFORM_MAPPABLE = 6
-        DVZ_BUFFER_TYPE_COUNT = 7
+        DVZ_BUFFER_TYPE_VERTEX_MAPPABLE = 7
+        DVZ_BUFFER_TYPE_INDIRECT = 8
+        DVZ_BUFFER_TYPE_COUNT = 9
 
     ctypedef enum DvzGraphicsType:
         DVZ_GRAPHICS_NONE = 0
@@ -1081,6 +1102,17 @@ cdef extern from "<datoviz/datoviz.h>":
         DvzGuiControl controls[32]
         bint show_imgui_demo
 
+    # from file: profile.h
+
+    ctypedef struct DvzProfileStats:
+        uint64_t count
+        double last
+        double p50
+        double p95
+        double p99
+        double max
+
+
 
     # STRUCT END
 
@@ -1127,6 +1159,12 @@ cdef extern from "<datoviz/datoviz.h>":
     void dvz_panel_transpose(DvzPanel* panel, DvzCDSTranspose transpose)
     DvzPanel* dvz_panel_at(DvzGrid* grid, vec2 pos)
 
+    # from file: profile.h
+    DvzProfileStats dvz_profile_stats(DvzProfilePhase phase)
+    const char* dvz_profile_name(DvzProfilePhase phase)
+    int dvz_profile_trace(const char* path)
+    void dvz_profile_reset()
+
     # from file: scene.h
     DvzScene* dvz_scene(DvzCanvas* canvas, uint32_t n_rows, uint32_t n_cols)
     void dvz_scene_destroy(DvzScene* scene)
@@ -563,6 +563,32 @@ def colormap(np.ndarray[DOUBLE, ndim=1] values, vmin=None, vmax=None, cmap=None,
 
 
 
+def profile_stats():
+    """Return the rolling statistics of the instrumented frame phases, durations in ms."""
+    cdef cv.DvzProfileStats stats
+    out = {}
+    for phase in range(cv.DVZ_PROFILE_COUNT):
+        stats = cv.dvz_profile_stats(phase)
+        out[cv.dvz_profile_name(phase)] = dict(
+            count=stats.count, last=stats.last,
+            p50=stats.p50, p95=stats.p95, p99=stats.p99, max=stats.max)
+    return out
+
+
+
+def profile_trace(unicode path):
+    """Write the most recent instrumented scopes to a Chrome trace JSON file."""
+    if cv.dvz_profile_trace(path) != 0:
+        raise IOError(f"unable to write the trace to {path}")
+
+
+
+def profile_reset():
+    """Discard all instrumented scopes."""
+    cv.dvz_profile_reset()
+
+
+
 # -------------------------------------------------------------------------------------------------
 # App
 # -------------------------------------------------------------------------------------------------
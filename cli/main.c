@@ -41,6 +41,7 @@ static TestCase TEST_CASES[] = {
     CASE_FIXTURE_NONE(test_vklite_submit),         //
     CASE_FIXTURE_NONE(test_vklite_blank),          //
     CASE_FIXTURE_NONE(test_vklite_graphics),       //
+    CASE_FIXTURE_NONE(test_vklite_pipeline_cache), //
     CASE_FIXTURE_NONE(test_basic_canvas_1),        //
     CASE_FIXTURE_NONE(test_basic_canvas_triangle), //
     CASE_FIXTURE_NONE(test_shader_compile),        //
@@ -49,11 +50,25 @@ static TestCase TEST_CASES[] = {
     CASE_FIXTURE_NONE(test_fifo_1),      //
     CASE_FIXTURE_NONE(test_fifo_2),      //
     CASE_FIXTURE_NONE(test_fifo_3),      //
+    CASE_FIXTURE_NONE(test_fifo_4),      //
+    CASE_FIXTURE_NONE(test_alloc_1),     //
+    CASE_FIXTURE_NONE(test_alloc_2),     //
     CASE_FIXTURE_NONE(test_default_app), //
 
     // canvas
     CASE_FIXTURE_NONE(test_canvas_transfer_buffer),  //
     CASE_FIXTURE_NONE(test_canvas_transfer_texture), //
+    CASE_FIXTURE_NONE(test_canvas_transfer_staging), //
+    CASE_FIXTURE_NONE(test_canvas_transfer_stream),  //
+    CASE_FIXTURE_NONE(test_canvas_transfer_batch),   //
+    CASE_FIXTURE_NONE(test_canvas_transfer_queue),   //
+    CASE_FIXTURE_NONE(test_canvas_transfer_async),   //
+    CASE_FIXTURE_NONE(test_canvas_transfer_sync),    //
+    CASE_FIXTURE_NONE(test_canvas_transfer_full),    //
+    CASE_FIXTURE_NONE(test_canvas_vertex_mappable),  //
+    CASE_FIXTURE_NONE(test_canvas_events_coalesce),  //
+    CASE_FIXTURE_NONE(test_canvas_events_workers),   //
+    CASE_FIXTURE_NONE(test_canvas_on_demand),        //
     CASE_FIXTURE_NONE(test_canvas_1),                //
     CASE_FIXTURE_NONE(test_canvas_2),                //
     CASE_FIXTURE_NONE(test_canvas_3),                //
@@ -66,13 +81,16 @@ static TestCase TEST_CASES[] = {
     CASE_FIXTURE_NONE(test_canvas_append),           //
     CASE_FIXTURE_NONE(test_canvas_particles),        //
     CASE_FIXTURE_NONE(test_canvas_offscreen),        //
+    CASE_FIXTURE_NONE(test_canvas_offscreen_workers), //
     CASE_FIXTURE_NONE(test_canvas_gui_1),            //
     CASE_FIXTURE_NONE(test_canvas_screencast),       //
 
     // graphics
-    CASE_FIXTURE_NONE(test_graphics_dynamic), //
-    CASE_FIXTURE_NONE(test_graphics_3D),      //
-    CASE_FIXTURE_NONE(test_graphics_depth),   //
+    CASE_FIXTURE_NONE(test_graphics_dynamic),        //
+    CASE_FIXTURE_NONE(test_graphics_3D),             //
+    CASE_FIXTURE_NONE(test_graphics_depth),          //
+    CASE_FIXTURE_NONE(test_graphics_pipelines),      //
+    CASE_FIXTURE_NONE(test_graphics_specialization), //
 
     CASE_FIXTURE_NONE(test_graphics_point),          //
     CASE_FIXTURE_NONE(test_graphics_line),           //
@@ -105,25 +123,29 @@ static TestCase TEST_CASES[] = {
     CASE_FIXTURE_NONE(test_transforms_3), //
     CASE_FIXTURE_NONE(test_transforms_4), //
     CASE_FIXTURE_NONE(test_transforms_5), //
+    CASE_FIXTURE_NONE(test_transforms_6), //
 
     // array
-    CASE_FIXTURE_NONE(test_array_1),    //
-    CASE_FIXTURE_NONE(test_array_2),    //
-    CASE_FIXTURE_NONE(test_array_3),    //
-    CASE_FIXTURE_NONE(test_array_4),    //
-    CASE_FIXTURE_NONE(test_array_5),    //
-    CASE_FIXTURE_NONE(test_array_6),    //
-    CASE_FIXTURE_NONE(test_array_7),    //
-    CASE_FIXTURE_NONE(test_array_cast), //
-    CASE_FIXTURE_NONE(test_array_mvp),  //
-    CASE_FIXTURE_NONE(test_array_3D),   //
+    CASE_FIXTURE_NONE(test_array_1),      //
+    CASE_FIXTURE_NONE(test_array_2),      //
+    CASE_FIXTURE_NONE(test_array_3),      //
+    CASE_FIXTURE_NONE(test_array_4),      //
+    CASE_FIXTURE_NONE(test_array_5),      //
+    CASE_FIXTURE_NONE(test_array_6),      //
+    CASE_FIXTURE_NONE(test_array_7),      //
+    CASE_FIXTURE_NONE(test_array_cast),   //
+    CASE_FIXTURE_NONE(test_array_mvp),    //
+    CASE_FIXTURE_NONE(test_array_3D),     //
+    CASE_FIXTURE_NONE(test_array_column), //
+    CASE_FIXTURE_NONE(test_array_bench),  //
 
     // visuals
-    CASE_FIXTURE_NONE(test_visuals_1), //
-    CASE_FIXTURE_NONE(test_visuals_2), //
-    CASE_FIXTURE_NONE(test_visuals_3), //
-    CASE_FIXTURE_NONE(test_visuals_4), //
-    CASE_FIXTURE_NONE(test_visuals_5), //
+    CASE_FIXTURE_NONE(test_visuals_1),     //
+    CASE_FIXTURE_NONE(test_visuals_2),     //
+    CASE_FIXTURE_NONE(test_visuals_3),     //
+    CASE_FIXTURE_NONE(test_visuals_4),     //
+    CASE_FIXTURE_NONE(test_visuals_5),     //
+    CASE_FIXTURE_NONE(test_visuals_dirty), //
 
     // interact
     CASE_FIXTURE_NONE(test_interact_1),       //
@@ -145,10 +167,12 @@ static TestCase TEST_CASES[] = {
 #endif
 
     CASE_FIXTURE_NONE(test_visuals_marker),         //
+    CASE_FIXTURE_NONE(test_visuals_marker_depth),   //
     CASE_FIXTURE_NONE(test_visuals_polygon),        //
     CASE_FIXTURE_NONE(test_visuals_path),           //
     CASE_FIXTURE_NONE(test_visuals_image_1),        //
     CASE_FIXTURE_NONE(test_visuals_image_cmap),     //
+    CASE_FIXTURE_NONE(test_visuals_image_stream),   //
     CASE_FIXTURE_NONE(test_visuals_axes_2D_1),      //
     CASE_FIXTURE_NONE(test_visuals_axes_2D_update), //
 
@@ -162,11 +186,18 @@ static TestCase TEST_CASES[] = {
     CASE_FIXTURE_NONE(test_axes_3), //
 
     // scene
-    CASE_FIXTURE_NONE(test_scene_0),        //
-    CASE_FIXTURE_NONE(test_scene_1),        //
-    CASE_FIXTURE_NONE(test_scene_mesh),     //
-    CASE_FIXTURE_NONE(test_scene_axes),     //
-    CASE_FIXTURE_NONE(test_scene_logistic), //
+    CASE_FIXTURE_NONE(test_scene_0),          //
+    CASE_FIXTURE_NONE(test_scene_1),          //
+    CASE_FIXTURE_NONE(test_scene_refill),     //
+    CASE_FIXTURE_NONE(test_scene_indirect),   //
+    CASE_FIXTURE_NONE(test_scene_on_demand),  //
+    CASE_FIXTURE_NONE(test_scene_profile),    //
+    CASE_FIXTURE_NONE(test_scene_instrument), //
+    CASE_FIXTURE_NONE(test_scene_bake),       //
+    CASE_FIXTURE_NONE(test_scene_float),      //
+    CASE_FIXTURE_NONE(test_scene_mesh),       //
+    CASE_FIXTURE_NONE(test_scene_axes),       //
+    CASE_FIXTURE_NONE(test_scene_logistic),   //
 
 };
 static uint32_t N_TESTS = sizeof(TEST_CASES) / sizeof(TestCase);
@@ -332,3 +332,158 @@ int test_array_3D(TestContext* context)
     dvz_array_destroy(&arr);
     return 0;
 }
+
+
+
+/*************************************************************************************************/
+/*  Column copy tests                                                                            */
+/*************************************************************************************************/
+
+// Straightforward per-item implementation of dvz_array_column(), used as a reference.
+static void _column_ref(
+    DvzArray* array, VkDeviceSize offset, VkDeviceSize col_size, uint32_t first_item,
+    uint32_t item_count, uint32_t data_item_count, const void* data, uint32_t components,
+    DvzArrayCopyType copy_type, uint32_t reps)
+{
+    uint32_t step = MAX(reps, 1);
+    uint32_t j = 0;
+    uint8_t* dst = NULL;
+    const uint8_t* src = NULL;
+    for (uint32_t i = 0; i < item_count; i++)
+    {
+        if (copy_type == DVZ_ARRAY_COPY_SINGLE && i % step > 0)
+            continue;
+        j = MIN(i / step, data_item_count - 1);
+        dst = (uint8_t*)array->data + (first_item + i) * array->item_size + offset;
+        src = (const uint8_t*)data + j * col_size;
+        if (components == 0)
+            memcpy(dst, src, col_size);
+        for (uint32_t k = 0; k < components; k++)
+            ((float*)dst)[k] = (float)((const double*)src)[k];
+    }
+}
+
+
+
+static const DvzDataType _CAST_DTYPES[][2] = {
+    {DVZ_DTYPE_NONE, DVZ_DTYPE_NONE},    //
+    {DVZ_DTYPE_DOUBLE, DVZ_DTYPE_FLOAT}, //
+    {DVZ_DTYPE_DVEC2, DVZ_DTYPE_VEC2},   //
+    {DVZ_DTYPE_DVEC3, DVZ_DTYPE_VEC3},   //
+    {DVZ_DTYPE_DVEC4, DVZ_DTYPE_VEC4},   //
+};
+
+int test_array_column(TestContext* context)
+{
+    const uint32_t n = 50, first = 3, item_size = 48;
+    DvzArray arr = dvz_array_struct(first + n, item_size);
+    DvzArray ref = dvz_array_struct(first + n, item_size);
+
+    double values[400] = {0};
+    for (uint32_t i = 0; i < 400; i++)
+        values[i] = i * .25;
+
+    uint32_t col_sizes[] = {1, 4, 8, 12, 16, 20};
+    uint32_t data_counts[] = {1, 7, 100};
+    uint32_t reps[] = {0, 1, 3};
+    DvzArrayCopyType copy_types[] = {DVZ_ARRAY_COPY_SINGLE, DVZ_ARRAY_COPY_REPEAT};
+
+    VkDeviceSize col_size = 0;
+    uint32_t components = 0;
+    for (uint32_t c = 0; c < 5; c++)
+    {
+        for (uint32_t s = 0; s < 6; s++)
+        {
+            // The casts take doubles, and the other copies all column sizes.
+            components = c;
+            col_size = c > 0 ? c * sizeof(double) : col_sizes[s];
+            if (c > 0 && s > 0)
+                continue;
+            for (uint32_t d = 0; d < 3; d++)
+            {
+                for (uint32_t r = 0; r < 3; r++)
+                {
+                    for (uint32_t t = 0; t < 2; t++)
+                    {
+                        memset(arr.data, 0xAB, arr.buffer_size);
+                        memset(ref.data, 0xAB, ref.buffer_size);
+                        dvz_array_column(
+                            &arr, 4, col_size, first, n, data_counts[d], values,
+                            _CAST_DTYPES[c][0], _CAST_DTYPES[c][1], copy_types[t], reps[r]);
+                        _column_ref(
+                            &ref, 4, col_size, first, n, data_counts[d], values, components,
+                            copy_types[t], reps[r]);
+                        AT(memcmp(arr.data, ref.data, arr.buffer_size) == 0);
+                    }
+                }
+            }
+        }
+    }
+
+    dvz_array_destroy(&arr);
+    dvz_array_destroy(&ref);
+    return 0;
+}
+
+
+
+#define TEST_COLUMN_BENCH_ITEMS 1000000
+#define TEST_COLUMN_BENCH_ITER  20
+
+typedef struct _ColumnBench _ColumnBench;
+struct _ColumnBench
+{
+    const char* name;
+    VkDeviceSize item_size, col_size;
+    DvzDataType source_dtype, target_dtype;
+    DvzArrayCopyType copy_type;
+    uint32_t reps;
+};
+
+int test_array_bench(TestContext* context)
+{
+    const uint32_t n = TEST_COLUMN_BENCH_ITEMS;
+    _ColumnBench paths[] = {
+        {"contiguous", 16, 16, 0, 0, DVZ_ARRAY_COPY_SINGLE, 1},                //
+        {"strided 4 bytes", 32, 4, 0, 0, DVZ_ARRAY_COPY_SINGLE, 1},            //
+        {"strided 8 bytes", 32, 8, 0, 0, DVZ_ARRAY_COPY_SINGLE, 1},            //
+        {"strided 12 bytes", 32, 12, 0, 0, DVZ_ARRAY_COPY_SINGLE, 1},          //
+        {"strided 16 bytes", 32, 16, 0, 0, DVZ_ARRAY_COPY_SINGLE, 1},          //
+        {"strided 20 bytes", 32, 20, 0, 0, DVZ_ARRAY_COPY_SINGLE, 1},          //
+        {"cast dvec3 to vec3", 32, 24, DVZ_DTYPE_DVEC3, DVZ_DTYPE_VEC3, 0, 1}, //
+        {"cast dvec4 to vec4", 32, 32, DVZ_DTYPE_DVEC4, DVZ_DTYPE_VEC4, 0, 1}, //
+        {"repeat x4", 32, 16, 0, 0, DVZ_ARRAY_COPY_REPEAT, 4},                 //
+        {"single x4", 32, 16, 0, 0, DVZ_ARRAY_COPY_SINGLE, 4},                 //
+    };
+    const uint32_t n_paths = sizeof(paths) / sizeof(_ColumnBench);
+
+    void* data = calloc(n, 32);
+    DvzClock clock = {0};
+    _ColumnBench* p = NULL;
+    DvzArray arr = {0};
+    double elapsed = 0, gbs = 0;
+    uint32_t written = 0;
+    VkDeviceSize col_size = 0;
+    for (uint32_t i = 0; i < n_paths; i++)
+    {
+        p = &paths[i];
+        arr = dvz_array_struct(n, p->item_size);
+        _clock_init(&clock);
+        for (uint32_t k = 0; k < TEST_COLUMN_BENCH_ITER; k++)
+        {
+            dvz_array_column(
+                &arr, 0, p->col_size, 0, n, n / p->reps, data, p->source_dtype, p->target_dtype,
+                p->copy_type, p->reps);
+        }
+        elapsed = _clock_get(&clock);
+
+        // Throughput in bytes written to the array column.
+        written = p->copy_type == DVZ_ARRAY_COPY_SINGLE ? n / p->reps : n;
+        col_size = p->source_dtype != DVZ_DTYPE_NONE ? p->col_size / 2 : p->col_size;
+        gbs = (double)TEST_COLUMN_BENCH_ITER * written * col_size / elapsed * 1e-9;
+        log_info("dvz_array_column %-20s %6.2f GB/s", p->name, gbs);
+        dvz_array_destroy(&arr);
+    }
+    FREE(data);
+    return 0;
+}
@@ -175,6 +175,33 @@ int test_visuals_marker(TestContext* context)
 
 
 
+int test_visuals_marker_depth(TestContext* context)
+{
+    INIT;
+
+    // The depth test is set by the flags, which are part of the key of the shared graphics.
+    DvzVisual visual = dvz_visual(canvas);
+    dvz_visual_builtin(&visual, DVZ_VISUAL_MARKER, DVZ_GRAPHICS_FLAGS_DEPTH_TEST_ENABLE);
+    DvzVisual visual2 = dvz_visual(canvas);
+    dvz_visual_builtin(&visual2, DVZ_VISUAL_MARKER, 0);
+
+    AT(visual.graphics[0] != visual2.graphics[0]);
+    AT(visual.graphics[0]->depth_test == DVZ_DEPTH_TEST_ENABLE);
+    AT(visual2.graphics[0]->depth_test == DVZ_DEPTH_TEST_DISABLE);
+
+    // Another marker visual shares the graphics, and leaves its depth test untouched.
+    DvzVisual visual3 = dvz_visual(canvas);
+    dvz_visual_builtin(&visual3, DVZ_VISUAL_MARKER, DVZ_GRAPHICS_FLAGS_DEPTH_TEST_ENABLE);
+    AT(visual3.graphics[0] == visual.graphics[0]);
+    AT(visual.graphics[0]->depth_test == DVZ_DEPTH_TEST_ENABLE);
+
+    dvz_visual_destroy(&visual2);
+    dvz_visual_destroy(&visual3);
+    END;
+}
+
+
+
 int test_visuals_line(TestContext* context)
 {
     INIT;
@@ -733,6 +760,79 @@ int test_visuals_image_cmap(TestContext* context)
 
 
 
+int test_visuals_image_stream(TestContext* context)
+{
+    INIT;
+
+    DvzVisual visual = dvz_visual(canvas);
+    dvz_visual_builtin(&visual, DVZ_VISUAL_IMAGE, 0);
+
+    // Top left, top right, bottom right, bottom left
+    dvz_visual_data(&visual, DVZ_PROP_POS, 0, 1, (dvec3[]){{-1, +1, 0}});
+    dvz_visual_data(&visual, DVZ_PROP_POS, 1, 1, (dvec3[]){{+1, +1, 0}});
+    dvz_visual_data(&visual, DVZ_PROP_POS, 2, 1, (dvec3[]){{+1, -1, 0}});
+    dvz_visual_data(&visual, DVZ_PROP_POS, 3, 1, (dvec3[]){{-1, -1, 0}});
+
+    dvz_visual_data(&visual, DVZ_PROP_TEXCOORDS, 0, 1, (vec2[]){{0, 0}});
+    dvz_visual_data(&visual, DVZ_PROP_TEXCOORDS, 1, 1, (vec2[]){{1, 0}});
+    dvz_visual_data(&visual, DVZ_PROP_TEXCOORDS, 2, 1, (vec2[]){{1, 1}});
+    dvz_visual_data(&visual, DVZ_PROP_TEXCOORDS, 3, 1, (vec2[]){{0, 1}});
+
+    // Full image.
+    const uint32_t width = 64, height = 32;
+    cvec4* img = calloc(width * height, sizeof(cvec4));
+    for (uint32_t i = 0; i < width * height; i++)
+    {
+        img[i][0] = i % 256;
+        img[i][1] = i / 256;
+        img[i][3] = 255;
+    }
+    dvz_visual_data_texture(
+        &visual, DVZ_SOURCE_TYPE_IMAGE, 0, DVZ_ZERO_OFFSET, (uvec3){width, height, 1}, img);
+    DvzSource* source = dvz_source_get(&visual, DVZ_SOURCE_TYPE_IMAGE, 0);
+    AT(source->dirty.full);
+
+    RUN;
+
+    // Update a tile: only its box is uploaded.
+    cvec4 tile[8 * 4] = {0};
+    memset(tile, 255, sizeof(tile));
+    dvz_visual_data_texture(
+        &visual, DVZ_SOURCE_TYPE_IMAGE, 0, (uvec3){16, 8, 0}, (uvec3){8, 4, 1}, tile);
+    AT(!source->dirty.full);
+    AT(source->dirty.count == 1);
+    AT(source->dirty.box_min[0] == 16 && source->dirty.box_max[0] == 24);
+    AT(source->dirty.box_min[1] == 8 && source->dirty.box_max[1] == 12);
+    dvz_visual_update(&visual, canvas->viewport, (DvzDataCoords){0}, NULL);
+    AT(source->dirty.count == 0);
+
+    // Scrolling columns that wrap around the right edge of the image.
+    cvec4* columns = calloc(8 * height, sizeof(cvec4));
+    memset(columns, 128, 8 * height * sizeof(cvec4));
+    uint32_t head = 0;
+    for (uint32_t i = 0; i < 8; i++)
+        head = dvz_visual_data_column(&visual, DVZ_SOURCE_TYPE_IMAGE, 0, 8, columns);
+    AT(head == 0);
+    head = dvz_visual_data_column(&visual, DVZ_SOURCE_TYPE_IMAGE, 0, 4, columns);
+    AT(head == 4);
+    dvz_visual_update(&visual, canvas->viewport, (DvzDataCoords){0}, NULL);
+
+    // Check the GPU texture.
+    cvec4* out = calloc(width * height, sizeof(cvec4));
+    dvz_download_texture(
+        canvas, source->u.tex, DVZ_ZERO_OFFSET, (uvec3){width, height, 1},
+        width * height * sizeof(cvec4), out);
+    AT(memcmp(out, source->arr.data, width * height * sizeof(cvec4)) == 0);
+    AT(out[0][0] == 128);
+
+    FREE(img);
+    FREE(columns);
+    FREE(out);
+    END;
+}
+
+
+
 /*************************************************************************************************/
 /*  Mesh visual tests                                                                            */
 /*************************************************************************************************/
@@ -2,6 +2,7 @@
 #include "../include/datoviz/canvas.h"
 #include "../include/datoviz/context.h"
 #include "../include/datoviz/controls.h"
+#include "../src/canvas_utils.h"
 #include "../src/vklite_utils.h"
 #include "utils.h"
 
@@ -102,6 +103,758 @@ int test_canvas_transfer_texture(TestContext* context)
 
 
 
+#define TEST_STAGING_UPLOADS 64
+
+typedef struct TestStaging TestStaging;
+struct TestStaging
+{
+    DvzBufferRegions br;
+    VkDeviceSize size;
+    uint8_t* data;
+};
+
+static void _staging_frame(DvzCanvas* canvas, DvzEvent ev)
+{
+    TestStaging* ts = (TestStaging*)ev.user_data;
+    ASSERT(ts != NULL);
+    uint32_t per_frame = DVZ_STAGING_RING_SLOTS;
+    if (ev.u.f.idx >= TEST_STAGING_UPLOADS / per_frame)
+        return;
+
+    // Back-to-back uploads processed in the same frame, as many as the staging ring can hold.
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < per_frame; i++)
+    {
+        k = (uint32_t)ev.u.f.idx * per_frame + i;
+        dvz_upload_buffers(canvas, ts->br, k * ts->size, ts->size, &ts->data[k * ts->size]);
+    }
+}
+
+int test_canvas_transfer_staging(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+    DvzContext* ctx = gpu->context;
+
+    TestStaging ts = {0};
+    ts.size = 1024;
+    VkDeviceSize size = TEST_STAGING_UPLOADS * ts.size;
+    ts.br = dvz_ctx_buffers(ctx, DVZ_BUFFER_TYPE_VERTEX, 1, size);
+    ts.data = calloc(size, sizeof(uint8_t));
+    for (uint32_t i = 0; i < size; i++)
+        ts.data[i] = (uint8_t)(i % 251);
+
+    dvz_event_callback(canvas, DVZ_EVENT_FRAME, 0, DVZ_EVENT_MODE_SYNC, _staging_frame, &ts);
+    dvz_app_run(app, TEST_STAGING_UPLOADS / DVZ_STAGING_RING_SLOTS + 2);
+
+    // The uploads fit in the staging ring, none of them should have waited for another one.
+    AT(ctx->staging.count == 0);
+    AT(ctx->staging.stall_count == 0);
+
+    // Check the uploaded data.
+    uint8_t* data2 = calloc(size, sizeof(uint8_t));
+    dvz_download_buffers(canvas, ts.br, 0, size, data2);
+    AT(memcmp(data2, ts.data, size) == 0);
+
+    FREE(ts.data);
+    FREE(data2);
+    TEST_END
+}
+
+
+
+int test_canvas_transfer_stream(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+    DvzContext* ctx = gpu->context;
+
+    // Bound the staging buffer to a size much smaller than the transfers.
+    VkDeviceSize max_size = 16 * 1024;
+    dvz_staging_max_size(ctx, max_size);
+    DvzBuffer* staging = (DvzBuffer*)dvz_container_get(&ctx->buffers, DVZ_BUFFER_TYPE_STAGING);
+
+    // Buffer upload, streamed in several chunks.
+    VkDeviceSize size = 1024 * 1024;
+    DvzBufferRegions br = dvz_ctx_buffers(ctx, DVZ_BUFFER_TYPE_VERTEX, 1, size);
+    uint8_t* data = calloc(size, sizeof(uint8_t));
+    for (uint32_t i = 0; i < size; i++)
+        data[i] = (uint8_t)(i % 251);
+    dvz_upload_buffers(canvas, br, 0, size, data);
+
+    uint8_t* data2 = calloc(size, sizeof(uint8_t));
+    dvz_download_buffers(canvas, br, 0, size, data2);
+    AT(memcmp(data2, data, size) == 0);
+    AT(staging->size <= max_size);
+
+    // Texture upload, streamed in slabs of rows.
+    uvec3 shape = {64, 64, 1};
+    VkDeviceSize tex_size = 64 * 64 * 4;
+    DvzTexture* tex = dvz_ctx_texture(ctx, 2, shape, VK_FORMAT_R8G8B8A8_UNORM);
+    dvz_upload_texture(canvas, tex, DVZ_ZERO_OFFSET, DVZ_ZERO_OFFSET, tex_size, data);
+    dvz_app_run(app, 3);
+
+    memset(data2, 0, tex_size);
+    dvz_download_texture(canvas, tex, DVZ_ZERO_OFFSET, shape, tex_size, data2);
+    dvz_app_run(app, 3);
+    AT(memcmp(data2, data, tex_size) == 0);
+    AT(staging->size <= max_size);
+
+    FREE(data);
+    FREE(data2);
+    TEST_END
+}
+
+
+
+#define TEST_BATCH_UPLOADS 40
+
+static void _batch_frame(DvzCanvas* canvas, DvzEvent ev)
+{
+    TestStaging* ts = (TestStaging*)ev.user_data;
+    ASSERT(ts != NULL);
+    if (ev.u.f.idx != 0)
+        return;
+
+    // Many small adjacent uploads in the same frame, in reverse order, plus an overlapping one.
+    for (uint32_t i = 0; i < TEST_BATCH_UPLOADS; i++)
+    {
+        uint32_t k = TEST_BATCH_UPLOADS - 1 - i;
+        dvz_upload_buffers(canvas, ts->br, k * ts->size, ts->size, &ts->data[k * ts->size]);
+    }
+    dvz_upload_buffers(canvas, ts->br, ts->size / 2, ts->size, &ts->data[ts->size]);
+}
+
+int test_canvas_transfer_batch(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+    DvzContext* ctx = gpu->context;
+
+    TestStaging ts = {0};
+    ts.size = 256;
+    VkDeviceSize size = TEST_BATCH_UPLOADS * ts.size;
+    ts.br = dvz_ctx_buffers(ctx, DVZ_BUFFER_TYPE_VERTEX, 1, size);
+    ts.data = calloc(size, sizeof(uint8_t));
+    for (uint32_t i = 0; i < size; i++)
+        ts.data[i] = (uint8_t)(i % 251);
+
+    dvz_event_callback(canvas, DVZ_EVENT_FRAME, 0, DVZ_EVENT_MODE_SYNC, _batch_frame, &ts);
+    uint32_t submit_count = ctx->staging.submit_count;
+    dvz_app_run(app, 3);
+
+    // All uploads of the frame were merged in a single submission.
+    AT(ctx->staging.submit_count == submit_count + 1);
+
+    // The last, overlapping upload wins.
+    uint8_t* expected = calloc(size, sizeof(uint8_t));
+    memcpy(expected, ts.data, size);
+    memcpy(&expected[ts.size / 2], &ts.data[ts.size], ts.size);
+
+    uint8_t* data2 = calloc(size, sizeof(uint8_t));
+    dvz_download_buffers(canvas, ts.br, 0, size, data2);
+    AT(memcmp(data2, expected, size) == 0);
+
+    FREE(ts.data);
+    FREE(expected);
+    FREE(data2);
+    TEST_END
+}
+
+
+
+#define TEST_QUEUE_PRODUCERS 4
+#define TEST_QUEUE_TRANSFERS 100000
+#define TEST_QUEUE_BENCH     1000000
+
+typedef struct TestQueueProducer TestQueueProducer;
+struct TestQueueProducer
+{
+    DvzTransferQueue* queue;
+    uint32_t idx;
+};
+
+static void* _queue_producer(void* user_data)
+{
+    TestQueueProducer* producer = (TestQueueProducer*)user_data;
+    ASSERT(producer != NULL);
+    DvzTransfer tr = {0};
+    tr.type = DVZ_TRANSFER_BUFFER_UPLOAD;
+    tr.u.buf.offset = producer->idx;
+    for (uint32_t i = 0; i < TEST_QUEUE_TRANSFERS; i++)
+    {
+        tr.u.buf.size = i;
+        while (!dvz_transfer_queue_enqueue(producer->queue, tr))
+            ;
+    }
+    return NULL;
+}
+
+int test_canvas_transfer_queue(TestContext* context)
+{
+    DvzTransferQueue queue = dvz_transfer_queue(8);
+    DvzTransfer tr = {0};
+
+    // Fill the queue, dequeue in order.
+    tr.type = DVZ_TRANSFER_BUFFER_UPLOAD;
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        tr.u.buf.size = i;
+        AT(dvz_transfer_queue_enqueue(&queue, tr));
+    }
+    AT(dvz_transfer_queue_size(&queue) == 8);
+    AT(!dvz_transfer_queue_enqueue(&queue, tr));
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        AT(dvz_transfer_queue_dequeue(&queue, &tr));
+        AT(tr.u.buf.size == i);
+    }
+    AT(!dvz_transfer_queue_dequeue(&queue, &tr));
+    dvz_transfer_queue_destroy(&queue);
+
+    // Several producer threads, one consumer: the order of each producer is preserved.
+    queue = dvz_transfer_queue(256);
+    pthread_t threads[TEST_QUEUE_PRODUCERS] = {0};
+    TestQueueProducer producers[TEST_QUEUE_PRODUCERS] = {0};
+    for (uint32_t i = 0; i < TEST_QUEUE_PRODUCERS; i++)
+    {
+        producers[i] = (TestQueueProducer){&queue, i};
+        pthread_create(&threads[i], NULL, _queue_producer, &producers[i]);
+    }
+    uint32_t next[TEST_QUEUE_PRODUCERS] = {0};
+    uint32_t count = 0;
+    while (count < TEST_QUEUE_PRODUCERS * TEST_QUEUE_TRANSFERS)
+    {
+        if (!dvz_transfer_queue_dequeue(&queue, &tr))
+            continue;
+        AT(tr.u.buf.offset < TEST_QUEUE_PRODUCERS);
+        AT(tr.u.buf.size == next[tr.u.buf.offset]);
+        next[tr.u.buf.offset]++;
+        count++;
+    }
+    for (uint32_t i = 0; i < TEST_QUEUE_PRODUCERS; i++)
+        pthread_join(threads[i], NULL);
+    AT(dvz_transfer_queue_size(&queue) == 0);
+    dvz_transfer_queue_destroy(&queue);
+
+    // Microbenchmark: by-value ring vs one heap-allocated transfer per request in a FIFO queue.
+    uint32_t batch = DVZ_MAX_FIFO_CAPACITY / 2;
+    DvzClock clock = {0};
+
+    queue = dvz_transfer_queue(DVZ_TRANSFER_QUEUE_CAPACITY);
+    _clock_init(&clock);
+    for (uint32_t i = 0; i < TEST_QUEUE_BENCH / batch; i++)
+    {
+        for (uint32_t j = 0; j < batch; j++)
+            dvz_transfer_queue_enqueue(&queue, tr);
+        for (uint32_t j = 0; j < batch; j++)
+            dvz_transfer_queue_dequeue(&queue, &tr);
+    }
+    double ring = _clock_get(&clock);
+    dvz_transfer_queue_destroy(&queue);
+
+    DvzFifo fifo = dvz_fifo(DVZ_MAX_FIFO_CAPACITY);
+    DvzTransfer* item = NULL;
+    _clock_init(&clock);
+    for (uint32_t i = 0; i < TEST_QUEUE_BENCH / batch; i++)
+    {
+        for (uint32_t j = 0; j < batch; j++)
+        {
+            item = (DvzTransfer*)calloc(1, sizeof(DvzTransfer));
+            *item = tr;
+            dvz_fifo_enqueue(&fifo, item);
+        }
+        for (uint32_t j = 0; j < batch; j++)
+        {
+            item = (DvzTransfer*)dvz_fifo_dequeue(&fifo, false);
+            tr = *item;
+            FREE(item);
+        }
+    }
+    double heap = _clock_get(&clock);
+    dvz_fifo_destroy(&fifo);
+
+    log_info(
+        "%d transfers: ring queue %.1f ns/transfer, heap FIFO queue %.1f ns/transfer",
+        TEST_QUEUE_BENCH, ring * 1e9 / TEST_QUEUE_BENCH, heap * 1e9 / TEST_QUEUE_BENCH);
+
+    return 0;
+}
+
+
+
+#define TEST_READBACKS 8
+
+typedef struct TestReadback TestReadback;
+struct TestReadback
+{
+    DvzBufferRegions br;
+    VkDeviceSize size;
+    uint8_t* expected;
+    uint8_t* data[2]; // the CPU consumes one buffer while the GPU fills the other
+    uint64_t ids[TEST_READBACKS];
+    uint32_t requested, received, valid;
+};
+
+static void _readback_frame(DvzCanvas* canvas, DvzEvent ev)
+{
+    TestReadback* tr = (TestReadback*)ev.user_data;
+    ASSERT(tr != NULL);
+    if (tr->requested >= TEST_READBACKS)
+        return;
+    uint8_t* data = tr->data[tr->requested % 2];
+    tr->ids[tr->requested] = dvz_download_buffers_async(canvas, tr->br, 0, tr->size, data);
+    tr->requested++;
+}
+
+static void _readback_done(DvzCanvas* canvas, DvzEvent ev)
+{
+    TestReadback* tr = (TestReadback*)ev.user_data;
+    ASSERT(tr != NULL);
+    ASSERT(tr->received < TEST_READBACKS);
+    ASSERT(ev.u.dl.id == tr->ids[tr->received]);
+    ASSERT(ev.u.dl.data == tr->data[tr->received % 2]);
+    if (ev.u.dl.size == tr->size && memcmp(ev.u.dl.data, tr->expected, tr->size) == 0)
+        tr->valid++;
+    tr->received++;
+}
+
+int test_canvas_transfer_async(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+    DvzContext* ctx = gpu->context;
+
+    TestReadback tr = {0};
+    tr.size = 64 * 1024;
+    tr.br = dvz_ctx_buffers(ctx, DVZ_BUFFER_TYPE_STORAGE, 1, tr.size);
+    tr.expected = calloc(tr.size, sizeof(uint8_t));
+    for (uint32_t i = 0; i < tr.size; i++)
+        tr.expected[i] = (uint8_t)(i % 251);
+    tr.data[0] = calloc(tr.size, sizeof(uint8_t));
+    tr.data[1] = calloc(tr.size, sizeof(uint8_t));
+    dvz_upload_buffers(canvas, tr.br, 0, tr.size, tr.expected);
+
+    // One asynchronous download per frame, completed at a later frame.
+    dvz_event_callback(canvas, DVZ_EVENT_FRAME, 0, DVZ_EVENT_MODE_SYNC, _readback_frame, &tr);
+    dvz_event_callback(canvas, DVZ_EVENT_DOWNLOAD, 0, DVZ_EVENT_MODE_SYNC, _readback_done, &tr);
+    dvz_app_run(app, TEST_READBACKS);
+    AT(tr.requested == TEST_READBACKS);
+    dvz_download_wait(canvas, tr.ids[TEST_READBACKS - 1]);
+    AT(dvz_download_done(canvas, tr.ids[TEST_READBACKS - 1]));
+    AT(tr.received == TEST_READBACKS);
+    AT(tr.valid == TEST_READBACKS);
+
+    // Texture download, waited on with its handle.
+    uvec3 shape = {64, 64, 1};
+    VkDeviceSize tex_size = 64 * 64 * 4;
+    DvzTexture* tex = dvz_ctx_texture(ctx, 2, shape, VK_FORMAT_R8G8B8A8_UNORM);
+    dvz_upload_texture(canvas, tex, DVZ_ZERO_OFFSET, DVZ_ZERO_OFFSET, tex_size, tr.expected);
+    uint8_t* tex_data = calloc(tex_size, sizeof(uint8_t));
+    uint64_t id =
+        dvz_download_texture_async(canvas, tex, DVZ_ZERO_OFFSET, shape, tex_size, tex_data);
+    dvz_download_wait(canvas, id);
+    AT(memcmp(tex_data, tr.expected, tex_size) == 0);
+
+    FREE(tr.expected);
+    FREE(tr.data[0]);
+    FREE(tr.data[1]);
+    FREE(tex_data);
+    TEST_END
+}
+
+
+
+#define TEST_SYNC_FRAMES 20
+
+typedef struct TestSync TestSync;
+struct TestSync
+{
+    DvzBufferRegions br;
+    VkDeviceSize size;
+    uint8_t* data;
+    uint32_t frames;
+};
+
+static void _sync_frame(DvzCanvas* canvas, DvzEvent ev)
+{
+    TestSync* ts = (TestSync*)ev.user_data;
+    ASSERT(ts != NULL);
+
+    // New data at every frame, uploaded while the previous frames may still be rendering.
+    memset(ts->data, (int)(ts->frames % 256), ts->size);
+    dvz_upload_buffers(canvas, ts->br, 0, ts->size, ts->data);
+    ts->frames++;
+}
+
+int test_canvas_transfer_sync(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+    DvzContext* ctx = gpu->context;
+
+    TestSync ts = {0};
+    ts.size = 1024 * 1024;
+    ts.br = dvz_ctx_buffers(ctx, DVZ_BUFFER_TYPE_STORAGE, 1, ts.size);
+    ts.data = calloc(ts.size, sizeof(uint8_t));
+
+    // Frame time without uploads.
+    DvzClock clock = {0};
+    _clock_init(&clock);
+    dvz_app_run(app, TEST_SYNC_FRAMES);
+    double idle = _clock_get(&clock);
+
+    // Frame time with one upload per frame, synchronized with the rendering on the GPU only.
+    dvz_event_callback(canvas, DVZ_EVENT_FRAME, 0, DVZ_EVENT_MODE_SYNC, _sync_frame, &ts);
+    _clock_init(&clock);
+    dvz_app_run(app, TEST_SYNC_FRAMES);
+    double busy = _clock_get(&clock);
+    log_info(
+        "frame time: %.3f ms without uploads, %.3f ms with uploads",
+        idle * 1000.0 / TEST_SYNC_FRAMES, busy * 1000.0 / TEST_SYNC_FRAMES);
+    AT(ts.frames == TEST_SYNC_FRAMES);
+
+    // The render submissions signal the semaphore that the next uploads wait upon.
+    AT(ctx->staging.render_semaphore == &canvas->sem_render_transfers);
+
+    // The last upload made it to the GPU.
+    uint8_t* data = calloc(ts.size, sizeof(uint8_t));
+    dvz_download_buffers(canvas, ts.br, 0, ts.size, data);
+    AT(memcmp(data, ts.data, ts.size) == 0);
+
+    FREE(ts.data);
+    FREE(data);
+    TEST_END
+}
+
+
+
+#define TEST_FULL_CAPACITY 8
+#define TEST_FULL_UPLOADS  32
+
+static void _full_frame(DvzCanvas* canvas, DvzEvent ev)
+{
+    TestSync* ts = (TestSync*)ev.user_data;
+    ASSERT(ts != NULL);
+    if (ts->frames > 0)
+        return;
+
+    // More uploads than the queue can hold, from the thread that processes the transfers.
+    VkDeviceSize size = ts->size / TEST_FULL_UPLOADS;
+    for (uint32_t i = 0; i < TEST_FULL_UPLOADS; i++)
+        dvz_upload_buffers(canvas, ts->br, i * size, size, ts->data + i * size);
+    ts->frames++;
+}
+
+int test_canvas_transfer_full(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+    DvzContext* ctx = gpu->context;
+
+    // A tiny transfer queue, which the FRAME callback fills up.
+    dvz_transfer_queue_destroy(&canvas->transfers);
+    canvas->transfers = dvz_transfer_queue(TEST_FULL_CAPACITY);
+
+    TestSync ts = {0};
+    ts.size = 64 * 1024;
+    ts.br = dvz_ctx_buffers(ctx, DVZ_BUFFER_TYPE_STORAGE, 1, ts.size);
+    ts.data = calloc(ts.size, sizeof(uint8_t));
+    for (uint32_t i = 0; i < ts.size; i++)
+        ts.data[i] = (uint8_t)(i % 251);
+
+    dvz_event_callback(canvas, DVZ_EVENT_FRAME, 0, DVZ_EVENT_MODE_SYNC, _full_frame, &ts);
+    dvz_app_run(app, 3);
+    AT(ts.frames == 1);
+
+    // All uploads made it to the GPU.
+    uint8_t* data = calloc(ts.size, sizeof(uint8_t));
+    dvz_download_buffers(canvas, ts.br, 0, ts.size, data);
+    AT(memcmp(data, ts.data, ts.size) == 0);
+
+    FREE(ts.data);
+    FREE(data);
+    TEST_END
+}
+
+
+
+#define TEST_MAPPABLE_FRAMES 10
+
+static void _mappable_frame(DvzCanvas* canvas, DvzEvent ev)
+{
+    TestSync* ts = (TestSync*)ev.user_data;
+    ASSERT(ts != NULL);
+
+    // Streaming data, written directly into the region of the current swapchain image.
+    memset(ts->data, (int)(100 + ts->frames), ts->size);
+    dvz_upload_buffers(canvas, ts->br, 0, ts->size, ts->data);
+    ts->frames++;
+}
+
+int test_canvas_vertex_mappable(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+    DvzContext* ctx = gpu->context;
+    uint32_t img_count = canvas->swapchain.img_count;
+
+    TestSync ts = {0};
+    ts.size = 64 * 1024;
+    ts.br = dvz_ctx_buffers(ctx, DVZ_BUFFER_TYPE_VERTEX_MAPPABLE, img_count, ts.size);
+    AT(ts.br.count == img_count);
+    AT(ts.br.buffer->mmap != NULL);
+    ts.data = calloc(ts.size, sizeof(uint8_t));
+    uint8_t* data = calloc(ts.size, sizeof(uint8_t));
+
+    // When the app is not running, all copies are updated.
+    memset(ts.data, 42, ts.size);
+    dvz_upload_buffers(canvas, ts.br, 0, ts.size, ts.data);
+    for (uint32_t i = 0; i < img_count; i++)
+    {
+        dvz_buffer_download(ts.br.buffer, ts.br.offsets[i], ts.size, data);
+        AT(memcmp(data, ts.data, ts.size) == 0);
+    }
+
+    // Per-frame uploads do not go through the staging buffer.
+    uint32_t submit_count = ctx->staging.submit_count;
+    dvz_event_callback(canvas, DVZ_EVENT_FRAME, 0, DVZ_EVENT_MODE_SYNC, _mappable_frame, &ts);
+    dvz_app_run(app, TEST_MAPPABLE_FRAMES);
+    AT(ts.frames == TEST_MAPPABLE_FRAMES);
+    AT(ctx->staging.submit_count == submit_count);
+
+    // The region of the last rendered image has the last data.
+    dvz_buffer_download(ts.br.buffer, ts.br.offsets[canvas->swapchain.img_idx], ts.size, data);
+    AT(memcmp(data, ts.data, ts.size) == 0);
+
+    FREE(ts.data);
+    FREE(data);
+    TEST_END
+}
+
+
+
+static void _enqueue_move(DvzCanvas* canvas, float x)
+{
+    DvzEvent ev = {0};
+    ev.type = DVZ_EVENT_MOUSE_MOVE;
+    ev.u.m.pos[0] = ev.u.m.pos[1] = x;
+    _event_enqueue(canvas, ev);
+}
+
+static void _enqueue_wheel(DvzCanvas* canvas, float dy)
+{
+    DvzEvent ev = {0};
+    ev.type = DVZ_EVENT_MOUSE_WHEEL;
+    ev.u.w.dir[1] = dy;
+    _event_enqueue(canvas, ev);
+}
+
+static void _enqueue_key(DvzCanvas* canvas, DvzEventType type)
+{
+    DvzEvent ev = {0};
+    ev.type = type;
+    ev.u.k.key_code = DVZ_KEY_A;
+    _event_enqueue(canvas, ev);
+}
+
+int test_canvas_events_coalesce(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+    DvzFifo* fifo = &canvas->event_queue;
+
+    // Stop the event thread so that the events pile up in the queue.
+    dvz_event_stop(canvas);
+    dvz_thread_join(&canvas->event_thread);
+    AT(dvz_fifo_size(fifo) == 0);
+
+    // Moves and wheel events are merged, but not across a discrete event.
+    _enqueue_move(canvas, 1);
+    _enqueue_wheel(canvas, 1);
+    _enqueue_move(canvas, 2);
+    _enqueue_wheel(canvas, 2);
+    _enqueue_key(canvas, DVZ_EVENT_KEY_PRESS);
+    _enqueue_move(canvas, 3);
+    _enqueue_wheel(canvas, 4);
+    AT(dvz_fifo_size(fifo) == 5);
+    AT(dvz_event_pending(canvas, DVZ_EVENT_MOUSE_MOVE) == 2);
+    AT(dvz_event_pending(canvas, DVZ_EVENT_KEY_PRESS) == 1);
+
+    DvzEvent ev = _event_dequeue(canvas, false);
+    AT(ev.type == DVZ_EVENT_MOUSE_MOVE);
+    AT(ev.u.m.pos[0] == 2);
+    ev = _event_dequeue(canvas, false);
+    AT(ev.type == DVZ_EVENT_MOUSE_WHEEL);
+    AT(ev.u.w.dir[1] == 3);
+    ev = _event_dequeue(canvas, false);
+    AT(ev.type == DVZ_EVENT_KEY_PRESS);
+    // Once dequeued, an event does not absorb the next ones.
+    ev = _event_dequeue(canvas, false);
+    AT(ev.type == DVZ_EVENT_MOUSE_MOVE);
+    AT(ev.u.m.pos[0] == 3);
+    _enqueue_wheel(canvas, 8);
+    ev = _event_dequeue(canvas, false);
+    AT(ev.type == DVZ_EVENT_MOUSE_WHEEL);
+    AT(ev.u.w.dir[1] == 4);
+    ev = _event_dequeue(canvas, false);
+    AT(ev.type == DVZ_EVENT_MOUSE_WHEEL);
+    AT(ev.u.w.dir[1] == 8);
+    AT(_event_dequeue(canvas, false).type == DVZ_EVENT_NONE);
+
+    // High-rate input: the queue stays short and the discrete events are kept.
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        _enqueue_move(canvas, i);
+        if (i == 500)
+            _enqueue_key(canvas, DVZ_EVENT_KEY_RELEASE);
+    }
+    AT(dvz_fifo_size(fifo) == 3);
+    AT(_event_dequeue(canvas, false).u.m.pos[0] == 500);
+    AT(_event_dequeue(canvas, false).type == DVZ_EVENT_KEY_RELEASE);
+    AT(_event_dequeue(canvas, false).u.m.pos[0] == 999);
+    AT(dvz_event_pending(canvas, DVZ_EVENT_MOUSE_MOVE) == 0);
+
+    // Restart the event thread, which is stopped when the canvas is destroyed.
+    canvas->event_thread = dvz_thread(_event_thread, canvas);
+    TEST_END
+}
+
+
+
+typedef struct _WorkersTest _WorkersTest;
+struct _WorkersTest
+{
+    int keys[5];
+    atomic(int, slow_count);
+    atomic(int, fast_count);
+    atomic(int, running);
+    int fast_seen;
+    bool overlap;
+};
+
+static void _slow_callback(DvzCanvas* canvas, DvzEvent ev)
+{
+    _WorkersTest* test = (_WorkersTest*)ev.user_data;
+    atomic_fetch_add(&test->running, 1);
+    dvz_sleep(20);
+    atomic_fetch_sub(&test->running, 1);
+    int i = atomic_load(&test->slow_count);
+    // The other callback should have processed all events while this one was busy.
+    if (i == 0)
+        test->fast_seen = atomic_load(&test->fast_count);
+    test->keys[i] = (int)ev.u.k.key_code;
+    atomic_fetch_add(&test->slow_count, 1);
+}
+
+static void _fast_callback(DvzCanvas* canvas, DvzEvent ev)
+{
+    _WorkersTest* test = (_WorkersTest*)ev.user_data;
+    atomic_fetch_add(&test->fast_count, 1);
+}
+
+static void _sync_callback(DvzCanvas* canvas, DvzEvent ev)
+{
+    _WorkersTest* test = (_WorkersTest*)ev.user_data;
+    if (atomic_load(&test->running) > 0)
+        test->overlap = true;
+}
+
+int test_canvas_events_workers(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+
+    _WorkersTest test = {0};
+    atomic_init(&test.slow_count, 0);
+    atomic_init(&test.fast_count, 0);
+    atomic_init(&test.running, 0);
+    dvz_event_workers(canvas, 4);
+    dvz_event_callback(
+        canvas, DVZ_EVENT_KEY_PRESS, 0, DVZ_EVENT_MODE_ASYNC, _slow_callback, &test);
+    dvz_event_callback(
+        canvas, DVZ_EVENT_KEY_PRESS, 0, DVZ_EVENT_MODE_ASYNC, _fast_callback, &test);
+    dvz_event_callback(canvas, DVZ_EVENT_KEY_PRESS, 0, DVZ_EVENT_MODE_SYNC, _sync_callback, &test);
+
+    for (int i = 0; i < 5; i++)
+        dvz_event_key_press(canvas, (DvzKeyCode)(DVZ_KEY_A + i), 0);
+    for (int i = 0; i < 1000; i++)
+    {
+        if (atomic_load(&test.slow_count) == 5 &&
+            dvz_event_pending(canvas, DVZ_EVENT_KEY_PRESS) == 0)
+            break;
+        dvz_sleep(1);
+    }
+    AT(dvz_event_pending(canvas, DVZ_EVENT_KEY_PRESS) == 0);
+
+    // The slow callback did not delay the fast one, and received the events in order.
+    AT(test.fast_seen == 5);
+    AT(atomic_load(&test.slow_count) == 5);
+    for (int i = 0; i < 5; i++)
+        AT(test.keys[i] == DVZ_KEY_A + i);
+    // The sync callback never ran while an async callback was running.
+    AT(!test.overlap);
+
+    DvzEventStats stats = dvz_event_stats(canvas, _slow_callback);
+    AT(stats.count == 5);
+    AT(stats.duration >= .015);
+    AT(stats.duration_max >= stats.duration);
+    // The last event waited for the four previous ones.
+    AT(stats.latency_max >= 4 * .015);
+    AT(dvz_event_stats(canvas, _fast_callback).count == 5);
+
+    TEST_END
+}
+
+
+
+static void _idle_timer_callback(DvzCanvas* canvas, DvzEvent ev)
+{
+    int* count = (int*)ev.user_data;
+    (*count)++;
+}
+
+int test_canvas_on_demand(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, DVZ_CANVAS_FLAGS_ON_DEMAND);
+    AT(canvas->on_demand);
+
+    // The timer wakes up the idle event loop without rendering any frame.
+    int timer_count = 0;
+    dvz_event_callback(
+        canvas, DVZ_EVENT_TIMER, .005, DVZ_EVENT_MODE_SYNC, _idle_timer_callback, &timer_count);
+
+    // The first frames refill the command buffers, then the canvas becomes idle.
+    dvz_app_run(app, 20);
+    uint64_t frame_idx = canvas->frame_idx;
+    log_debug("%d frames rendered out of 20 iterations", (int)frame_idx);
+    AT(frame_idx > 0);
+    AT(frame_idx < 20);
+    AT(timer_count > 0);
+
+    // A frame request renders one frame per swapchain image.
+    dvz_canvas_to_render(canvas);
+    AT(atomic_load(&canvas->frames_dirty) > 0);
+    dvz_app_run(app, 20);
+    AT(canvas->frame_idx >= frame_idx + canvas->swapchain.img_count);
+    AT(atomic_load(&canvas->frames_dirty) == 0);
+
+    TEST_END
+}
+
+
+
 /*************************************************************************************************/
 /*  Canvas 1                                                                                     */
 /*************************************************************************************************/
@@ -1165,6 +1918,71 @@ int test_canvas_offscreen(TestContext* context)
 
 
 
+static void _count_frames(DvzCanvas* canvas, DvzEvent ev)
+{
+    ASSERT(canvas != NULL);
+    uint32_t* count = (uint32_t*)ev.user_data;
+    ASSERT(count != NULL);
+    (*count)++;
+}
+
+#define TEST_WORKERS_FRAMES 20
+
+int test_canvas_offscreen_workers(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+
+    const uint32_t n = 4;
+    DvzCanvas* canvas[4] = {0};
+    TestVisual visual[4] = {0};
+    uint32_t frames[4] = {0};
+    for (uint32_t i = 0; i < n; i++)
+    {
+        canvas[i] = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+        AT(canvas[i] != NULL);
+        _make_triangle2(canvas[i], &visual[i], "");
+        dvz_event_callback(
+            canvas[i], DVZ_EVENT_REFILL, 0, DVZ_EVENT_MODE_SYNC, _triangle_refill, &visual[i]);
+        dvz_event_callback(
+            canvas[i], DVZ_EVENT_FRAME, 0, DVZ_EVENT_MODE_SYNC, _count_frames, &frames[i]);
+    }
+
+    // Warm up, then prepare the frames of the offscreen canvases one after the other.
+    dvz_app_run(app, 2);
+    DvzClock clock = {0};
+    _clock_init(&clock);
+    dvz_app_run(app, TEST_WORKERS_FRAMES);
+    double serial = _clock_get(&clock);
+
+    // Prepare them in parallel.
+    dvz_app_workers(app, n);
+    AT(app->frame_workers_count == n);
+    _clock_init(&clock);
+    dvz_app_run(app, TEST_WORKERS_FRAMES);
+    double parallel = _clock_get(&clock);
+    log_info(
+        "%d offscreen canvases: %.3f ms per frame with the main thread, %.3f ms with %d workers",
+        n, serial * 1000.0 / TEST_WORKERS_FRAMES, parallel * 1000.0 / TEST_WORKERS_FRAMES, n);
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        AT(frames[i] == 2 + 2 * TEST_WORKERS_FRAMES);
+        AT(canvas[i]->frame_idx == 2 + 2 * TEST_WORKERS_FRAMES);
+    }
+
+    dvz_app_workers(app, 0);
+    AT(app->frame_workers_count == 0);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        dvz_graphics_destroy(&visual[i].graphics);
+        destroy_visual(&visual[i]);
+    }
+    TEST_END
+}
+
+
+
 /*************************************************************************************************/
 /*  Canvas GUI                                                                                   */
 /*************************************************************************************************/
@@ -12,6 +12,17 @@
 
 int test_canvas_transfer_buffer(TestContext* context);
 int test_canvas_transfer_texture(TestContext* context);
+int test_canvas_transfer_staging(TestContext* context);
+int test_canvas_transfer_stream(TestContext* context);
+int test_canvas_transfer_batch(TestContext* context);
+int test_canvas_transfer_queue(TestContext* context);
+int test_canvas_transfer_async(TestContext* context);
+int test_canvas_transfer_sync(TestContext* context);
+int test_canvas_transfer_full(TestContext* context);
+int test_canvas_vertex_mappable(TestContext* context);
+int test_canvas_events_coalesce(TestContext* context);
+int test_canvas_events_workers(TestContext* context);
+int test_canvas_on_demand(TestContext* context);
 int test_canvas_1(TestContext* context);
 int test_canvas_2(TestContext* context);
 int test_canvas_3(TestContext* context);
@@ -24,6 +35,7 @@ int test_canvas_depth(TestContext* context);
 int test_canvas_append(TestContext* context);
 int test_canvas_particles(TestContext* context);
 int test_canvas_offscreen(TestContext* context);
+int test_canvas_offscreen_workers(TestContext* context);
 int test_canvas_gui_1(TestContext* context);
 int test_canvas_screencast(TestContext* context);
 
@@ -1,4 +1,6 @@
 #include "test_common.h"
+#include "../include/datoviz/alloc.h"
+#include "../include/datoviz/app.h"
 #include "../include/datoviz/common.h"
 
 
@@ -232,3 +234,217 @@ int test_fifo_3(TestContext* context)
     dvz_fifo_destroy(&fifo);
     return 0;
 }
+
+
+
+#define TEST_FIFO_PRODUCERS 4
+#define TEST_FIFO_CONSUMERS 2
+#define TEST_FIFO_ITEMS     100000
+
+typedef struct TestFifoThread TestFifoThread;
+struct TestFifoThread
+{
+    DvzFifo* fifo;
+    uint32_t idx;
+    uint32_t* items; // items enqueued by a producer
+    uint32_t count;  // number of items dequeued by a consumer
+    uint64_t sum;    // sum of the items dequeued by a consumer
+    bool in_order;   // whether a consumer saw the items of each producer in order
+};
+
+static void* _fifo_producer(void* arg)
+{
+    TestFifoThread* th = arg;
+    for (uint32_t i = 0; i < TEST_FIFO_ITEMS; i++)
+    {
+        th->items[i] = th->idx * TEST_FIFO_ITEMS + i;
+        dvz_fifo_enqueue(th->fifo, &th->items[i]);
+    }
+    return NULL;
+}
+
+static void* _fifo_consumer(void* arg)
+{
+    TestFifoThread* th = arg;
+    uint32_t* item = NULL;
+    int64_t last[TEST_FIFO_PRODUCERS] = {0};
+    for (uint32_t i = 0; i < TEST_FIFO_PRODUCERS; i++)
+        last[i] = -1;
+    th->in_order = true;
+    while ((item = dvz_fifo_dequeue(th->fifo, true)) != NULL)
+    {
+        uint32_t producer = *item / TEST_FIFO_ITEMS;
+        int64_t i = *item % TEST_FIFO_ITEMS;
+        if (i <= last[producer])
+            th->in_order = false;
+        last[producer] = i;
+        th->sum += *item;
+        th->count++;
+    }
+    return NULL;
+}
+
+// Several producers and consumers on a small queue that needs to grow, return the time taken.
+static double _fifo_contention(uint32_t n_producers, uint32_t n_consumers, bool* ok)
+{
+    ASSERT(n_producers <= TEST_FIFO_PRODUCERS);
+    ASSERT(n_consumers <= TEST_FIFO_CONSUMERS);
+    DvzFifo fifo = dvz_fifo(8);
+    pthread_t producers[TEST_FIFO_PRODUCERS] = {0};
+    pthread_t consumers[TEST_FIFO_CONSUMERS] = {0};
+    TestFifoThread prod[TEST_FIFO_PRODUCERS] = {0};
+    TestFifoThread cons[TEST_FIFO_CONSUMERS] = {0};
+
+    DvzClock clock = {0};
+    _clock_init(&clock);
+    for (uint32_t i = 0; i < n_consumers; i++)
+    {
+        cons[i] = (TestFifoThread){.fifo = &fifo, .idx = i};
+        pthread_create(&consumers[i], NULL, _fifo_consumer, &cons[i]);
+    }
+    for (uint32_t i = 0; i < n_producers; i++)
+    {
+        prod[i] = (TestFifoThread){.fifo = &fifo, .idx = i};
+        prod[i].items = calloc(TEST_FIFO_ITEMS, sizeof(uint32_t));
+        pthread_create(&producers[i], NULL, _fifo_producer, &prod[i]);
+    }
+    for (uint32_t i = 0; i < n_producers; i++)
+        pthread_join(producers[i], NULL);
+    // One NULL item per consumer to stop them.
+    for (uint32_t i = 0; i < n_consumers; i++)
+        dvz_fifo_enqueue(&fifo, NULL);
+    for (uint32_t i = 0; i < n_consumers; i++)
+        pthread_join(consumers[i], NULL);
+    double elapsed = _clock_get(&clock);
+
+    // Check that all items have been dequeued exactly once.
+    uint64_t n = (uint64_t)n_producers * TEST_FIFO_ITEMS;
+    uint64_t count = 0, sum = 0;
+    *ok = dvz_fifo_size(&fifo) == 0;
+    for (uint32_t i = 0; i < n_consumers; i++)
+    {
+        count += cons[i].count;
+        sum += cons[i].sum;
+        // With a single consumer, the order of each producer is preserved.
+        if (n_consumers == 1)
+            *ok &= cons[i].in_order;
+    }
+    *ok &= count == n && sum == n * (n - 1) / 2;
+
+    for (uint32_t i = 0; i < n_producers; i++)
+        FREE(prod[i].items);
+    dvz_fifo_destroy(&fifo);
+    return elapsed;
+}
+
+int test_fifo_4(TestContext* context)
+{
+    bool ok = false;
+    double elapsed = 0;
+    for (uint32_t n_producers = 1; n_producers <= TEST_FIFO_PRODUCERS; n_producers *= 2)
+    {
+        for (uint32_t n_consumers = 1; n_consumers <= TEST_FIFO_CONSUMERS; n_consumers++)
+        {
+            elapsed = _fifo_contention(n_producers, n_consumers, &ok);
+            AT(ok);
+            log_info(
+                "FIFO queue, %d producers, %d consumers: %.1f ns/item", n_producers, n_consumers,
+                elapsed * 1e9 / (n_producers * TEST_FIFO_ITEMS));
+        }
+    }
+    return 0;
+}
+
+
+
+/*************************************************************************************************/
+/*  Allocator                                                                                    */
+/*************************************************************************************************/
+
+int test_alloc_1(TestContext* context)
+{
+    DvzAlloc alloc = dvz_alloc(1024);
+    uint64_t a = 0, b = 0, c = 0;
+
+    // Allocations are packed from the beginning.
+    AT(dvz_alloc_new(&alloc, 100, 0, &a));
+    AT(a == 0);
+    AT(dvz_alloc_new(&alloc, 100, 0, &b));
+    AT(b == 100);
+
+    // Aligned allocation.
+    AT(dvz_alloc_new(&alloc, 100, 256, &c));
+    AT(c == 256);
+
+    DvzAllocStats stats = dvz_alloc_stats(&alloc);
+    AT(stats.alloc_count == 3);
+    AT(stats.allocated == 300);
+    AT(stats.free == 1024 - 300);
+    AT(stats.free_count == 2); // [200, 256) and [356, 1024)
+
+    // Freed space is reused.
+    dvz_alloc_free(&alloc, a, 100);
+    AT(dvz_alloc_new(&alloc, 50, 0, &a));
+    AT(a == 0);
+    dvz_alloc_free(&alloc, a, 50);
+
+    // Freeing everything merges all blocks back.
+    dvz_alloc_free(&alloc, b, 100);
+    dvz_alloc_free(&alloc, c, 100);
+    stats = dvz_alloc_stats(&alloc);
+    AT(stats.alloc_count == 0);
+    AT(stats.free_count == 1);
+    AT(stats.largest_free == 1024);
+    AT(stats.fragmentation == 0);
+
+    // No room left.
+    AT(!dvz_alloc_new(&alloc, 2048, 0, &a));
+    dvz_alloc_grow(&alloc, 4096);
+    AT(dvz_alloc_new(&alloc, 2048, 0, &a));
+    AT(a == 0);
+
+    dvz_alloc_destroy(&alloc);
+    return 0;
+}
+
+
+
+int test_alloc_2(TestContext* context)
+{
+    DvzAlloc alloc = dvz_alloc(1000);
+    uint64_t offsets[10] = {0};
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        AT(dvz_alloc_new(&alloc, 100, 0, &offsets[i]));
+        AT(offsets[i] == i * 100);
+    }
+    AT(!dvz_alloc_new(&alloc, 1, 0, &offsets[0]));
+
+    // Free every other range: 5 free blocks of 100 bytes.
+    for (uint32_t i = 0; i < 10; i += 2)
+        dvz_alloc_free(&alloc, offsets[i], 100);
+    DvzAllocStats stats = dvz_alloc_stats(&alloc);
+    AT(stats.free == 500);
+    AT(stats.free_count == 5);
+    AT(stats.largest_free == 100);
+    AT(stats.fragmentation > .75);
+    AT(!dvz_alloc_new(&alloc, 200, 0, &offsets[0]));
+
+    // In-place resize: growing into the next free block, and shrinking.
+    AT(dvz_alloc_resize(&alloc, offsets[1], 100, 200));
+    AT(!dvz_alloc_resize(&alloc, offsets[1], 200, 300));
+    AT(dvz_alloc_resize(&alloc, offsets[1], 200, 50));
+    stats = dvz_alloc_stats(&alloc);
+    AT(stats.allocated == 450);
+
+    // Freeing the odd ranges merges everything back.
+    dvz_alloc_free(&alloc, offsets[1], 50);
+    for (uint32_t i = 3; i < 10; i += 2)
+        dvz_alloc_free(&alloc, offsets[i], 100);
+    stats = dvz_alloc_stats(&alloc);
+    AT(stats.free_count == 1);
+    AT(stats.free == 1000);
+
+    dvz_alloc_destroy(&alloc);
+    return 0;
+}
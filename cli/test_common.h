@@ -21,6 +21,16 @@ int test_container(TestContext* context);
 int test_fifo_1(TestContext* context);
 int test_fifo_2(TestContext* context);
 int test_fifo_3(TestContext* context);
+int test_fifo_4(TestContext* context);
+
+
+
+/*************************************************************************************************/
+/*  Allocator                                                                                    */
+/*************************************************************************************************/
+
+int test_alloc_1(TestContext* context);
+int test_alloc_2(TestContext* context);
 
 
 
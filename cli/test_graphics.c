@@ -360,6 +360,104 @@ int test_graphics_depth(TestContext* context)
 
 
 
+int test_graphics_pipelines(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+
+    DvzGraphicsType types[] = {
+        DVZ_GRAPHICS_POINT,  DVZ_GRAPHICS_LINE, DVZ_GRAPHICS_TRIANGLE, DVZ_GRAPHICS_MARKER,
+        DVZ_GRAPHICS_SEGMENT, DVZ_GRAPHICS_PATH, DVZ_GRAPHICS_TEXT,     DVZ_GRAPHICS_MESH};
+    const uint32_t n = sizeof(types) / sizeof(types[0]);
+    DvzGraphics* graphics[8] = {0};
+    for (uint32_t i = 0; i < n; i++)
+    {
+        graphics[i] = dvz_graphics_builtin(canvas, types[i], 0);
+        // The pipelines are not compiled yet, but they can already be used to create bindings.
+        AT(dvz_obj_is_created(&graphics[i]->obj));
+        AT(graphics[i]->pipeline == VK_NULL_HANDLE);
+    }
+
+    // Identical graphics are shared.
+    AT(dvz_graphics_builtin(canvas, DVZ_GRAPHICS_PATH, 0) == graphics[5]);
+    AT(canvas->graphics.count == n);
+
+    // Identical shader modules are shared.
+    AT(graphics[1]->shader_modules[0] == graphics[2]->shader_modules[0]);
+    AT(graphics[1]->shader_shared[0]);
+
+    // Compile the pipelines in parallel.
+    dvz_canvas_pipelines(canvas);
+    for (uint32_t i = 0; i < n; i++)
+        AT(graphics[i]->pipeline != VK_NULL_HANDLE);
+
+    TEST_END
+}
+
+
+
+int test_graphics_specialization(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+
+    // Marker graphics specialized for a single marker type, without viewport clipping.
+    DvzSpecialization spec = {0};
+    spec.count = 2;
+    spec.ids[0] = DVZ_SPEC_MARKER;
+    spec.values[0] = DVZ_MARKER_DISC;
+    spec.ids[1] = DVZ_SPEC_CLIP;
+    spec.values[1] = DVZ_VIEWPORT_FULL;
+    DvzGraphics* graphics =
+        dvz_graphics_builtin_specialized(canvas, DVZ_GRAPHICS_MARKER, 0, &spec);
+    AT(graphics->specialization.count == 2);
+
+    // Identical specializations share the same graphics, other ones do not.
+    AT(dvz_graphics_builtin_specialized(canvas, DVZ_GRAPHICS_MARKER, 0, &spec) == graphics);
+    DvzGraphics* generic = dvz_graphics_builtin(canvas, DVZ_GRAPHICS_MARKER, 0);
+    AT(generic != graphics);
+    AT(generic->specialization.count == 0);
+
+    // Volume graphics with a lower quality level.
+    float step = .02f;
+    int32_t max_iter = 500;
+    spec = (DvzSpecialization){0};
+    spec.count = 2;
+    spec.ids[0] = DVZ_SPEC_VOLUME_STEP;
+    memcpy(&spec.values[0], &step, sizeof(float));
+    spec.ids[1] = DVZ_SPEC_VOLUME_MAX_ITER;
+    memcpy(&spec.values[1], &max_iter, sizeof(int32_t));
+    DvzGraphics* volume =
+        dvz_graphics_builtin_specialized(canvas, DVZ_GRAPHICS_VOLUME, 0, &spec);
+    AT(volume->specialization.count == 2);
+
+    // Builtin graphics are shared, so they cannot be specialized in place.
+    DvzGraphics* volume_generic = dvz_graphics_builtin(canvas, DVZ_GRAPHICS_VOLUME, 0);
+    AT(volume_generic != volume);
+    dvz_graphics_specialization(volume_generic, DVZ_SPEC_VOLUME_STEP, &step);
+    AT(volume_generic->specialization.count == 0);
+    AT(dvz_graphics_builtin(canvas, DVZ_GRAPHICS_VOLUME, 0) == volume_generic);
+
+    // Custom graphics can be.
+    DvzGraphics custom = dvz_graphics(gpu);
+    dvz_graphics_specialization(&custom, DVZ_SPEC_VOLUME_MAX_ITER, &max_iter);
+    dvz_graphics_specialization(&custom, DVZ_SPEC_VOLUME_STEP, &step);
+    dvz_graphics_specialization(&custom, DVZ_SPEC_VOLUME_MAX_ITER, &max_iter);
+    AT(custom.specialization.count == 2);
+    dvz_graphics_destroy(&custom);
+
+    dvz_canvas_pipelines(canvas);
+    AT(graphics->pipeline != VK_NULL_HANDLE);
+    AT(generic->pipeline != VK_NULL_HANDLE);
+    AT(volume->pipeline != VK_NULL_HANDLE);
+
+    TEST_END
+}
+
+
+
 /*************************************************************************************************/
 /*  Basic graphics tests                                                                         */
 /*************************************************************************************************/
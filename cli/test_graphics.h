@@ -12,6 +12,8 @@
 int test_graphics_dynamic(TestContext* context);
 int test_graphics_3D(TestContext* context);
 int test_graphics_depth(TestContext* context);
+int test_graphics_pipelines(TestContext* context);
+int test_graphics_specialization(TestContext* context);
 
 // Basic graphics.
 int test_graphics_point(TestContext* context);
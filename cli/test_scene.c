@@ -1,6 +1,7 @@
 #include "test_scene.h"
 #include "../external/video.h"
 #include "../include/datoviz/builtin_visuals.h"
+#include "../include/datoviz/profile.h"
 #include "../include/datoviz/scene.h"
 #include "../src/ticks.h"
 #include "utils.h"
@@ -291,6 +292,459 @@ int test_scene_1(TestContext* context)
 
 
 
+static bool _all_valid(DvzVisual* visual, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+        if (!visual->fill_valid[i])
+            return false;
+    return true;
+}
+
+static DvzVisualFillCallback _fill_default;
+static uint32_t _fill_count;
+
+// Count the recordings of a visual, on top of its builtin fill callback.
+static void _counting_fill(DvzVisual* visual, DvzVisualFillEvent ev)
+{
+    _fill_count++;
+    _fill_default(visual, ev);
+}
+
+int test_scene_refill(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, CANVAS_FLAGS);
+
+    DvzScene* scene = dvz_scene(canvas, 1, 1);
+    DvzPanel* panel = dvz_scene_panel(scene, 0, 0, DVZ_CONTROLLER_PANZOOM, 0);
+    DvzVisual* visual = dvz_scene_visual(panel, DVZ_VISUAL_POINT, 0);
+    DvzVisual* visual2 = dvz_scene_visual(panel, DVZ_VISUAL_POINT, 0);
+
+    const uint32_t N = 1000;
+    dvec3* pos = calloc(N, sizeof(dvec3));
+    for (uint32_t i = 0; i < N; i++)
+    {
+        RANDN_POS(pos[i])
+    }
+    dvz_visual_data(visual, DVZ_PROP_POS, 0, N, pos);
+    dvz_visual_data(visual2, DVZ_PROP_POS, 0, N, pos);
+    _fill_default = visual2->callback_fill;
+    _fill_count = 0;
+    visual2->callback_fill = _counting_fill;
+
+    // The first frames record the secondary command buffers of both visuals.
+    dvz_app_run(app, 10);
+    uint32_t img_count = canvas->swapchain.img_count;
+    AT(visual->cmds_fill.count == img_count);
+    AT(_all_valid(visual, img_count));
+    AT(_all_valid(visual2, img_count));
+    AT(_fill_count == img_count);
+
+    // A change in one visual only invalidates its own command buffers.
+    dvz_visual_to_refill(visual);
+    AT(!visual->fill_valid[0]);
+    AT(_all_valid(visual2, img_count));
+    AT(atomic_load(&canvas->refills.status) == DVZ_REFILL_REQUESTED);
+
+    // The refill records them again.
+    dvz_app_run(app, 10);
+    AT(_all_valid(visual, img_count));
+    // The other visual was not recorded again.
+    AT(_fill_count == img_count);
+
+    // Changing the number of points leaves the command buffers valid.
+    dvz_visual_data(visual, DVZ_PROP_POS, 0, N / 2, pos);
+    dvz_app_run(app, 10);
+    AT(_all_valid(visual, img_count));
+    AT(_all_valid(visual2, img_count));
+    AT(_fill_count == img_count);
+
+    dvz_visual_destroy(visual);
+    dvz_visual_destroy(visual2);
+    dvz_scene_destroy(scene);
+    FREE(pos);
+    TEST_END
+}
+
+
+
+static void _count_refills(DvzCanvas* canvas, DvzEvent ev)
+{
+    uint32_t* count = (uint32_t*)ev.user_data;
+    ASSERT(count != NULL);
+    (*count)++;
+}
+
+int test_scene_indirect(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, CANVAS_FLAGS);
+
+    DvzScene* scene = dvz_scene(canvas, 1, 1);
+    DvzPanel* panel = dvz_scene_panel(scene, 0, 0, DVZ_CONTROLLER_PANZOOM, 0);
+    DvzVisual* visual = dvz_scene_visual(panel, DVZ_VISUAL_POINT, 0);
+
+    const uint32_t N = 1000;
+    dvec3* pos = calloc(2 * N, sizeof(dvec3));
+    for (uint32_t i = 0; i < 2 * N; i++)
+    {
+        RANDN_POS(pos[i])
+    }
+    dvz_visual_data(visual, DVZ_PROP_POS, 0, N, pos);
+
+    uint32_t refills = 0;
+    dvz_event_callback(canvas, DVZ_EVENT_REFILL, 0, DVZ_EVENT_MODE_SYNC, _count_refills, &refills);
+
+    dvz_app_run(app, 10);
+    AT(visual->draw_indirect);
+    AT(visual->indirect[0].buffer != NULL);
+    AT(visual->indirect_args[0].draw.vertexCount == N);
+
+    // Shrinking or growing within the capacity of the vertex buffer only updates the indirect
+    // draw parameters.
+    refills = 0;
+    dvz_visual_data(visual, DVZ_PROP_POS, 0, N / 2, pos);
+    dvz_app_run(app, 10);
+    AT(visual->indirect_args[0].draw.vertexCount == N / 2);
+    dvz_visual_data(visual, DVZ_PROP_POS, 0, N, pos);
+    dvz_app_run(app, 10);
+    AT(visual->indirect_args[0].draw.vertexCount == N);
+    AT(refills == 0);
+
+    // Growing beyond the capacity reallocates the vertex buffer, which requires a refill.
+    dvz_visual_data(visual, DVZ_PROP_POS, 0, 2 * N, pos);
+    dvz_app_run(app, 10);
+    AT(visual->indirect_args[0].draw.vertexCount == 2 * N);
+    AT(refills > 0);
+
+    dvz_visual_destroy(visual);
+    dvz_scene_destroy(scene);
+    FREE(pos);
+    TEST_END
+}
+
+
+
+static void _idle_timer(DvzCanvas* canvas, DvzEvent ev)
+{
+    uint32_t* count = (uint32_t*)ev.user_data;
+    ASSERT(count != NULL);
+    (*count)++;
+}
+
+int test_scene_on_demand(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, DVZ_CANVAS_FLAGS_ON_DEMAND);
+    AT(canvas->on_demand);
+
+    DvzScene* scene = dvz_scene(canvas, 1, 1);
+    DvzPanel* panel = dvz_scene_panel(scene, 0, 0, DVZ_CONTROLLER_PANZOOM, 0);
+    DvzVisual* visual = dvz_scene_visual(panel, DVZ_VISUAL_POINT, 0);
+
+    const uint32_t N = 1000;
+    dvec3* pos = calloc(N, sizeof(dvec3));
+    for (uint32_t i = 0; i < N; i++)
+    {
+        RANDN_POS(pos[i])
+    }
+    dvz_visual_data(visual, DVZ_PROP_POS, 0, N, pos);
+
+    // The timer wakes up the idle event loop without rendering any frame.
+    uint32_t timer_count = 0;
+    dvz_event_callback(
+        canvas, DVZ_EVENT_TIMER, .005, DVZ_EVENT_MODE_SYNC, _idle_timer, &timer_count);
+
+    // The first frames upload the data and the MVP, then the scene becomes idle.
+    dvz_app_run(app, 30);
+    uint64_t frame_idx = canvas->frame_idx;
+    log_debug("%d frames rendered out of 30 iterations", (int)frame_idx);
+    AT(frame_idx > 0);
+    dvz_app_run(app, 30);
+    AT(canvas->frame_idx == frame_idx);
+    AT(timer_count > 0);
+
+    // New data wakes up the canvas, which becomes idle again.
+    dvz_visual_data(visual, DVZ_PROP_POS, 0, N / 2, pos);
+    dvz_app_run(app, 30);
+    AT(canvas->frame_idx > frame_idx);
+    frame_idx = canvas->frame_idx;
+    dvz_app_run(app, 30);
+    AT(canvas->frame_idx == frame_idx);
+
+    dvz_visual_destroy(visual);
+    dvz_scene_destroy(scene);
+    FREE(pos);
+    TEST_END
+}
+
+
+
+int test_scene_profile(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, CANVAS_FLAGS);
+
+    DvzScene* scene = dvz_scene(canvas, 1, 1);
+    DvzPanel* panel = dvz_scene_panel(scene, 0, 0, DVZ_CONTROLLER_PANZOOM, 0);
+    DvzVisual* visual = dvz_scene_visual(panel, DVZ_VISUAL_POINT, 0);
+    DvzVisual* visual2 = dvz_scene_visual(panel, DVZ_VISUAL_POINT, 0);
+
+    const uint32_t N = 10000;
+    dvec3* pos = calloc(N, sizeof(dvec3));
+    for (uint32_t i = 0; i < N; i++)
+    {
+        RANDN_POS(pos[i])
+    }
+    dvz_visual_data(visual, DVZ_PROP_POS, 0, N, pos);
+    dvz_visual_data(visual2, DVZ_PROP_POS, 0, N, pos);
+
+    // The timestamps are collected a few frames after their submission.
+    dvz_canvas_profile(canvas, true);
+    AT(canvas->profile.enabled);
+    dvz_app_run(app, 20);
+
+    DvzCanvasStats stats = dvz_canvas_stats(canvas);
+    int slot = dvz_canvas_profile_slot(canvas, visual);
+    int slot2 = dvz_canvas_profile_slot(canvas, visual2);
+    AT(slot >= 0);
+    AT(slot2 >= 0);
+    AT(slot != slot2);
+    AT(stats.frame_idx > 0);
+    AT(stats.gpu_frame > 0);
+    AT(stats.gpu_slots[slot] >= 0);
+    AT(stats.gpu_slots[slot2] >= 0);
+    AT(stats.gpu_slots[slot] <= stats.gpu_frame);
+    AT(stats.gpu_transfers >= 0);
+    log_debug(
+        "GPU frame %.3f ms, visuals %.3f ms and %.3f ms", //
+        stats.gpu_frame, stats.gpu_slots[slot], stats.gpu_slots[slot2]);
+
+    // The staging timestamps are shared by the canvases of the context: they stay enabled until
+    // the last profiled canvas stops profiling, or is destroyed.
+    DvzContext* ctx = gpu->context;
+    bool staging_profile = ctx->staging.profile;
+    AT(ctx->profile_count == 1);
+    DvzCanvas* canvas2 = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, CANVAS_FLAGS);
+    dvz_canvas_profile(canvas2, true);
+    AT(ctx->profile_count == 2);
+    dvz_canvas_profile(canvas2, false);
+    AT(ctx->profile_count == 1);
+    AT(ctx->staging.profile == staging_profile);
+    dvz_canvas_profile(canvas2, true);
+    dvz_canvas_destroy(canvas2);
+    AT(ctx->profile_count == 1);
+    AT(ctx->staging.profile == staging_profile);
+
+    dvz_canvas_profile(canvas, false);
+    AT(!canvas->profile.enabled);
+    AT(ctx->profile_count == 0);
+    AT(!ctx->staging.profile);
+    dvz_app_run(app, 5);
+
+    // Destroying a visual releases its slot. The visual is still in the panel, so this is done
+    // after the last frame.
+    AT(canvas->profile.slots[slot2] == visual2);
+    dvz_visual_destroy(visual2);
+    AT(canvas->profile.slots[slot2] == NULL);
+
+    dvz_visual_destroy(visual);
+    dvz_scene_destroy(scene);
+    FREE(pos);
+    TEST_END
+}
+
+
+
+int test_scene_instrument(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, CANVAS_FLAGS);
+
+    DvzScene* scene = dvz_scene(canvas, 1, 1);
+    DvzPanel* panel = dvz_scene_panel(scene, 0, 0, DVZ_CONTROLLER_PANZOOM, 0);
+    DvzVisual* visual = dvz_scene_visual(panel, DVZ_VISUAL_POINT, 0);
+
+    const uint32_t N = 1000;
+    dvec3* pos = calloc(N, sizeof(dvec3));
+    for (uint32_t i = 0; i < N; i++)
+    {
+        RANDN_POS(pos[i])
+    }
+    dvz_visual_data(visual, DVZ_PROP_POS, 0, N, pos);
+
+    dvz_profile_reset();
+    dvz_app_run(app, 20);
+
+    DvzProfileStats stats = {0};
+    for (uint32_t i = 0; i < DVZ_PROFILE_COUNT; i++)
+    {
+        stats = dvz_profile_stats((DvzProfilePhase)i);
+        log_debug(
+            "%-16s n=%-4d p50 %.3f ms, p95 %.3f ms, p99 %.3f ms", dvz_profile_name(i),
+            (int)stats.count, stats.p50, stats.p95, stats.p99);
+        AT(stats.p50 <= stats.p95);
+        AT(stats.p95 <= stats.p99);
+        AT(stats.p99 <= stats.max);
+    }
+
+    // The scopes compile to nothing without profiling.
+    stats = dvz_profile_stats(DVZ_PROFILE_FRAME);
+    AT(HAS_PROFILING ? stats.count > 0 : stats.count == 0);
+    stats = dvz_profile_stats(DVZ_PROFILE_VISUAL_UPDATE);
+    AT(HAS_PROFILING ? stats.count > 0 : stats.count == 0);
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/trace.json", ARTIFACTS_DIR);
+    AT(dvz_profile_trace(path) == 0);
+    size_t size = 0;
+    char* trace = (char*)dvz_read_file(path, &size);
+    AT(trace != NULL);
+    AT(size > 0);
+    AT(strncmp(trace, "{\"traceEvents\":[", 16) == 0);
+    FREE(trace);
+
+    dvz_profile_reset();
+    AT(dvz_profile_stats(DVZ_PROFILE_FRAME).count == 0);
+
+    dvz_visual_destroy(visual);
+    dvz_scene_destroy(scene);
+    FREE(pos);
+    TEST_END
+}
+
+
+
+int test_scene_bake(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, CANVAS_FLAGS);
+
+    DvzScene* scene = dvz_scene(canvas, 1, 1);
+    DvzPanel* panel = dvz_scene_panel(scene, 0, 0, DVZ_CONTROLLER_PANZOOM, 0);
+
+    const uint32_t n_visuals = 8;
+    const uint32_t N = 10000;
+    DvzVisual* visuals[8] = {0};
+    dvec3* pos = calloc(n_visuals * N, sizeof(dvec3));
+    for (uint32_t i = 0; i < n_visuals * N; i++)
+    {
+        RANDN_POS(pos[i])
+    }
+    for (uint32_t i = 0; i < n_visuals; i++)
+    {
+        visuals[i] = dvz_scene_visual(panel, DVZ_VISUAL_PATH, 0);
+        dvz_visual_data(visuals[i], DVZ_PROP_POS, 0, N, &pos[i * N]);
+    }
+
+    // Bake the visuals concurrently.
+    dvz_scene_workers(scene, 4);
+    AT(scene->bake_workers_count == 4);
+    DvzClock clock = {0};
+    _clock_init(&clock);
+    dvz_app_run(app, 3);
+    log_debug("parallel bake: %.3f ms", _clock_get(&clock) * 1000);
+
+    // Keep a copy of the baked vertices.
+    DvzArray* arr = NULL;
+    VkDeviceSize sizes[8] = {0};
+    void* baked[8] = {0};
+    for (uint32_t i = 0; i < n_visuals; i++)
+    {
+        AT(!visuals[i]->baked);
+        arr = dvz_source_array(visuals[i], DVZ_SOURCE_TYPE_VERTEX, 0);
+        AT(arr->item_count > 0);
+        sizes[i] = arr->item_count * arr->item_size;
+        baked[i] = calloc(sizes[i], 1);
+        memcpy(baked[i], arr->data, sizes[i]);
+    }
+
+    // Bake the same data again in the main thread, the vertices must be identical.
+    dvz_scene_workers(scene, 0);
+    AT(scene->bake_workers_count == 0);
+    for (uint32_t i = 0; i < n_visuals; i++)
+        dvz_visual_data(visuals[i], DVZ_PROP_POS, 0, N, &pos[i * N]);
+    _clock_init(&clock);
+    dvz_app_run(app, 3);
+    log_debug("serial bake: %.3f ms", _clock_get(&clock) * 1000);
+
+    for (uint32_t i = 0; i < n_visuals; i++)
+    {
+        arr = dvz_source_array(visuals[i], DVZ_SOURCE_TYPE_VERTEX, 0);
+        AT(arr->item_count * arr->item_size == sizes[i]);
+        AT(memcmp(arr->data, baked[i], sizes[i]) == 0);
+        FREE(baked[i]);
+    }
+
+    dvz_scene_destroy(scene);
+    FREE(pos);
+    TEST_END
+}
+
+
+
+int test_scene_float(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, CANVAS_FLAGS);
+
+    DvzScene* scene = dvz_scene(canvas, 1, 1);
+    DvzPanel* panel = dvz_scene_panel(scene, 0, 0, DVZ_CONTROLLER_PANZOOM, 0);
+
+    // Same positions in double and single precision.
+    const uint32_t N = 10000;
+    dvec3* pos = calloc(N, sizeof(dvec3));
+    vec3* pos_f = calloc(N, sizeof(vec3));
+    for (uint32_t i = 0; i < N; i++)
+    {
+        RANDN_POS(pos[i])
+        for (uint32_t j = 0; j < 3; j++)
+            pos_f[i][j] = (float)pos[i][j];
+    }
+
+    DvzVisual* visual = dvz_scene_visual(panel, DVZ_VISUAL_POINT, 0);
+    dvz_visual_data(visual, DVZ_PROP_POS, 0, N, pos);
+
+    DvzVisual* visual_f = dvz_scene_visual(panel, DVZ_VISUAL_POINT, 0);
+    DvzProp* prop = dvz_prop_get(visual_f, DVZ_PROP_POS, 0);
+    dvz_visual_prop_float(prop);
+    AT(prop->dtype == DVZ_DTYPE_VEC3);
+    dvz_visual_data(visual_f, DVZ_PROP_POS, 0, N, pos_f);
+
+    dvz_app_run(app, 3);
+
+    // The single-precision prop has no transformed array, and the same vertices.
+    AT(prop->arr_orig.item_size == sizeof(vec3));
+    AT(prop->arr_trans.item_count == 0);
+    DvzArray* arr = dvz_source_array(visual, DVZ_SOURCE_TYPE_VERTEX, 0);
+    DvzArray* arr_f = dvz_source_array(visual_f, DVZ_SOURCE_TYPE_VERTEX, 0);
+    AT(arr->item_count == N);
+    AT(arr_f->item_count == N);
+    DvzVertex* vertex = NULL;
+    DvzVertex* vertex_f = NULL;
+    for (uint32_t i = 0; i < N; i++)
+    {
+        vertex = (DvzVertex*)dvz_array_item(arr, i);
+        vertex_f = (DvzVertex*)dvz_array_item(arr_f, i);
+        for (uint32_t j = 0; j < 3; j++)
+            AC(vertex_f->pos[j], vertex->pos[j], 1e-5);
+    }
+
+    dvz_scene_destroy(scene);
+    FREE(pos);
+    FREE(pos_f);
+    TEST_END
+}
+
+
+
 static void _rotate(DvzCanvas* canvas, DvzEvent ev)
 {
     DvzPanel* panel = (DvzPanel*)ev.user_data;
@@ -15,6 +15,13 @@ int test_axes_3(TestContext* context);
 
 int test_scene_0(TestContext* context);
 int test_scene_1(TestContext* context);
+int test_scene_refill(TestContext* context);
+int test_scene_indirect(TestContext* context);
+int test_scene_on_demand(TestContext* context);
+int test_scene_profile(TestContext* context);
+int test_scene_instrument(TestContext* context);
+int test_scene_bake(TestContext* context);
+int test_scene_float(TestContext* context);
 int test_scene_mesh(TestContext* context);
 int test_scene_axes(TestContext* context);
 int test_scene_logistic(TestContext* context);
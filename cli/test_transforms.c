@@ -215,3 +215,60 @@ int test_transforms_5(TestContext* context)
 
     TEST_END
 }
+
+
+
+int test_transforms_6(TestContext* context)
+{
+    const uint32_t n = 1000;
+    DvzDataCoords coords = {0};
+    coords.box = (DvzBox){{-5, -2, -1}, {5, 8, 1}};
+    coords.transform = DVZ_TRANSFORM_CARTESIAN;
+
+    // Double- and single-precision positions.
+    DvzArray pos = dvz_array(n, DVZ_DTYPE_DVEC3);
+    DvzArray pos_f = dvz_array(n, DVZ_DTYPE_VEC3);
+    DvzArray pos_tr = dvz_array(n, DVZ_DTYPE_DVEC3);
+    double* p = NULL;
+    float* pf = NULL;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        p = (double*)dvz_array_item(&pos, i);
+        pf = (float*)dvz_array_item(&pos_f, i);
+        for (uint32_t j = 0; j < 3; j++)
+        {
+            p[j] = coords.box.p0[j] + (coords.box.p1[j] - coords.box.p0[j]) * dvz_rand_float();
+            pf[j] = (float)p[j];
+        }
+    }
+    dvz_transform_pos(coords, &pos, &pos_tr, false);
+
+    // Fused normalization to the second field of a record array, each position repeated twice.
+    DvzArray arr = dvz_array_struct(2 * n, 32);
+    DvzArray* data[] = {&pos, &pos_f};
+    dvec3* ref = NULL;
+    float* out = NULL;
+    for (uint32_t k = 0; k < 2; k++)
+    {
+        dvz_array_clear(&arr);
+        dvz_transform_pos_column(
+            coords, &arr, 4, 0, 2 * n, n, data[k]->data, data[k]->dtype, DVZ_DTYPE_VEC3,
+            DVZ_ARRAY_COPY_REPEAT, 2);
+        for (uint32_t i = 0; i < 2 * n; i++)
+        {
+            out = (float*)((uint8_t*)dvz_array_item(&arr, i) + 4);
+            ref = (dvec3*)dvz_array_item(&pos_tr, i / 2);
+            for (uint32_t j = 0; j < 3; j++)
+            {
+                AT(-1 <= out[j] && out[j] <= 1);
+                AC(out[j], (*ref)[j], 1e-5);
+            }
+        }
+    }
+
+    dvz_array_destroy(&pos);
+    dvz_array_destroy(&pos_f);
+    dvz_array_destroy(&pos_tr);
+    dvz_array_destroy(&arr);
+    return 0;
+}
@@ -366,3 +366,89 @@ int test_visuals_5(TestContext* context)
     dvz_visual_destroy(&visual);
     TEST_END
 }
+
+
+
+int test_visuals_dirty(TestContext* context)
+{
+    // Interval set.
+    DvzDirtyRanges dirty = {0};
+    _dirty_add(&dirty, 20, 10);
+    _dirty_add(&dirty, 0, 10);
+    AT(dirty.count == 2);
+    _dirty_add(&dirty, 10, 10);
+    AT(dirty.count == 1);
+    AT(dirty.first[0] == 0);
+    AT(dirty.last[0] == 30);
+    AT(_dirty_size(&dirty, 100) == 30);
+
+    // Too many ranges: the closest ones are coalesced.
+    _dirty_clear(&dirty);
+    for (uint32_t i = 0; i < DVZ_MAX_DIRTY_RANGES; i++)
+        _dirty_add(&dirty, 100 * i, 10);
+    _dirty_add(&dirty, 815, 1);
+    AT(dirty.count == DVZ_MAX_DIRTY_RANGES);
+    AT(dirty.first[DVZ_MAX_DIRTY_RANGES - 1] == 700);
+    AT(dirty.last[DVZ_MAX_DIRTY_RANGES - 1] == 816);
+    _dirty_full(&dirty);
+    AT(_dirty_size(&dirty, 100) == 100);
+
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+    DvzVisual visual = dvz_visual(canvas);
+    _marker_visual(&visual);
+
+    const uint32_t N = 1000;
+    const uint32_t M = 10;
+    dvec3* pos = calloc(N + M, sizeof(dvec3));
+    for (uint32_t i = 0; i < N + M; i++)
+    {
+        RANDN_POS(pos[i])
+    }
+    cvec4 color = {255, 0, 0, 255};
+    dvz_visual_data(&visual, DVZ_PROP_POS, 0, N, pos);
+    dvz_visual_data(&visual, DVZ_PROP_COLOR, 0, 1, color);
+
+    mat4 id = GLM_MAT4_IDENTITY_INIT;
+    dvz_visual_data(&visual, DVZ_PROP_MODEL, 0, 1, id);
+    dvz_visual_data(&visual, DVZ_PROP_VIEW, 0, 1, id);
+    dvz_visual_data(&visual, DVZ_PROP_PROJ, 0, 1, id);
+    float param = 5.0f;
+    dvz_visual_data(&visual, DVZ_PROP_MARKER_SIZE, 0, 1, &param);
+    dvz_visual_data_source(&visual, DVZ_SOURCE_TYPE_VIEWPORT, 0, 0, 1, 1, &canvas->viewport);
+    dvz_visual_update(&visual, canvas->viewport, (DvzDataCoords){0}, NULL);
+
+    // Append items: only the new vertices are baked.
+    DvzSource* source = dvz_source_get(&visual, DVZ_SOURCE_TYPE_VERTEX, 0);
+    dvz_visual_data_append(&visual, DVZ_PROP_POS, 0, M, &pos[N]);
+    visual.callback_bake(&visual, (DvzVisualDataEvent){0});
+    AT(!source->dirty.full);
+    AT(source->dirty.count == 1);
+    AT(source->dirty.first[0] == N);
+    AT(source->dirty.last[0] == N + M);
+    dvz_visual_update(&visual, canvas->viewport, (DvzDataCoords){0}, NULL);
+
+    // Change the last items.
+    for (uint32_t i = N + M / 2; i < N + M; i++)
+        pos[i][0] = i;
+    dvz_visual_data_partial(&visual, DVZ_PROP_POS, 0, N + M / 2, M / 2, M / 2, &pos[N + M / 2]);
+    visual.callback_bake(&visual, (DvzVisualDataEvent){0});
+    AT(_dirty_size(&source->dirty, N + M) == M / 2);
+    dvz_visual_update(&visual, canvas->viewport, (DvzDataCoords){0}, NULL);
+
+    // Check the GPU data.
+    DvzVertex* vertices = calloc(N + M, sizeof(DvzVertex));
+    dvz_download_buffers(canvas, source->u.br, 0, (N + M) * sizeof(DvzVertex), vertices);
+    for (uint32_t i = 0; i < N + M; i++)
+    {
+        AT(vertices[i].pos[0] == (float)pos[i][0]);
+        AT(vertices[i].pos[1] == (float)pos[i][1]);
+        AT(memcmp(vertices[i].color, color, sizeof(cvec4)) == 0);
+    }
+
+    dvz_visual_destroy(&visual);
+    FREE(pos);
+    FREE(vertices);
+    TEST_END
+}
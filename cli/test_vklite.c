@@ -603,6 +603,80 @@ int test_vklite_graphics(TestContext* context)
 
 
 
+static double _pipeline_cache_run(DvzApp* app)
+{
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    dvz_gpu_queue(gpu, 0, DVZ_QUEUE_RENDER);
+    dvz_gpu_create(gpu, 0);
+    ASSERT(gpu->pipeline_cache != VK_NULL_HANDLE);
+    ASSERT(strlen(gpu->pipeline_cache_path) > 0);
+
+    // Time the creation of the graphics and compute pipelines.
+    DvzClock clock = {0};
+    _clock_init(&clock);
+
+    TestCanvas canvas = offscreen(gpu);
+    TestVisual visual = {0};
+    _make_triangle(&canvas, &visual);
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/test_square.comp.spv", SPIRV_DIR);
+    DvzCompute compute = dvz_compute(gpu, path);
+    dvz_compute_slot(&compute, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    DvzBindings bindings = dvz_bindings(&compute.slots, 1);
+    dvz_compute_bindings(&compute, &bindings);
+    dvz_compute_create(&compute);
+
+    double elapsed = _clock_get(&clock);
+
+    dvz_bindings_destroy(&bindings);
+    dvz_compute_destroy(&compute);
+    destroy_visual(&visual);
+    destroy_canvas(&canvas);
+    return elapsed;
+}
+
+int test_vklite_pipeline_cache(TestContext* context)
+{
+    char dir[1024];
+    snprintf(dir, sizeof(dir), "%s/pipeline_cache", ARTIFACTS_DIR);
+#if OS_WIN32
+    _putenv_s("DVZ_PIPELINE_CACHE_DIR", dir);
+#else
+    setenv("DVZ_PIPELINE_CACHE_DIR", dir, 1);
+#endif
+
+    // Cold start: remove the cache file of the previous test runs, if any.
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    char path[1024] = {0};
+    AT(pipeline_cache_path(&gpu->device_properties, path, sizeof(path)));
+    remove(path);
+    double cold = _pipeline_cache_run(app);
+    AT(dvz_app_destroy(app) == 0);
+
+    // The cache has been saved when destroying the GPU.
+    FILE* f = fopen(path, "rb");
+    AT(f != NULL);
+    fclose(f);
+
+    // Warm start: the pipelines are created from the cache.
+    app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    double warm = _pipeline_cache_run(app);
+    log_info(
+        "pipeline creation: %.3f ms (cold cache), %.3f ms (warm cache)", cold * 1000,
+        warm * 1000);
+
+#if OS_WIN32
+    _putenv_s("DVZ_PIPELINE_CACHE_DIR", "");
+#else
+    unsetenv("DVZ_PIPELINE_CACHE_DIR");
+#endif
+    TEST_END
+}
+
+
+
 int test_basic_canvas_1(TestContext* context)
 {
     DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
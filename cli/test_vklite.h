@@ -25,6 +25,7 @@ int test_vklite_barrier(TestContext* context);
 int test_vklite_submit(TestContext* context);
 int test_vklite_blank(TestContext* context);
 int test_vklite_graphics(TestContext* context);
+int test_vklite_pipeline_cache(TestContext* context);
 
 int test_basic_canvas_1(TestContext* context);
 int test_basic_canvas_triangle(TestContext* context);
@@ -0,0 +1,157 @@
+/*************************************************************************************************/
+/*  Standalone, generic allocator of ranges within a linear address space                        */
+/*************************************************************************************************/
+
+#ifndef DVZ_ALLOC_HEADER
+#define DVZ_ALLOC_HEADER
+
+#include "common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+/*************************************************************************************************/
+/*  Constants                                                                                    */
+/*************************************************************************************************/
+
+#define DVZ_ALLOC_DEFAULT_BLOCKS 16
+
+
+
+/*************************************************************************************************/
+/*  Type definitions                                                                             */
+/*************************************************************************************************/
+
+typedef struct DvzAllocBlock DvzAllocBlock;
+typedef struct DvzAlloc DvzAlloc;
+typedef struct DvzAllocStats DvzAllocStats;
+
+
+
+/*************************************************************************************************/
+/*  Structs                                                                                      */
+/*************************************************************************************************/
+
+struct DvzAllocBlock
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+
+
+struct DvzAlloc
+{
+    uint64_t size; // total size of the managed space
+
+    // Free blocks, sorted by offset, never adjacent (they are merged when freed).
+    uint32_t free_count;
+    uint32_t free_capacity;
+    DvzAllocBlock* free_blocks;
+
+    // Live allocations.
+    uint32_t alloc_count;
+    uint64_t allocated;
+};
+
+
+
+struct DvzAllocStats
+{
+    uint64_t size;         // total size of the managed space
+    uint64_t allocated;    // number of bytes in live allocations
+    uint64_t free;         // number of free bytes
+    uint64_t largest_free; // size of the largest free block
+    uint32_t alloc_count;  // number of live allocations
+    uint32_t free_count;   // number of free blocks
+    double fragmentation;  // 0 when all free bytes are contiguous, close to 1 when scattered
+};
+
+
+
+/*************************************************************************************************/
+/*  Allocator                                                                                    */
+/*************************************************************************************************/
+
+/**
+ * Create an allocator managing the range [0, size).
+ *
+ * @param size the total size of the managed space
+ * @returns an allocator
+ */
+DVZ_EXPORT DvzAlloc dvz_alloc(uint64_t size);
+
+/**
+ * Allocate a range.
+ *
+ * The first free block that can hold the aligned range is used. The bytes skipped to align the
+ * range remain free.
+ *
+ * @param alloc the allocator
+ * @param size the size of the range to allocate
+ * @param alignment the required alignment of the offset, or 0 for no alignment
+ * @param[out] offset the offset of the allocated range
+ * @returns whether the allocation succeeded, false if there is no free block large enough
+ */
+DVZ_EXPORT bool
+dvz_alloc_new(DvzAlloc* alloc, uint64_t size, uint64_t alignment, uint64_t* offset);
+
+/**
+ * Free a range previously allocated with `dvz_alloc_new()`.
+ *
+ * The range is merged with the adjacent free blocks.
+ *
+ * @param alloc the allocator
+ * @param offset the offset of the range
+ * @param size the size of the range
+ */
+DVZ_EXPORT void dvz_alloc_free(DvzAlloc* alloc, uint64_t offset, uint64_t size);
+
+/**
+ * Resize an allocated range in place.
+ *
+ * Shrinking always succeeds. Growing only succeeds if the range is directly followed by a free
+ * block large enough.
+ *
+ * @param alloc the allocator
+ * @param offset the offset of the range
+ * @param size the current size of the range
+ * @param new_size the new size of the range
+ * @returns whether the range could be resized in place
+ */
+DVZ_EXPORT bool
+dvz_alloc_resize(DvzAlloc* alloc, uint64_t offset, uint64_t size, uint64_t new_size);
+
+/**
+ * Enlarge the managed space, for example after the underlying buffer has been resized.
+ *
+ * @param alloc the allocator
+ * @param new_size the new total size, larger than the current one
+ */
+DVZ_EXPORT void dvz_alloc_grow(DvzAlloc* alloc, uint64_t new_size);
+
+/**
+ * Get allocation and fragmentation statistics.
+ *
+ * @param alloc the allocator
+ * @returns the statistics
+ */
+DVZ_EXPORT DvzAllocStats dvz_alloc_stats(DvzAlloc* alloc);
+
+/**
+ * Destroy an allocator.
+ *
+ * @param alloc the allocator
+ */
+DVZ_EXPORT void dvz_alloc_destroy(DvzAlloc* alloc);
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -18,6 +18,7 @@
 #include <vulkan/vulkan.h>
 
 #include "common.h"
+#include "fifo.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -34,6 +35,14 @@ typedef struct DvzClock DvzClock;
 
 
 
+/*************************************************************************************************/
+/*  Constants                                                                                    */
+/*************************************************************************************************/
+
+#define DVZ_MAX_FRAME_WORKERS 16
+
+
+
 /*************************************************************************************************/
 /*  Enums                                                                                        */
 /*************************************************************************************************/
@@ -115,6 +124,12 @@ struct DvzApp
 
     // Threads.
     DvzThread timer_thread;
+
+    // Worker threads preparing the offscreen canvases in parallel, see dvz_app_workers().
+    uint32_t frame_workers_count;
+    DvzThread frame_workers[DVZ_MAX_FRAME_WORKERS];
+    DvzFifo frame_jobs; // canvases to prepare in the current iteration of the main loop
+    DvzFifo frame_done; // canvases whose frame has been submitted
 };
 
 
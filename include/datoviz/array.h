@@ -8,6 +8,13 @@
 
 #include "vklite.h"
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DVZ_ARRAY_SSE2 1
+#else
+#define DVZ_ARRAY_SSE2 0
+#endif
+
 
 
 /*************************************************************************************************/
@@ -694,26 +701,117 @@ static inline void* dvz_array_item(DvzArray* array, uint32_t idx)
 
 
 
-// Cast a vector.
-static inline void _cast(DvzDataType target_dtype, void* dst, DvzDataType source_dtype, void* src)
+/*************************************************************************************************/
+/*  Column copy kernels                                                                          */
+/*************************************************************************************************/
+
+// Number of components converted from double to float by a cast, or 0 if unsupported.
+static inline uint32_t _cast_components(DvzDataType source_dtype, DvzDataType target_dtype)
 {
     if (source_dtype == DVZ_DTYPE_DOUBLE && target_dtype == DVZ_DTYPE_FLOAT)
+        return 1;
+    else if (source_dtype == DVZ_DTYPE_DVEC2 && target_dtype == DVZ_DTYPE_VEC2)
+        return 2;
+    else if (source_dtype == DVZ_DTYPE_DVEC3 && target_dtype == DVZ_DTYPE_VEC3)
+        return 3;
+    else if (source_dtype == DVZ_DTYPE_DVEC4 && target_dtype == DVZ_DTYPE_VEC4)
+        return 4;
+    return 0;
+}
+
+
+
+// Cast a vector of doubles to floats, two or four components at a time with SSE2.
+static inline void _cast_item(float* dst, const double* src, uint32_t components)
+{
+    uint32_t k = 0;
+#if DVZ_ARRAY_SSE2
+    __m128 lo, hi;
+    for (; k + 4 <= components; k += 4)
     {
-        ((vec3*)dst)[0][0] = ((dvec3*)src)[0][0];
+        lo = _mm_cvtpd_ps(_mm_loadu_pd(&src[k]));
+        hi = _mm_cvtpd_ps(_mm_loadu_pd(&src[k + 2]));
+        _mm_storeu_ps(&dst[k], _mm_movelh_ps(lo, hi));
     }
-    else if (source_dtype == DVZ_DTYPE_DVEC2 && target_dtype == DVZ_DTYPE_VEC2)
+    for (; k + 2 <= components; k += 2)
+        _mm_storel_pi((__m64*)&dst[k], _mm_cvtpd_ps(_mm_loadu_pd(&src[k])));
+#endif
+    for (; k < components; k++)
+        dst[k] = (float)src[k];
+}
+
+
+
+// Copy `count` source items of `size` bytes to a strided column. Each source item is written to
+// the `group` consecutive column items at the start of a block of `step` column items.
+#define _COLUMN_COPY(size)                                                                        \
+    for (uint32_t i = 0; i < count; i++, src += src_stride, dst += step * dst_stride)             \
+        for (uint32_t r = 0; r < group; r++)                                                      \
+            memcpy(dst + r * dst_stride, src, (size));
+
+static inline void _column_copy(
+    uint8_t* dst, VkDeviceSize dst_stride, const uint8_t* src, VkDeviceSize src_stride,
+    VkDeviceSize size, uint32_t count, uint32_t group, uint32_t step)
+{
+    // Contiguous column and data: a single copy.
+    if (group == 1 && step == 1 && dst_stride == size && src_stride == size)
     {
-        ((vec3*)dst)[0][0] = ((dvec3*)src)[0][0];
-        ((vec3*)dst)[0][1] = ((dvec3*)src)[0][1];
+        memcpy(dst, src, count * size);
+        return;
     }
-    else if (source_dtype == DVZ_DTYPE_DVEC3 && target_dtype == DVZ_DTYPE_VEC3)
+
+    // With a constant size, each copy compiles to one or two vector moves.
+    switch (size)
+    {
+    case 4:
+        _COLUMN_COPY(4)
+        break;
+    case 8:
+        _COLUMN_COPY(8)
+        break;
+    case 12:
+        _COLUMN_COPY(12)
+        break;
+    case 16:
+        _COLUMN_COPY(16)
+        break;
+    default:
+        _COLUMN_COPY(size)
+        break;
+    }
+}
+
+#undef _COLUMN_COPY
+
+
+
+// Same as _column_copy(), but casting the source items from doubles to floats.
+static inline void _column_cast(
+    uint8_t* dst, VkDeviceSize dst_stride, const uint8_t* src, VkDeviceSize src_stride,
+    uint32_t components, uint32_t count, uint32_t group, uint32_t step)
+{
+    size_t size = components * sizeof(float);
+    for (uint32_t i = 0; i < count; i++, src += src_stride, dst += step * dst_stride)
     {
-        ((vec3*)dst)[0][0] = ((dvec3*)src)[0][0];
-        ((vec3*)dst)[0][1] = ((dvec3*)src)[0][1];
-        ((vec3*)dst)[0][2] = ((dvec3*)src)[0][2];
+        _cast_item((float*)dst, (const double*)src, components);
+        // The repeats copy the converted item.
+        for (uint32_t r = 1; r < group; r++)
+            memcpy(dst + r * dst_stride, dst, size);
     }
+}
+
+
+
+static inline void _column_write(
+    uint8_t* dst, VkDeviceSize dst_stride, const uint8_t* src, VkDeviceSize src_stride,
+    VkDeviceSize size, uint32_t components, uint32_t count, uint32_t group, uint32_t step)
+{
+    if (count == 0 || group == 0)
+        return;
+    if (components > 0)
+        _column_cast(dst, dst_stride, src, src_stride, components, count, group, step);
     else
-        log_error("unknown casting dtypes %d %d", source_dtype, target_dtype);
+        _column_copy(dst, dst_stride, src, src_stride, size, count, group, step);
 }
 
 
@@ -725,6 +823,9 @@ static inline void _cast(DvzDataType target_dtype, void* dst, DvzDataType source
  * (corresponding to a record array with as many fields as GLSL attributes in the vertex shader)
  * the user-specified visual props (data for the individual elements).
  *
+ * The array item `first_item + i` takes the data item `min(i / reps, data_item_count - 1)`. In
+ * SINGLE copy mode, only the first item of each group of `reps` items is written.
+ *
  * @param array the array
  * @param offset the offset within the array, in bytes
  * @param col_size stride in the source array, in bytes
@@ -751,63 +852,55 @@ static void dvz_array_column(
     ASSERT(item_count > 0);
     ASSERT(first_item + item_count <= array->item_count);
 
-    VkDeviceSize src_offset = 0;
     VkDeviceSize src_stride = col_size;
-
-    VkDeviceSize dst_offset = offset;
     VkDeviceSize dst_stride = array->item_size;
-
-    void* dst = array->data;
-    const void* src = data;
-
-    ASSERT(src != NULL);
-    ASSERT(dst != NULL);
     ASSERT(src_stride > 0);
     ASSERT(dst_stride > 0);
-    ASSERT(item_count > 0);
 
     log_trace(
-        "copy src offset %d stride %d, dst offset %d stride %d, item size %d count %d", //
-        src_offset, src_stride, dst_offset, dst_stride, col_size, item_count);
+        "copy src stride %d, dst offset %d stride %d, item size %d count %d", //
+        src_stride, offset, dst_stride, col_size, item_count);
 
-    int64_t src_byte = (int64_t)src + (int64_t)src_offset;
-    int64_t dst_byte = (int64_t)dst + (int64_t)(first_item * dst_stride) + (int64_t)dst_offset;
+    const uint8_t* src = (const uint8_t*)data;
+    uint8_t* dst = (uint8_t*)array->data + first_item * dst_stride + offset;
 
-    uint32_t j = 0; // j: src index
-    uint32_t m = 0;
-    bool skip = false;
-    for (uint32_t i = 0; i < item_count; i++) // i: dst index
+    // Number of components to cast from double to float, if any.
+    uint32_t components = 0;
+    if (source_dtype != target_dtype &&   //
+        source_dtype != DVZ_DTYPE_NONE && //
+        target_dtype != DVZ_DTYPE_NONE)   //
     {
-        if (reps > 1)
-            m = i % reps;
-        // Determine whether the current item copy should be skipped.
-        skip = copy_type == DVZ_ARRAY_COPY_SINGLE && reps > 1 && m > 0;
-
-        // NOTE: this function is not optimized and might benefit from being refactored.
-
-        // Copy the current item, unless we are in SINGLE copy mode
-        if (!skip)
-        {
-            if (source_dtype == target_dtype ||   //
-                source_dtype == DVZ_DTYPE_NONE || //
-                target_dtype == DVZ_DTYPE_NONE)   //
-                memcpy((void*)dst_byte, (void*)src_byte, col_size);
-            else
-            {
-                _cast(target_dtype, (void*)dst_byte, source_dtype, (void*)src_byte);
-            }
-        }
-
-        // Advance the source pointer, unless we are in SINGLE copy mode
-        skip = reps > 1 && m < reps - 1;
-        if (j < data_item_count - 1 && !skip)
+        components = _cast_components(source_dtype, target_dtype);
+        if (components == 0)
         {
-            src_byte += (int64_t)src_stride;
-            j++;
+            log_error("unknown casting dtypes %d %d", source_dtype, target_dtype);
+            return;
         }
-
-        dst_byte += (int64_t)dst_stride;
     }
+
+    // The array items are processed by blocks of `step` items, each block taking one data item.
+    uint32_t step = MAX(reps, 1);
+    uint32_t group = copy_type == DVZ_ARRAY_COPY_SINGLE ? 1 : step;
+    uint32_t n_full = item_count / step;            // number of complete blocks
+    uint32_t n_data = MIN(n_full, data_item_count); // complete blocks with their own data item
+    uint32_t rem = item_count - n_full * step;      // size of the last, incomplete block
+    VkDeviceSize block = step * dst_stride;
+    const uint8_t* last = src + (data_item_count - 1) * src_stride;
+
+    // Complete blocks with their own data item.
+    _column_write(dst, dst_stride, src, src_stride, col_size, components, n_data, group, step);
+
+    // Complete blocks beyond the data, which repeat its last item.
+    _column_write(
+        dst + n_data * block, dst_stride, last, 0, col_size, components, n_full - n_data, group,
+        step);
+
+    // Last, incomplete block.
+    if (rem > 0)
+        _column_write(
+            dst + n_full * block, dst_stride,
+            n_full < data_item_count ? src + n_full * src_stride : last, 0, col_size, components,
+            1, MIN(group, rem), step);
 }
 
 
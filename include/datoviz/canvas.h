@@ -21,9 +21,9 @@ extern "C" {
 /*  Constants                                                                                    */
 /*************************************************************************************************/
 
-#define DVZ_MAX_EVENT_CALLBACKS 32
-// Maximum acceptable duration for the pending events in the event queue, in seconds
-#define DVZ_MAX_EVENT_DURATION .5
+#define DVZ_MAX_EVENT_CALLBACKS   32
+#define DVZ_MAX_EVENT_WORKERS     16
+#define DVZ_DEFAULT_EVENT_WORKERS 1
 #define DVZ_DEFAULT_BACKGROUND                                                                    \
     (VkClearColorValue)                                                                           \
     {                                                                                             \
@@ -41,6 +41,8 @@ extern "C" {
 #define DVZ_DEFAULT_COMMANDS_TRANSFER 0
 #define DVZ_DEFAULT_COMMANDS_RENDER   1
 #define DVZ_MAX_FRAMES_IN_FLIGHT      2
+#define DVZ_MAX_IDLE_TIMEOUT          1.0 // in seconds, for on-demand rendering
+#define DVZ_MAX_PROFILE_SLOTS         64  // max number of GPU-timed draw ranges per canvas
 
 
 
@@ -53,7 +55,8 @@ typedef enum
 {
     DVZ_CANVAS_FLAGS_NONE = 0x0000,
     DVZ_CANVAS_FLAGS_IMGUI = 0x0001,
-    DVZ_CANVAS_FLAGS_FPS = 0x0003, // NOTE: 1 bit for ImGUI, 1 bit for FPS
+    DVZ_CANVAS_FLAGS_FPS = 0x0003,       // NOTE: 1 bit for ImGUI, 1 bit for FPS
+    DVZ_CANVAS_FLAGS_ON_DEMAND = 0x0008, // only render a frame when something changed
 
     DVZ_CANVAS_FLAGS_DPI_SCALE_050 = 0x1000,
     DVZ_CANVAS_FLAGS_DPI_SCALE_100 = 0x2000,
@@ -192,6 +195,8 @@ typedef enum
     DVZ_EVENT_PRE_SEND,           // called before sending the commands buffers
     DVZ_EVENT_POST_SEND,          // called after sending the commands buffers
     DVZ_EVENT_DESTROY,            // called before destruction
+    DVZ_EVENT_DOWNLOAD,           // called when an asynchronous download has completed
+    DVZ_EVENT_COUNT,
 } DvzEventType;
 
 
@@ -250,6 +255,7 @@ typedef struct DvzMouseWheelEvent DvzMouseWheelEvent;
 typedef struct DvzRefillEvent DvzRefillEvent;
 typedef struct DvzResizeEvent DvzResizeEvent;
 typedef struct DvzScreencastEvent DvzScreencastEvent;
+typedef struct DvzDownloadEvent DvzDownloadEvent;
 typedef struct DvzSubmitEvent DvzSubmitEvent;
 typedef struct DvzGuiEvent DvzGuiEvent;
 typedef struct DvzTimerEvent DvzTimerEvent;
@@ -258,9 +264,12 @@ typedef union DvzEventUnion DvzEventUnion;
 
 typedef void (*DvzEventCallback)(DvzCanvas*, DvzEvent);
 typedef struct DvzEventCallbackRegister DvzEventCallbackRegister;
+typedef struct DvzEventStats DvzEventStats;
 
 typedef struct DvzScreencast DvzScreencast;
 typedef struct DvzPendingRefill DvzPendingRefill;
+typedef struct DvzCanvasStats DvzCanvasStats;
+typedef struct DvzCanvasProfile DvzCanvasProfile;
 
 // Forward declarations.
 typedef struct DvzGui DvzGui;
@@ -431,6 +440,15 @@ struct DvzScreencastEvent
 
 
 
+struct DvzDownloadEvent
+{
+    uint64_t id; // download handle
+    VkDeviceSize size;
+    void* data;
+};
+
+
+
 struct DvzRefillEvent
 {
     uint32_t img_idx;
@@ -478,6 +496,7 @@ union DvzEventUnion
     DvzRefillEvent rf;     // for REFILL events
     DvzResizeEvent r;      // for RESIZE events
     DvzScreencastEvent sc; // for SCREENCAST events
+    DvzDownloadEvent dl;   // for DOWNLOAD events
     DvzSubmitEvent s;      // for SUBMIT events
     DvzGuiEvent g;         // for GUI events
 };
@@ -493,6 +512,17 @@ struct DvzEvent
 
 
 
+struct DvzEventStats
+{
+    uint64_t count;      // number of calls
+    double duration;     // average duration of the callback, in seconds
+    double duration_max; // maximum duration of the callback, in seconds
+    double latency;      // average time between the event dispatch and the end of the callback
+    double latency_max;  // maximum latency, in seconds
+};
+
+
+
 struct DvzEventCallbackRegister
 {
     DvzEventType type;
@@ -501,6 +531,13 @@ struct DvzEventCallbackRegister
     DvzEventMode mode;
     DvzEventCallback callback;
     void* user_data;
+
+    // Async callbacks only: events waiting for this callback, processed in order, one at a time,
+    // by the worker pool.
+    DvzFifo jobs;
+    atomic(bool, scheduled); // true while the callback is queued in or run by the worker pool
+    atomic(int, pending);    // number of events dispatched but not yet processed
+    DvzEventStats stats;     // only modified by the worker running the callback
 };
 
 
@@ -537,6 +574,39 @@ struct DvzPendingRefill
 
 
 
+// GPU timings of a canvas, measured with timestamps a few frames after the submission.
+struct DvzCanvasStats
+{
+    uint64_t frame_idx;   // frame at which the timings below were submitted
+    double gpu_frame;     // GPU time of the render submission, in ms
+    double gpu_transfers; // GPU time of the transfers completed since the previous stats, in ms
+
+    // GPU time of the draw calls of each slot (typically a visual), in ms, or -1 if unavailable.
+    double gpu_slots[DVZ_MAX_PROFILE_SLOTS];
+};
+
+
+
+struct DvzCanvasProfile
+{
+    bool enabled;
+
+    // One block of queries per swapchain image: frame begin, frame end, then begin and end of
+    // each slot.
+    DvzQueries queries;
+    uint32_t block_size;
+    DvzCommands cmds_begin; // reset the block of the image and write the frame begin timestamp
+    DvzCommands cmds_end;   // write the frame end timestamp
+
+    const void* slots[DVZ_MAX_PROFILE_SLOTS];  // owner of each slot, or NULL if free
+    bool pending[DVZ_MAX_SWAPCHAIN_IMAGES];    // whether the block of each image was submitted
+    uint64_t frames[DVZ_MAX_SWAPCHAIN_IMAGES]; // frame of the last submission of each image
+    double transfers;                          // total transfer GPU time at the last stats
+    DvzCanvasStats stats;
+};
+
+
+
 /*************************************************************************************************/
 /*  Canvas struct                                                                                */
 /*************************************************************************************************/
@@ -559,6 +629,13 @@ struct DvzCanvas
     atomic(DvzObjectStatus, cur_status);
     atomic(bool, to_close);
 
+    // On-demand rendering: number of frames to render before the canvas may idle again.
+    bool on_demand;
+    atomic(int, frames_dirty);
+
+    // Whether the current frame is prepared by a frame worker, see dvz_app_workers().
+    bool frame_job;
+
     DvzWindow* window;
 
     // Swapchain
@@ -580,10 +657,15 @@ struct DvzCanvas
     // Synchronization events.
     DvzSemaphores sem_img_available;
     DvzSemaphores sem_render_finished;
+    DvzSemaphores sem_render_transfers; // the next uploads wait for the last render submission
     DvzSemaphores* present_semaphores;
     DvzFences fences_render_finished;
     DvzFences fences_flight;
 
+    // Command pool of the render command buffers of the canvas and its visuals, so that they
+    // can be recorded in another thread than those of the other canvases.
+    VkCommandPool cmd_pool;
+
     // Default command buffers.
     DvzCommands cmds_transfer;
     DvzCommands cmds_render;
@@ -595,7 +677,9 @@ struct DvzCanvas
     DvzContainer graphics;
 
     // Data transfers.
-    DvzFifo transfers;
+    DvzTransferQueue transfers;
+    DvzReadback readback;
+    pthread_t frame_thread; // thread preparing the frames, which processes the transfers
 
     // Event callbacks, running in the background thread, may be slow, for end-users.
     uint32_t callbacks_count;
@@ -603,11 +687,23 @@ struct DvzCanvas
 
     // Event queue.
     DvzFifo event_queue;
-    DvzEvent events[DVZ_MAX_FIFO_CAPACITY];
+    atomic(int, events_pending[DVZ_EVENT_COUNT]); // number of queued events of each type
+    // Queued event that can absorb the next events of the same type, protected by the lock.
+    pthread_mutex_t event_lock;
+    DvzEvent* events_last[DVZ_EVENT_COUNT];
     DvzThread event_thread;
     bool enable_lock;
+    // Global callback lock: taken exclusively by the sync callbacks, shared by the async ones.
+    pthread_rwlock_t callback_lock;
+    pthread_t callback_owner;    // thread holding the exclusive lock
+    atomic(int, callback_depth); // nesting level of the exclusive lock
     atomic(DvzEventType, event_processing);
 
+    // Worker pool running the async callbacks, fed by the event thread.
+    DvzFifo event_ready; // async callbacks with pending events, waiting for a worker
+    uint32_t event_workers_count;
+    DvzThread event_workers[DVZ_MAX_EVENT_WORKERS];
+
     bool captured; // if true, mouse and keyboard should not be processed
     DvzMouse mouse;
     DvzKeyboard keyboard;
@@ -621,6 +717,9 @@ struct DvzCanvas
 
     DvzViewport viewport;
     DvzScene* scene;
+
+    // GPU profiling, see dvz_canvas_profile().
+    DvzCanvasProfile profile;
 };
 
 
@@ -667,6 +766,17 @@ DVZ_EXPORT void dvz_canvas_recreate(DvzCanvas* canvas);
  */
 DVZ_EXPORT DvzCommands* dvz_canvas_commands(DvzCanvas* canvas, uint32_t queue_idx, uint32_t count);
 
+/**
+ * Compile the pending graphics pipelines of a canvas in parallel.
+ *
+ * The builtin graphics pipelines are created with `dvz_graphics_create_deferred()`. This function
+ * is called automatically before each canvas refill, it only needs to be called explicitly to
+ * compile the pipelines ahead of time.
+ *
+ * @param canvas the canvas
+ */
+DVZ_EXPORT void dvz_canvas_pipelines(DvzCanvas* canvas);
+
 
 
 /*************************************************************************************************/
@@ -744,6 +854,65 @@ DVZ_EXPORT void dvz_canvas_dpi_scaling(DvzCanvas* canvas, float scaling);
 
 
 
+/*************************************************************************************************/
+/*  Canvas profiling                                                                             */
+/*************************************************************************************************/
+
+/**
+ * Enable or disable GPU profiling with timestamp queries.
+ *
+ * When enabled, GPU timestamps are written around each render submission, around the draw
+ * calls of each visual, and around the staging transfers. The results are collected without
+ * blocking, a few frames after their submission, and can be read with `dvz_canvas_stats()`.
+ * Toggling profiling triggers a refill of the canvas.
+ *
+ * @param canvas the canvas
+ * @param enable whether to enable GPU profiling
+ */
+DVZ_EXPORT void dvz_canvas_profile(DvzCanvas* canvas, bool enable);
+
+/**
+ * Return the latest GPU timings of a canvas.
+ *
+ * @param canvas the canvas
+ * @returns the GPU timings, all zero if profiling is disabled or no results are available yet
+ */
+DVZ_EXPORT DvzCanvasStats dvz_canvas_stats(DvzCanvas* canvas);
+
+/**
+ * Return the profiling slot of an object drawing in the canvas, reserving it if needed.
+ *
+ * @param canvas the canvas
+ * @param owner the object timed by the slot, typically a visual
+ * @returns the slot index in `DvzCanvasStats.gpu_slots`, or -1 if all slots are taken
+ */
+DVZ_EXPORT int dvz_canvas_profile_slot(DvzCanvas* canvas, const void* owner);
+
+/**
+ * Release the profiling slot of an object, if any.
+ *
+ * @param canvas the canvas
+ * @param owner the object timed by the slot
+ */
+DVZ_EXPORT void dvz_canvas_profile_release(DvzCanvas* canvas, const void* owner);
+
+/**
+ * Write a GPU timestamp at the beginning or end of a profiling slot.
+ *
+ * Nothing is recorded if profiling is disabled or the slot is negative. This command may be
+ * recorded inside a render pass.
+ *
+ * @param canvas the canvas
+ * @param cmds the set of command buffers to record
+ * @param idx the index of the command buffer to record, which is the swapchain image index
+ * @param slot the profiling slot
+ * @param end whether to write the end timestamp rather than the begin timestamp
+ */
+DVZ_EXPORT void dvz_canvas_profile_timestamp(
+    DvzCanvas* canvas, DvzCommands* cmds, uint32_t idx, int slot, bool end);
+
+
+
 /*************************************************************************************************/
 /*  Callbacks                                                                                    */
 /*************************************************************************************************/
@@ -751,9 +920,9 @@ DVZ_EXPORT void dvz_canvas_dpi_scaling(DvzCanvas* canvas, float scaling);
 /**
  * Register a callback for canvas events.
  *
- * These user callbacks run either in the main thread (*sync* callbacks) or in the background
- * thread * (*async* callbacks). Callbacks can access the `DvzMouse` and `DvzKeyboard` structures
- * with the current state of the mouse and keyboard.
+ * These user callbacks run either in the main thread (*sync* callbacks) or in background worker
+ * threads (*async* callbacks, see `dvz_event_workers()`). Callbacks can access the `DvzMouse` and
+ * `DvzKeyboard` structures with the current state of the mouse and keyboard.
  *
  * Callback function signature: `void(DvzCanvas*, DvzEvent)`
  *
@@ -771,6 +940,33 @@ DVZ_EXPORT void dvz_event_callback(
     DvzCanvas* canvas, DvzEventType type, double param, DvzEventMode mode, //
     DvzEventCallback callback, void* user_data);
 
+/**
+ * Set the number of worker threads running the async callbacks.
+ *
+ * The background event thread dispatches every event to the async callbacks registered for its
+ * type, and a pool of worker threads runs them. Each callback receives its events in order and is
+ * never run by two workers at the same time, but different callbacks may run concurrently when
+ * there is more than one worker: they must then protect any state they share with each other.
+ * The async callbacks never run at the same time as the sync callbacks, which include the scene
+ * updates, so they can safely modify the scene objects.
+ *
+ * @param canvas the canvas
+ * @param count the number of workers, between 1 and `DVZ_MAX_EVENT_WORKERS`
+ */
+DVZ_EXPORT void dvz_event_workers(DvzCanvas* canvas, uint32_t count);
+
+/**
+ * Return the timing statistics of an async callback.
+ *
+ * The latency is the time between the dispatch of the event by the event thread and the end of
+ * the callback, it includes the time spent waiting for a free worker.
+ *
+ * @param canvas the canvas
+ * @param callback the callback function, as passed to `dvz_event_callback()`
+ * @returns the statistics of the first async registration of that callback
+ */
+DVZ_EXPORT DvzEventStats dvz_event_stats(DvzCanvas* canvas, DvzEventCallback callback);
+
 
 
 /*************************************************************************************************/
@@ -784,6 +980,17 @@ DVZ_EXPORT void dvz_event_callback(
  */
 DVZ_EXPORT void dvz_canvas_to_refill(DvzCanvas* canvas);
 
+/**
+ * Render the canvas at the next iterations of the event loop.
+ *
+ * This is only needed for canvases created with the `DVZ_CANVAS_FLAGS_ON_DEMAND` flag, when
+ * something changes that is not a data transfer, a refill, or a user input, for example when a
+ * FRAME callback animates the scene. This function may be called from any thread.
+ *
+ * @param canvas the canvas
+ */
+DVZ_EXPORT void dvz_canvas_to_render(DvzCanvas* canvas);
+
 /**
  * Close the canvas at the next frame.
  *
@@ -1079,6 +1286,18 @@ DVZ_EXPORT void dvz_event_frame(DvzCanvas* canvas, uint64_t idx, double time, do
  */
 DVZ_EXPORT void dvz_event_timer(DvzCanvas* canvas, uint64_t idx, double time, double interval);
 
+/**
+ * Emit a download event.
+ *
+ * Raised when an asynchronous download has completed.
+ *
+ * @param canvas the canvas
+ * @param id the download handle
+ * @param size the size of the downloaded data, in bytes
+ * @param data pointer to the downloaded data
+ */
+DVZ_EXPORT void dvz_event_download(DvzCanvas* canvas, uint64_t id, VkDeviceSize size, void* data);
+
 /**
  * Return the number of pending events.
  *
@@ -1125,7 +1344,13 @@ DVZ_EXPORT void dvz_canvas_frame_submit(DvzCanvas* canvas);
 /**
  * Start the main event loop.
  *
- * Every loop iteration processes one frame of all open canvases.
+ * Every loop iteration processes one frame of all open canvases. Canvases created with the
+ * `DVZ_CANVAS_FLAGS_ON_DEMAND` flag skip the frame when nothing changed since their last frames:
+ * when all canvases are idle, the loop sleeps until the next user input, TIMER event, transfer or
+ * call to `dvz_canvas_to_render()`, and skipped iterations count in `frame_count`.
+ *
+ * With `dvz_app_workers()`, the offscreen canvases are prepared and submitted in parallel by
+ * worker threads, once the other canvases have been processed in the main thread.
  *
  * @param app the app
  * @param frame_count number of frames to process (0 for infinite loop)
@@ -5,6 +5,7 @@
 #ifndef DVZ_CONTEXT_HEADER
 #define DVZ_CONTEXT_HEADER
 
+#include "alloc.h"
 #include "colormaps.h"
 #include "common.h"
 #include "fifo.h"
@@ -30,6 +31,25 @@ extern "C" {
 #define DVZ_BUFFER_TYPE_STORAGE_SIZE (16 * 1024 * 1024)
 #define DVZ_BUFFER_TYPE_UNIFORM_SIZE (4 * 1024 * 1024)
 
+// Host-visible memory may be scarce, the mappable vertex buffer grows when needed.
+#define DVZ_BUFFER_TYPE_VERTEX_MAPPABLE_SIZE (4 * 1024 * 1024)
+
+// Indirect draw parameters only take a few bytes per graphics pipeline.
+#define DVZ_BUFFER_TYPE_INDIRECT_SIZE (1024 * 1024)
+
+// Maximum size of the staging buffer. Larger transfers are streamed in several chunks.
+#define DVZ_BUFFER_TYPE_STAGING_MAX_SIZE (64 * 1024 * 1024)
+
+// Number of staging chunks that may be in flight at the same time.
+#define DVZ_STAGING_RING_SLOTS DVZ_MAX_COMMAND_BUFFERS_PER_SET
+// Alignment of each chunk in the staging ring, in bytes (valid for buffer-image copies).
+#define DVZ_STAGING_ALIGNMENT 256
+// Large transfers are split so that this many chunks fit in the staging buffer at once.
+#define DVZ_STAGING_STREAM_CHUNKS 4
+
+// Maximum number of shader modules shared by the graphics pipelines of a context.
+#define DVZ_MAX_SHADERS 128
+
 #define DVZ_ZERO_OFFSET                                                                           \
     (uvec3) { 0, 0, 0 }
 
@@ -66,6 +86,8 @@ typedef enum
 
 typedef struct DvzFontAtlas DvzFontAtlas;
 typedef struct DvzColorTexture DvzColorTexture;
+typedef struct DvzStagingChunk DvzStagingChunk;
+typedef struct DvzStaging DvzStaging;
 
 
 
@@ -94,19 +116,84 @@ struct DvzColorTexture
 
 
 
+// Region of the staging buffer reserved for a single transfer.
+struct DvzStagingChunk
+{
+    uint32_t slot;       // index of the command buffer and fence of this chunk
+    VkDeviceSize offset; // offset of the chunk in the staging buffer
+    VkDeviceSize size;
+    bool timestamps; // whether GPU timestamps are written around the transfer
+};
+
+
+
+// Ring allocator on top of the staging buffer. Each transfer takes a chunk which is recycled
+// as soon as the fence of its submission is signaled.
+struct DvzStaging
+{
+    DvzCommands cmds;  // one command buffer per slot
+    DvzFences fences;  // one fence per slot
+    VkDeviceSize head; // offset of the next allocation
+    VkDeviceSize tail; // offset of the oldest in-flight chunk
+
+    // In-flight chunks, from the oldest (`first`) to the newest.
+    DvzStagingChunk chunks[DVZ_STAGING_RING_SLOTS];
+    uint32_t first;
+    uint32_t count;
+    bool pending; // whether the newest chunk has been allocated but not submitted yet
+
+    // Maximum size of the staging buffer, in bytes.
+    VkDeviceSize max_size;
+
+    // Synchronization with the other queues, without blocking the CPU. Each submission waits on
+    // the semaphore of the previous one and signals its own, so that waiting on the newest
+    // semaphore waits on all submissions.
+    DvzSemaphores semaphores; // one semaphore per slot
+    int32_t signaled;         // slot whose semaphore has not been waited upon yet, or -1
+
+    // Semaphore signaled by the last render submission, waited upon by the next staging
+    // submission so that it does not overwrite data still in use, or NULL.
+    DvzSemaphores* render_semaphore;
+
+    // Number of allocations that had to block because the ring was full.
+    uint32_t stall_count;
+    // Number of submissions to the transfer queue.
+    uint32_t submit_count;
+
+    // Optional GPU timestamps around each submission, two per slot, see
+    // dvz_staging_timestamps().
+    bool profile;
+    DvzQueries queries;
+    double gpu_time; // total GPU time of the completed transfers that were timed, in ms
+};
+
+
+
 struct DvzContext
 {
     DvzObject obj;
     DvzGpu* gpu;
 
     DvzCommands transfer_cmd;
+    DvzStaging staging;
+    // Number of canvases being profiled, which share the staging timestamps.
+    uint32_t profile_count;
+
+    // Recursive lock protecting the state shared by the canvases, see dvz_context_lock().
+    pthread_mutex_t lock;
 
     DvzContainer buffers;
+    DvzAlloc allocs[DVZ_BUFFER_TYPE_COUNT]; // one sub-allocator per buffer type
     DvzContainer images;
     DvzContainer samplers;
     DvzContainer textures;
     DvzContainer computes;
 
+    // Builtin shader modules, shared by all graphics pipelines, see dvz_ctx_shader().
+    uint32_t shader_count;
+    char shader_names[DVZ_MAX_SHADERS][64];
+    VkShaderModule shader_modules[DVZ_MAX_SHADERS];
+
     // Font atlas.
     DvzFontAtlas font_atlas;
     DvzColorTexture color_texture;
@@ -115,94 +202,195 @@ struct DvzContext
 
 
 /*************************************************************************************************/
-/*  Utils                                                                                        */
+/*  Staging ring                                                                                 */
 /*************************************************************************************************/
 
-// Get the staging buffer, and make sure it can contain `size` bytes.
-static DvzBuffer* staging_buffer(DvzContext* context, VkDeviceSize size)
-{
-    DvzBuffer* staging = (DvzBuffer*)dvz_container_get(&context->buffers, DVZ_BUFFER_TYPE_STAGING);
-    ASSERT(staging != NULL);
-    ASSERT(staging->buffer != VK_NULL_HANDLE);
+/**
+ * Set the maximum size of the staging buffer.
+ *
+ * This bounds the host-visible memory used for transfers. Transfers larger than a fraction of
+ * this size are streamed through the staging buffer in several chunks.
+ *
+ * @param context the context
+ * @param max_size the maximum size of the staging buffer, in bytes
+ */
+DVZ_EXPORT void dvz_staging_max_size(DvzContext* context, VkDeviceSize max_size);
 
-    // Make sure the staging buffer is idle before using it.
-    // TODO: optimize this and avoid hard synchronization here before copying data into
-    // the staging buffer.
-    dvz_queue_wait(context->gpu, DVZ_DEFAULT_QUEUE_TRANSFER);
+/**
+ * Reserve a chunk of the staging buffer for a transfer.
+ *
+ * The chunk's command buffer is reset and begun, ready to record the copy commands. This function
+ * only blocks when all in-flight chunks are still used by the GPU and there is no room left in
+ * the ring. The chunk must be submitted with `dvz_staging_submit()` before the next allocation.
+ *
+ * @param context the context
+ * @param size the size of the chunk, in bytes, at most the maximum size of the staging buffer
+ * @returns the staging chunk
+ */
+DVZ_EXPORT DvzStagingChunk dvz_staging_alloc(DvzContext* context, VkDeviceSize size);
 
-    // Resize the staging buffer is needed.
-    // TODO: keep staging buffer fixed and copy parts of the data to staging buffer in several
-    // steps?
-    if (staging->size < size)
-    {
-        VkDeviceSize new_size = dvz_next_pow2(size);
-        log_info("reallocating staging buffer to %s", pretty_size(new_size));
-        dvz_buffer_resize(staging, new_size, &context->transfer_cmd);
-    }
-    ASSERT(staging->size >= size);
-    return staging;
+/**
+ * Copy data from the CPU to a staging chunk.
+ *
+ * @param context the context
+ * @param chunk the staging chunk
+ * @param size the size of the data to copy, in bytes
+ * @param data the data to copy
+ */
+DVZ_EXPORT void dvz_staging_upload(
+    DvzContext* context, DvzStagingChunk* chunk, VkDeviceSize size, const void* data);
+
+/**
+ * Copy a box of strided data from the CPU to a staging chunk, packing its rows.
+ *
+ * @param context the context
+ * @param chunk the staging chunk
+ * @param shape the shape of the box, in items
+ * @param item_size the size of each item, in bytes
+ * @param row_pitch the number of bytes between two consecutive rows of `data`
+ * @param slice_pitch the number of bytes between two consecutive slices of `data`
+ * @param data the data to copy
+ */
+DVZ_EXPORT void dvz_staging_upload_strided(
+    DvzContext* context, DvzStagingChunk* chunk, uvec3 shape, VkDeviceSize item_size,
+    VkDeviceSize row_pitch, VkDeviceSize slice_pitch, const void* data);
+
+/**
+ * Copy data from a staging chunk to the CPU.
+ *
+ * The chunk must have been submitted and waited upon with `dvz_staging_wait()`.
+ *
+ * @param context the context
+ * @param chunk the staging chunk
+ * @param size the size of the data to copy, in bytes
+ * @param data the buffer to write the data to
+ */
+DVZ_EXPORT void dvz_staging_download(
+    DvzContext* context, DvzStagingChunk* chunk, VkDeviceSize size, void* data);
+
+/**
+ * End the command buffer of a staging chunk and submit it to the transfer queue.
+ *
+ * @param context the context
+ * @param chunk the staging chunk
+ */
+DVZ_EXPORT void dvz_staging_submit(DvzContext* context, DvzStagingChunk* chunk);
+
+/**
+ * Wait until all in-flight staging chunks have been processed by the GPU.
+ *
+ * @param context the context
+ */
+DVZ_EXPORT void dvz_staging_wait(DvzContext* context);
+
+/**
+ * Make a submission to another queue wait for the staging submissions.
+ *
+ * The submission waits on the semaphore of the newest staging submission that has not been waited
+ * upon yet, if any. This does not block the CPU.
+ *
+ * @param context the context
+ * @param submit the submission, typically the next render submission
+ * @param stage the pipeline stages that must wait for the transfers
+ */
+DVZ_EXPORT void
+dvz_staging_sync_wait(DvzContext* context, DvzSubmit* submit, VkPipelineStageFlags stage);
+
+/**
+ * Make the next staging submission wait for a submission to another queue.
+ *
+ * The submission signals the semaphore, which the next staging submission waits upon before
+ * overwriting GPU data. This does not block the CPU.
+ *
+ * @param context the context
+ * @param submit the submission, typically a render submission
+ * @param semaphores a set with a single semaphore
+ */
+DVZ_EXPORT void
+dvz_staging_sync_signal(DvzContext* context, DvzSubmit* submit, DvzSemaphores* semaphores);
+
+/**
+ * Enable or disable GPU timestamps around the staging submissions.
+ *
+ * This has no effect if the transfer queue cannot write and reset timestamps.
+ *
+ * @param context the context
+ * @param enable whether to write GPU timestamps
+ */
+DVZ_EXPORT void dvz_staging_timestamps(DvzContext* context, bool enable);
+
+/**
+ * Return the total GPU time of the timed staging submissions that have completed.
+ *
+ * The time of a submission is only taken into account once its chunk has been recycled.
+ *
+ * @param context the context
+ * @returns the GPU time, in milliseconds
+ */
+DVZ_EXPORT double dvz_staging_gpu_time(DvzContext* context);
+
+
+
+/*************************************************************************************************/
+/*  Utils                                                                                        */
+/*************************************************************************************************/
+
+// Maximum size of a single staging chunk. Larger transfers are split into several chunks so that
+// the CPU can fill a chunk while the GPU copies the previous ones.
+static VkDeviceSize _staging_chunk_size(DvzContext* context)
+{
+    ASSERT(context != NULL);
+    ASSERT(context->staging.max_size >= DVZ_STAGING_STREAM_CHUNKS * DVZ_STAGING_ALIGNMENT);
+    VkDeviceSize size = context->staging.max_size / DVZ_STAGING_STREAM_CHUNKS;
+    // Keep the chunks aligned so that they are packed in the ring.
+    return size - (size % DVZ_STAGING_ALIGNMENT);
 }
 
 
 
 static void _copy_buffer_from_staging(
-    DvzContext* context, DvzBufferRegions br, VkDeviceSize offset, VkDeviceSize size)
+    DvzContext* context, DvzStagingChunk* chunk, DvzBufferRegions br, VkDeviceSize offset,
+    VkDeviceSize size)
 {
     ASSERT(context != NULL);
+    ASSERT(chunk != NULL);
 
-    DvzGpu* gpu = context->gpu;
-    ASSERT(gpu != NULL);
-
-    DvzBuffer* staging = staging_buffer(context, size);
+    DvzBuffer* staging = (DvzBuffer*)dvz_container_get(&context->buffers, DVZ_BUFFER_TYPE_STAGING);
     ASSERT(staging != NULL);
 
-    // Take transfer cmd buf.
-    DvzCommands* cmds = &context->transfer_cmd;
-    dvz_cmd_reset(cmds, 0);
-    dvz_cmd_begin(cmds, 0);
+    // Take the command buffer of the staging chunk.
+    DvzCommands* cmds = &context->staging.cmds;
 
     VkBufferCopy region = {0};
     region.size = size;
-    region.srcOffset = 0;
+    region.srcOffset = chunk->offset;
     region.dstOffset = br.offsets[0] + offset;
-    vkCmdCopyBuffer(cmds->cmds[0], staging->buffer, br.buffer->buffer, br.count, &region);
-    dvz_cmd_end(cmds, 0);
-
-    // Wait for the render queue to be idle.
-    // TODO: less brutal synchronization with semaphores. Here we stop all
-    // rendering so that we're sure that the buffer we're going to write to is not
-    // being used by the GPU.
-    dvz_queue_wait(gpu, DVZ_DEFAULT_QUEUE_RENDER);
+    vkCmdCopyBuffer(cmds->cmds[chunk->slot], staging->buffer, br.buffer->buffer, 1, &region);
 
-    // Submit the commands to the transfer queue.
-    DvzSubmit submit = dvz_submit(gpu);
-    dvz_submit_commands(&submit, cmds);
+    // Submit the commands to the transfer queue. The chunk will be recycled when the
+    // transfer has completed. The submission waits for the last render submission on the GPU,
+    // so that the buffer is not overwritten while being used.
     log_debug("copy %s from staging buffer", pretty_size(size));
-    dvz_submit_send(&submit, 0, NULL, 0);
-
-    // Wait for the transfer queue to be idle.
-    // TODO: less brutal synchronization with semaphores. Here we wait for the
-    // transfer to be complete before we send new rendering commands.
-    dvz_queue_wait(gpu, DVZ_DEFAULT_QUEUE_TRANSFER);
+    dvz_staging_submit(context, chunk);
 }
 
 
 
 static void _copy_buffer_to_staging(
-    DvzContext* context, DvzBufferRegions br, VkDeviceSize offset, VkDeviceSize size)
+    DvzContext* context, DvzStagingChunk* chunk, DvzBufferRegions br, VkDeviceSize offset,
+    VkDeviceSize size)
 {
     ASSERT(context != NULL);
+    ASSERT(chunk != NULL);
 
     DvzGpu* gpu = context->gpu;
     ASSERT(gpu != NULL);
 
-    DvzBuffer* staging = staging_buffer(context, size);
+    DvzBuffer* staging = (DvzBuffer*)dvz_container_get(&context->buffers, DVZ_BUFFER_TYPE_STAGING);
     ASSERT(staging != NULL);
 
-    // Take transfer cmd buf.
-    DvzCommands* cmds = &context->transfer_cmd;
-    dvz_cmd_reset(cmds, 0);
-    dvz_cmd_begin(cmds, 0);
+    // Take the command buffer of the staging chunk.
+    DvzCommands* cmds = &context->staging.cmds;
 
     // Determine the offset in the source buffer.
     // Should be consecutive offsets.
@@ -214,11 +402,12 @@ static void _copy_buffer_to_staging(
     }
     // Take into account the transfer offset.
     vk_offset += offset;
+    ASSERT(chunk->size >= size * n_regions);
 
     // Copy to staging buffer
     ASSERT(br.buffer != 0);
-    dvz_cmd_copy_buffer(cmds, 0, br.buffer, vk_offset, staging, 0, size * n_regions);
-    dvz_cmd_end(cmds, 0);
+    dvz_cmd_copy_buffer(
+        cmds, chunk->slot, br.buffer, vk_offset, staging, chunk->offset, size * n_regions);
 
     // Wait for the compute queue to be idle, as we assume the buffer to be copied from may
     // be modified by compute shaders.
@@ -226,88 +415,112 @@ static void _copy_buffer_to_staging(
     dvz_queue_wait(gpu, DVZ_DEFAULT_QUEUE_COMPUTE);
 
     // Submit the commands to the transfer queue.
-    DvzSubmit submit = dvz_submit(gpu);
-    dvz_submit_commands(&submit, cmds);
     log_debug("copy %s to staging buffer", pretty_size(size));
-    dvz_submit_send(&submit, 0, NULL, 0);
+    dvz_staging_submit(context, chunk);
+
+    // Wait for the copy to complete before the caller reads the staging chunk.
+    dvz_staging_wait(context);
+}
+
 
-    // Wait for the transfer queue to be idle.
-    // TODO: less brutal synchronization with semaphores. Here we wait for the
-    // transfer to be complete before we send new rendering commands.
-    dvz_queue_wait(gpu, DVZ_DEFAULT_QUEUE_TRANSFER);
+
+// Resolve the shape of a texture region, a zero dimension meaning the full texture dimension.
+static void _texture_shape(DvzTexture* texture, uvec3 offset, uvec3 shape, uvec3 out)
+{
+    ASSERT(texture != NULL);
+    ASSERT(texture->image != NULL);
+    uint32_t dims[3] = {texture->image->width, texture->image->height, texture->image->depth};
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        out[i] = shape[i] > 0 ? shape[i] : dims[i] - offset[i];
+        ASSERT(offset[i] + out[i] <= dims[i]);
+    }
+}
+
+
+
+// Copy region between a staging chunk and a texture region.
+static VkBufferImageCopy _texture_copy_region(DvzStagingChunk* chunk, uvec3 offset, uvec3 shape)
+{
+    ASSERT(chunk != NULL);
+    VkBufferImageCopy region = {0};
+    region.bufferOffset = chunk->offset;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset.x = (int32_t)offset[0];
+    region.imageOffset.y = (int32_t)offset[1];
+    region.imageOffset.z = (int32_t)offset[2];
+    region.imageExtent.width = shape[0];
+    region.imageExtent.height = shape[1];
+    region.imageExtent.depth = shape[2];
+    return region;
 }
 
 
 
 static void _copy_texture_from_staging(
-    DvzContext* context, DvzTexture* texture, uvec3 offset, uvec3 shape, VkDeviceSize size)
+    DvzContext* context, DvzStagingChunk* chunk, DvzTexture* texture, uvec3 offset, uvec3 shape,
+    VkDeviceSize size)
 {
     ASSERT(context != NULL);
+    ASSERT(chunk != NULL);
 
     DvzGpu* gpu = context->gpu;
     ASSERT(gpu != NULL);
 
-    DvzBuffer* staging = staging_buffer(context, size);
+    DvzBuffer* staging = (DvzBuffer*)dvz_container_get(&context->buffers, DVZ_BUFFER_TYPE_STAGING);
     ASSERT(staging != NULL);
 
-    // Take transfer cmd buf.
-    DvzCommands* cmds = &context->transfer_cmd;
-    dvz_cmd_reset(cmds, 0);
-    dvz_cmd_begin(cmds, 0);
+    // Take the command buffer of the staging chunk.
+    DvzCommands* cmds = &context->staging.cmds;
+    uint32_t idx = chunk->slot;
 
-    // Image transition.
+    // Image transition. NOTE: we transition from the current layout rather than from an
+    // undefined layout, so that the parts of the image outside the copied region are kept.
     DvzBarrier barrier = dvz_barrier(gpu);
     dvz_barrier_stages(&barrier, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
     ASSERT(texture != NULL);
     ASSERT(texture->image != NULL);
     dvz_barrier_images(&barrier, texture->image);
     dvz_barrier_images_layout(
-        &barrier, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        &barrier, texture->image->layout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
     dvz_barrier_images_access(&barrier, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
-    dvz_cmd_barrier(cmds, 0, &barrier);
+    dvz_cmd_barrier(cmds, idx, &barrier);
 
-    // Copy to staging buffer
-    dvz_cmd_copy_buffer_to_image(cmds, 0, staging, texture->image);
+    // Copy from the staging chunk.
+    VkBufferImageCopy region = _texture_copy_region(chunk, offset, shape);
+    vkCmdCopyBufferToImage(
+        cmds->cmds[idx], staging->buffer, texture->image->images[0],
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 
     // Image transition.
     dvz_barrier_images_layout(
         &barrier, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture->image->layout);
     dvz_barrier_images_access(&barrier, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT);
-    dvz_cmd_barrier(cmds, 0, &barrier);
-
-    dvz_cmd_end(cmds, 0);
-
-    // Wait for the render queue to be idle.
-    dvz_queue_wait(gpu, DVZ_DEFAULT_QUEUE_RENDER);
+    dvz_cmd_barrier(cmds, idx, &barrier);
 
-    // Submit the commands to the transfer queue.
-    DvzSubmit submit = dvz_submit(gpu);
-    dvz_submit_commands(&submit, cmds);
-    dvz_submit_send(&submit, 0, NULL, 0);
-
-    // Wait for the transfer queue to be idle.
-    // TODO: less brutal synchronization with semaphores. Here we wait for the
-    // transfer to be complete before we send new rendering commands.
-    dvz_queue_wait(gpu, DVZ_DEFAULT_QUEUE_TRANSFER);
+    // Submit the commands to the transfer queue, after the last render submission on the GPU.
+    dvz_staging_submit(context, chunk);
 }
 
 
 
 static void _copy_texture_to_staging(
-    DvzContext* context, DvzTexture* texture, uvec3 offset, uvec3 shape, VkDeviceSize size)
+    DvzContext* context, DvzStagingChunk* chunk, DvzTexture* texture, uvec3 offset, uvec3 shape,
+    VkDeviceSize size)
 {
     ASSERT(context != NULL);
+    ASSERT(chunk != NULL);
 
     DvzGpu* gpu = context->gpu;
     ASSERT(gpu != NULL);
 
-    DvzBuffer* staging = staging_buffer(context, size);
+    DvzBuffer* staging = (DvzBuffer*)dvz_container_get(&context->buffers, DVZ_BUFFER_TYPE_STAGING);
     ASSERT(staging != NULL);
 
-    // Take transfer cmd buf.
-    DvzCommands* cmds = &context->transfer_cmd;
-    dvz_cmd_reset(cmds, 0);
-    dvz_cmd_begin(cmds, 0);
+    // Take the command buffer of the staging chunk.
+    DvzCommands* cmds = &context->staging.cmds;
+    uint32_t idx = chunk->slot;
 
     // Image transition.
     DvzBarrier barrier = dvz_barrier(gpu);
@@ -316,33 +529,164 @@ static void _copy_texture_to_staging(
     ASSERT(texture->image != NULL);
     dvz_barrier_images(&barrier, texture->image);
     dvz_barrier_images_layout(
-        &barrier, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        &barrier, texture->image->layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
     dvz_barrier_images_access(&barrier, 0, VK_ACCESS_TRANSFER_READ_BIT);
-    dvz_cmd_barrier(cmds, 0, &barrier);
+    dvz_cmd_barrier(cmds, idx, &barrier);
 
-    // Copy to staging buffer
-    dvz_cmd_copy_image_to_buffer(cmds, 0, texture->image, staging);
+    // Copy to the staging chunk.
+    VkBufferImageCopy region = _texture_copy_region(chunk, offset, shape);
+    vkCmdCopyImageToBuffer(
+        cmds->cmds[idx], texture->image->images[0], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        staging->buffer, 1, &region);
 
     // Image transition.
     dvz_barrier_images_layout(
         &barrier, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture->image->layout);
     dvz_barrier_images_access(&barrier, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_MEMORY_READ_BIT);
-    dvz_cmd_barrier(cmds, 0, &barrier);
-
-    dvz_cmd_end(cmds, 0);
+    dvz_cmd_barrier(cmds, idx, &barrier);
 
     // Wait for the render queue to be idle.
     dvz_queue_wait(gpu, DVZ_DEFAULT_QUEUE_RENDER);
 
     // Submit the commands to the transfer queue.
-    DvzSubmit submit = dvz_submit(gpu);
-    dvz_submit_commands(&submit, cmds);
-    dvz_submit_send(&submit, 0, NULL, 0);
-
-    // Wait for the transfer queue to be idle.
-    // TODO: less brutal synchronization with semaphores. Here we wait for the
-    // transfer to be complete before we send new rendering commands.
-    dvz_queue_wait(gpu, DVZ_DEFAULT_QUEUE_TRANSFER);
+    dvz_staging_submit(context, chunk);
+
+    // Wait for the copy to complete before the caller reads the staging chunk.
+    dvz_staging_wait(context);
+}
+
+
+
+// Number of slices (along Z) or rows (along Y) of a texture region that fit in a staging chunk.
+static uint32_t _texture_slab(
+    VkDeviceSize chunk_size, uvec3 shape, VkDeviceSize texel_size, uint32_t* axis)
+{
+    ASSERT(axis != NULL);
+    VkDeviceSize row_size = shape[0] * texel_size;
+    VkDeviceSize slice_size = shape[1] * row_size;
+
+    // Whole slices fit in a chunk: slabs along Z.
+    if (slice_size <= chunk_size)
+    {
+        *axis = 2;
+        return (uint32_t)MIN(chunk_size / slice_size, shape[2]);
+    }
+
+    // Otherwise, slabs of rows along Y, one slice at a time.
+    if (row_size > chunk_size)
+        log_error("texture row of %s exceeds the staging chunk size", pretty_size(row_size));
+    ASSERT(row_size <= chunk_size);
+    *axis = 1;
+    return (uint32_t)MIN(chunk_size / row_size, shape[1]);
+}
+
+
+
+// Stream data to a texture region through the staging buffer, by slabs along Z or Y. The row and
+// slice pitches of the data are in bytes, 0 means the data is packed.
+// NOTE: this function does not wait for the upload to complete.
+static void _upload_texture_staging(
+    DvzContext* context, DvzTexture* texture, uvec3 offset, uvec3 shape, VkDeviceSize size,
+    VkDeviceSize row_pitch, VkDeviceSize slice_pitch, const void* data)
+{
+    ASSERT(context != NULL);
+    ASSERT(size > 0);
+    ASSERT(data != NULL);
+
+    uvec3 sh = {0};
+    _texture_shape(texture, offset, shape, sh);
+    VkDeviceSize texel_size = size / (sh[0] * sh[1] * sh[2]);
+    ASSERT(texel_size > 0);
+    ASSERT(size == texel_size * sh[0] * sh[1] * sh[2]);
+
+    // Strides of the source data.
+    if (row_pitch == 0)
+        row_pitch = sh[0] * texel_size;
+    if (slice_pitch == 0)
+        slice_pitch = sh[1] * row_pitch;
+    ASSERT(row_pitch >= sh[0] * texel_size);
+    ASSERT(slice_pitch >= sh[1] * row_pitch);
+    bool packed = row_pitch == sh[0] * texel_size && slice_pitch == sh[1] * row_pitch;
+
+    uint32_t axis = 0;
+    uint32_t step = _texture_slab(_staging_chunk_size(context), sh, texel_size, &axis);
+    ASSERT(step > 0);
+
+    uvec3 slab_offset = {0};
+    uvec3 slab_shape = {0};
+    VkDeviceSize slab_size = 0, data_offset = 0;
+    DvzStagingChunk chunk = {0};
+    const void* src = NULL;
+    for (uint32_t z = 0; z < sh[2]; z += (axis == 2 ? step : 1))
+    {
+        for (uint32_t y = 0; y < sh[1]; y += (axis == 2 ? sh[1] : step))
+        {
+            slab_offset[0] = offset[0];
+            slab_offset[1] = offset[1] + y;
+            slab_offset[2] = offset[2] + z;
+            slab_shape[0] = sh[0];
+            slab_shape[1] = axis == 2 ? sh[1] : MIN(step, sh[1] - y);
+            slab_shape[2] = axis == 2 ? MIN(step, sh[2] - z) : 1;
+            slab_size = slab_shape[0] * slab_shape[1] * slab_shape[2] * texel_size;
+            data_offset = (VkDeviceSize)z * slice_pitch + (VkDeviceSize)y * row_pitch;
+            src = (const void*)((const uint8_t*)data + data_offset);
+
+            chunk = dvz_staging_alloc(context, slab_size);
+            if (packed)
+                dvz_staging_upload(context, &chunk, slab_size, src);
+            else
+                dvz_staging_upload_strided(
+                    context, &chunk, slab_shape, texel_size, row_pitch, slice_pitch, src);
+            _copy_texture_from_staging(
+                context, &chunk, texture, slab_offset, slab_shape, slab_size);
+        }
+    }
+}
+
+
+
+// Stream data from a texture region through the staging buffer, by slabs along Z or Y.
+static void _download_texture_staging(
+    DvzContext* context, DvzTexture* texture, uvec3 offset, uvec3 shape, VkDeviceSize size,
+    void* data)
+{
+    ASSERT(context != NULL);
+    ASSERT(size > 0);
+    ASSERT(data != NULL);
+
+    uvec3 sh = {0};
+    _texture_shape(texture, offset, shape, sh);
+    VkDeviceSize texel_size = size / (sh[0] * sh[1] * sh[2]);
+    ASSERT(texel_size > 0);
+    ASSERT(size == texel_size * sh[0] * sh[1] * sh[2]);
+
+    uint32_t axis = 0;
+    uint32_t step = _texture_slab(_staging_chunk_size(context), sh, texel_size, &axis);
+    ASSERT(step > 0);
+
+    uvec3 slab_offset = {0};
+    uvec3 slab_shape = {0};
+    VkDeviceSize slab_size = 0, data_offset = 0;
+    DvzStagingChunk chunk = {0};
+    for (uint32_t z = 0; z < sh[2]; z += (axis == 2 ? step : 1))
+    {
+        for (uint32_t y = 0; y < sh[1]; y += (axis == 2 ? sh[1] : step))
+        {
+            slab_offset[0] = offset[0];
+            slab_offset[1] = offset[1] + y;
+            slab_offset[2] = offset[2] + z;
+            slab_shape[0] = sh[0];
+            slab_shape[1] = axis == 2 ? sh[1] : MIN(step, sh[1] - y);
+            slab_shape[2] = axis == 2 ? MIN(step, sh[2] - z) : 1;
+            slab_size = slab_shape[0] * slab_shape[1] * slab_shape[2] * texel_size;
+            data_offset = ((VkDeviceSize)z * sh[1] + y) * sh[0] * texel_size;
+
+            chunk = dvz_staging_alloc(context, slab_size);
+            _copy_texture_to_staging(context, &chunk, texture, slab_offset, slab_shape, slab_size);
+            dvz_staging_download(
+                context, &chunk, slab_size, (void*)((uint8_t*)data + data_offset));
+        }
+    }
 }
 
 
@@ -366,6 +710,25 @@ DVZ_EXPORT DvzContext* dvz_context(DvzGpu* gpu, DvzWindow* window);
  */
 DVZ_EXPORT void dvz_context_reset(DvzContext* context);
 
+/**
+ * Acquire the context lock.
+ *
+ * The lock serializes the accesses to the GPU state shared by the canvases: buffer and texture
+ * allocations, staging ring, and queue submissions. This is needed when several canvases are
+ * prepared in parallel, see `dvz_app_workers()`. The lock may be acquired several times by the
+ * same thread.
+ *
+ * @param context the context
+ */
+DVZ_EXPORT void dvz_context_lock(DvzContext* context);
+
+/**
+ * Release the context lock.
+ *
+ * @param context the context
+ */
+DVZ_EXPORT void dvz_context_unlock(DvzContext* context);
+
 
 
 /*************************************************************************************************/
@@ -386,6 +749,9 @@ DVZ_EXPORT DvzBufferRegions dvz_ctx_buffers(
 /**
  * Resize a set of buffer regions.
  *
+ * The regions are resized in place when possible. Otherwise, new regions are allocated, the old
+ * ones are freed, and the data is not kept.
+ *
  * @param context the context
  * @param br the buffer regions to resize
  * @param new_size the new size of each buffer region, in bytes
@@ -393,6 +759,25 @@ DVZ_EXPORT DvzBufferRegions dvz_ctx_buffers(
 DVZ_EXPORT void
 dvz_ctx_buffers_resize(DvzContext* context, DvzBufferRegions* br, VkDeviceSize new_size);
 
+/**
+ * Free a set of buffer regions so that the space can be reused by later allocations.
+ *
+ * The regions must no longer be used by the GPU.
+ *
+ * @param context the context
+ * @param br the buffer regions to free, reset by this function
+ */
+DVZ_EXPORT void dvz_ctx_buffers_free(DvzContext* context, DvzBufferRegions* br);
+
+/**
+ * Get allocation and fragmentation statistics of a buffer.
+ *
+ * @param context the context
+ * @param buffer_type the buffer type
+ * @returns the statistics
+ */
+DVZ_EXPORT DvzAllocStats dvz_ctx_buffers_stats(DvzContext* context, DvzBufferType buffer_type);
+
 
 
 /*************************************************************************************************/
@@ -409,6 +794,24 @@ DVZ_EXPORT DvzCompute* dvz_ctx_compute(DvzContext* context, const char* shader_p
 
 
 
+/*************************************************************************************************/
+/*  Shaders                                                                                      */
+/*************************************************************************************************/
+
+/**
+ * Get the shader module of a builtin shader.
+ *
+ * The shader module is created the first time it is requested, and then shared by all graphics
+ * pipelines of the context. It is destroyed with the context.
+ *
+ * @param context the context
+ * @param name the name of the builtin shader resource, for example `graphics_point_vert`
+ * @returns the shader module
+ */
+DVZ_EXPORT VkShaderModule dvz_ctx_shader(DvzContext* context, const char* name);
+
+
+
 /*************************************************************************************************/
 /*  Texture                                                                                      */
 /*************************************************************************************************/
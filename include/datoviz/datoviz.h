@@ -21,6 +21,7 @@ extern "C" {
 #include "interact.h"
 #include "mesh.h"
 #include "panel.h"
+#include "profile.h"
 #include "scene.h"
 #include "transfers.h"
 #include "visuals.h"
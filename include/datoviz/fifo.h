@@ -1,5 +1,5 @@
 /*************************************************************************************************/
-/*  Standalone, thread-safe, generic FIFO queue                                                  */
+/*  Standalone, thread-safe, lock-free, generic FIFO queue                                       */
 /*************************************************************************************************/
 
 #ifndef DVZ_FIFO_HEADER
@@ -17,6 +17,7 @@ extern "C" {
 /*  Constants                                                                                    */
 /*************************************************************************************************/
 
+// Default initial capacity of the FIFO queues. The queues grow beyond it when needed.
 #define DVZ_MAX_FIFO_CAPACITY 256
 
 
@@ -26,6 +27,7 @@ extern "C" {
 /*************************************************************************************************/
 
 typedef struct DvzFifo DvzFifo;
+typedef struct DvzFifoSlot DvzFifoSlot;
 
 
 
@@ -33,15 +35,34 @@ typedef struct DvzFifo DvzFifo;
 /*  FIFO queue                                                                                   */
 /*************************************************************************************************/
 
+struct DvzFifoSlot
+{
+    // Position of the slot in the ring: equal to the enqueue position when the slot is free,
+    // to that position + 1 when it holds an item ready to be dequeued.
+    atomic(uint64_t, seq);
+    void* item;
+};
+
+
+
+// Bounded, lock-free, multiple-producer multiple-consumer ring of pointers. When the ring is
+// full, it is enlarged while the other threads wait for the few microseconds this takes.
 struct DvzFifo
 {
-    int32_t head, tail;
-    int32_t capacity;
-    void** items;
+    atomic(uint64_t, head); // next enqueue position
+    atomic(uint64_t, tail); // next dequeue position
+    atomic(int32_t, capacity);
+    DvzFifoSlot* slots;
     void* user_data;
 
+    // Enlarging the ring requires that no other thread accesses it.
+    atomic(int32_t, users);
+    atomic(bool, resizing);
+
+    // Only used by consumers waiting on an empty queue.
     pthread_mutex_t lock;
     pthread_cond_t cond;
+    atomic(int32_t, waiters);
 
     atomic(bool, is_processing);
     atomic(bool, is_empty);
@@ -56,7 +77,7 @@ struct DvzFifo
 /**
  * Create a FIFO queue.
  *
- * @param capacity the maximum size
+ * @param capacity the initial capacity, rounded up to a power of two, the queue grows if needed
  * @returns a FIFO queue
  */
 DVZ_EXPORT DvzFifo dvz_fifo(int32_t capacity);
@@ -73,7 +94,7 @@ DVZ_EXPORT void dvz_fifo_enqueue(DvzFifo* fifo, void* item);
  * Dequeue an object from a queue.
  *
  * @param fifo the FIFO queue
- * @param wait whether to return immediately, or wait until the queue is non-empty
+ * @param wait whether to return immediately, or sleep until the queue is non-empty
  * @returns a pointer to the dequeued object, or NULL if the queue is empty
  */
 DVZ_EXPORT void* dvz_fifo_dequeue(DvzFifo* fifo, bool wait);
@@ -99,6 +120,8 @@ DVZ_EXPORT void dvz_fifo_discard(DvzFifo* fifo, int max_size);
 /**
  * Delete all items in a queue.
  *
+ * The items are removed from the queue but not freed.
+ *
  * @param fifo the FIFO queue
  */
 DVZ_EXPORT void dvz_fifo_reset(DvzFifo* fifo);
@@ -20,10 +20,15 @@
 
 #define USER_BINDING 2
 
+// Specialization constants, see DvzSpecializationConstant. Negative values mean that the clipping
+// and transform modes are read at runtime from the viewport uniform.
+layout(constant_id = 0) const int DVZ_SPEC_CLIP = -1;
+layout(constant_id = 1) const int DVZ_SPEC_TRANSFORM = -1;
+
 // NOTE:needs to be a macro and not a function so that it can be safely included in both
 // vertex and fragment shaders (discard is forbidden in the vertex shader)
 #define CLIP \
-    switch (viewport.clip)                                                                        \
+    switch (DVZ_SPEC_CLIP >= 0 ? DVZ_SPEC_CLIP : viewport.clip)                                   \
     {                                                                                             \
         case DVZ_VIEWPORT_NONE:                                                                   \
             break;                                                                                \
@@ -103,9 +108,10 @@ vec4 transform(vec3 pos, vec2 shift, uint transform_mode) {
     mat4 mvp = mvp.proj * mvp.view * mvp.model;
     vec4 tr = vec4(pos, 1.0);
 
-    // By default, take the viewport transform.
+    // By default, take the specialized transform, or the viewport transform.
     if (transform_mode == DVZ_INTERACT_FIXED_AXIS_DEFAULT)
-        transform_mode = uint(viewport.interact_axis);
+        transform_mode = DVZ_SPEC_TRANSFORM >= 0 ?
+            uint(DVZ_SPEC_TRANSFORM) : uint(viewport.interact_axis);
     // Default: transform all
     if (transform_mode == DVZ_INTERACT_FIXED_AXIS_DEFAULT)
         transform_mode = DVZ_INTERACT_FIXED_AXIS_NONE;
@@ -5,6 +5,10 @@
 
 #include "constants.glsl"
 
+// Specialization constant, see DvzSpecializationConstant. A pipeline specialized with a single
+// marker type does not branch on the marker type of each vertex.
+layout(constant_id = 2) const int DVZ_SPEC_MARKER = -1;
+
 
 float marker_arrow(vec2 P, float size)
 {
@@ -251,6 +255,8 @@ float marker_vbar(vec2 P, float size)
 
 float select_marker(vec2 P, float size, float marker_type) {
     // NOTE: the numbers need to correspond to DvzMarkerType enum in visuals.h
+    if (DVZ_SPEC_MARKER >= 0)
+        marker_type = float(DVZ_SPEC_MARKER);
     if (marker_type <  0.5) return marker_disc(P, size);
     if (marker_type <  1.5) return marker_asterisk(P, size);
     if (marker_type <  2.5) return marker_chevron(P, size);
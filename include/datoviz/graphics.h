@@ -96,6 +96,22 @@ typedef enum
 
 
 
+// Specialization constants of the builtin shaders.
+// NOTE: the ids need to correspond to the constant_id values in the builtin shaders. For the int
+// constants, a negative value (the default) means that the value is read at runtime from the
+// uniforms or the vertices.
+typedef enum
+{
+    DVZ_SPEC_CLIP = 0,            // int: DvzViewportClip, viewport clipping
+    DVZ_SPEC_TRANSFORM = 1,       // int: DvzInteractAxis, fixed axes of the transform
+    DVZ_SPEC_MARKER = 2,          // int: DvzMarkerType, single marker type
+    DVZ_SPEC_VOLUME_STEP = 3,     // float: ray marching step size (0.005)
+    DVZ_SPEC_VOLUME_MAX_ITER = 4, // int: maximum number of ray marching steps (2000)
+    DVZ_SPEC_VOLUME_COLORMAP = 5, // int: DvzColormap
+} DvzSpecializationConstant;
+
+
+
 /*************************************************************************************************/
 /*  Typedefs                                                                                     */
 /*************************************************************************************************/
@@ -463,6 +479,21 @@ DVZ_EXPORT void dvz_graphics_append(DvzGraphicsData* data, const void* item);
  */
 DVZ_EXPORT DvzGraphics* dvz_graphics_builtin(DvzCanvas* canvas, DvzGraphicsType type, int flags);
 
+/**
+ * Create a new graphics pipeline of a given builtin type, with specialization constants.
+ *
+ * The specialization constants, see `DvzSpecializationConstant`, let the builtin shaders drop
+ * their runtime branches, for example on the marker type or on the viewport clipping mode.
+ * Graphics pipelines with the same type, flags, and specialization constants are shared.
+ *
+ * @param canvas the canvas holding the grahpics pipeline
+ * @param type the graphics type
+ * @param flags the creation flags for the graphics
+ * @param specialization the specialization constants, or NULL
+ */
+DVZ_EXPORT DvzGraphics* dvz_graphics_builtin_specialized(
+    DvzCanvas* canvas, DvzGraphicsType type, int flags, const DvzSpecialization* specialization);
+
 
 
 /**
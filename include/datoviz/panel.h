@@ -99,6 +99,8 @@ struct DvzPanel
 
     // GPU objects
     DvzBufferRegions br_mvp; // for the uniform buffer containing the MVP
+    DvzMVP mvp_last;         // last MVP uploaded, for on-demand canvases
+    uint32_t mvp_pending;    // number of swapchain images whose MVP region is out of date
 
     DvzController* controller;
     DvzCommands* cmds;
@@ -0,0 +1,155 @@
+/*************************************************************************************************/
+/*  Lightweight CPU instrumentation of the frame phases                                          */
+/*************************************************************************************************/
+
+#ifndef DVZ_PROFILE_HEADER
+#define DVZ_PROFILE_HEADER
+
+#include "common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+/*************************************************************************************************/
+/*  Constants                                                                                    */
+/*************************************************************************************************/
+
+// The instrumentation scopes compile to nothing unless the library is built with profiling.
+#ifndef HAS_PROFILING
+#define HAS_PROFILING 0
+#endif
+
+// Number of most recent durations kept for each phase, used by the percentiles.
+#define DVZ_PROFILE_WINDOW 1024
+
+// Number of most recent scopes kept for the Chrome trace.
+#define DVZ_PROFILE_MAX_EVENTS 65536
+
+
+
+/*************************************************************************************************/
+/*  Enums                                                                                        */
+/*************************************************************************************************/
+
+// Instrumented phases.
+typedef enum
+{
+    DVZ_PROFILE_INTERACT,      // INTERACT callbacks
+    DVZ_PROFILE_FRAME,         // FRAME callbacks
+    DVZ_PROFILE_TIMER,         // TIMER callbacks
+    DVZ_PROFILE_TRANSFERS,     // pending transfers
+    DVZ_PROFILE_REFILL,        // command buffer refill
+    DVZ_PROFILE_FENCE_WAIT,    // wait for the fence of the frame in flight
+    DVZ_PROFILE_ACQUIRE,       // swapchain image acquisition
+    DVZ_PROFILE_SUBMIT,        // frame submission and presentation
+    DVZ_PROFILE_VISUAL_UPDATE, // dvz_visual_update(), including the bake callback
+    DVZ_PROFILE_BAKE,          // visual bake callback
+    DVZ_PROFILE_COUNT,
+} DvzProfilePhase;
+
+
+
+/*************************************************************************************************/
+/*  Type definitions                                                                             */
+/*************************************************************************************************/
+
+typedef struct DvzProfileStats DvzProfileStats;
+
+
+
+/*************************************************************************************************/
+/*  Structs                                                                                      */
+/*************************************************************************************************/
+
+// Rolling statistics of a phase, over its last DVZ_PROFILE_WINDOW durations.
+struct DvzProfileStats
+{
+    uint64_t count; // total number of recorded scopes
+    double last;    // duration of the last scope, in ms
+    double p50;     // median duration, in ms
+    double p95;     // 95th percentile, in ms
+    double p99;     // 99th percentile, in ms
+    double max;     // maximum duration, in ms
+};
+
+
+
+/*************************************************************************************************/
+/*  Instrumentation macros                                                                       */
+/*************************************************************************************************/
+
+#if HAS_PROFILING
+#define DVZ_PROFILE_BEGIN(phase) uint64_t _dvz_profile_##phase = dvz_profile_now();
+#define DVZ_PROFILE_END(phase)                                                                    \
+    dvz_profile_record(phase, _dvz_profile_##phase, dvz_profile_now());
+#else
+#define DVZ_PROFILE_BEGIN(phase)
+#define DVZ_PROFILE_END(phase)
+#endif
+
+
+
+/*************************************************************************************************/
+/*  Profiling                                                                                    */
+/*************************************************************************************************/
+
+/**
+ * Return the current time of the monotonic clock used by the instrumentation.
+ *
+ * @returns the time, in nanoseconds
+ */
+DVZ_EXPORT uint64_t dvz_profile_now(void);
+
+/**
+ * Record a scope of a phase. Thread-safe and lock-free.
+ *
+ * This function is normally called through the `DVZ_PROFILE_BEGIN()` and `DVZ_PROFILE_END()`
+ * macros, which compile to nothing when the library is built without profiling.
+ *
+ * @param phase the phase
+ * @param begin the start time of the scope, in nanoseconds
+ * @param end the end time of the scope, in nanoseconds
+ */
+DVZ_EXPORT void dvz_profile_record(DvzProfilePhase phase, uint64_t begin, uint64_t end);
+
+/**
+ * Return the rolling statistics of a phase.
+ *
+ * @param phase the phase
+ * @returns the statistics, all zero if the phase has not been recorded
+ */
+DVZ_EXPORT DvzProfileStats dvz_profile_stats(DvzProfilePhase phase);
+
+/**
+ * Return the name of a phase, as it appears in the Chrome trace.
+ *
+ * @param phase the phase
+ * @returns the name of the phase
+ */
+DVZ_EXPORT const char* dvz_profile_name(DvzProfilePhase phase);
+
+/**
+ * Write the most recent scopes to a JSON file in the Chrome trace event format.
+ *
+ * The file can be opened in chrome://tracing or https://ui.perfetto.dev.
+ *
+ * @param path the path to the JSON file to create
+ * @returns 0 on success, nonzero on error
+ */
+DVZ_EXPORT int dvz_profile_trace(const char* path);
+
+/**
+ * Discard all recorded scopes.
+ */
+DVZ_EXPORT void dvz_profile_reset(void);
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -19,6 +19,7 @@
 /*************************************************************************************************/
 
 #define DVZ_MAX_VISUALS_PER_CONTROLLER 64
+#define DVZ_MAX_BAKE_WORKERS           16
 
 
 
@@ -161,6 +162,12 @@ struct DvzScene
 
     // FIFO queue with the pending scene updates.
     DvzFifo update_fifo;
+
+    // Worker threads baking the changed visuals in parallel, see dvz_scene_workers().
+    uint32_t bake_workers_count;
+    DvzThread bake_workers[DVZ_MAX_BAKE_WORKERS];
+    DvzFifo bake_jobs; // visual updates to bake in the current scene update pass
+    DvzFifo bake_done; // visual updates that have been baked
 };
 
 
@@ -195,6 +202,22 @@ DVZ_EXPORT void dvz_scene_destroy(DvzScene* scene);
 
 
 
+/**
+ * Set the number of worker threads baking the visuals of a scene in parallel.
+ *
+ * At every scene update, the bake callbacks of all changed visuals run concurrently on the
+ * workers, then the uploads and bindings updates are done serially in the calling thread. The
+ * bake callbacks of the scene's visuals, including the custom ones, must then follow the
+ * thread-safety contract of `DvzVisualDataCallback`.
+ *
+ * @param scene the scene
+ * @param count the number of workers, up to `DVZ_MAX_BAKE_WORKERS`, or 0 or 1 to bake all
+ *      visuals in the calling thread (default)
+ */
+DVZ_EXPORT void dvz_scene_workers(DvzScene* scene, uint32_t count);
+
+
+
 /*************************************************************************************************/
 /*  Controller                                                                                   */
 /*************************************************************************************************/
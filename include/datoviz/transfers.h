@@ -10,6 +10,21 @@
 
 
 
+/*************************************************************************************************/
+/*  Constants                                                                                    */
+/*************************************************************************************************/
+
+// Maximum number of buffer uploads packed in a single staging submission.
+#define DVZ_MAX_TRANSFER_BATCH 256
+
+// Number of transfers that can be pending in a canvas transfer queue. Must be a power of two.
+#define DVZ_TRANSFER_QUEUE_CAPACITY 4096
+
+// Number of asynchronous downloads that can be in flight at once (double buffering).
+#define DVZ_READBACK_SLOTS 2
+
+
+
 /*************************************************************************************************/
 /*  Transfer enums                                                                               */
 /*************************************************************************************************/
@@ -24,6 +39,8 @@ typedef enum
     DVZ_TRANSFER_TEXTURE_UPLOAD,
     DVZ_TRANSFER_TEXTURE_DOWNLOAD,
     DVZ_TRANSFER_TEXTURE_COPY,
+    DVZ_TRANSFER_BUFFER_DOWNLOAD_ASYNC,
+    DVZ_TRANSFER_TEXTURE_DOWNLOAD_ASYNC,
 } DvzDataTransferType;
 
 
@@ -38,6 +55,10 @@ typedef struct DvzTransferBufferCopy DvzTransferBufferCopy;
 typedef struct DvzTransferTexture DvzTransferTexture;
 typedef struct DvzTransferTextureCopy DvzTransferTextureCopy;
 typedef union DvzTransferUnion DvzTransferUnion;
+typedef struct DvzTransferSlot DvzTransferSlot;
+typedef struct DvzTransferQueue DvzTransferQueue;
+typedef struct DvzReadbackSlot DvzReadbackSlot;
+typedef struct DvzReadback DvzReadback;
 
 
 
@@ -68,6 +89,7 @@ struct DvzTransferTexture
     DvzTexture* texture;
     uvec3 offset, shape;
     VkDeviceSize size;
+    VkDeviceSize row_pitch, slice_pitch; // strides of the data in bytes, 0 if the data is packed
     void* data;
 };
 
@@ -95,10 +117,132 @@ struct DvzTransfer
 {
     DvzDataTransferType type;
     DvzTransferUnion u;
+    uint64_t id; // handle of asynchronous downloads
+};
+
+
+
+/*************************************************************************************************/
+/*  Transfer queue structs                                                                       */
+/*************************************************************************************************/
+
+struct DvzTransferSlot
+{
+    // Position of the slot in the ring: equal to the enqueue position when the slot is free,
+    // to that position + 1 when it holds a transfer ready to be dequeued.
+    atomic(uint64_t, seq);
+    DvzTransfer transfer;
+};
+
+
+
+// Bounded, lock-free, multiple-producer queue of transfers stored by value in a preallocated ring.
+struct DvzTransferQueue
+{
+    uint32_t capacity; // power of two
+    DvzTransferSlot* slots;
+
+    atomic(uint64_t, head); // next enqueue position
+    atomic(uint64_t, tail); // next dequeue position
 };
 
 
 
+/*************************************************************************************************/
+/*  Readback structs                                                                             */
+/*************************************************************************************************/
+
+struct DvzReadbackSlot
+{
+    uint64_t id;      // handle of the download in flight in this slot, 0 if the slot is free
+    DvzBuffer buffer; // host-visible, permanently mapped
+    VkDeviceSize size;
+    void* data; // destination of the download in host memory
+};
+
+
+
+// Asynchronous downloads. Each one is copied to its own host-visible buffer, and the copy is
+// fenced, so that the GPU fills one slot while the CPU consumes the other.
+struct DvzReadback
+{
+    DvzGpu* gpu;
+
+    // Buffers are read back on the compute queue, after the compute shaders that typically fill
+    // them. Textures are read back on the render queue, which owns their layout.
+    DvzCommands cmds_compute;
+    DvzCommands cmds_render;
+    DvzFences fences;
+
+    DvzReadbackSlot slots[DVZ_READBACK_SLOTS];
+    uint32_t next; // next slot to use, also the oldest one in flight when all slots are busy
+
+    atomic(uint64_t, last_id); // handle of the last requested download
+    uint32_t stall_count;      // number of downloads that waited for a slot to be free
+
+    // The handles are taken by the calling threads before the downloads are enqueued, so they
+    // may complete out of order.
+    pthread_mutex_t lock; // protects the completed handles
+    uint64_t done_id;     // all downloads up to this handle have completed
+    uint64_t* done_ids;   // sorted handles completed after a download that is still pending
+    uint32_t done_count, done_capacity;
+};
+
+
+
+/*************************************************************************************************/
+/*  Transfer queue                                                                               */
+/*************************************************************************************************/
+
+/**
+ * Create a transfer queue.
+ *
+ * The ring is allocated once here: enqueuing and dequeuing transfers never allocate memory.
+ *
+ * @param capacity the maximum number of pending transfers, must be a power of two
+ * @returns a transfer queue
+ */
+DVZ_EXPORT DvzTransferQueue dvz_transfer_queue(uint32_t capacity);
+
+/**
+ * Enqueue a transfer, copied by value.
+ *
+ * This function is lock-free and may be called concurrently from several threads.
+ *
+ * @param queue the transfer queue
+ * @param transfer the transfer
+ * @returns false if the queue is full
+ */
+DVZ_EXPORT bool dvz_transfer_queue_enqueue(DvzTransferQueue* queue, DvzTransfer transfer);
+
+/**
+ * Dequeue the oldest transfer.
+ *
+ * @param queue the transfer queue
+ * @param[out] transfer the dequeued transfer
+ * @returns false if the queue is empty
+ */
+DVZ_EXPORT bool dvz_transfer_queue_dequeue(DvzTransferQueue* queue, DvzTransfer* transfer);
+
+/**
+ * Get the number of pending transfers.
+ *
+ * The value is approximate while other threads are enqueuing or dequeuing.
+ *
+ * @param queue the transfer queue
+ * @returns the number of pending transfers
+ */
+DVZ_EXPORT uint32_t dvz_transfer_queue_size(DvzTransferQueue* queue);
+
+/**
+ * Destroy a transfer queue.
+ *
+ * @param queue the transfer queue
+ */
+DVZ_EXPORT void dvz_transfer_queue_destroy(DvzTransferQueue* queue);
+
+
+
 /*************************************************************************************************/
 /*  Transfers                                                                                    */
 /*************************************************************************************************/
@@ -127,6 +271,23 @@ DVZ_EXPORT void dvz_upload_buffers(
 DVZ_EXPORT void dvz_download_buffers(
     DvzCanvas* canvas, DvzBufferRegions br, VkDeviceSize offset, VkDeviceSize size, void* data);
 
+/**
+ * Download data from a buffer region without blocking.
+ *
+ * The copy is recorded at the next frame and the function returns immediately. When the data has
+ * landed in `data`, a `DVZ_EVENT_DOWNLOAD` event is raised with the returned handle, and
+ * `dvz_download_done()` returns true.
+ *
+ * @param canvas the canvas
+ * @param br the buffer regions to download from
+ * @param offset the offset within the buffer regions, in bytes
+ * @param size the size of the data to download, in bytes
+ * @param[out] data pointer to a buffer of `size` bytes, that must live until the download is done
+ * @returns the download handle
+ */
+DVZ_EXPORT uint64_t dvz_download_buffers_async(
+    DvzCanvas* canvas, DvzBufferRegions br, VkDeviceSize offset, VkDeviceSize size, void* data);
+
 /**
  * Copy data between two GPU buffer regions.
  *
@@ -157,6 +318,25 @@ DVZ_EXPORT void dvz_upload_texture(
     DvzCanvas* canvas, DvzTexture* texture, uvec3 offset, uvec3 shape, VkDeviceSize size,
     void* data);
 
+/**
+ * Upload a region of a larger CPU array to a texture.
+ *
+ * The region does not need to be contiguous in memory: its rows and slices are taken from `data`
+ * with the given pitches, so that a sub-box of an image can be uploaded without copying it first.
+ *
+ * @param canvas the canvas
+ * @param texture the texture to update
+ * @param offset the offset within the texture
+ * @param shape the shape of the region to update within the texture
+ * @param size the size of the region, in bytes, without padding
+ * @param row_pitch the number of bytes between two rows of `data`, or 0 if packed
+ * @param slice_pitch the number of bytes between two slices of `data`, or 0 if packed
+ * @param data pointer to the first texel of the region
+ */
+DVZ_EXPORT void dvz_upload_texture_strided(
+    DvzCanvas* canvas, DvzTexture* texture, uvec3 offset, uvec3 shape, VkDeviceSize size,
+    VkDeviceSize row_pitch, VkDeviceSize slice_pitch, void* data);
+
 /**
  * Download data from a texture.
  *
@@ -171,6 +351,46 @@ DVZ_EXPORT void dvz_download_texture(
     DvzCanvas* canvas, DvzTexture* texture, uvec3 offset, uvec3 shape, VkDeviceSize size,
     void* data);
 
+/**
+ * Download data from a texture without blocking.
+ *
+ * See `dvz_download_buffers_async()`.
+ *
+ * @param canvas the canvas
+ * @param texture the texture to download from
+ * @param offset the offset within the texture
+ * @param shape the shape of the region to download within the texture
+ * @param size the size of the downloaded data, in bytes
+ * @param[out] data pointer to a buffer of `size` bytes, that must live until the download is done
+ * @returns the download handle
+ */
+DVZ_EXPORT uint64_t dvz_download_texture_async(
+    DvzCanvas* canvas, DvzTexture* texture, uvec3 offset, uvec3 shape, VkDeviceSize size,
+    void* data);
+
+/**
+ * Return whether an asynchronous download has completed.
+ *
+ * The downloads requested from several threads may complete in a different order than their
+ * handles.
+ *
+ * @param canvas the canvas
+ * @param id the download handle
+ * @returns whether the data is available in host memory
+ */
+DVZ_EXPORT bool dvz_download_done(DvzCanvas* canvas, uint64_t id);
+
+/**
+ * Block until an asynchronous download has completed.
+ *
+ * This function must be called from the thread that processes the transfers, or when the event
+ * loop is not running.
+ *
+ * @param canvas the canvas
+ * @param id the download handle
+ */
+DVZ_EXPORT void dvz_download_wait(DvzCanvas* canvas, uint64_t id);
+
 /**
  * Copy part of a texture to another.
  *
@@ -206,4 +426,25 @@ DVZ_EXPORT void dvz_process_transfers(DvzCanvas* canvas);
 
 
 
+/*************************************************************************************************/
+/*  Readback                                                                                     */
+/*************************************************************************************************/
+
+/**
+ * Create the resources used by asynchronous downloads.
+ *
+ * @param gpu the GPU
+ * @returns the readback object
+ */
+DVZ_EXPORT DvzReadback dvz_readback(DvzGpu* gpu);
+
+/**
+ * Wait for the downloads in flight and destroy the readback resources.
+ *
+ * @param readback the readback object
+ */
+DVZ_EXPORT void dvz_readback_destroy(DvzReadback* readback);
+
+
+
 #endif
@@ -204,6 +204,31 @@ MAKE_TRANSPOSE(vec3)
 DVZ_EXPORT void
 dvz_transform_pos(DvzDataCoords coords, DvzArray* pos_in, DvzArray* pos_out, bool inverse);
 
+/**
+ * Normalize positions and write them in single precision to the column of a record array.
+ *
+ * This fuses `dvz_transform_pos()` and the cast done by `dvz_array_column()`, without any
+ * intermediate array. Each data item is normalized once, even when it is repeated.
+ *
+ * @param coords the data coordinate system and bounds
+ * @param array the record array
+ * @param offset the offset of the column within each array item, in bytes
+ * @param first_item first element in the array to be overwritten
+ * @param item_count number of elements to write
+ * @param data_item_count number of positions in `data`
+ * @param data the positions
+ * @param source_dtype the dtype of the positions: dvec3, vec3, dvec2, or vec2
+ * @param target_dtype the dtype of the column: vec3 or vec2
+ * @param copy_type the type of copy
+ * @param reps the number of repeats for each position
+ */
+DVZ_EXPORT void dvz_transform_pos_column(
+    DvzDataCoords coords, DvzArray* array, VkDeviceSize offset, //
+    uint32_t first_item, uint32_t item_count,                   //
+    uint32_t data_item_count, const void* data,                 //
+    DvzDataType source_dtype, DvzDataType target_dtype,         //
+    DvzArrayCopyType copy_type, uint32_t reps);
+
 /**
  * Convert a 3D position from a coordinate system to another.
  *
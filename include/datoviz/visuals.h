@@ -21,6 +21,7 @@
 #define DVZ_MAX_VISUAL_GROUPS       1024
 #define DVZ_MAX_VISUAL_PRIORITY     4
 #define DVZ_MAX_UNIFORM_SIZE        65536
+#define DVZ_MAX_DIRTY_RANGES        8
 
 
 /*************************************************************************************************/
@@ -131,6 +132,7 @@ typedef enum
 typedef enum
 {
     DVZ_SOURCE_FLAG_MAPPABLE = 0x0001,
+    DVZ_SOURCE_FLAG_CIRCULAR = 0x0002, // texture written column by column, wrapping around
 } DvzSourceFlags;
 
 
@@ -157,7 +159,9 @@ typedef struct DvzVisual DvzVisual;
 typedef struct DvzProp DvzProp;
 
 typedef union DvzSourceUnion DvzSourceUnion;
+typedef union DvzIndirectArgs DvzIndirectArgs;
 typedef struct DvzSource DvzSource;
+typedef struct DvzDirtyRanges DvzDirtyRanges;
 
 typedef struct DvzVisualFillEvent DvzVisualFillEvent;
 typedef struct DvzVisualDataEvent DvzVisualDataEvent;
@@ -185,6 +189,13 @@ called by the scene event callback in response to a DATA event
 baking process
 visual data sources, item count, groups ==> bindings, vertex buffer, index buffer
 enqueue data transfers
+
+Thread-safety contract of the bake callback: the scene may bake several visuals concurrently
+on its worker threads (see dvz_scene_workers()). The bake callback of a visual may only read and
+write the props, sources, and user data of that visual, and read the canvas and its own
+graphics. It must not make any GPU call (buffers, textures, bindings, transfers, context), nor
+modify any state shared with other visuals without its own synchronization. The uploads and
+bindings updates happen later, serially, in dvz_visual_update().
 */
 
 
@@ -201,6 +212,31 @@ union DvzSourceUnion
 
 
 
+// Indirect draw parameters of a graphics pipeline, as read by the GPU. Both structures start with
+// the number of vertices/indices to draw.
+union DvzIndirectArgs
+{
+    VkDrawIndirectCommand draw;
+    VkDrawIndexedIndirectCommand draw_indexed;
+};
+
+
+
+// Set of disjoint item ranges that have changed since the last upload. Ranges are kept sorted
+// and merged, and the closest ranges are coalesced when there are too many of them.
+struct DvzDirtyRanges
+{
+    bool full;                            // whether all items have changed
+    uint32_t count;                       // number of ranges
+    uint32_t first[DVZ_MAX_DIRTY_RANGES]; // first item of each range
+    uint32_t last[DVZ_MAX_DIRTY_RANGES];  // item following the last item of each range
+
+    // Texture sources track a single box of texels instead, with count = 1 when it is set.
+    uvec3 box_min, box_max;
+};
+
+
+
 // Within a visual, a source is uniquely identified by (1) its type, (2) the source_idx
 struct DvzSource
 {
@@ -224,6 +260,9 @@ struct DvzSource
 
     DvzSourceOrigin origin; // whether the underlying GPU object is handled by the user or datoviz
     DvzSourceUnion u;
+
+    DvzDirtyRanges dirty; // items of the array to upload at the next update
+    uint32_t column_head; // next column to write to, for circular texture sources
 };
 
 
@@ -252,7 +291,14 @@ struct DvzProp
     DvzDataType target_dtype; // used for casting during the copy to the vertex array
     DvzArrayCopyType copy_type;
     uint32_t reps; // number of repeats when copying
+
+    DvzDirtyRanges dirty; // items of the prop arrays changed since the last baking
     // bool is_set; // whether the user has set this prop
+
+    // Single-precision POS props have no transformed array: they are normalized with these data
+    // coordinates when they are copied to their source, see dvz_visual_prop_float().
+    bool normalize;
+    DvzDataCoords coords;
 };
 
 
@@ -275,10 +321,18 @@ struct DvzVisual
 
     // Keep track of the previous number of vertices/indices in each graphics pipeline, so that
     // we can automatically detect changes in vetex_count/index_count and trigger a full REFILL
-    // in this case.
+    // in this case, unless the visual draws with indirect draw parameters.
     uint32_t prev_vertex_count[DVZ_MAX_GRAPHICS_PER_VISUAL];
     uint32_t prev_index_count[DVZ_MAX_GRAPHICS_PER_VISUAL];
 
+    // Indirect draw parameters of each graphics pipeline, uploaded by dvz_visual_update() when
+    // the number of vertices/indices changes. The default fill callback draws with them, so that
+    // the command buffers do not need to be recorded again.
+    bool draw_indirect; // whether the fill callback uses the indirect draw parameters
+    DvzBufferRegions indirect[DVZ_MAX_GRAPHICS_PER_VISUAL];
+    DvzIndirectArgs indirect_args[DVZ_MAX_GRAPHICS_PER_VISUAL];
+    bool indirect_indexed[DVZ_MAX_GRAPHICS_PER_VISUAL]; // whether the recorded draw is indexed
+
     // Computes.
     uint32_t compute_count;
     DvzCompute* computes[DVZ_MAX_COMPUTES_PER_VISUAL];
@@ -308,6 +362,17 @@ struct DvzVisual
     // GPU data
     DvzContainer bindings;
     DvzContainer bindings_comp;
+
+    // Cached secondary command buffers recorded by the fill callback, one per swapchain image,
+    // with the viewport and clear color they were recorded with.
+    DvzCommands cmds_fill;
+    bool fill_valid[DVZ_MAX_SWAPCHAIN_IMAGES];
+    VkViewport fill_viewport;
+    VkClearColorValue fill_clear_color;
+    bool fill_profile; // whether the command buffers write GPU timestamps
+
+    // Whether dvz_visual_bake() was called since the last dvz_visual_update().
+    bool baked;
 };
 
 
@@ -352,7 +417,9 @@ DVZ_EXPORT DvzVisual dvz_visual(DvzCanvas* canvas);
 /**
  * Destroy a visual.
  *
- * This function destroys all GPU objects associated to the visual.
+ * This function destroys all GPU objects associated to the visual. The visuals of a scene may be
+ * destroyed after their canvas, but the other visuals must be destroyed before, as their command
+ * buffers are allocated from the canvas command pool.
  *
  * @param visual the visual
  */
@@ -396,6 +463,22 @@ DVZ_EXPORT void dvz_visual_source(
 DVZ_EXPORT void dvz_visual_source_share(
     DvzVisual* visual, DvzSourceType source_type, uint32_t source_idx, uint32_t other_idx);
 
+/**
+ * Make a source use a persistently-mapped, host-visible buffer.
+ *
+ * The data of a mappable vertex source is written directly into GPU-visible memory at every
+ * upload, without going through the staging buffer. There is one copy of the data per swapchain
+ * image, and only the copy of the image being rendered is updated while the app is running: this
+ * is meant for data that changes at every frame.
+ *
+ * @param visual the visual
+ * @param source_type the source type, either a vertex or a uniform source
+ * @param source_idx the source index
+ * @param mappable whether the source should be mappable
+ */
+DVZ_EXPORT void dvz_visual_source_mappable(
+    DvzVisual* visual, DvzSourceType source_type, uint32_t source_idx, bool mappable);
+
 /**
  * Define a new prop for a visual.
  *
@@ -435,6 +518,19 @@ DVZ_EXPORT void dvz_visual_prop_copy(
     DvzProp* prop, uint32_t field_idx, VkDeviceSize offset, //
     DvzArrayCopyType copy_type, uint32_t reps);
 
+/**
+ * Store a POS prop in single precision.
+ *
+ * The prop data must then be passed as vec3 (or vec2) instead of dvec3 (or dvec2). The data
+ * normalization and the cast to the vertex buffer are fused, so that the prop requires neither a
+ * double-precision copy nor a transformed array. This is only supported by the visuals using the
+ * default bake callback, and whose source takes single-precision positions. The data that has
+ * already been set is converted.
+ *
+ * @param prop the POS prop
+ */
+DVZ_EXPORT void dvz_visual_prop_float(DvzProp* prop);
+
 /**
  * Set up how a prop should be cast when it is copied to its source.
  *
@@ -500,6 +596,9 @@ DVZ_EXPORT void dvz_visual_data(
  * If the specified data has less elements than the number of elements to update, the last element
  * will be repeated as many times as necessary.
  *
+ * The changed items are tracked, so that only the corresponding vertices are baked and uploaded
+ * at the next visual update, with the default baking function.
+ *
  * @param visual the visual
  * @param prop_type the prop type
  * @param prop_idx the prop index
@@ -539,6 +638,44 @@ DVZ_EXPORT void dvz_visual_data_source(
     DvzVisual* visual, DvzSourceType source_type, uint32_t source_idx, //
     uint32_t first_item, uint32_t item_count, uint32_t data_item_count, const void* data);
 
+/**
+ * Set a box of texels of a texture source.
+ *
+ * Only the changed box is uploaded to the GPU at the next visual update. If the box extends
+ * beyond the current shape of the texture, the texture is enlarged and *its contents are cleared*,
+ * so the full texture should be set first, with a zero offset.
+ *
+ * @param visual the visual
+ * @param source_type the source type
+ * @param source_idx the source index
+ * @param offset the offset of the box within the texture
+ * @param shape the shape of the box
+ * @param data the texels of the box, packed, in the format of the texture
+ */
+DVZ_EXPORT void dvz_visual_data_texture(
+    DvzVisual* visual, DvzSourceType source_type, uint32_t source_idx, //
+    uvec3 offset, uvec3 shape, const void* data);
+
+/**
+ * Write columns in a 2D texture source used as a circular buffer, for example a spectrogram.
+ *
+ * The columns are written at the current head of the source, wrapping around the width of the
+ * texture, which must have been set beforehand with `dvz_visual_data_texture()`. The texture
+ * uses a repeat address mode along its first axis, so that the visual can scroll the image by
+ * shifting its texture coordinates by `head / width`. If the texture already exists on the GPU,
+ * the first call waits for the GPU to switch its sampler, and refills the command buffers.
+ *
+ * @param visual the visual
+ * @param source_type the source type
+ * @param source_idx the source index
+ * @param column_count the number of columns to write
+ * @param data the texels of the columns, as a packed image of `column_count` columns
+ * @returns the new head, that is, the column that will be written next
+ */
+DVZ_EXPORT uint32_t dvz_visual_data_column(
+    DvzVisual* visual, DvzSourceType source_type, uint32_t source_idx, //
+    uint32_t column_count, const void* data);
+
 /**
  * Set an existing GPU buffer for a visual source.
  *
@@ -580,6 +717,10 @@ DVZ_EXPORT void dvz_visual_flags(DvzVisual* visual, int flags);
  *
  * Callback function signature: `void(DvzVisual*, DvzVisualFillEvent)`
  *
+ * A custom fill callback records its own draw commands, so any change in the number of vertices
+ * or indices triggers a refill. A callback that draws with `visual->indirect[pipeline_idx]` may
+ * set `visual->draw_indirect` back to true to avoid this.
+ *
  * @param visual the visual
  * @param callback the fill callback
  */
@@ -617,6 +758,36 @@ DVZ_EXPORT void dvz_visual_fill_begin(DvzCanvas* canvas, DvzCommands* cmds, uint
  */
 DVZ_EXPORT void dvz_visual_fill_end(DvzCanvas* canvas, DvzCommands* cmds, uint32_t idx);
 
+/**
+ * Return the secondary command buffers of a visual, recording them if needed.
+ *
+ * The visual keeps one secondary command buffer per swapchain image. The command buffer is only
+ * recorded again, with the visual fill callback, when the visual has been marked with
+ * `dvz_visual_to_refill()` or when the viewport or the clear color have changed. It must be
+ * executed with `dvz_cmd_execute()` within a render pass begun with
+ * `dvz_cmd_begin_renderpass_secondary()`.
+ *
+ * @param visual the visual
+ * @param clear_color the clear color
+ * @param cmd_idx the index of the command buffer
+ * @param cmd_count the number of command buffers, usually the number of swapchain images
+ * @param viewport the viewport
+ * @returns the secondary command buffers
+ */
+DVZ_EXPORT DvzCommands* dvz_visual_fill_secondary(
+    DvzVisual* visual, VkClearColorValue clear_color, uint32_t cmd_idx, uint32_t cmd_count,
+    DvzViewport viewport);
+
+/**
+ * Invalidate the cached command buffers of a visual and trigger a canvas refill.
+ *
+ * This function must be called whenever the fill callback would record different commands, for
+ * example after a change in the number of vertices or in the visual visibility.
+ *
+ * @param visual the visual
+ */
+DVZ_EXPORT void dvz_visual_to_refill(DvzVisual* visual);
+
 /**
  * Set the visual bake callback function.
  *
@@ -703,9 +874,28 @@ DVZ_EXPORT void* dvz_prop_item(DvzProp* prop, uint32_t prop_idx);
 /*  Data update                                                                                  */
 /*************************************************************************************************/
 
+/**
+ * Bake the visual props into its sources, without any GPU call.
+ *
+ * This calls the bake callback and fills the uniform sources. It may run in a worker thread,
+ * concurrently with the baking of other visuals, see `DvzVisualDataCallback`. The next call to
+ * `dvz_visual_update()` then only uploads the baked sources.
+ *
+ * @param visual the visual
+ * @param viewport the viewport
+ * @param coords the data coordinates and transformation
+ * @param user_data arbitrary user data pointer
+ */
+DVZ_EXPORT void dvz_visual_bake(
+    DvzVisual* visual, DvzViewport viewport, DvzDataCoords coords, const void* user_data);
+
 /**
  * Update all GPU buffers and textures from the visual props and sources.
  *
+ * The visual is baked first, unless `dvz_visual_bake()` has been called since the last update.
+ * This also uploads the indirect draw parameters of the graphics pipelines, when the number of
+ * vertices or indices has changed.
+ *
  * @param visual the visual
  * @param viewport the viewport
  * @param coords the data coordinates and transformation
@@ -63,6 +63,10 @@ extern "C" {
 #define DVZ_MAX_DEPENDENCIES_PER_RENDERPASS 8
 #define DVZ_MAX_VERTEX_BINDINGS             16
 #define DVZ_MAX_VERTEX_ATTRS                32
+#define DVZ_MAX_SPECIALIZATION_CONSTANTS    16
+
+// Maximum number of threads compiling graphics pipelines at the same time
+#define DVZ_MAX_PIPELINE_THREADS 8
 
 
 
@@ -84,12 +88,14 @@ typedef struct DvzBindings DvzBindings;
 typedef struct DvzCompute DvzCompute;
 typedef struct DvzVertexBinding DvzVertexBinding;
 typedef struct DvzVertexAttr DvzVertexAttr;
+typedef struct DvzSpecialization DvzSpecialization;
 typedef struct DvzGraphics DvzGraphics;
 typedef struct DvzBarrierBuffer DvzBarrierBuffer;
 typedef struct DvzBarrierImage DvzBarrierImage;
 typedef struct DvzBarrier DvzBarrier;
 typedef struct DvzSemaphores DvzSemaphores;
 typedef struct DvzFences DvzFences;
+typedef struct DvzQueries DvzQueries;
 typedef struct DvzRenderpass DvzRenderpass;
 typedef struct DvzRenderpassAttachment DvzRenderpassAttachment;
 typedef struct DvzRenderpassSubpass DvzRenderpassSubpass;
@@ -146,6 +152,8 @@ typedef enum
     DVZ_BUFFER_TYPE_UNIFORM,
     DVZ_BUFFER_TYPE_STORAGE,
     DVZ_BUFFER_TYPE_UNIFORM_MAPPABLE,
+    DVZ_BUFFER_TYPE_VERTEX_MAPPABLE,
+    DVZ_BUFFER_TYPE_INDIRECT,
     DVZ_BUFFER_TYPE_COUNT,
 } DvzBufferType;
 
@@ -302,6 +310,8 @@ struct DvzQueues
     bool support_compute[DVZ_MAX_QUEUE_FAMILIES];
     bool support_present[DVZ_MAX_QUEUE_FAMILIES];
     uint32_t max_queue_count[DVZ_MAX_QUEUE_FAMILIES]; // for each queue family, the max # of queues
+    // For each queue family, the number of valid bits in the timestamps (0 if not supported)
+    uint32_t timestamp_valid_bits[DVZ_MAX_QUEUE_FAMILIES];
 
     // Requested queues
     // ----------------
@@ -336,6 +346,8 @@ struct DvzGpu
 
     DvzQueues queues;
     VkDescriptorPool dset_pool;
+    VkPipelineCache pipeline_cache;
+    char pipeline_cache_path[1024]; // empty if the pipeline cache is not persisted on disk
 
     VkPhysicalDeviceFeatures requested_features;
     VkDevice device;
@@ -389,6 +401,8 @@ struct DvzCommands
     DvzGpu* gpu;
 
     uint32_t queue_idx;
+    VkCommandPool pool; // the pool the command buffers are allocated from
+    VkCommandBufferLevel level;
     uint32_t count;
     VkCommandBuffer cmds[DVZ_MAX_COMMAND_BUFFERS_PER_SET];
 };
@@ -510,6 +524,19 @@ struct DvzBindings
 
 
 
+struct DvzQueries
+{
+    DvzObject obj;
+    DvzGpu* gpu;
+
+    VkQueryType type;
+    uint32_t count;
+    VkQueryPool pool;
+    uint32_t queue_idx; // queue of the last recorded timestamp
+};
+
+
+
 struct DvzCompute
 {
     DvzObject obj;
@@ -523,6 +550,9 @@ struct DvzCompute
     DvzSlots slots;
     DvzBindings* bindings;
     VkShaderModule shader_module;
+
+    // Optional GPU timestamps written around the dispatch, see dvz_compute_timestamps().
+    DvzQueries queries;
 };
 
 
@@ -545,6 +575,15 @@ struct DvzVertexAttr
 
 
 
+struct DvzSpecialization
+{
+    uint32_t count;
+    uint32_t ids[DVZ_MAX_SPECIALIZATION_CONSTANTS];    // constant_id in the shaders
+    uint32_t values[DVZ_MAX_SPECIALIZATION_CONSTANTS]; // raw 32-bit int, uint, float or bool
+};
+
+
+
 struct DvzGraphics
 {
     DvzObject obj;
@@ -575,6 +614,8 @@ struct DvzGraphics
     uint32_t shader_count;
     VkShaderStageFlagBits shader_stages[DVZ_MAX_SHADERS_PER_GRAPHICS];
     VkShaderModule shader_modules[DVZ_MAX_SHADERS_PER_GRAPHICS];
+    bool shader_shared[DVZ_MAX_SHADERS_PER_GRAPHICS]; // shader modules owned by the caller
+    DvzSpecialization specialization;                 // applied to all shader stages
 
     DvzGraphicsCallback callback;
 };
@@ -782,6 +823,23 @@ DVZ_EXPORT DvzApp* dvz_app(DvzBackend backend);
  */
 DVZ_EXPORT int dvz_app_destroy(DvzApp* app);
 
+/**
+ * Set the number of worker threads preparing the offscreen canvases in parallel.
+ *
+ * At every iteration of the main loop, each worker takes an offscreen canvas, waits for its
+ * previous frame, calls its frame callbacks, records its command buffers from the canvas' own
+ * command pool, then processes its transfers and submits it. Only the transfers and submissions
+ * are serialized between canvases, see `dvz_context_lock()`. Window polling, presentation, and
+ * the canvases with a window or a GUI remain in the main thread.
+ *
+ * This function must not be called while the main loop is running.
+ *
+ * @param app the application
+ * @param count the number of workers, up to `DVZ_MAX_FRAME_WORKERS`, or 0 or 1 to prepare all
+ *      canvases in the main thread (default)
+ */
+DVZ_EXPORT void dvz_app_workers(DvzApp* app, uint32_t count);
+
 
 
 /*************************************************************************************************/
@@ -856,6 +914,19 @@ DVZ_EXPORT void dvz_app_wait(DvzApp* app);
  */
 DVZ_EXPORT void dvz_gpu_wait(DvzGpu* gpu);
 
+/**
+ * Save the GPU pipeline cache to disk.
+ *
+ * All graphics and compute pipelines are created with a pipeline cache that is loaded from disk
+ * when creating the GPU, and saved when destroying it. The cache file depends on the device
+ * UUID and on the driver version. It is stored in the directory given by the
+ * `DVZ_PIPELINE_CACHE_DIR` environment variable, or in the user cache directory by default. An
+ * empty `DVZ_PIPELINE_CACHE_DIR` disables the on-disk cache.
+ *
+ * @param gpu the GPU
+ */
+DVZ_EXPORT void dvz_gpu_pipeline_cache_save(DvzGpu* gpu);
+
 /**
  * Destroy the resources associated to a GPU.
  *
@@ -1031,6 +1102,52 @@ DVZ_EXPORT void dvz_swapchain_destroy(DvzSwapchain* swapchain);
  */
 DVZ_EXPORT DvzCommands dvz_commands(DvzGpu* gpu, uint32_t queue, uint32_t count);
 
+/**
+ * Create a set of secondary command buffers.
+ *
+ * Secondary command buffers are recorded within a render pass with `dvz_cmd_begin_secondary()`,
+ * and executed by a primary command buffer with `dvz_cmd_execute()`.
+ *
+ * @param gpu the GPU
+ * @param queue the queue index within the GPU
+ * @param count the number of command buffers to create
+ * @returns the set of command buffers
+ */
+DVZ_EXPORT DvzCommands dvz_commands_secondary(DvzGpu* gpu, uint32_t queue, uint32_t count);
+
+/**
+ * Create a command pool for the family of a given queue.
+ *
+ * The command buffers allocated from the GPU's default command pools must not be recorded from
+ * several threads at the same time. Command buffers allocated from different pools may.
+ *
+ * @param gpu the GPU
+ * @param queue the queue index within the GPU
+ * @returns the command pool
+ */
+DVZ_EXPORT VkCommandPool dvz_command_pool(DvzGpu* gpu, uint32_t queue);
+
+/**
+ * Destroy a command pool created with `dvz_command_pool()`, and its command buffers.
+ *
+ * @param gpu the GPU
+ * @param pool the command pool
+ */
+DVZ_EXPORT void dvz_command_pool_destroy(DvzGpu* gpu, VkCommandPool* pool);
+
+/**
+ * Create a set of command buffers allocated from a given command pool.
+ *
+ * @param gpu the GPU
+ * @param queue the queue index within the GPU, its family must match the pool's
+ * @param pool the command pool
+ * @param level the level of the command buffers, primary or secondary
+ * @param count the number of command buffers to create
+ * @returns the set of command buffers
+ */
+DVZ_EXPORT DvzCommands dvz_commands_pool(
+    DvzGpu* gpu, uint32_t queue, VkCommandPool pool, VkCommandBufferLevel level, uint32_t count);
+
 /**
  * Start recording a command buffer.
  *
@@ -1039,6 +1156,18 @@ DVZ_EXPORT DvzCommands dvz_commands(DvzGpu* gpu, uint32_t queue, uint32_t count)
  */
 DVZ_EXPORT void dvz_cmd_begin(DvzCommands* cmds, uint32_t idx);
 
+/**
+ * Start recording a secondary command buffer that continues a render pass.
+ *
+ * The command buffer does not inherit any state: the viewport must be set again.
+ *
+ * @param cmds the set of secondary command buffers
+ * @param idx the index of the command buffer to begin recording on
+ * @param renderpass the render pass the command buffer will be executed in
+ */
+DVZ_EXPORT void
+dvz_cmd_begin_secondary(DvzCommands* cmds, uint32_t idx, DvzRenderpass* renderpass);
+
 /**
  * Stop recording a command buffer.
  *
@@ -1575,6 +1704,27 @@ DVZ_EXPORT void dvz_compute_push(
  */
 DVZ_EXPORT void dvz_compute_bindings(DvzCompute* compute, DvzBindings* bindings);
 
+/**
+ * Enable or disable GPU timestamps around the dispatches of a compute pipeline.
+ *
+ * When enabled, the commands recorded by `dvz_cmd_compute()` measure the GPU time of the
+ * dispatch, which can be retrieved after the submission with `dvz_compute_gpu_time()`.
+ *
+ * @param compute the compute pipeline
+ * @param enable whether to write GPU timestamps
+ */
+DVZ_EXPORT void dvz_compute_timestamps(DvzCompute* compute, bool enable);
+
+/**
+ * Return the GPU time of the last completed dispatch of a compute pipeline.
+ *
+ * This function does not wait for the GPU.
+ *
+ * @param compute the compute pipeline
+ * @returns the GPU time in milliseconds, or a negative value if not available yet
+ */
+DVZ_EXPORT double dvz_compute_gpu_time(DvzCompute* compute);
+
 /**
  * Destroy a compute pipeline.
  *
@@ -1635,6 +1785,19 @@ dvz_graphics_shader_glsl(DvzGraphics* graphics, VkShaderStageFlagBits stage, con
 DVZ_EXPORT void dvz_graphics_shader_spirv(
     DvzGraphics* graphics, VkShaderStageFlagBits stage, VkDeviceSize size, const uint32_t* buffer);
 
+/**
+ * Set an existing shader module of a graphics pipeline.
+ *
+ * The shader module is owned by the caller and may be shared by several graphics pipelines. It is
+ * not destroyed with the graphics pipeline.
+ *
+ * @param graphics the graphics pipeline
+ * @param stage the shader stage
+ * @param module the shader module
+ */
+DVZ_EXPORT void dvz_graphics_shader_module(
+    DvzGraphics* graphics, VkShaderStageFlagBits stage, VkShaderModule module);
+
 /**
  * Set the path to a shader for a graphics pipeline.
  *
@@ -1708,6 +1871,20 @@ DVZ_EXPORT void dvz_graphics_cull_mode(DvzGraphics* graphics, VkCullModeFlags cu
  */
 DVZ_EXPORT void dvz_graphics_front_face(DvzGraphics* graphics, VkFrontFace front_face);
 
+/**
+ * Set the value of a specialization constant of a graphics pipeline.
+ *
+ * The constant is declared in the shaders with `layout(constant_id = id) const`, and is passed to
+ * all shader stages. The value is a 32-bit int, uint, float, or bool. Specialization constants
+ * must be set before the Vulkan pipeline is compiled. Builtin graphics are shared between
+ * visuals, so they cannot be specialized in place: use `dvz_graphics_builtin_specialized()`.
+ *
+ * @param graphics the graphics pipeline
+ * @param id the specialization constant id
+ * @param value pointer to the 32-bit value
+ */
+DVZ_EXPORT void dvz_graphics_specialization(DvzGraphics* graphics, uint32_t id, const void* value);
+
 /**
  * Create a graphics pipeline after it has been set up.
  *
@@ -1715,6 +1892,36 @@ DVZ_EXPORT void dvz_graphics_front_face(DvzGraphics* graphics, VkFrontFace front
  */
 DVZ_EXPORT void dvz_graphics_create(DvzGraphics* graphics);
 
+/**
+ * Create a graphics pipeline, but defer the compilation of the Vulkan pipeline.
+ *
+ * The slots and the pipeline layout are created immediately, so that bindings can be created for
+ * the graphics pipeline. The Vulkan pipeline is compiled by `dvz_graphics_pipeline()`,
+ * `dvz_graphics_pipelines()`, or the first time the graphics pipeline is bound to a command
+ * buffer.
+ *
+ * @param graphics the graphics pipeline
+ */
+DVZ_EXPORT void dvz_graphics_create_deferred(DvzGraphics* graphics);
+
+/**
+ * Compile the Vulkan pipeline of a graphics pipeline, if it has not been compiled yet.
+ *
+ * @param graphics the graphics pipeline
+ */
+DVZ_EXPORT void dvz_graphics_pipeline(DvzGraphics* graphics);
+
+/**
+ * Compile the Vulkan pipelines of several graphics pipelines in parallel.
+ *
+ * The pipelines are compiled on up to `DVZ_MAX_PIPELINE_THREADS` threads. The function returns
+ * once all pipelines have been compiled.
+ *
+ * @param count the number of graphics pipelines
+ * @param graphics the graphics pipelines
+ */
+DVZ_EXPORT void dvz_graphics_pipelines(uint32_t count, DvzGraphics** graphics);
+
 /**
  * Set a binding slot for a graphics pipeline.
  *
@@ -1914,6 +2121,65 @@ DVZ_EXPORT void dvz_fences_destroy(DvzFences* fences);
 
 
 
+/*************************************************************************************************/
+/*  Queries                                                                                      */
+/*************************************************************************************************/
+
+/**
+ * Create a query pool, for example to write GPU timestamps.
+ *
+ * @param gpu the GPU
+ * @param type the query type
+ * @param count the number of queries in the pool
+ * @returns the queries
+ */
+DVZ_EXPORT DvzQueries dvz_queries(DvzGpu* gpu, VkQueryType type, uint32_t count);
+
+/**
+ * Retrieve query results without waiting for the GPU.
+ *
+ * The results array should have room for `2 * count` values: each query yields its value
+ * followed by its availability (nonzero if the value is available).
+ *
+ * @param queries the queries
+ * @param first the first query
+ * @param count the number of queries
+ * @param results the array receiving the values and availabilities
+ * @returns whether all requested queries were available
+ */
+DVZ_EXPORT bool
+dvz_queries_results(DvzQueries* queries, uint32_t first, uint32_t count, uint64_t* results);
+
+/**
+ * Destroy a query pool.
+ *
+ * @param queries the queries
+ */
+DVZ_EXPORT void dvz_queries_destroy(DvzQueries* queries);
+
+/**
+ * Return whether a queue supports GPU timestamps.
+ *
+ * @param gpu the GPU
+ * @param queue_idx the queue index
+ * @returns whether timestamps can be written in command buffers submitted to that queue
+ */
+DVZ_EXPORT bool dvz_gpu_timestamps(DvzGpu* gpu, uint32_t queue_idx);
+
+/**
+ * Convert two GPU timestamps into an elapsed time.
+ *
+ * @param gpu the GPU
+ * @param queue_idx the queue the timestamps were written in
+ * @param begin the first timestamp
+ * @param end the second timestamp
+ * @returns the elapsed time, in milliseconds
+ */
+DVZ_EXPORT double
+dvz_gpu_timestamps_elapsed(DvzGpu* gpu, uint32_t queue_idx, uint64_t begin, uint64_t end);
+
+
+
 /*************************************************************************************************/
 /*  Renderpass                                                                                   */
 /*************************************************************************************************/
@@ -2148,6 +2414,19 @@ DVZ_EXPORT void dvz_submit_reset(DvzSubmit* submit);
 DVZ_EXPORT void dvz_cmd_begin_renderpass(
     DvzCommands* cmds, uint32_t idx, DvzRenderpass* renderpass, DvzFramebuffers* framebuffers);
 
+/**
+ * Begin a render pass whose commands are recorded in secondary command buffers.
+ *
+ * Only `dvz_cmd_execute()` may be called until the end of the render pass.
+ *
+ * @param cmds the set of command buffers to record
+ * @param idx the index of the command buffer to record
+ * @param renderpass the render pass
+ * @param framebuffers the framebuffers
+ */
+DVZ_EXPORT void dvz_cmd_begin_renderpass_secondary(
+    DvzCommands* cmds, uint32_t idx, DvzRenderpass* renderpass, DvzFramebuffers* framebuffers);
+
 /**
  * End a render pass.
  *
@@ -2156,6 +2435,17 @@ DVZ_EXPORT void dvz_cmd_begin_renderpass(
  */
 DVZ_EXPORT void dvz_cmd_end_renderpass(DvzCommands* cmds, uint32_t idx);
 
+/**
+ * Execute a secondary command buffer.
+ *
+ * @param cmds the set of command buffers to record
+ * @param idx the index of the command buffer to record
+ * @param secondary the set of secondary command buffers
+ * @param secondary_idx the index of the secondary command buffer to execute
+ */
+DVZ_EXPORT void dvz_cmd_execute(
+    DvzCommands* cmds, uint32_t idx, DvzCommands* secondary, uint32_t secondary_idx);
+
 /**
  * Launch a compute task.
  *
@@ -2166,6 +2456,35 @@ DVZ_EXPORT void dvz_cmd_end_renderpass(DvzCommands* cmds, uint32_t idx);
  */
 DVZ_EXPORT void dvz_cmd_compute(DvzCommands* cmds, uint32_t idx, DvzCompute* compute, uvec3 size);
 
+/**
+ * Reset queries before they are written again.
+ *
+ * This command must be recorded outside of a render pass.
+ *
+ * @param cmds the set of command buffers to record
+ * @param idx the index of the command buffer to record
+ * @param queries the queries
+ * @param first the first query to reset
+ * @param count the number of queries to reset
+ */
+DVZ_EXPORT void dvz_cmd_reset_queries(
+    DvzCommands* cmds, uint32_t idx, DvzQueries* queries, uint32_t first, uint32_t count);
+
+/**
+ * Write a GPU timestamp.
+ *
+ * Nothing is recorded if the queue of the command buffers does not support timestamps.
+ *
+ * @param cmds the set of command buffers to record
+ * @param idx the index of the command buffer to record
+ * @param queries the timestamp queries
+ * @param query the query to write
+ * @param stage the pipeline stage after which the timestamp is written
+ */
+DVZ_EXPORT void dvz_cmd_timestamp(
+    DvzCommands* cmds, uint32_t idx, DvzQueries* queries, uint32_t query,
+    VkPipelineStageFlagBits stage);
+
 /**
  * Register a barrier.
  *
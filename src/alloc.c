@@ -0,0 +1,229 @@
+#include "../include/datoviz/alloc.h"
+
+
+
+/*************************************************************************************************/
+/*  Utils                                                                                        */
+/*************************************************************************************************/
+
+static uint64_t _align_offset(uint64_t offset, uint64_t alignment)
+{
+    if (alignment <= 1)
+        return offset;
+    return ((offset + alignment - 1) / alignment) * alignment;
+}
+
+
+
+// Insert a free block at a given position in the sorted list.
+static void _insert_block(DvzAlloc* alloc, uint32_t idx, uint64_t offset, uint64_t size)
+{
+    ASSERT(alloc != NULL);
+    ASSERT(idx <= alloc->free_count);
+    ASSERT(size > 0);
+
+    if (alloc->free_count == alloc->free_capacity)
+    {
+        alloc->free_capacity *= 2;
+        REALLOC(alloc->free_blocks, alloc->free_capacity * sizeof(DvzAllocBlock));
+    }
+    ASSERT(alloc->free_count < alloc->free_capacity);
+
+    memmove(
+        &alloc->free_blocks[idx + 1], &alloc->free_blocks[idx],
+        (alloc->free_count - idx) * sizeof(DvzAllocBlock));
+    alloc->free_blocks[idx] = (DvzAllocBlock){offset, size};
+    alloc->free_count++;
+}
+
+
+
+// Remove the free block at a given position in the sorted list.
+static void _remove_block(DvzAlloc* alloc, uint32_t idx)
+{
+    ASSERT(alloc != NULL);
+    ASSERT(idx < alloc->free_count);
+    memmove(
+        &alloc->free_blocks[idx], &alloc->free_blocks[idx + 1],
+        (alloc->free_count - idx - 1) * sizeof(DvzAllocBlock));
+    alloc->free_count--;
+}
+
+
+
+// Add a free range and merge it with its neighbors.
+static void _add_free(DvzAlloc* alloc, uint64_t offset, uint64_t size)
+{
+    ASSERT(alloc != NULL);
+    if (size == 0)
+        return;
+
+    // Find the first free block after the range.
+    uint32_t idx = 0;
+    while (idx < alloc->free_count && alloc->free_blocks[idx].offset < offset)
+        idx++;
+
+    DvzAllocBlock* prev = idx > 0 ? &alloc->free_blocks[idx - 1] : NULL;
+    DvzAllocBlock* next = idx < alloc->free_count ? &alloc->free_blocks[idx] : NULL;
+    ASSERT(prev == NULL || prev->offset + prev->size <= offset);
+    ASSERT(next == NULL || offset + size <= next->offset);
+
+    bool merge_prev = prev != NULL && prev->offset + prev->size == offset;
+    bool merge_next = next != NULL && offset + size == next->offset;
+
+    if (merge_prev && merge_next)
+    {
+        prev->size += size + next->size;
+        _remove_block(alloc, idx);
+    }
+    else if (merge_prev)
+    {
+        prev->size += size;
+    }
+    else if (merge_next)
+    {
+        next->offset = offset;
+        next->size += size;
+    }
+    else
+    {
+        _insert_block(alloc, idx, offset, size);
+    }
+}
+
+
+
+/*************************************************************************************************/
+/*  Allocator                                                                                    */
+/*************************************************************************************************/
+
+DvzAlloc dvz_alloc(uint64_t size)
+{
+    DvzAlloc alloc = {0};
+    alloc.free_capacity = DVZ_ALLOC_DEFAULT_BLOCKS;
+    alloc.free_blocks = calloc(alloc.free_capacity, sizeof(DvzAllocBlock));
+    alloc.size = size;
+    _add_free(&alloc, 0, size);
+    return alloc;
+}
+
+
+
+bool dvz_alloc_new(DvzAlloc* alloc, uint64_t size, uint64_t alignment, uint64_t* offset)
+{
+    ASSERT(alloc != NULL);
+    ASSERT(offset != NULL);
+    ASSERT(size > 0);
+
+    DvzAllocBlock block = {0};
+    uint64_t aligned = 0;
+    for (uint32_t i = 0; i < alloc->free_count; i++)
+    {
+        block = alloc->free_blocks[i];
+        aligned = _align_offset(block.offset, alignment);
+        if (aligned + size > block.offset + block.size)
+            continue;
+
+        // Split the free block in up to two free blocks, before and after the range.
+        _remove_block(alloc, i);
+        _add_free(alloc, block.offset, aligned - block.offset);
+        _add_free(alloc, aligned + size, block.offset + block.size - aligned - size);
+
+        alloc->alloc_count++;
+        alloc->allocated += size;
+        *offset = aligned;
+        return true;
+    }
+    return false;
+}
+
+
+
+void dvz_alloc_free(DvzAlloc* alloc, uint64_t offset, uint64_t size)
+{
+    ASSERT(alloc != NULL);
+    ASSERT(size > 0);
+    ASSERT(offset + size <= alloc->size);
+    ASSERT(alloc->alloc_count > 0);
+    ASSERT(alloc->allocated >= size);
+
+    _add_free(alloc, offset, size);
+    alloc->alloc_count--;
+    alloc->allocated -= size;
+}
+
+
+
+bool dvz_alloc_resize(DvzAlloc* alloc, uint64_t offset, uint64_t size, uint64_t new_size)
+{
+    ASSERT(alloc != NULL);
+    ASSERT(size > 0);
+    ASSERT(new_size > 0);
+
+    // Shrink: free the end of the range.
+    if (new_size <= size)
+    {
+        _add_free(alloc, offset + new_size, size - new_size);
+        alloc->allocated -= size - new_size;
+        return true;
+    }
+
+    // Grow: the range must be followed by a large enough free block.
+    uint64_t end = offset + size;
+    uint64_t extra = new_size - size;
+    for (uint32_t i = 0; i < alloc->free_count; i++)
+    {
+        DvzAllocBlock* block = &alloc->free_blocks[i];
+        if (block->offset < end)
+            continue;
+        if (block->offset > end || block->size < extra)
+            return false;
+        block->offset += extra;
+        block->size -= extra;
+        if (block->size == 0)
+            _remove_block(alloc, i);
+        alloc->allocated += extra;
+        return true;
+    }
+    return false;
+}
+
+
+
+void dvz_alloc_grow(DvzAlloc* alloc, uint64_t new_size)
+{
+    ASSERT(alloc != NULL);
+    ASSERT(new_size >= alloc->size);
+    _add_free(alloc, alloc->size, new_size - alloc->size);
+    alloc->size = new_size;
+}
+
+
+
+DvzAllocStats dvz_alloc_stats(DvzAlloc* alloc)
+{
+    ASSERT(alloc != NULL);
+    DvzAllocStats stats = {0};
+    stats.size = alloc->size;
+    stats.allocated = alloc->allocated;
+    stats.alloc_count = alloc->alloc_count;
+    stats.free_count = alloc->free_count;
+    for (uint32_t i = 0; i < alloc->free_count; i++)
+    {
+        stats.free += alloc->free_blocks[i].size;
+        stats.largest_free = MAX(stats.largest_free, alloc->free_blocks[i].size);
+    }
+    if (stats.free > 0)
+        stats.fragmentation = 1 - stats.largest_free / (double)stats.free;
+    return stats;
+}
+
+
+
+void dvz_alloc_destroy(DvzAlloc* alloc)
+{
+    ASSERT(alloc != NULL);
+    FREE(alloc->free_blocks);
+    alloc->free_count = 0;
+    alloc->free_capacity = 0;
+}
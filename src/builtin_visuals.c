@@ -369,7 +369,6 @@ static void _visual_marker(DvzVisual* visual)
 
     // Graphics.
     dvz_visual_graphics(visual, dvz_graphics_builtin(canvas, DVZ_GRAPHICS_MARKER, visual->flags));
-    dvz_graphics_depth_test(visual->graphics[0], DVZ_DEPTH_TEST_DISABLE);
 
     // Sources
     dvz_visual_source(
@@ -910,7 +909,7 @@ static void _visual_image(DvzVisual* visual)
     for (uint32_t i = 0; i < 4; i++)
         dvz_visual_source(                                              // textures
             visual, DVZ_SOURCE_TYPE_IMAGE, i, DVZ_PIPELINE_GRAPHICS, 0, //
-            DVZ_USER_BINDING + i + 1, sizeof(uint8_t), 0);              //
+            DVZ_USER_BINDING + i + 1, sizeof(cvec4), 0);                //
 
     // Props:
 
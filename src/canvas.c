@@ -3,6 +3,8 @@
 #include "../include/datoviz/context.h"
 #include "../include/datoviz/controls.h"
 #include "../include/datoviz/gui.h"
+#include "../include/datoviz/profile.h"
+#include "../include/datoviz/scene.h"
 #include "../include/datoviz/vklite.h"
 #include "../src/canvas_utils.h"
 #include "../src/vklite_utils.h"
@@ -200,6 +202,28 @@ static void _glfw_move_callback(GLFWwindow* window, double xpos, double ypos)
     dvz_event_mouse_move(canvas, (vec2){xpos, ypos}, canvas->mouse.modifiers);
 }
 
+// In on-demand mode, these window events must wake up an idle canvas.
+static void _glfw_cursor_callback(GLFWwindow* window, double xpos, double ypos)
+{
+    DvzCanvas* canvas = (DvzCanvas*)glfwGetWindowUserPointer(window);
+    ASSERT(canvas != NULL);
+    dvz_canvas_to_render(canvas);
+}
+
+static void _glfw_size_callback(GLFWwindow* window, int width, int height)
+{
+    DvzCanvas* canvas = (DvzCanvas*)glfwGetWindowUserPointer(window);
+    ASSERT(canvas != NULL);
+    dvz_canvas_to_render(canvas);
+}
+
+static void _glfw_refresh_callback(GLFWwindow* window)
+{
+    DvzCanvas* canvas = (DvzCanvas*)glfwGetWindowUserPointer(window);
+    ASSERT(canvas != NULL);
+    dvz_canvas_to_render(canvas);
+}
+
 static void _glfw_frame_callback(DvzCanvas* canvas, DvzEvent ev)
 {
     ASSERT(canvas != NULL);
@@ -265,6 +289,14 @@ static void backend_event_callbacks(DvzCanvas* canvas)
         // Register the mouse move callback.
         // glfwSetCursorPosCallback(w, _glfw_move_callback);
 
+        // The mouse position is polled at every frame, but an idle canvas does not render frames.
+        if (canvas->on_demand)
+        {
+            glfwSetCursorPosCallback(w, _glfw_cursor_callback);
+            glfwSetFramebufferSizeCallback(w, _glfw_size_callback);
+            glfwSetWindowRefreshCallback(w, _glfw_refresh_callback);
+        }
+
         // Register a function called at every frame, after event polling and state update
         dvz_event_callback(
             canvas, DVZ_EVENT_INTERACT, 0, DVZ_EVENT_MODE_SYNC, _glfw_frame_callback, NULL);
@@ -413,6 +445,9 @@ static void _refill_canvas(DvzCanvas* canvas, uint32_t img_idx)
 {
     ASSERT(canvas != NULL);
     log_debug("refill canvas %d", img_idx);
+
+    // All deferred pipelines must be compiled before the command buffers are recorded.
+    dvz_canvas_pipelines(canvas);
     DvzEvent ev = {0};
     ev.type = DVZ_EVENT_REFILL;
     ev.u.rf.img_idx = img_idx;
@@ -564,6 +599,11 @@ _canvas(DvzGpu* gpu, uint32_t width, uint32_t height, bool offscreen, bool overl
     atomic_init(&canvas->to_close, false);
     atomic_init(&canvas->refills.status, DVZ_REFILL_NONE);
 
+    // On-demand rendering, only for canvases with a window.
+    canvas->on_demand = !offscreen && (flags & DVZ_CANVAS_FLAGS_ON_DEMAND) != 0;
+    atomic_init(&canvas->frames_dirty, 0);
+    canvas->frame_thread = pthread_self();
+
     // Allocate memory for canvas objects.
     canvas->commands =
         dvz_container(DVZ_CONTAINER_DEFAULT_COUNT, sizeof(DvzCommands), DVZ_OBJECT_TYPE_COMMANDS);
@@ -667,6 +707,7 @@ _canvas(DvzGpu* gpu, uint32_t width, uint32_t height, bool offscreen, bool overl
 
         canvas->sem_img_available = dvz_semaphores(gpu, frames_in_flight);
         canvas->sem_render_finished = dvz_semaphores(gpu, frames_in_flight);
+        canvas->sem_render_transfers = dvz_semaphores(gpu, 1);
         canvas->present_semaphores = &canvas->sem_render_finished;
 
         canvas->fences_render_finished = dvz_fences(gpu, frames_in_flight, true);
@@ -679,21 +720,33 @@ _canvas(DvzGpu* gpu, uint32_t width, uint32_t height, bool offscreen, bool overl
         canvas->cmds_transfer = dvz_commands(gpu, DVZ_DEFAULT_QUEUE_TRANSFER, 1);
     }
 
-    // Default render commands.
+    // Default render commands, allocated from the canvas command pool.
     {
-        canvas->cmds_render =
-            dvz_commands(gpu, DVZ_DEFAULT_QUEUE_RENDER, canvas->swapchain.img_count);
+        canvas->cmd_pool = dvz_command_pool(gpu, DVZ_DEFAULT_QUEUE_RENDER);
+        canvas->cmds_render = dvz_commands_pool(
+            gpu, DVZ_DEFAULT_QUEUE_RENDER, canvas->cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            canvas->swapchain.img_count);
     }
 
     // Default submit instance.
     canvas->submit = dvz_submit(gpu);
 
-    canvas->transfers = dvz_fifo(DVZ_MAX_FIFO_CAPACITY);
+    canvas->transfers = dvz_transfer_queue(DVZ_TRANSFER_QUEUE_CAPACITY);
+    canvas->readback = dvz_readback(gpu);
 
     // Event system.
     {
         canvas->event_queue = dvz_fifo(DVZ_MAX_FIFO_CAPACITY);
+        for (uint32_t i = 0; i < DVZ_EVENT_COUNT; i++)
+            atomic_init(&canvas->events_pending[i], 0);
+        if (pthread_mutex_init(&canvas->event_lock, NULL) != 0)
+            log_error("mutex creation failed");
+        if (pthread_rwlock_init(&canvas->callback_lock, NULL) != 0)
+            log_error("rwlock creation failed");
+        atomic_init(&canvas->callback_depth, 0);
         canvas->event_thread = dvz_thread(_event_thread, canvas);
+        canvas->event_ready = dvz_fifo(DVZ_MAX_EVENT_CALLBACKS);
+        _event_workers_start(canvas, DVZ_DEFAULT_EVENT_WORKERS);
 
         canvas->mouse = dvz_mouse();
         canvas->keyboard = dvz_keyboard();
@@ -818,13 +871,51 @@ void dvz_canvas_recreate(DvzCanvas* canvas)
 DvzCommands* dvz_canvas_commands(DvzCanvas* canvas, uint32_t queue_idx, uint32_t count)
 {
     ASSERT(canvas != NULL);
+    DvzGpu* gpu = canvas->gpu;
+    ASSERT(gpu != NULL);
     DvzCommands* commands = dvz_container_alloc(&canvas->commands);
-    *commands = dvz_commands(canvas->gpu, queue_idx, count);
+    // The command buffers on the render queue family may be recorded during a refill, which
+    // happens in a frame worker when the canvases are prepared in parallel.
+    uint32_t qf = gpu->queues.queue_families[queue_idx];
+    if (qf == gpu->queues.queue_families[DVZ_DEFAULT_QUEUE_RENDER])
+        *commands = dvz_commands_pool(
+            gpu, queue_idx, canvas->cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, count);
+    else
+        *commands = dvz_commands(gpu, queue_idx, count);
     return commands;
 }
 
 
 
+void dvz_canvas_pipelines(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+
+    // Collect the graphics whose pipeline has not been compiled yet.
+    uint32_t count = 0;
+    DvzGraphics** pending = NULL;
+    DvzContainerIterator iter = dvz_container_iterator(&canvas->graphics);
+    DvzGraphics* graphics = NULL;
+    while (iter.item != NULL)
+    {
+        graphics = iter.item;
+        if (dvz_obj_is_created(&graphics->obj) && graphics->pipeline == VK_NULL_HANDLE)
+        {
+            if (pending == NULL)
+                pending = calloc(canvas->graphics.capacity, sizeof(DvzGraphics*));
+            pending[count++] = graphics;
+        }
+        dvz_container_iter(&iter);
+    }
+    if (count == 0)
+        return;
+
+    dvz_graphics_pipelines(count, pending);
+    FREE(pending);
+}
+
+
+
 /*************************************************************************************************/
 /*  Offscreen                                                                                    */
 /*************************************************************************************************/
@@ -954,6 +1045,199 @@ DvzViewport dvz_viewport_full(DvzCanvas* canvas)
 
 
 
+/*************************************************************************************************/
+/*  Canvas profiling                                                                             */
+/*************************************************************************************************/
+
+// Read the timestamps of the last submission of a swapchain image, without blocking.
+static void _profile_collect(DvzCanvas* canvas, uint32_t img_idx)
+{
+    ASSERT(canvas != NULL);
+    DvzCanvasProfile* profile = &canvas->profile;
+    if (!profile->pending[img_idx])
+        return;
+
+    uint32_t n = profile->block_size;
+    ASSERT(n == 2 + 2 * DVZ_MAX_PROFILE_SLOTS);
+    uint64_t results[2 * (2 + 2 * DVZ_MAX_PROFILE_SLOTS)] = {0};
+    dvz_queries_results(&profile->queries, img_idx * n, n, results);
+
+    // NOTE: the results of a frame are only taken into account if the frame has completed.
+    if (results[1] == 0 || results[3] == 0)
+        return;
+    profile->pending[img_idx] = false;
+
+    DvzGpu* gpu = canvas->gpu;
+    uint32_t queue = canvas->cmds_render.queue_idx;
+    DvzCanvasStats* stats = &profile->stats;
+    stats->frame_idx = profile->frames[img_idx];
+    stats->gpu_frame = dvz_gpu_timestamps_elapsed(gpu, queue, results[0], results[2]);
+    uint64_t* r = NULL;
+    for (uint32_t i = 0; i < DVZ_MAX_PROFILE_SLOTS; i++)
+    {
+        // Begin and end timestamps of the slot, each followed by its availability.
+        r = &results[4 + 4 * i];
+        stats->gpu_slots[i] = profile->slots[i] != NULL && r[1] != 0 && r[3] != 0
+                                  ? dvz_gpu_timestamps_elapsed(gpu, queue, r[0], r[2])
+                                  : -1;
+    }
+
+    // Transfers completed since the previous stats.
+    DvzContext* context = gpu->context;
+    dvz_context_lock(context);
+    double transfers = dvz_staging_gpu_time(context);
+    dvz_context_unlock(context);
+    stats->gpu_transfers = transfers - profile->transfers;
+    profile->transfers = transfers;
+}
+
+
+
+// Count the profiled canvases of the context, whose transfers are timed while there is one.
+static void _profile_transfers(DvzContext* context, bool enable)
+{
+    ASSERT(context != NULL);
+    if (enable)
+        context->profile_count++;
+    else
+    {
+        ASSERT(context->profile_count > 0);
+        context->profile_count--;
+    }
+    dvz_staging_timestamps(context, context->profile_count > 0);
+}
+
+
+
+void dvz_canvas_profile(DvzCanvas* canvas, bool enable)
+{
+    ASSERT(canvas != NULL);
+    DvzGpu* gpu = canvas->gpu;
+    ASSERT(gpu != NULL);
+    DvzCanvasProfile* profile = &canvas->profile;
+    if (profile->enabled == enable)
+        return;
+
+    if (enable && !dvz_obj_is_created(&profile->queries.obj))
+    {
+        if (!dvz_gpu_timestamps(gpu, DVZ_DEFAULT_QUEUE_RENDER))
+        {
+            log_warn("the render queue does not support GPU timestamps, cannot profile");
+            return;
+        }
+
+        uint32_t img_count = canvas->cmds_render.count;
+        ASSERT(img_count > 0);
+        profile->block_size = 2 + 2 * DVZ_MAX_PROFILE_SLOTS;
+        profile->queries =
+            dvz_queries(gpu, VK_QUERY_TYPE_TIMESTAMP, img_count * profile->block_size);
+
+        // The command buffers submitted before and after the render commands are recorded once.
+        profile->cmds_begin = dvz_commands_pool(
+            gpu, DVZ_DEFAULT_QUEUE_RENDER, canvas->cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            img_count);
+        profile->cmds_end = dvz_commands_pool(
+            gpu, DVZ_DEFAULT_QUEUE_RENDER, canvas->cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            img_count);
+        uint32_t base = 0;
+        for (uint32_t i = 0; i < img_count; i++)
+        {
+            base = i * profile->block_size;
+
+            dvz_cmd_begin(&profile->cmds_begin, i);
+            dvz_cmd_reset_queries(
+                &profile->cmds_begin, i, &profile->queries, base, profile->block_size);
+            dvz_cmd_timestamp(
+                &profile->cmds_begin, i, &profile->queries, base,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+            dvz_cmd_end(&profile->cmds_begin, i);
+
+            dvz_cmd_begin(&profile->cmds_end, i);
+            dvz_cmd_timestamp(
+                &profile->cmds_end, i, &profile->queries, base + 1,
+                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+            dvz_cmd_end(&profile->cmds_end, i);
+        }
+    }
+
+    profile->enabled = enable;
+    memset(&profile->stats, 0, sizeof(DvzCanvasStats));
+    memset(profile->pending, 0, sizeof(profile->pending));
+
+    // Transfers are timed at the context level, as long as one of its canvases is profiled.
+    DvzContext* context = gpu->context;
+    dvz_context_lock(context);
+    _profile_transfers(context, enable);
+    profile->transfers = dvz_staging_gpu_time(context);
+    dvz_context_unlock(context);
+
+    // The visuals write their timestamps in their command buffers.
+    dvz_canvas_to_refill(canvas);
+}
+
+
+
+DvzCanvasStats dvz_canvas_stats(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    return canvas->profile.stats;
+}
+
+
+
+int dvz_canvas_profile_slot(DvzCanvas* canvas, const void* owner)
+{
+    ASSERT(canvas != NULL);
+    ASSERT(owner != NULL);
+    DvzCanvasProfile* profile = &canvas->profile;
+
+    int slot = -1;
+    for (int i = 0; i < DVZ_MAX_PROFILE_SLOTS; i++)
+    {
+        if (profile->slots[i] == owner)
+            return i;
+        if (slot < 0 && profile->slots[i] == NULL)
+            slot = i;
+    }
+    if (slot < 0)
+    {
+        log_debug("no profiling slot left on the canvas");
+        return -1;
+    }
+    profile->slots[slot] = owner;
+    return slot;
+}
+
+
+
+void dvz_canvas_profile_release(DvzCanvas* canvas, const void* owner)
+{
+    ASSERT(canvas != NULL);
+    for (uint32_t i = 0; i < DVZ_MAX_PROFILE_SLOTS; i++)
+        if (canvas->profile.slots[i] == owner)
+            canvas->profile.slots[i] = NULL;
+}
+
+
+
+void dvz_canvas_profile_timestamp(
+    DvzCanvas* canvas, DvzCommands* cmds, uint32_t idx, int slot, bool end)
+{
+    ASSERT(canvas != NULL);
+    DvzCanvasProfile* profile = &canvas->profile;
+    if (!profile->enabled || slot < 0)
+        return;
+    ASSERT(slot < DVZ_MAX_PROFILE_SLOTS);
+    ASSERT(idx < profile->cmds_begin.count);
+
+    uint32_t query = idx * profile->block_size + 2 + 2 * (uint32_t)slot + (end ? 1 : 0);
+    dvz_cmd_timestamp(
+        cmds, idx, &profile->queries, query,
+        end ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+}
+
+
+
 /*************************************************************************************************/
 /*  Callbacks                                                                                    */
 /*************************************************************************************************/
@@ -994,7 +1278,17 @@ void dvz_event_callback(
     if (canvas->enable_lock)
         dvz_thread_lock(&canvas->event_thread);
 
-    canvas->callbacks[canvas->callbacks_count++] = r;
+    // The queue of an async callback must not move once the workers may access it.
+    ASSERT(canvas->callbacks_count < DVZ_MAX_EVENT_CALLBACKS);
+    canvas->callbacks[canvas->callbacks_count] = r;
+    if (mode == DVZ_EVENT_MODE_ASYNC)
+    {
+        DvzEventCallbackRegister* pr = &canvas->callbacks[canvas->callbacks_count];
+        pr->jobs = dvz_fifo(16);
+        atomic_init(&pr->scheduled, false);
+        atomic_init(&pr->pending, 0);
+    }
+    canvas->callbacks_count++;
 
     if (canvas->enable_lock)
         dvz_thread_unlock(&canvas->event_thread);
@@ -1002,6 +1296,35 @@ void dvz_event_callback(
 
 
 
+void dvz_event_workers(DvzCanvas* canvas, uint32_t count)
+{
+    ASSERT(canvas != NULL);
+    ASSERT(0 < count && count <= DVZ_MAX_EVENT_WORKERS);
+    if (count == canvas->event_workers_count)
+        return;
+
+    // The callbacks still waiting in the pool will be picked by the new workers.
+    _event_workers_stop(canvas);
+    _event_workers_start(canvas, count);
+}
+
+
+
+DvzEventStats dvz_event_stats(DvzCanvas* canvas, DvzEventCallback callback)
+{
+    ASSERT(canvas != NULL);
+    DvzEventStats stats = {0};
+    for (uint32_t i = 0; i < canvas->callbacks_count; i++)
+    {
+        DvzEventCallbackRegister* r = &canvas->callbacks[i];
+        if (r->callback == callback && r->mode == DVZ_EVENT_MODE_ASYNC)
+            return r->stats;
+    }
+    log_warn("async callback not found");
+    return stats;
+}
+
+
 /*************************************************************************************************/
 /*  Thread-safe state changes                                                                    */
 /*************************************************************************************************/
@@ -1011,6 +1334,24 @@ void dvz_canvas_to_refill(DvzCanvas* canvas)
     ASSERT(canvas != NULL);
     DvzRefillStatus status = DVZ_REFILL_REQUESTED;
     atomic_store(&canvas->refills.status, status);
+    dvz_canvas_to_render(canvas);
+}
+
+
+
+void dvz_canvas_to_render(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    if (!canvas->on_demand)
+        return;
+
+    // Render one frame per swapchain image, so that all images are up to date.
+    int count = (int)MAX(canvas->swapchain.img_count, 1);
+    atomic_store(&canvas->frames_dirty, count);
+
+    // Wake up the event loop if it is waiting for events.
+    ASSERT(canvas->app != NULL);
+    backend_wakeup(canvas->app->backend);
 }
 
 
@@ -1479,36 +1820,43 @@ void dvz_event_frame(DvzCanvas* canvas, uint64_t idx, double time, double interv
 
 
 
+void dvz_event_download(DvzCanvas* canvas, uint64_t id, VkDeviceSize size, void* data)
+{
+    ASSERT(canvas != NULL);
+
+    DvzEvent event = {0};
+    event.type = DVZ_EVENT_DOWNLOAD;
+    event.u.dl.id = id;
+    event.u.dl.size = size;
+    event.u.dl.data = data;
+
+    _event_produce(canvas, event);
+}
+
+
+
 int dvz_event_pending(DvzCanvas* canvas, DvzEventType type)
 {
     ASSERT(canvas != NULL);
-    DvzFifo* fifo = &canvas->event_queue;
-    pthread_mutex_lock(&fifo->lock);
-    int i, j;
-    if (fifo->tail <= fifo->head)
-    {
-        i = fifo->tail;
-        j = fifo->head;
-    }
-    else
-    {
-        i = fifo->head;
-        j = fifo->tail;
-    }
-    ASSERT(i <= j);
+    ASSERT(type < DVZ_EVENT_COUNT);
+
     // Count the pending events with the given type.
-    int count = 0;
-    for (int k = i; k <= j; k++)
-    {
-        if (((DvzEvent*)fifo->items[k])->type == type)
-            count++;
-    }
+    int count = atomic_load(&canvas->events_pending[type]);
 
-    // Add 1 if the event being processed in the event thread has the requested type.
+    // Add 1 if the event being dispatched in the event thread has the requested type.
     if (canvas->event_processing == type)
         count++;
 
-    pthread_mutex_unlock(&fifo->lock);
+    // Add the events that are waiting for, or being processed by, the slowest async callback.
+    int pending = 0;
+    for (uint32_t i = 0; i < canvas->callbacks_count; i++)
+    {
+        DvzEventCallbackRegister* r = &canvas->callbacks[i];
+        if (r->type == type && r->mode == DVZ_EVENT_MODE_ASYNC)
+            pending = MAX(pending, atomic_load(&r->pending));
+    }
+    count += pending;
+
     ASSERT(count >= 0);
     return count;
 }
@@ -1518,8 +1866,10 @@ int dvz_event_pending(DvzCanvas* canvas, DvzEventType type)
 void dvz_event_stop(DvzCanvas* canvas)
 {
     ASSERT(canvas != NULL);
-    DvzFifo* fifo = &canvas->event_queue;
-    dvz_fifo_reset(fifo);
+    // Discard the pending events.
+    int size = dvz_fifo_size(&canvas->event_queue);
+    for (int i = 0; i < size; i++)
+        _event_dequeue(canvas, false);
     // Send a null event to the queue which causes the dequeue awaiting thread to end.
     _event_enqueue(canvas, (DvzEvent){0});
 }
@@ -1959,39 +2309,121 @@ void dvz_canvas_stop(DvzCanvas* canvas)
 /*  Event loop                                                                                   */
 /*************************************************************************************************/
 
-void dvz_canvas_frame(DvzCanvas* canvas)
+// Time until the next TIMER event of a canvas, in seconds.
+static double _next_timer(DvzCanvas* canvas)
 {
     ASSERT(canvas != NULL);
-    ASSERT(canvas->app != NULL);
-    ASSERT(canvas->gpu != NULL);
+    double next = DVZ_MAX_IDLE_TIMEOUT;
+    double cur_time = _clock_get(&canvas->clock);
+    DvzEventCallbackRegister* r = NULL;
+    for (uint32_t i = 0; i < canvas->callbacks_count; i++)
+    {
+        r = &canvas->callbacks[i];
+        if (r->type == DVZ_EVENT_TIMER)
+            next = MIN(next, (r->idx + 1) * r->param - cur_time);
+    }
+    return MAX(next, 0);
+}
+
+
+
+// Whether a canvas in on-demand mode may skip the current frame.
+static bool _canvas_idle(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    if (!canvas->on_demand || canvas->window == NULL || canvas->frame_idx == 0)
+        return false;
+
+    // The canvas is being closed or resized.
+    if (canvas->obj.status == DVZ_OBJECT_STATUS_NEED_DESTROY ||
+        canvas->window->obj.status == DVZ_OBJECT_STATUS_NEED_DESTROY ||
+        backend_window_should_close(canvas->app->backend, canvas->window->backend_window) ||
+        canvas->swapchain.obj.status == DVZ_OBJECT_STATUS_INVALID ||
+        canvas->swapchain.obj.status == DVZ_OBJECT_STATUS_NEED_RECREATE)
+        return false;
+
+    // Raise the TIMER events that are due, they may request a new frame. The frame clock is left
+    // untouched so that the FRAME events keep the interval since the last rendered frame.
+    double elapsed = canvas->clock.elapsed;
+    canvas->clock.elapsed = _clock_get(&canvas->clock);
+    _event_timer(canvas);
+    canvas->clock.elapsed = elapsed;
 
-    // Update the global and local clocks.
-    // These calls update canvas->clock.elapsed and canvas->clock.interval, the latter is
+    // Something changed since the last frames.
+    if (atomic_load(&canvas->frames_dirty) > 0 ||
+        atomic_load(&canvas->refills.status) != DVZ_REFILL_NONE ||
+        dvz_transfer_queue_size(&canvas->transfers) > 0)
+        return false;
+
+    // The downloads in flight are completed during the frames.
+    for (uint32_t i = 0; i < DVZ_READBACK_SLOTS; i++)
+        if (canvas->readback.slots[i].id != 0)
+            return false;
+
+    // A screencast records every frame.
+    if (canvas->screencast != NULL && canvas->screencast->is_active)
+        return false;
+
+    return true;
+}
+
+
+
+// Raise the events of a new frame, before the transfers and the refill.
+static void _canvas_frame_events(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+
+    // Update the local clock.
+    // This call updates canvas->clock.elapsed and canvas->clock.interval, the latter is
     // the delay since the last frame.
-    _clock_set(&canvas->app->clock); // global clock
-    _clock_set(&canvas->clock);      // canvas-local clock
+    _clock_set(&canvas->clock); // canvas-local clock
 
     // Call INTERACT callbacks (for backends only), which may enqueue some events.
+    DVZ_PROFILE_BEGIN(DVZ_PROFILE_INTERACT)
     _event_interact(canvas);
+    DVZ_PROFILE_END(DVZ_PROFILE_INTERACT)
 
     // Call FRAME callbacks.
+    DVZ_PROFILE_BEGIN(DVZ_PROFILE_FRAME)
     _event_frame(canvas);
+    DVZ_PROFILE_END(DVZ_PROFILE_FRAME)
 
     // Give a chance to update event structures in the main loop, for example reset wheel.
     _backend_next_frame(canvas);
 
     // Call TIMER callbacks, in the main thread.
+    DVZ_PROFILE_BEGIN(DVZ_PROFILE_TIMER)
     _event_timer(canvas);
+    DVZ_PROFILE_END(DVZ_PROFILE_TIMER)
 
     // Refill all command buffers at the first iteration.
     if (canvas->frame_idx == 0)
         dvz_canvas_to_refill(canvas);
+}
+
+
+
+void dvz_canvas_frame(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    ASSERT(canvas->app != NULL);
+    ASSERT(canvas->gpu != NULL);
+
+    // Update the global clock, then the local clock and the frame events.
+    canvas->frame_thread = pthread_self();
+    _clock_set(&canvas->app->clock); // global clock
+    _canvas_frame_events(canvas);
 
     // Pending transfers.
+    DVZ_PROFILE_BEGIN(DVZ_PROFILE_TRANSFERS)
     dvz_process_transfers(canvas);
+    DVZ_PROFILE_END(DVZ_PROFILE_TRANSFERS)
 
     // Refill if needed, only 1 swapchain command buffer per frame to avoid waiting on the device.
+    DVZ_PROFILE_BEGIN(DVZ_PROFILE_REFILL)
     _refill_frame(canvas);
+    DVZ_PROFILE_END(DVZ_PROFILE_REFILL)
 }
 
 
@@ -2014,6 +2446,16 @@ void dvz_canvas_frame_submit(DvzCanvas* canvas)
     // Reset the Submit instance before adding the command buffers.
     dvz_submit_reset(s);
 
+    // GPU profiling: collect the timestamps of the last submission of this swapchain image,
+    // before the render commands are wrapped by the commands writing the new timestamps.
+    DvzCanvasProfile* profile = &canvas->profile;
+    bool profiling = profile->enabled && img_idx < profile->cmds_begin.count;
+    if (profiling)
+    {
+        _profile_collect(canvas, img_idx);
+        dvz_submit_commands(s, &profile->cmds_begin);
+    }
+
     // Add the command buffers to the submit instance.
     // Default render commands.
     if (canvas->cmds_render.obj.status == DVZ_OBJECT_STATUS_CREATED)
@@ -2031,11 +2473,17 @@ void dvz_canvas_frame_submit(DvzCanvas* canvas)
     //         dvz_submit_commands(s, cmds);
     //     cmds = dvz_container_iter(&canvas->commands);
     // }
-    if (s->commands_count == 0)
+    if (s->commands_count == (profiling ? 1u : 0u))
     {
         log_error("no recorded command buffers");
         return;
     }
+    if (profiling)
+    {
+        dvz_submit_commands(s, &profile->cmds_end);
+        profile->pending[img_idx] = true;
+        profile->frames[img_idx] = canvas->frame_idx;
+    }
 
     if (!canvas->offscreen)
     {
@@ -2047,6 +2495,14 @@ void dvz_canvas_frame_submit(DvzCanvas* canvas)
         dvz_submit_signal_semaphores(s, &canvas->sem_render_finished, f);
     }
 
+    // Synchronization with the uploads on the transfer queue, on the GPU only. The rendering
+    // waits for the uploads processed in this frame, and the next uploads will wait for the
+    // rendering before overwriting the data it uses.
+    DvzContext* context = gpu->context;
+    ASSERT(context != NULL);
+    dvz_staging_sync_wait(context, s, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    dvz_staging_sync_signal(context, s, &canvas->sem_render_transfers);
+
     // SEND callbacks and send the Submit instance.
     {
         // Call PRE_SEND callbacks
@@ -2072,6 +2528,131 @@ void dvz_canvas_frame_submit(DvzCanvas* canvas)
 
 
 
+// Whether a canvas may be prepared by a frame worker. The canvases with a window must be polled
+// and presented in the main thread, and the GUI and screencasts use global or shared state.
+static bool _canvas_parallel(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    return canvas->offscreen && !canvas->overlay && canvas->screencast == NULL;
+}
+
+
+
+// Prepare and submit a frame of an offscreen canvas, in a frame worker.
+static void _canvas_frame_job(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    DvzContext* context = canvas->gpu->context;
+    ASSERT(context != NULL);
+
+    // Wait for the previous frame, then call the frame callbacks.
+    canvas->frame_thread = pthread_self();
+    DVZ_PROFILE_BEGIN(DVZ_PROFILE_FENCE_WAIT)
+    dvz_fences_wait(&canvas->fences_render_finished, canvas->cur_frame);
+    DVZ_PROFILE_END(DVZ_PROFILE_FENCE_WAIT)
+    _canvas_frame_events(canvas);
+
+    // The command buffers are recorded from the canvas command pool, without the lock.
+    DVZ_PROFILE_BEGIN(DVZ_PROFILE_REFILL)
+    _refill_frame(canvas);
+    DVZ_PROFILE_END(DVZ_PROFILE_REFILL)
+
+    // The rendering waits on the last uploads of the staging ring: the transfers and submission
+    // of a canvas must not be interleaved with those of another canvas.
+    dvz_context_lock(context);
+    DVZ_PROFILE_BEGIN(DVZ_PROFILE_TRANSFERS)
+    dvz_process_transfers(canvas);
+    DVZ_PROFILE_END(DVZ_PROFILE_TRANSFERS)
+    DVZ_PROFILE_BEGIN(DVZ_PROFILE_SUBMIT)
+    dvz_canvas_frame_submit(canvas);
+    DVZ_PROFILE_END(DVZ_PROFILE_SUBMIT)
+    dvz_context_unlock(context);
+
+    canvas->resized = false;
+    canvas->frame_idx++;
+    if (atomic_load(&canvas->frames_dirty) > 0)
+        atomic_fetch_sub(&canvas->frames_dirty, 1);
+}
+
+
+
+static void* _frame_worker(void* p_app)
+{
+    DvzApp* app = (DvzApp*)p_app;
+    ASSERT(app != NULL);
+    DvzCanvas* canvas = NULL;
+    // A NULL canvas stops the worker.
+    while ((canvas = (DvzCanvas*)dvz_fifo_dequeue(&app->frame_jobs, true)) != NULL)
+    {
+        _canvas_frame_job(canvas);
+        dvz_fifo_enqueue(&app->frame_done, canvas);
+    }
+    log_trace("stopping frame worker");
+    return NULL;
+}
+
+
+
+// Dispatch the canvases marked in the current iteration to the frame workers, and wait until
+// they have all been submitted.
+static void _frame_jobs_run(DvzApp* app)
+{
+    ASSERT(app != NULL);
+    ASSERT(app->frame_workers_count > 0);
+
+    uint32_t n_jobs = 0;
+    DvzCanvas* canvas = NULL;
+    DvzContainerIterator iterator = dvz_container_iterator(&app->canvases);
+    while (iterator.item != NULL)
+    {
+        canvas = (DvzCanvas*)iterator.item;
+        if (canvas->frame_job)
+        {
+            dvz_fifo_enqueue(&app->frame_jobs, canvas);
+            n_jobs++;
+        }
+        dvz_container_iter(&iterator);
+    }
+
+    for (uint32_t i = 0; i < n_jobs; i++)
+    {
+        canvas = (DvzCanvas*)dvz_fifo_dequeue(&app->frame_done, true);
+        ASSERT(canvas != NULL);
+        canvas->frame_job = false;
+    }
+}
+
+
+
+void dvz_app_workers(DvzApp* app, uint32_t count)
+{
+    ASSERT(app != NULL);
+    ASSERT(count <= DVZ_MAX_FRAME_WORKERS);
+    if (app->is_running)
+    {
+        log_error("the number of frame workers cannot be changed while the main loop runs");
+        return;
+    }
+    // A single worker would not prepare the canvases in parallel.
+    if (count == 1)
+        count = 0;
+    if (count == app->frame_workers_count)
+        return;
+
+    // Stop the current workers.
+    for (uint32_t i = 0; i < app->frame_workers_count; i++)
+        dvz_fifo_enqueue(&app->frame_jobs, NULL);
+    for (uint32_t i = 0; i < app->frame_workers_count; i++)
+        dvz_thread_join(&app->frame_workers[i]);
+
+    log_debug("starting %d frame workers", count);
+    for (uint32_t i = 0; i < count; i++)
+        app->frame_workers[i] = dvz_thread(_frame_worker, app);
+    app->frame_workers_count = count;
+}
+
+
+
 void dvz_app_run(DvzApp* app, uint64_t frame_count)
 {
     if (frame_count > 1)
@@ -2084,12 +2665,24 @@ void dvz_app_run(DvzApp* app, uint64_t frame_count)
 
     DvzContainerIterator iterator;
     DvzCanvas* canvas = NULL;
+    bool parallel = app->frame_workers_count > 0;
 
     // Main loop.
     uint32_t n_canvas_active = 0;
+    uint32_t n_canvas_idle = 0;
+    uint32_t n_canvas_jobs = 0;
+    double idle_timeout = 0;
+    bool job = false;
     for (uint64_t iter = 0; iter < frame_count; iter++)
     {
         n_canvas_active = 0;
+        n_canvas_idle = 0;
+        n_canvas_jobs = 0;
+        idle_timeout = DVZ_MAX_IDLE_TIMEOUT;
+
+        // The frame workers do not update the global clock.
+        if (parallel)
+            _clock_set(&app->clock);
 
         // Loop over the canvases.
         iterator = dvz_container_iterator(&app->canvases);
@@ -2120,17 +2713,37 @@ void dvz_app_run(DvzApp* app, uint64_t frame_count)
             if (canvas->window != NULL)
                 dvz_window_poll_events(canvas->window);
 
+            // On-demand rendering: skip the frame if nothing changed since the last frames.
+            if (_canvas_idle(canvas))
+            {
+                idle_timeout = MIN(idle_timeout, _next_timer(canvas));
+                n_canvas_idle++;
+                n_canvas_active++;
+                dvz_container_iter(&iterator);
+                continue;
+            }
+
             // NOTE: swapchain image acquisition happens here
 
-            // Wait for fence.
-            dvz_fences_wait(&canvas->fences_render_finished, canvas->cur_frame);
+            // Wait for fence, in the frame worker if the canvas is prepared in parallel.
+            job = parallel && _canvas_parallel(canvas);
+            if (!job)
+            {
+                DVZ_PROFILE_BEGIN(DVZ_PROFILE_FENCE_WAIT)
+                dvz_fences_wait(&canvas->fences_render_finished, canvas->cur_frame);
+                DVZ_PROFILE_END(DVZ_PROFILE_FENCE_WAIT)
+            }
 
             // We acquire the next swapchain image.
             // NOTE: this call modifies swapchain->img_idx
             if (!canvas->offscreen)
+            {
+                DVZ_PROFILE_BEGIN(DVZ_PROFILE_ACQUIRE)
                 dvz_swapchain_acquire(
                     &canvas->swapchain, &canvas->sem_img_available, //
                     canvas->cur_frame, NULL, 0);
+                DVZ_PROFILE_END(DVZ_PROFILE_ACQUIRE)
+            }
 
             // If there is a problem with swapchain image acquisition, wait and try again later.
             if (canvas->swapchain.obj.status == DVZ_OBJECT_STATUS_INVALID)
@@ -2188,20 +2801,38 @@ void dvz_app_run(DvzApp* app, uint64_t frame_count)
                 continue;
             }
 
+            // The frame workers prepare the canvas once all canvases have been processed here.
+            if (job)
+            {
+                canvas->frame_job = true;
+                n_canvas_jobs++;
+                n_canvas_active++;
+                dvz_container_iter(&iterator);
+                continue;
+            }
+
             // Frame logic.
             dvz_canvas_frame(canvas);
             canvas->resized = false;
 
             // Submit the command buffers and swapchain logic.
             // log_trace("submitting frame for canvas #%d", canvas_idx);
+            DVZ_PROFILE_BEGIN(DVZ_PROFILE_SUBMIT)
             dvz_canvas_frame_submit(canvas);
+            DVZ_PROFILE_END(DVZ_PROFILE_SUBMIT)
             canvas->frame_idx++;
             n_canvas_active++;
+            if (atomic_load(&canvas->frames_dirty) > 0)
+                atomic_fetch_sub(&canvas->frames_dirty, 1);
 
 
             dvz_container_iter(&iterator);
         }
 
+        // Prepare and submit the offscreen canvases in parallel.
+        if (n_canvas_jobs > 0)
+            _frame_jobs_run(app);
+
         // IMPORTANT: we need to wait for the present queue to be idle, otherwise the GPU hangs
         // when waiting for fences (not sure why). The problem only arises when using different
         // queues for command buffer submission and swapchain present. There has be a better way
@@ -2232,6 +2863,10 @@ void dvz_app_run(DvzApp* app, uint64_t frame_count)
             log_trace("no more active canvas, closing the app");
             break;
         }
+
+        // Sleep until the next user input, TIMER event, or frame request if all canvases are idle.
+        if (n_canvas_idle > 0 && n_canvas_idle == n_canvas_active)
+            backend_wait_events(app->backend, idle_timeout);
     }
     log_trace("end main loop");
 
@@ -2268,9 +2903,26 @@ void dvz_canvas_destroy(DvzCanvas* canvas)
     dvz_event_stop(canvas);
     dvz_thread_join(&canvas->event_thread);
     dvz_fifo_destroy(&canvas->event_queue);
+    pthread_mutex_destroy(&canvas->event_lock);
+
+    // Stop the async callback workers, and discard the events they have not processed.
+    _event_workers_stop(canvas);
+    pthread_rwlock_destroy(&canvas->callback_lock);
+    dvz_fifo_destroy(&canvas->event_ready);
+    for (uint32_t i = 0; i < canvas->callbacks_count; i++)
+    {
+        DvzEventCallbackRegister* r = &canvas->callbacks[i];
+        if (r->mode != DVZ_EVENT_MODE_ASYNC)
+            continue;
+        void* job = NULL;
+        while ((job = dvz_fifo_dequeue(&r->jobs, false)) != NULL)
+            FREE(job);
+        dvz_fifo_destroy(&r->jobs);
+    }
 
     // Destroy the transfers queue.
-    dvz_fifo_destroy(&canvas->transfers);
+    dvz_transfer_queue_destroy(&canvas->transfers);
+    dvz_readback_destroy(&canvas->readback);
 
     // Destroy callbacks.
     _destroy_callbacks(canvas);
@@ -2310,11 +2962,37 @@ void dvz_canvas_destroy(DvzCanvas* canvas)
     log_trace("canvas destroy commands");
     CONTAINER_DESTROY_ITEMS(DvzCommands, canvas->commands, dvz_commands_destroy)
     dvz_container_destroy(&canvas->commands);
+    // The scene may be destroyed after the canvas: its visuals must not free their command
+    // buffers from the destroyed pool.
+    if (canvas->scene != NULL)
+    {
+        DvzContainerIterator iter = dvz_container_iterator(&canvas->scene->visuals);
+        DvzVisual* visual = NULL;
+        while (iter.item != NULL)
+        {
+            visual = (DvzVisual*)iter.item;
+            visual->cmds_fill = (DvzCommands){0};
+            memset(visual->fill_valid, 0, sizeof(visual->fill_valid));
+            dvz_container_iter(&iter);
+        }
+    }
+    // This also frees the command buffers allocated from the canvas command pool.
+    dvz_command_pool_destroy(canvas->gpu, &canvas->cmd_pool);
+    if (canvas->profile.enabled)
+    {
+        dvz_context_lock(canvas->gpu->context);
+        _profile_transfers(canvas->gpu->context, false);
+        dvz_context_unlock(canvas->gpu->context);
+    }
+    dvz_queries_destroy(&canvas->profile.queries);
 
     // Destroy the semaphores.
     log_trace("canvas destroy semaphores");
     dvz_semaphores_destroy(&canvas->sem_img_available);
     dvz_semaphores_destroy(&canvas->sem_render_finished);
+    if (canvas->gpu->context->staging.render_semaphore == &canvas->sem_render_transfers)
+        canvas->gpu->context->staging.render_semaphore = NULL;
+    dvz_semaphores_destroy(&canvas->sem_render_transfers);
 
     // Destroy the fences.
     log_trace("canvas destroy fences");
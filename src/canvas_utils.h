@@ -13,15 +13,96 @@ extern "C" {
 /*  Event system                                                                                 */
 /*************************************************************************************************/
 
-// Enqueue an event.
+// Whether only the latest state carried by events of a given type matters, in which case
+// consecutive events of that type can be merged while they wait in the queue.
+static bool _event_coalescable(DvzEventType type)
+{
+    switch (type)
+    {
+    case DVZ_EVENT_MOUSE_MOVE:
+    case DVZ_EVENT_MOUSE_WHEEL:
+    case DVZ_EVENT_FRAME:
+    case DVZ_EVENT_TIMER:
+    case DVZ_EVENT_RESIZE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+
+// Merge a new event into a pending event of the same type.
+static void _event_merge(DvzEvent* pending, DvzEvent* event)
+{
+    ASSERT(pending != NULL);
+    ASSERT(event != NULL);
+    ASSERT(pending->type == event->type);
+
+    switch (event->type)
+    {
+    case DVZ_EVENT_MOUSE_WHEEL:
+        // Sum the wheel deltas.
+        pending->u.w.dir[0] += event->u.w.dir[0];
+        pending->u.w.dir[1] += event->u.w.dir[1];
+        pending->u.w.modifiers = event->u.w.modifiers;
+        break;
+
+    case DVZ_EVENT_FRAME:
+        // Keep the latest frame, with the interval since the event before the merged ones.
+        pending->u.f.idx = event->u.f.idx;
+        pending->u.f.time = event->u.f.time;
+        pending->u.f.interval += event->u.f.interval;
+        break;
+
+    case DVZ_EVENT_TIMER:
+        // Same for timer ticks.
+        pending->u.t.idx = event->u.t.idx;
+        pending->u.t.time = event->u.t.time;
+        pending->u.t.interval += event->u.t.interval;
+        break;
+
+    default:
+        // Mouse moves, including drag updates, and resizes: keep the latest state.
+        *pending = *event;
+        break;
+    }
+}
+
+
+
+// Enqueue an event. Events whose latest state is all that matters are coalesced with a pending
+// event of the same type, as long as no discrete event (click, key, etc.) has been enqueued since
+// then, so that the queue stays short under high-rate input without reordering discrete events.
 static void _event_enqueue(DvzCanvas* canvas, DvzEvent event)
 {
     ASSERT(canvas != NULL);
     DvzFifo* fifo = &canvas->event_queue;
     ASSERT(fifo != NULL);
+    ASSERT(event.type < DVZ_EVENT_COUNT);
+
+    pthread_mutex_lock(&canvas->event_lock);
+    bool coalescable = _event_coalescable(event.type);
+    DvzEvent* pending = canvas->events_last[event.type];
+    if (coalescable && pending != NULL)
+    {
+        _event_merge(pending, &event);
+        pthread_mutex_unlock(&canvas->event_lock);
+        return;
+    }
+
     DvzEvent* ev = (DvzEvent*)calloc(1, sizeof(DvzEvent));
     *ev = event;
+    if (coalescable)
+        canvas->events_last[event.type] = ev;
+    else
+        // A discrete event: the pending events cannot absorb the next ones anymore.
+        memset(canvas->events_last, 0, sizeof(canvas->events_last));
+    atomic_fetch_add(&canvas->events_pending[event.type], 1);
+    // NOTE: enqueue while holding the lock, so that the order of the queue matches the order in
+    // which the events were coalesced.
     dvz_fifo_enqueue(fifo, ev);
+    pthread_mutex_unlock(&canvas->event_lock);
 }
 
 
@@ -38,8 +119,16 @@ static DvzEvent _event_dequeue(DvzCanvas* canvas, bool wait)
     if (item == NULL)
         return out;
     ASSERT(item != NULL);
+
+    // The event may still be merged with new events until it is out of the coalescing table.
+    pthread_mutex_lock(&canvas->event_lock);
+    if (canvas->events_last[item->type] == item)
+        canvas->events_last[item->type] = NULL;
     out = *item;
+    pthread_mutex_unlock(&canvas->event_lock);
+
     FREE(item);
+    atomic_fetch_sub(&canvas->events_pending[out.type], 1);
     return out;
 }
 
@@ -73,13 +162,69 @@ static bool _has_event_callbacks(DvzCanvas* canvas, DvzEventType type)
 
 
 
+// Whether the calling thread is one of the async callback workers.
+static bool _is_event_worker(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    pthread_t self = pthread_self();
+    for (uint32_t i = 0; i < canvas->event_workers_count; i++)
+        if (pthread_equal(canvas->event_workers[i].thread, self))
+            return true;
+    return false;
+}
+
+
+
+// Acquire the callback lock exclusively. The lock is reentrant, so that a sync callback may
+// produce other events.
+static void _callback_lock(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    pthread_t self = pthread_self();
+    int depth = atomic_load(&canvas->callback_depth);
+    if (depth > 0 && pthread_equal(canvas->callback_owner, self))
+    {
+        atomic_store(&canvas->callback_depth, depth + 1);
+        return;
+    }
+    // NOTE: an async callback producing an event already holds the shared lock, upgrading it
+    // would deadlock. Its sync callbacks then run within the shared lock.
+    if (_is_event_worker(canvas))
+        return;
+    pthread_rwlock_wrlock(&canvas->callback_lock);
+    canvas->callback_owner = self;
+    atomic_store(&canvas->callback_depth, 1);
+    // Also exclude the callback registration.
+    dvz_thread_lock(&canvas->event_thread);
+}
+
+
+
+static void _callback_unlock(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    int depth = atomic_load(&canvas->callback_depth);
+    if (depth == 0 || !pthread_equal(canvas->callback_owner, pthread_self()))
+        return; // in an async callback worker, see _callback_lock()
+    if (depth == 1)
+        dvz_thread_unlock(&canvas->event_thread);
+    atomic_store(&canvas->callback_depth, depth - 1);
+    if (depth == 1)
+        pthread_rwlock_unlock(&canvas->callback_lock);
+}
+
+
+
 // Consume an event, return the number of callbacks called.
 static int _event_consume(DvzCanvas* canvas, DvzEvent ev, DvzEventMode mode)
 {
     ASSERT(canvas != NULL);
 
-    if (canvas->enable_lock)
-        dvz_thread_lock(&canvas->event_thread);
+    // The sync callbacks run with exclusive access to the scene objects, so the async callbacks
+    // are not running meanwhile.
+    bool lock = canvas->enable_lock;
+    if (lock)
+        _callback_lock(canvas);
 
     // HACK: we first call the callbacks with no param, then we call the callbacks with a non-zero
     // param. This is a way to use the param as a priority value. This is used by the scene FRAME
@@ -106,8 +251,8 @@ static int _event_consume(DvzCanvas* canvas, DvzEvent ev, DvzEventMode mode)
         }
     }
 
-    if (canvas->enable_lock)
-        dvz_thread_unlock(&canvas->event_thread);
+    if (lock)
+        _callback_unlock(canvas);
 
     return n_callbacks;
 }
@@ -120,6 +265,11 @@ static int _event_produce(DvzCanvas* canvas, DvzEvent ev)
 {
     ASSERT(canvas != NULL);
 
+    // In on-demand mode, user input is likely to change what the canvas displays.
+    if (canvas->on_demand && (ev.type == DVZ_EVENT_GUI || (ev.type >= DVZ_EVENT_MOUSE_PRESS &&
+                                                           ev.type <= DVZ_EVENT_RESIZE)))
+        dvz_canvas_to_render(canvas);
+
     // Call the sync callbacks directly.
     int n_callbacks = _event_consume(canvas, ev, DVZ_EVENT_MODE_SYNC);
 
@@ -132,7 +282,171 @@ static int _event_produce(DvzCanvas* canvas, DvzEvent ev)
 
 
 
-// Event loop running in the background thread, waiting for events and dequeuing them.
+/*************************************************************************************************/
+/*  Async callbacks worker pool                                                                  */
+/*************************************************************************************************/
+
+typedef struct DvzEventJob DvzEventJob;
+
+// Event waiting for an async callback.
+struct DvzEventJob
+{
+    DvzEvent ev;
+    double time; // dispatch time
+};
+
+
+
+// Time since the canvas creation. Unlike _clock_get(), this can be called from any thread.
+static double _event_time(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    struct timeval now = {0};
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - canvas->clock.start.tv_sec) +
+           (now.tv_usec - canvas->clock.start.tv_usec) / 1000000.0;
+}
+
+
+
+// Update the timing statistics of a callback.
+static void _event_stats_add(DvzEventStats* stats, double duration, double latency)
+{
+    ASSERT(stats != NULL);
+    stats->count++;
+    double n = (double)stats->count;
+    stats->duration += (duration - stats->duration) / n;
+    stats->latency += (latency - stats->latency) / n;
+    stats->duration_max = MAX(stats->duration_max, duration);
+    stats->latency_max = MAX(stats->latency_max, latency);
+}
+
+
+
+// Hand an async callback with pending events to the worker pool, unless it is already there.
+static void _event_schedule(DvzCanvas* canvas, DvzEventCallbackRegister* r)
+{
+    ASSERT(canvas != NULL);
+    ASSERT(r != NULL);
+    if (dvz_fifo_size(&r->jobs) == 0)
+        return;
+    bool expected = false;
+    if (atomic_compare_exchange_strong(&r->scheduled, &expected, true))
+        dvz_fifo_enqueue(&canvas->event_ready, r);
+}
+
+
+
+// Send an event to all async callbacks registered for its type.
+static int _event_dispatch(DvzCanvas* canvas, DvzEvent ev)
+{
+    ASSERT(canvas != NULL);
+
+    int n_callbacks = 0;
+    DvzEventCallbackRegister* r = NULL;
+    DvzEventJob* job = NULL;
+    double time = _event_time(canvas);
+    for (uint32_t i = 0; i < canvas->callbacks_count; i++)
+    {
+        r = &canvas->callbacks[i];
+        if (r->type != ev.type || r->mode != DVZ_EVENT_MODE_ASYNC)
+            continue;
+
+        job = (DvzEventJob*)calloc(1, sizeof(DvzEventJob));
+        job->ev = ev;
+        job->ev.user_data = r->user_data;
+        job->time = time;
+        atomic_fetch_add(&r->pending, 1);
+        dvz_fifo_enqueue(&r->jobs, job);
+        _event_schedule(canvas, r);
+        n_callbacks++;
+    }
+    return n_callbacks;
+}
+
+
+
+// Process the next pending event of an async callback, in a worker thread.
+static void _event_run(DvzCanvas* canvas, DvzEventCallbackRegister* r)
+{
+    ASSERT(canvas != NULL);
+    ASSERT(r != NULL);
+
+    // NOTE: the job may not be visible yet if the dispatcher is still enqueuing it.
+    DvzEventJob* job = (DvzEventJob*)dvz_fifo_dequeue(&r->jobs, false);
+    if (job != NULL)
+    {
+        // The async callbacks share the callback lock: they may run concurrently with each
+        // other, but never at the same time as the sync callbacks.
+        bool lock = canvas->enable_lock;
+        if (lock)
+            pthread_rwlock_rdlock(&canvas->callback_lock);
+
+        double start = _event_time(canvas);
+        r->callback(canvas, job->ev);
+        double end = _event_time(canvas);
+
+        if (lock)
+            pthread_rwlock_unlock(&canvas->callback_lock);
+
+        _event_stats_add(&r->stats, end - start, end - job->time);
+        atomic_fetch_sub(&r->pending, 1);
+        FREE(job);
+    }
+
+    // Release the callback, and hand it back to the pool if new events arrived in the meantime.
+    // Processing one event at a time lets the other callbacks get a worker in between.
+    atomic_store(&r->scheduled, false);
+    _event_schedule(canvas, r);
+}
+
+
+
+// Worker thread running the async callbacks.
+static void* _event_worker(void* p_canvas)
+{
+    DvzCanvas* canvas = (DvzCanvas*)p_canvas;
+    ASSERT(canvas != NULL);
+
+    DvzEventCallbackRegister* r = NULL;
+    // A NULL item is sent to stop the worker.
+    while ((r = (DvzEventCallbackRegister*)dvz_fifo_dequeue(&canvas->event_ready, true)) != NULL)
+        _event_run(canvas, r);
+
+    return NULL;
+}
+
+
+
+static void _event_workers_start(DvzCanvas* canvas, uint32_t count)
+{
+    ASSERT(canvas != NULL);
+    ASSERT(canvas->event_workers_count == 0);
+    ASSERT(0 < count && count <= DVZ_MAX_EVENT_WORKERS);
+    log_debug("starting %d async callback workers", count);
+    for (uint32_t i = 0; i < count; i++)
+        canvas->event_workers[i] = dvz_thread(_event_worker, canvas);
+    canvas->event_workers_count = count;
+}
+
+
+
+// Stop the workers once they have processed the callbacks that are already in the pool.
+static void _event_workers_stop(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    uint32_t count = canvas->event_workers_count;
+    for (uint32_t i = 0; i < count; i++)
+        dvz_fifo_enqueue(&canvas->event_ready, NULL);
+    for (uint32_t i = 0; i < count; i++)
+        dvz_thread_join(&canvas->event_workers[i]);
+    canvas->event_workers_count = 0;
+}
+
+
+
+// Event loop running in the background thread, waiting for events and dispatching them to the
+// worker pool.
 static void* _event_thread(void* p_canvas)
 {
     DvzCanvas* canvas = (DvzCanvas*)p_canvas;
@@ -140,12 +454,6 @@ static void* _event_thread(void* p_canvas)
     log_debug("starting event thread");
 
     DvzEvent ev;
-    double avg_event_time = 0; // average event callback time across all event types
-    double elapsed = 0;        // average time of the event callbacks in the current iteration
-    int n_callbacks = 0;       // number of event callbacks in the current event loop iteration
-    int counter = 0;           // number of iterations in the event loop
-    int events_to_keep = 0;    // maximum number of pending events to keep in the queue
-
     while (true)
     {
         // log_trace("event thread awaits for events...");
@@ -158,39 +466,13 @@ static void* _event_thread(void* p_canvas)
             break;
         }
 
-        // Logic to discard some events if the queue is getting overloaded because of long-running
-        // callbacks.
-
-        // TODO: there are ways to improve the mechanism dropping events from the queue when the
-        // queue is getting overloaded. Doing it on a per-type basis, better estimating the avg
-        // time taken by each callback, etc.
-
-        // log_trace("event dequeued type %d, processing it...", ev.type);
-        // process the dequeued task
-        elapsed = _clock_get(&canvas->clock);
-        n_callbacks = _event_consume(canvas, ev, DVZ_EVENT_MODE_ASYNC);
-        elapsed = _clock_get(&canvas->clock) - elapsed;
-        // NOTE: avoid division by zero.
-        if (n_callbacks > 0)
-            elapsed /= n_callbacks; // average duration of the events
-
-        // Update the average event time.
-        avg_event_time = ((avg_event_time * counter) + elapsed) / (counter + 1);
-        if (avg_event_time > 0)
-        {
-            events_to_keep =
-                CLIP(DVZ_MAX_EVENT_DURATION / avg_event_time, 1, DVZ_MAX_FIFO_CAPACITY);
-            if (events_to_keep == DVZ_MAX_FIFO_CAPACITY)
-                events_to_keep = 0;
-        }
+        // NOTE: the queue does not need to be trimmed when the callbacks are slow, as high-rate
+        // events are coalesced when they are enqueued, see _event_enqueue().
 
-        // Handle event queue overloading: if events are enqueued faster than
-        // they are consumed, we should discard the older events so that the
-        // queue doesn't keep filling up.
-        dvz_fifo_discard(&canvas->event_queue, events_to_keep);
+        // log_trace("event dequeued type %d, dispatching it...", ev.type);
+        _event_dispatch(canvas, ev);
 
         canvas->event_processing = DVZ_EVENT_NONE;
-        counter++;
     }
     log_debug("end event thread");
 
@@ -122,6 +122,47 @@ static void _context_default_buffers(DvzContext* context)
         // Permanently map the buffer.
         buffer->mmap = dvz_buffer_map(buffer, 0, VK_WHOLE_SIZE);
     }
+
+    // Mappable vertex buffer, for data that changes at every frame: it is written directly
+    // without going through the staging buffer.
+    {
+        buffer = dvz_container_get(&context->buffers, DVZ_BUFFER_TYPE_VERTEX_MAPPABLE);
+        ASSERT(buffer != NULL);
+        dvz_buffer_type(buffer, DVZ_BUFFER_TYPE_VERTEX_MAPPABLE);
+        dvz_buffer_size(buffer, DVZ_BUFFER_TYPE_VERTEX_MAPPABLE_SIZE);
+        dvz_buffer_usage(
+            buffer,
+            transferable | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        dvz_buffer_memory(
+            buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        dvz_buffer_create(buffer);
+        ASSERT(dvz_obj_is_created(&buffer->obj));
+
+        // Permanently map the buffer.
+        buffer->mmap = dvz_buffer_map(buffer, 0, VK_WHOLE_SIZE);
+    }
+
+    // Indirect buffer, with the draw parameters of the visuals: the number of vertices/indices to
+    // draw is read by the GPU so that it can change without recording the command buffers again.
+    {
+        buffer = dvz_container_get(&context->buffers, DVZ_BUFFER_TYPE_INDIRECT);
+        ASSERT(buffer != NULL);
+        dvz_buffer_type(buffer, DVZ_BUFFER_TYPE_INDIRECT);
+        dvz_buffer_size(buffer, DVZ_BUFFER_TYPE_INDIRECT_SIZE);
+        dvz_buffer_usage(
+            buffer, transferable | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        dvz_buffer_memory(buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        dvz_buffer_create(buffer);
+        ASSERT(dvz_obj_is_created(&buffer->obj));
+    }
+
+    // Sub-allocators of the buffers.
+    for (uint32_t i = 0; i < DVZ_BUFFER_TYPE_COUNT; i++)
+    {
+        buffer = dvz_container_get(&context->buffers, i);
+        context->allocs[i] = dvz_alloc(buffer->size);
+    }
 }
 
 
@@ -132,6 +173,8 @@ static void _destroy_resources(DvzContext* context)
 
     log_trace("context destroy buffers");
     CONTAINER_DESTROY_ITEMS(DvzBuffer, context->buffers, dvz_buffer_destroy)
+    for (uint32_t i = 0; i < DVZ_BUFFER_TYPE_COUNT; i++)
+        dvz_alloc_destroy(&context->allocs[i]);
 
     log_trace("context destroy sets of images");
     CONTAINER_DESTROY_ITEMS(DvzImages, context->images, dvz_images_destroy)
@@ -157,6 +200,15 @@ DvzContext* dvz_context(DvzGpu* gpu, DvzWindow* window)
     DvzContext* context = calloc(1, sizeof(DvzContext));
     context->gpu = gpu;
 
+    // The lock may be acquired again by the same thread, for example when a transfer allocates a
+    // buffer region.
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    if (pthread_mutex_init(&context->lock, &attr) != 0)
+        log_error("mutex creation failed");
+    pthread_mutexattr_destroy(&attr);
+
     // Allocate memory for buffers, textures, and computes.
     context->buffers =
         dvz_container(DVZ_CONTAINER_DEFAULT_COUNT, sizeof(DvzBuffer), DVZ_OBJECT_TYPE_BUFFER);
@@ -186,6 +238,13 @@ DvzContext* dvz_context(DvzGpu* gpu, DvzWindow* window)
 
     context->transfer_cmd = dvz_commands(gpu, DVZ_DEFAULT_QUEUE_TRANSFER, 1);
 
+    // Staging ring: one command buffer and one fence per in-flight chunk.
+    context->staging.cmds = dvz_commands(gpu, DVZ_DEFAULT_QUEUE_TRANSFER, DVZ_STAGING_RING_SLOTS);
+    context->staging.fences = dvz_fences(gpu, DVZ_STAGING_RING_SLOTS, true);
+    context->staging.semaphores = dvz_semaphores(gpu, DVZ_STAGING_RING_SLOTS);
+    context->staging.signaled = -1;
+    context->staging.max_size = DVZ_BUFFER_TYPE_STAGING_MAX_SIZE;
+
     gpu->context = context;
     dvz_obj_created(&context->obj);
 
@@ -215,6 +274,8 @@ void dvz_context_reset(DvzContext* context)
 {
     ASSERT(context != NULL);
     log_trace("reset the context");
+    // Make sure the staging buffer is no longer used before destroying it.
+    dvz_staging_wait(context);
     _destroy_resources(context);
     _context_default_buffers(context);
 }
@@ -235,32 +296,419 @@ void dvz_context_destroy(DvzContext* context)
     // Destroy the font atlas.
     dvz_font_atlas_destroy(&context->font_atlas);
 
+    // Destroy the staging ring.
+    dvz_staging_wait(context);
+    dvz_fences_destroy(&context->staging.fences);
+    dvz_semaphores_destroy(&context->staging.semaphores);
+    dvz_queries_destroy(&context->staging.queries);
+
     // Destroy the buffers, images, samplers, textures, computes.
     _destroy_resources(context);
 
+    // Destroy the shader modules.
+    for (uint32_t i = 0; i < context->shader_count; i++)
+        vkDestroyShaderModule(context->gpu->device, context->shader_modules[i], NULL);
+    context->shader_count = 0;
+
     // Free the allocated memory.
     dvz_container_destroy(&context->buffers);
     dvz_container_destroy(&context->images);
     dvz_container_destroy(&context->samplers);
     dvz_container_destroy(&context->textures);
     dvz_container_destroy(&context->computes);
+
+    pthread_mutex_destroy(&context->lock);
+}
+
+
+
+void dvz_context_lock(DvzContext* context)
+{
+    ASSERT(context != NULL);
+    pthread_mutex_lock(&context->lock);
+}
+
+
+
+void dvz_context_unlock(DvzContext* context)
+{
+    ASSERT(context != NULL);
+    pthread_mutex_unlock(&context->lock);
 }
 
 
 
 /*************************************************************************************************/
-/*  Buffer allocation                                                                            */
+/*  Staging ring                                                                                 */
 /*************************************************************************************************/
 
-DvzBufferRegions dvz_ctx_buffers(
-    DvzContext* context, DvzBufferType buffer_type, uint32_t buffer_count, VkDeviceSize size)
+static DvzBuffer* _staging_buffer(DvzContext* context)
+{
+    DvzBuffer* buffer = (DvzBuffer*)dvz_container_get(&context->buffers, DVZ_BUFFER_TYPE_STAGING);
+    ASSERT(buffer != NULL);
+    ASSERT(buffer->buffer != VK_NULL_HANDLE);
+    ASSERT(buffer->mmap != NULL);
+    return buffer;
+}
+
+
+
+// Recycle the oldest in-flight chunk.
+static void _staging_release(DvzStaging* staging)
+{
+    ASSERT(staging != NULL);
+    ASSERT(staging->count > 0);
+
+    // Accumulate the GPU time of the transfer, which has completed.
+    DvzStagingChunk* chunk = &staging->chunks[staging->first];
+    uint64_t results[4] = {0};
+    if (chunk->timestamps && dvz_queries_results(&staging->queries, 2 * chunk->slot, 2, results))
+    {
+        staging->gpu_time += dvz_gpu_timestamps_elapsed(
+            staging->cmds.gpu, staging->cmds.queue_idx, results[0], results[2]);
+    }
+
+    staging->first = (staging->first + 1) % DVZ_STAGING_RING_SLOTS;
+    staging->count--;
+    if (staging->count > 0)
+    {
+        staging->tail = staging->chunks[staging->first].offset;
+    }
+    else
+    {
+        // The ring is empty: restart from the beginning of the buffer.
+        staging->head = 0;
+        staging->tail = 0;
+    }
+}
+
+
+
+// Recycle all chunks, from the oldest, whose transfer has completed. Non-blocking.
+static void _staging_retire(DvzStaging* staging)
+{
+    ASSERT(staging != NULL);
+    while (staging->count > 0 && dvz_fences_ready(&staging->fences, staging->first))
+        _staging_release(staging);
+}
+
+
+
+// Find a free region of the ring that can hold `size` bytes.
+static bool _staging_fits(
+    DvzStaging* staging, VkDeviceSize capacity, VkDeviceSize size, VkDeviceSize* offset)
+{
+    ASSERT(staging != NULL);
+    ASSERT(offset != NULL);
+
+    if (staging->count == 0)
+    {
+        *offset = 0;
+        return size <= capacity;
+    }
+    if (staging->count >= DVZ_STAGING_RING_SLOTS)
+        return false;
+
+    VkDeviceSize head = staging->head;
+    VkDeviceSize tail = staging->tail;
+
+    // Free space is [head, capacity) followed by [0, tail).
+    if (head > tail)
+    {
+        if (head + size <= capacity)
+        {
+            *offset = head;
+            return true;
+        }
+        if (size <= tail)
+        {
+            *offset = 0;
+            return true;
+        }
+        return false;
+    }
+
+    // Free space is [head, tail). When head == tail, the ring is full.
+    if (head < tail && head + size <= tail)
+    {
+        *offset = head;
+        return true;
+    }
+    return false;
+}
+
+
+
+void dvz_staging_max_size(DvzContext* context, VkDeviceSize max_size)
+{
+    ASSERT(context != NULL);
+    ASSERT(max_size >= DVZ_STAGING_STREAM_CHUNKS * DVZ_STAGING_ALIGNMENT);
+    context->staging.max_size = max_size;
+
+    // Shrink the staging buffer if it is larger than the new maximum size.
+    DvzBuffer* buffer = _staging_buffer(context);
+    if (buffer->size > max_size)
+    {
+        dvz_staging_wait(context);
+        log_info("reallocating staging buffer to %s", pretty_size(max_size));
+        dvz_buffer_resize(buffer, max_size, NULL);
+    }
+}
+
+
+
+DvzStagingChunk dvz_staging_alloc(DvzContext* context, VkDeviceSize size)
 {
     ASSERT(context != NULL);
-    ASSERT(context->gpu != NULL);
-    ASSERT(buffer_count > 0);
     ASSERT(size > 0);
-    ASSERT(buffer_type < DVZ_BUFFER_TYPE_COUNT);
+    DvzStaging* staging = &context->staging;
+    ASSERT(!staging->pending);
+    DvzBuffer* buffer = _staging_buffer(context);
+
+    VkDeviceSize aligned = aligned_size(size, DVZ_STAGING_ALIGNMENT);
+    if (aligned > staging->max_size)
+    {
+        log_error(
+            "staging chunk of %s exceeds the maximum staging buffer size %s", pretty_size(size),
+            pretty_size(staging->max_size));
+    }
+    ASSERT(aligned <= staging->max_size);
+
+    // Resize the staging buffer if the chunk cannot fit in it at all. This requires all
+    // in-flight chunks to complete first.
+    if (buffer->size < aligned)
+    {
+        dvz_staging_wait(context);
+        VkDeviceSize new_size = MIN(dvz_next_pow2(aligned), staging->max_size);
+        log_info("reallocating staging buffer to %s", pretty_size(new_size));
+        // NOTE: no need to keep the data as no chunk is in flight.
+        dvz_buffer_resize(buffer, new_size, NULL);
+    }
+    ASSERT(buffer->size >= aligned);
+
+    // Recycle the chunks that are done, and block on the oldest ones only if the ring is full.
+    VkDeviceSize offset = 0;
+    _staging_retire(staging);
+    while (!_staging_fits(staging, buffer->size, aligned, &offset))
+    {
+        ASSERT(staging->count > 0);
+        log_trace("staging ring full, waiting for the oldest chunk");
+        staging->stall_count++;
+        dvz_fences_wait(&staging->fences, staging->first);
+        _staging_release(staging);
+    }
+
+    DvzStagingChunk chunk = {0};
+    chunk.slot = (staging->first + staging->count) % DVZ_STAGING_RING_SLOTS;
+    chunk.offset = offset;
+    chunk.size = aligned;
+    chunk.timestamps = staging->profile;
+
+    staging->chunks[chunk.slot] = chunk;
+    if (staging->count == 0)
+        staging->tail = offset;
+    staging->head = offset + aligned;
+    staging->count++;
+    staging->pending = true;
+
+    // Start recording the chunk's command buffer.
+    dvz_cmd_reset(&staging->cmds, chunk.slot);
+    dvz_cmd_begin(&staging->cmds, chunk.slot);
+    if (chunk.timestamps)
+    {
+        dvz_cmd_reset_queries(&staging->cmds, chunk.slot, &staging->queries, 2 * chunk.slot, 2);
+        dvz_cmd_timestamp(
+            &staging->cmds, chunk.slot, &staging->queries, 2 * chunk.slot,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+    }
+
+    return chunk;
+}
+
+
+
+void dvz_staging_upload(
+    DvzContext* context, DvzStagingChunk* chunk, VkDeviceSize size, const void* data)
+{
+    ASSERT(context != NULL);
+    ASSERT(chunk != NULL);
+    ASSERT(size <= chunk->size);
+    dvz_buffer_upload(_staging_buffer(context), chunk->offset, size, data);
+}
+
+
+
+void dvz_staging_upload_strided(
+    DvzContext* context, DvzStagingChunk* chunk, uvec3 shape, VkDeviceSize item_size,
+    VkDeviceSize row_pitch, VkDeviceSize slice_pitch, const void* data)
+{
+    ASSERT(context != NULL);
+    ASSERT(chunk != NULL);
+    ASSERT(data != NULL);
+    ASSERT(item_size > 0);
+
+    VkDeviceSize row_size = shape[0] * item_size;
+    ASSERT(row_size > 0);
+    ASSERT(row_size * shape[1] * shape[2] <= chunk->size);
+    DvzBuffer* buffer = _staging_buffer(context);
+
+    // Pack the rows of the box one after the other in the chunk.
+    VkDeviceSize offset = chunk->offset;
+    const uint8_t* src = NULL;
+    for (uint32_t z = 0; z < shape[2]; z++)
+    {
+        for (uint32_t y = 0; y < shape[1]; y++)
+        {
+            src = (const uint8_t*)data + z * slice_pitch + y * row_pitch;
+            dvz_buffer_upload(buffer, offset, row_size, src);
+            offset += row_size;
+        }
+    }
+}
+
+
+
+void dvz_staging_download(
+    DvzContext* context, DvzStagingChunk* chunk, VkDeviceSize size, void* data)
+{
+    ASSERT(context != NULL);
+    ASSERT(chunk != NULL);
+    ASSERT(size <= chunk->size);
+    dvz_buffer_download(_staging_buffer(context), chunk->offset, size, data);
+}
+
+
+
+void dvz_staging_submit(DvzContext* context, DvzStagingChunk* chunk)
+{
+    ASSERT(context != NULL);
+    ASSERT(chunk != NULL);
+    DvzStaging* staging = &context->staging;
+    ASSERT(staging->pending);
+
+    if (chunk->timestamps)
+        dvz_cmd_timestamp(
+            &staging->cmds, chunk->slot, &staging->queries, 2 * chunk->slot + 1,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    dvz_cmd_end(&staging->cmds, chunk->slot);
+
+    DvzSubmit submit = dvz_submit(context->gpu);
+    dvz_submit_commands(&submit, &staging->cmds);
+
+    // Do not overwrite data that the last render submission may still be using.
+    if (staging->render_semaphore != NULL)
+    {
+        dvz_submit_wait_semaphores(
+            &submit, VK_PIPELINE_STAGE_TRANSFER_BIT, staging->render_semaphore, 0);
+        staging->render_semaphore = NULL;
+    }
+
+    // Follow the previous submission, and signal the semaphore of this slot. The semaphore of a
+    // slot has always been waited upon when the slot is reused, as slots are used in turn.
+    if (staging->signaled >= 0)
+    {
+        ASSERT((uint32_t)staging->signaled != chunk->slot);
+        dvz_submit_wait_semaphores(
+            &submit, VK_PIPELINE_STAGE_TRANSFER_BIT, &staging->semaphores,
+            (uint32_t)staging->signaled);
+    }
+    dvz_submit_signal_semaphores(&submit, &staging->semaphores, chunk->slot);
+    staging->signaled = (int32_t)chunk->slot;
+
+    // NOTE: the fence of the slot is signaled at this point, dvz_submit_send() resets it.
+    dvz_submit_send(&submit, chunk->slot, &staging->fences, chunk->slot);
+    staging->pending = false;
+    staging->submit_count++;
+}
+
+
+
+void dvz_staging_wait(DvzContext* context)
+{
+    ASSERT(context != NULL);
+    DvzStaging* staging = &context->staging;
+    ASSERT(!staging->pending);
+    while (staging->count > 0)
+    {
+        dvz_fences_wait(&staging->fences, staging->first);
+        _staging_release(staging);
+    }
+}
+
+
+
+void dvz_staging_sync_wait(DvzContext* context, DvzSubmit* submit, VkPipelineStageFlags stage)
+{
+    ASSERT(context != NULL);
+    ASSERT(submit != NULL);
+    DvzStaging* staging = &context->staging;
+    if (staging->signaled < 0)
+        return;
+    dvz_submit_wait_semaphores(submit, stage, &staging->semaphores, (uint32_t)staging->signaled);
+    staging->signaled = -1;
+}
+
+
+
+void dvz_staging_sync_signal(DvzContext* context, DvzSubmit* submit, DvzSemaphores* semaphores)
+{
+    ASSERT(context != NULL);
+    ASSERT(submit != NULL);
+    ASSERT(semaphores != NULL);
+    DvzStaging* staging = &context->staging;
+
+    // The semaphore of a previous submission has not been waited upon by any staging submission.
+    // Consume it here, without waiting for anything: the new signal covers all the previous
+    // submissions to the queue anyway.
+    if (staging->render_semaphore != NULL)
+    {
+        dvz_submit_wait_semaphores(
+            submit, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, staging->render_semaphore, 0);
+    }
+    dvz_submit_signal_semaphores(submit, semaphores, 0);
+    staging->render_semaphore = semaphores;
+}
+
+
 
+void dvz_staging_timestamps(DvzContext* context, bool enable)
+{
+    ASSERT(context != NULL);
+    DvzStaging* staging = &context->staging;
+    DvzGpu* gpu = context->gpu;
+    ASSERT(gpu != NULL);
+
+    if (enable && !dvz_obj_is_created(&staging->queries.obj))
+    {
+        // Query resets are not supported on transfer-only queue families.
+        uint32_t qf = gpu->queues.queue_families[staging->cmds.queue_idx];
+        if (!dvz_gpu_timestamps(gpu, staging->cmds.queue_idx) ||
+            !(gpu->queues.support_graphics[qf] || gpu->queues.support_compute[qf]))
+        {
+            log_debug("the transfer queue does not support timestamps, skipping");
+            return;
+        }
+        staging->queries = dvz_queries(gpu, VK_QUERY_TYPE_TIMESTAMP, 2 * DVZ_STAGING_RING_SLOTS);
+    }
+    staging->profile = enable && dvz_obj_is_created(&staging->queries.obj);
+}
+
+
+
+double dvz_staging_gpu_time(DvzContext* context)
+{
+    ASSERT(context != NULL);
+    return context->staging.gpu_time;
+}
+
+
+
+/*************************************************************************************************/
+/*  Buffer allocation                                                                            */
+/*************************************************************************************************/
+
+static DvzBuffer* _ctx_buffer(DvzContext* context, DvzBufferType buffer_type)
+{
     // Choose the first buffer with the requested type.
     DvzContainerIterator iter = dvz_container_iterator(&context->buffers);
     DvzBuffer* buffer = NULL;
@@ -268,39 +716,71 @@ DvzBufferRegions dvz_ctx_buffers(
     {
         buffer = iter.item;
         if (dvz_obj_is_created(&buffer->obj) && buffer->type == buffer_type)
-            break;
+            return buffer;
         dvz_container_iter(&iter);
     }
+    return NULL;
+}
+
+
+
+// Total size of a set of buffer regions, in bytes.
+static VkDeviceSize _regions_size(DvzBufferRegions* br)
+{
+    ASSERT(br != NULL);
+    VkDeviceSize alsize = br->aligned_size > 0 ? br->aligned_size : br->size;
+    return alsize * br->count;
+}
+
+
+
+DvzBufferRegions dvz_ctx_buffers(
+    DvzContext* context, DvzBufferType buffer_type, uint32_t buffer_count, VkDeviceSize size)
+{
+    ASSERT(context != NULL);
+    ASSERT(context->gpu != NULL);
+    ASSERT(buffer_count > 0);
+    ASSERT(size > 0);
+    ASSERT(buffer_type < DVZ_BUFFER_TYPE_COUNT);
+
+    DvzBuffer* buffer = _ctx_buffer(context, buffer_type);
     if (buffer == NULL)
     {
         log_error("could not find buffer with requested type %d", buffer_type);
         return (DvzBufferRegions){0};
     }
+    dvz_context_lock(context);
     ASSERT(buffer != NULL);
     ASSERT(buffer->type == buffer_type);
     ASSERT(dvz_obj_is_created(&buffer->obj));
+    DvzAlloc* alloc = &context->allocs[buffer_type];
 
     VkDeviceSize alignment = 0;
-    VkDeviceSize offset = buffer->allocated_size;
     bool needs_align =
         buffer_type == DVZ_BUFFER_TYPE_UNIFORM || buffer_type == DVZ_BUFFER_TYPE_UNIFORM_MAPPABLE;
     if (needs_align)
-    {
         alignment = context->gpu->device_properties.limits.minUniformBufferOffsetAlignment;
-        ASSERT(offset % alignment == 0); // offset should be already aligned
-    }
-
-    DvzBufferRegions regions = dvz_buffer_regions(buffer, buffer_count, offset, size, alignment);
-    VkDeviceSize alsize = regions.aligned_size;
-    if (alsize == 0)
-        alsize = size;
+    VkDeviceSize alsize = alignment > 0 ? aligned_size(size, alignment) : size;
     ASSERT(alsize > 0);
+    VkDeviceSize total = alsize * buffer_count;
 
-    if (!dvz_obj_is_created(&buffer->obj))
+    // Find a free range in the buffer, or reallocate the buffer if there is none.
+    VkDeviceSize offset = 0;
+    if (!dvz_alloc_new(alloc, total, alignment, &offset))
     {
-        log_error("invalid buffer %d", buffer_type);
-        return regions;
+        VkDeviceSize new_size = dvz_next_pow2(buffer->size + total);
+        log_info("reallocating buffer %d to %s", buffer_type, pretty_size(new_size));
+        dvz_buffer_resize(buffer, new_size, &context->transfer_cmd);
+        dvz_alloc_grow(alloc, new_size);
+        bool success = dvz_alloc_new(alloc, total, alignment, &offset);
+        ASSERT(success);
     }
+    ASSERT(offset + total <= buffer->size);
+    buffer->allocated_size = alloc->allocated;
+
+    DvzBufferRegions regions = dvz_buffer_regions(buffer, buffer_count, offset, size, alignment);
+    ASSERT(regions.offsets[0] == offset);
+    ASSERT(_regions_size(&regions) == total);
 
     // Check alignment for uniform buffers.
     if (needs_align)
@@ -311,66 +791,93 @@ DvzBufferRegions dvz_ctx_buffers(
             ASSERT(regions.offsets[i] % alignment == 0);
     }
 
-    // Need to reallocate?
-    if (offset + alsize * buffer_count > regions.buffer->size)
-    {
-        VkDeviceSize new_size = dvz_next_pow2(offset + alsize * buffer_count);
-        log_info("reallocating buffer %d to %s", buffer_type, pretty_size(new_size));
-        dvz_buffer_resize(regions.buffer, new_size, &context->transfer_cmd);
-    }
-
     log_debug(
         "allocating %d buffers (type %d) with size %s (aligned size %s)", //
         buffer_count, buffer_type, pretty_size(size), pretty_size(alsize));
-    ASSERT(offset + alsize * buffer_count <= regions.buffer->size);
-    buffer->allocated_size += alsize * buffer_count;
-
-    ASSERT(regions.offsets[buffer_count - 1] + alsize == buffer->allocated_size);
+    dvz_context_unlock(context);
     return regions;
 }
 
 
 
+void dvz_ctx_buffers_free(DvzContext* context, DvzBufferRegions* br)
+{
+    ASSERT(context != NULL);
+    ASSERT(br != NULL);
+    if (br->buffer == NULL || br->count == 0)
+    {
+        log_debug("skip freeing of empty buffer regions");
+        return;
+    }
+    ASSERT(br->buffer->type < DVZ_BUFFER_TYPE_COUNT);
+    DvzAlloc* alloc = &context->allocs[br->buffer->type];
+
+    log_debug(
+        "free %d buffers (type %d) with size %s", br->count, br->buffer->type,
+        pretty_size(br->size));
+    dvz_context_lock(context);
+    dvz_alloc_free(alloc, br->offsets[0], _regions_size(br));
+    br->buffer->allocated_size = alloc->allocated;
+    dvz_context_unlock(context);
+    *br = (DvzBufferRegions){0};
+}
+
+
+
 void dvz_ctx_buffers_resize(DvzContext* context, DvzBufferRegions* br, VkDeviceSize new_size)
 {
-    // NOTE: this function tries to resize a buffer region in-place, which only works if
-    // it is the last allocated region in the buffer. Otherwise a brand new region is allocated,
-    // which wastes space. TODO: smarter memory management, defragmentation etc.
+    ASSERT(context != NULL);
     ASSERT(br->buffer != NULL);
     ASSERT(br->count > 0);
+    ASSERT(new_size > 0);
     if (br->count > 1)
     {
         log_error("dvz_buffer_regions_resize() currently only supports regions with buf count=1");
         return;
     }
     ASSERT(br->count == 1);
+    DvzBuffer* buffer = br->buffer;
+    DvzAlloc* alloc = &context->allocs[buffer->type];
 
-    // The region is the last allocated in the buffer, we can safely resize it.
-    VkDeviceSize old_size = br->aligned_size > 0 ? br->aligned_size : br->size;
+    VkDeviceSize old_size = _regions_size(br);
     ASSERT(old_size > 0);
-    if (br->offsets[0] + old_size == br->buffer->allocated_size)
+    VkDeviceSize alsize = br->alignment > 0 ? aligned_size(new_size, br->alignment) : new_size;
+
+    dvz_context_lock(context);
+
+    // Try to resize the region in-place, which works when shrinking it or when it is followed by
+    // enough free space.
+    if (dvz_alloc_resize(alloc, br->offsets[0], old_size, alsize))
     {
         log_debug("resize the buffer region in-place");
         br->size = new_size;
         if (br->alignment > 0)
-            br->aligned_size = aligned_size(new_size, br->alignment);
-        br->buffer->allocated_size = br->offsets[0] + new_size;
-
-        // Need to reallocate a new underlying buffer.
-        if (br->offsets[0] + old_size > br->buffer->size)
-        {
-            VkDeviceSize bs = dvz_next_pow2(br->offsets[0] + old_size);
-            log_info("reallocating buffer #%d to %s", br->buffer->type, pretty_size(bs));
-            dvz_buffer_resize(br->buffer, bs, &context->transfer_cmd);
-        }
+            br->aligned_size = alsize;
+        buffer->allocated_size = alloc->allocated;
+        ASSERT(br->offsets[0] + alsize <= buffer->size);
     }
 
-    // The region cannot be resized directly, need to make a new region allocation.
+    // The region cannot be resized directly, need to make a new region allocation and release
+    // the old one.
+    // NOTE: the data is not copied to the new region.
     else
     {
         log_debug("failed to resize the buffer region in-place, allocating a new region");
-        *br = dvz_ctx_buffers(context, br->buffer->type, 1, new_size);
+        DvzBufferRegions new_br = dvz_ctx_buffers(context, buffer->type, 1, new_size);
+        dvz_ctx_buffers_free(context, br);
+        *br = new_br;
     }
+
+    dvz_context_unlock(context);
+}
+
+
+
+DvzAllocStats dvz_ctx_buffers_stats(DvzContext* context, DvzBufferType buffer_type)
+{
+    ASSERT(context != NULL);
+    ASSERT(buffer_type < DVZ_BUFFER_TYPE_COUNT);
+    return dvz_alloc_stats(&context->allocs[buffer_type]);
 }
 
 
@@ -391,6 +898,63 @@ DvzCompute* dvz_ctx_compute(DvzContext* context, const char* shader_path)
 
 
 
+/*************************************************************************************************/
+/*  Shaders                                                                                      */
+/*************************************************************************************************/
+
+VkShaderModule dvz_ctx_shader(DvzContext* context, const char* name)
+{
+    ASSERT(context != NULL);
+    ASSERT(context->gpu != NULL);
+    ASSERT(name != NULL);
+    ASSERT(strlen(name) < sizeof(context->shader_names[0]));
+
+    VkShaderModule module = VK_NULL_HANDLE;
+    dvz_context_lock(context);
+
+    // Look for an existing shader module.
+    for (uint32_t i = 0; i < context->shader_count; i++)
+    {
+        if (strcmp(context->shader_names[i], name) == 0)
+        {
+            module = context->shader_modules[i];
+            break;
+        }
+    }
+
+    if (module == VK_NULL_HANDLE)
+    {
+        if (context->shader_count >= DVZ_MAX_SHADERS)
+        {
+            log_error("maximum number of shader modules reached");
+            dvz_context_unlock(context);
+            return VK_NULL_HANDLE;
+        }
+
+        log_trace("create shader module %s", name);
+        unsigned long size = 0;
+        const unsigned char* buffer = dvz_resource_shader(name, &size);
+        ASSERT(buffer != NULL);
+        ASSERT(size > 0);
+        ASSERT(size % 4 == 0);
+
+        // NOTE: the resource buffer may not be aligned on 4 bytes.
+        uint32_t* code = (uint32_t*)calloc(size, 1);
+        memcpy(code, buffer, size);
+        module = create_shader_module(context->gpu->device, size, code);
+        FREE(code);
+
+        uint32_t i = context->shader_count++;
+        strncpy(context->shader_names[i], name, sizeof(context->shader_names[i]) - 1);
+        context->shader_modules[i] = module;
+    }
+
+    dvz_context_unlock(context);
+    return module;
+}
+
+
+
 /*************************************************************************************************/
 /*  Texture                                                                                      */
 /*************************************************************************************************/
@@ -425,6 +989,7 @@ DvzTexture* dvz_ctx_texture(DvzContext* context, uint32_t dims, uvec3 size, VkFo
         "creating %dD texture with shape %dx%dx%d and format %d", //
         dims, size[0], size[1], size[2], format);
 
+    dvz_context_lock(context);
     DvzTexture* texture = dvz_container_alloc(&context->textures);
     DvzImages* image = dvz_container_alloc(&context->images);
     DvzSampler* sampler = dvz_container_alloc(&context->samplers);
@@ -480,6 +1045,7 @@ DvzTexture* dvz_ctx_texture(DvzContext* context, uint32_t dims, uvec3 size, VkFo
         dvz_cmd_end(cmds, 0);
         dvz_cmd_submit_sync(cmds, 0);
     }
+    dvz_context_unlock(context);
 
     return texture;
 }
@@ -542,14 +1108,11 @@ void dvz_texture_upload(
     ASSERT(size > 0);
     ASSERT(data != NULL);
 
-    // Take the staging buffer.
-    DvzBuffer* staging = staging_buffer(context, size);
-
-    // Memcpy into the staging buffer.
-    dvz_buffer_upload(staging, 0, size, data);
+    // Stream the data to the texture through the staging buffer.
+    _upload_texture_staging(context, texture, offset, shape, size, 0, 0, data);
 
-    // Copy from the staging buffer to the texture.
-    _copy_texture_from_staging(context, texture, offset, shape, size);
+    // Wait for the upload to complete.
+    dvz_staging_wait(context);
 }
 
 
@@ -563,14 +1126,8 @@ void dvz_texture_download(
     ASSERT(size > 0);
     ASSERT(data != NULL);
 
-    // Take the staging buffer.
-    DvzBuffer* staging = staging_buffer(context, size);
-
-    // Copy from the staging buffer to the texture.
-    _copy_texture_to_staging(context, texture, offset, shape, size);
-
-    // Memcpy into the staging buffer.
-    dvz_buffer_download(staging, 0, size, data);
+    // Stream the data from the texture through the staging buffer.
+    _download_texture_staging(context, texture, offset, shape, size, data);
 }
 
 
@@ -585,6 +1142,7 @@ void dvz_texture_copy(
     ASSERT(context != NULL);
 
     // Take transfer cmd buf.
+    dvz_context_lock(context);
     DvzCommands* cmds = &context->transfer_cmd;
     dvz_cmd_reset(cmds, 0);
     dvz_cmd_begin(cmds, 0);
@@ -666,6 +1224,7 @@ void dvz_texture_copy(
 
     // Wait for the transfer queue to be idle.
     dvz_queue_wait(gpu, DVZ_DEFAULT_QUEUE_TRANSFER);
+    dvz_context_unlock(context);
 }
 
 
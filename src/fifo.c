@@ -3,127 +3,250 @@
 
 
 /*************************************************************************************************/
-/*  Thread-safe FIFO queue                                                                       */
+/*  Utils                                                                                        */
 /*************************************************************************************************/
 
-DvzFifo dvz_fifo(int32_t capacity)
+static DvzFifoSlot* _fifo_slots(uint32_t capacity)
 {
-    log_trace("creating generic FIFO queue with a capacity of %d items", capacity);
     ASSERT(capacity >= 2);
-    DvzFifo fifo = {0};
-    ASSERT(capacity <= DVZ_MAX_FIFO_CAPACITY);
-    fifo.capacity = capacity;
-    fifo.is_empty = true;
-    fifo.items = calloc((uint32_t)capacity, sizeof(void*));
+    ASSERT((capacity & (capacity - 1)) == 0);
+    DvzFifoSlot* slots = (DvzFifoSlot*)calloc(capacity, sizeof(DvzFifoSlot));
+    for (uint32_t i = 0; i < capacity; i++)
+        atomic_init(&slots[i].seq, i);
+    return slots;
+}
 
-    if (pthread_mutex_init(&fifo.lock, NULL) != 0)
-        log_error("mutex creation failed");
-    if (pthread_cond_init(&fifo.cond, NULL) != 0)
-        log_error("cond creation failed");
 
-    return fifo;
+
+// Register the calling thread as a user of the ring, waiting if the ring is being enlarged.
+static void _fifo_enter(DvzFifo* fifo)
+{
+    while (true)
+    {
+        atomic_fetch_add(&fifo->users, 1);
+        if (!atomic_load(&fifo->resizing))
+            return;
+        atomic_fetch_sub(&fifo->users, 1);
+        while (atomic_load(&fifo->resizing))
+            sched_yield();
+    }
 }
 
 
 
-void dvz_fifo_enqueue(DvzFifo* fifo, void* item)
+static void _fifo_leave(DvzFifo* fifo) { atomic_fetch_sub(&fifo->users, 1); }
+
+
+
+// Try to enqueue an item, return false if the ring is full.
+static bool _fifo_push(DvzFifo* fifo, void* item)
 {
-    ASSERT(fifo != NULL);
-    pthread_mutex_lock(&fifo->lock);
+    uint64_t mask = (uint64_t)atomic_load_explicit(&fifo->capacity, memory_order_relaxed) - 1;
+    uint64_t pos = atomic_load_explicit(&fifo->head, memory_order_relaxed);
+    DvzFifoSlot* slot = NULL;
+    while (true)
+    {
+        slot = &fifo->slots[pos & mask];
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int64_t diff = (int64_t)seq - (int64_t)pos;
+        if (diff == 0)
+        {
+            // The slot is free: try to claim it. On failure, pos is updated to the new head.
+            if (atomic_compare_exchange_weak_explicit(
+                    &fifo->head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // The slot still holds an item from the previous lap: the ring is full.
+            return false;
+        }
+        else
+        {
+            // Another producer claimed the slot first.
+            pos = atomic_load_explicit(&fifo->head, memory_order_relaxed);
+        }
+    }
+
+    slot->item = item;
+    // Publish the item to the consumers.
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    return true;
+}
 
-    // Old size
-    int size = fifo->head - fifo->tail;
-    if (size < 0)
-        size += fifo->capacity;
 
-    // Old capacity
-    int old_cap = fifo->capacity;
 
-    // Resize if queue is full.
-    if ((fifo->head + 1) % fifo->capacity == fifo->tail)
+// Try to dequeue an item, return false if the ring is empty.
+static bool _fifo_pop(DvzFifo* fifo, void** item)
+{
+    uint64_t mask = (uint64_t)atomic_load_explicit(&fifo->capacity, memory_order_relaxed) - 1;
+    uint64_t pos = atomic_load_explicit(&fifo->tail, memory_order_relaxed);
+    DvzFifoSlot* slot = NULL;
+    while (true)
     {
-        ASSERT(fifo->items != NULL);
-        ASSERT(size == fifo->capacity - 1);
+        slot = &fifo->slots[pos & mask];
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int64_t diff = (int64_t)seq - (int64_t)(pos + 1);
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(
+                    &fifo->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // The slot has not been published yet: the ring is empty.
+            return false;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&fifo->tail, memory_order_relaxed);
+        }
+    }
+
+    *item = slot->item;
+    // Hand the slot back to the producers, for the next lap.
+    atomic_store_explicit(&slot->seq, pos + mask + 1, memory_order_release);
+    return true;
+}
 
-        // NOTE: we hard-code the maximum size of FIFO queues for now as the canvas has an array of
-        // fixed size for the event objects stored in the FIFO queue.
-        // TODO: fix this by making the canvas event array enlargeable.
-        ASSERT(fifo->capacity <= DVZ_MAX_FIFO_CAPACITY);
 
-        fifo->capacity *= 2;
-        log_debug("FIFO queue is full, enlarging it to %d", fifo->capacity);
-        REALLOC(fifo->items, (uint32_t)fifo->capacity * sizeof(void*));
+
+// Double the capacity of a full ring. Must be called between _fifo_enter() and _fifo_leave().
+static void _fifo_grow(DvzFifo* fifo, int32_t old_capacity)
+{
+    bool expected = false;
+    if (!atomic_compare_exchange_strong(&fifo->resizing, &expected, true))
+    {
+        // Another thread is enlarging the ring: wait for it.
+        _fifo_leave(fifo);
+        _fifo_enter(fifo);
+        return;
     }
 
-    if ((fifo->head + 1) % fifo->capacity == fifo->tail)
+    // Wait until the other threads have left the ring.
+    while (atomic_load(&fifo->users) > 1)
+        sched_yield();
+
+    // The ring may have been enlarged in the meantime.
+    if (atomic_load(&fifo->capacity) == old_capacity)
     {
-        // Here, the queue buffer has been resized, but the new space should be used instead of the
-        // part of the buffer before the tail.
+        uint64_t tail = atomic_load(&fifo->tail);
+        uint64_t head = atomic_load(&fifo->head);
+        uint64_t mask = (uint64_t)old_capacity - 1;
+        uint32_t capacity = 2 * (uint32_t)old_capacity;
+        log_debug("FIFO queue is full, enlarging it to %d", capacity);
+
+        // Move the items to the beginning of a larger ring.
+        DvzFifoSlot* slots = _fifo_slots(capacity);
+        uint32_t size = (uint32_t)(head - tail);
+        for (uint32_t i = 0; i < size; i++)
+        {
+            slots[i].item = fifo->slots[(tail + i) & mask].item;
+            atomic_store(&slots[i].seq, i + 1);
+        }
+        FREE(fifo->slots);
+        fifo->slots = slots;
+        // NOTE: move the head first so that dvz_fifo_size() never sees a negative size.
+        atomic_store(&fifo->head, size);
+        atomic_store(&fifo->tail, 0);
+        atomic_store(&fifo->capacity, (int32_t)capacity);
+    }
 
-        ASSERT(fifo->head > 0);
-        ASSERT(old_cap < fifo->capacity);
-        memcpy(&fifo->items[old_cap], &fifo->items[0], (uint32_t)fifo->head * sizeof(void*));
+    atomic_store(&fifo->resizing, false);
+}
 
-        // Move the head to the new position.
-        fifo->head += old_cap;
 
-        // Check new size.
-        ASSERT(fifo->head - fifo->tail > 0);
-        ASSERT(fifo->head - fifo->tail == size);
-    }
-    ASSERT((fifo->head + 1) % fifo->capacity != fifo->tail);
-    fifo->items[fifo->head] = item;
-    fifo->head++;
-    if (fifo->head >= fifo->capacity)
-        fifo->head -= fifo->capacity;
-    fifo->is_empty = false;
 
-    ASSERT(0 <= fifo->head && fifo->head < fifo->capacity);
-    pthread_cond_signal(&fifo->cond);
-    pthread_mutex_unlock(&fifo->lock);
+/*************************************************************************************************/
+/*  Thread-safe FIFO queue                                                                       */
+/*************************************************************************************************/
+
+DvzFifo dvz_fifo(int32_t capacity)
+{
+    log_trace("creating generic FIFO queue with a capacity of %d items", capacity);
+    ASSERT(capacity >= 2);
+    DvzFifo fifo = {0};
+    capacity = (int32_t)dvz_next_pow2((uint64_t)capacity);
+    atomic_init(&fifo.capacity, capacity);
+    fifo.slots = _fifo_slots((uint32_t)capacity);
+    atomic_init(&fifo.head, 0);
+    atomic_init(&fifo.tail, 0);
+    atomic_init(&fifo.users, 0);
+    atomic_init(&fifo.resizing, false);
+    atomic_init(&fifo.waiters, 0);
+    atomic_init(&fifo.is_empty, true);
+
+    if (pthread_mutex_init(&fifo.lock, NULL) != 0)
+        log_error("mutex creation failed");
+    if (pthread_cond_init(&fifo.cond, NULL) != 0)
+        log_error("cond creation failed");
+
+    return fifo;
 }
 
 
 
-void* dvz_fifo_dequeue(DvzFifo* fifo, bool wait)
+void dvz_fifo_enqueue(DvzFifo* fifo, void* item)
 {
     ASSERT(fifo != NULL);
-    pthread_mutex_lock(&fifo->lock);
 
-    // Wait until the queue is not empty.
-    if (wait)
+    _fifo_enter(fifo);
+    int32_t capacity = atomic_load(&fifo->capacity);
+    while (!_fifo_push(fifo, item))
     {
-        log_trace("waiting for the queue to be non-empty");
-        while (fifo->head == fifo->tail)
-            pthread_cond_wait(&fifo->cond, &fifo->lock);
+        _fifo_grow(fifo, capacity);
+        capacity = atomic_load(&fifo->capacity);
     }
+    _fifo_leave(fifo);
+    fifo->is_empty = false;
 
-    // Empty queue.
-    if (fifo->head == fifo->tail)
+    // Wake up the consumers sleeping on an empty queue, if any. The fence pairs with the one in
+    // dvz_fifo_dequeue(): either the consumer sees the new item, or we see the consumer.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&fifo->waiters, memory_order_relaxed) > 0)
     {
-        // log_trace("FIFO queue was empty");
-        // Don't forget to unlock the mutex before exiting this function.
+        pthread_mutex_lock(&fifo->lock);
+        pthread_cond_signal(&fifo->cond);
         pthread_mutex_unlock(&fifo->lock);
-        fifo->is_empty = true;
-        return NULL;
     }
+}
 
-    ASSERT(0 <= fifo->tail && fifo->tail < fifo->capacity);
 
-    // log_trace("dequeue item, head %d, tail %d", fifo->head, fifo->tail);
-    void* item = fifo->items[fifo->tail];
 
-    fifo->tail++;
-    if (fifo->tail >= fifo->capacity)
-        fifo->tail -= fifo->capacity;
+void* dvz_fifo_dequeue(DvzFifo* fifo, bool wait)
+{
+    ASSERT(fifo != NULL);
+    void* item = NULL;
+    bool ok = false;
 
-    ASSERT(0 <= fifo->tail && fifo->tail < fifo->capacity);
-    pthread_mutex_unlock(&fifo->lock);
+    _fifo_enter(fifo);
+    ok = _fifo_pop(fifo, &item);
+    _fifo_leave(fifo);
 
-    if (fifo->head == fifo->tail)
-        fifo->is_empty = true;
+    // Only sleep when the queue is empty.
+    if (!ok && wait)
+    {
+        log_trace("waiting for the queue to be non-empty");
+        pthread_mutex_lock(&fifo->lock);
+        atomic_fetch_add(&fifo->waiters, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        while (true)
+        {
+            _fifo_enter(fifo);
+            ok = _fifo_pop(fifo, &item);
+            _fifo_leave(fifo);
+            if (ok)
+                break;
+            pthread_cond_wait(&fifo->cond, &fifo->lock);
+        }
+        atomic_fetch_sub(&fifo->waiters, 1);
+        pthread_mutex_unlock(&fifo->lock);
+    }
 
-    return item;
+    if (dvz_fifo_size(fifo) == 0)
+        fifo->is_empty = true;
+    return ok ? item : NULL;
 }
 
 
@@ -131,14 +254,10 @@ void* dvz_fifo_dequeue(DvzFifo* fifo, bool wait)
 int dvz_fifo_size(DvzFifo* fifo)
 {
     ASSERT(fifo != NULL);
-    pthread_mutex_lock(&fifo->lock);
-    // log_debug("head %d tail %d", fifo->head, fifo->tail);
-    int size = fifo->head - fifo->tail;
-    if (size < 0)
-        size += fifo->capacity;
-    ASSERT(0 <= size && size <= fifo->capacity);
-    pthread_mutex_unlock(&fifo->lock);
-    return size;
+    uint64_t tail = atomic_load(&fifo->tail);
+    uint64_t head = atomic_load(&fifo->head);
+    // NOTE: the size is only indicative when other threads use the queue.
+    return head > tail ? (int)MIN(head - tail, (uint64_t)fifo->capacity) : 0;
 }
 
 
@@ -148,20 +267,14 @@ void dvz_fifo_discard(DvzFifo* fifo, int max_size)
     ASSERT(fifo != NULL);
     if (max_size == 0)
         return;
-    pthread_mutex_lock(&fifo->lock);
-    int size = fifo->head - fifo->tail;
-    if (size < 0)
-        size += fifo->capacity;
-    ASSERT(0 <= size && size <= fifo->capacity);
+    int size = dvz_fifo_size(fifo);
     if (size > max_size)
     {
         log_trace(
             "discarding %d items in the FIFO queue which is getting overloaded", size - max_size);
-        fifo->tail = fifo->head - max_size;
-        if (fifo->tail < 0)
-            fifo->tail += fifo->capacity;
+        for (int i = 0; i < size - max_size; i++)
+            dvz_fifo_dequeue(fifo, false);
     }
-    pthread_mutex_unlock(&fifo->lock);
 }
 
 
@@ -169,11 +282,9 @@ void dvz_fifo_discard(DvzFifo* fifo, int max_size)
 void dvz_fifo_reset(DvzFifo* fifo)
 {
     ASSERT(fifo != NULL);
-    pthread_mutex_lock(&fifo->lock);
-    fifo->head = 0;
-    fifo->tail = 0;
-    pthread_cond_signal(&fifo->cond);
-    pthread_mutex_unlock(&fifo->lock);
+    int size = dvz_fifo_size(fifo);
+    for (int i = 0; i < size; i++)
+        dvz_fifo_dequeue(fifo, false);
 }
 
 
@@ -184,6 +295,6 @@ void dvz_fifo_destroy(DvzFifo* fifo)
     pthread_mutex_destroy(&fifo->lock);
     pthread_cond_destroy(&fifo->cond);
 
-    ASSERT(fifo->items != NULL);
-    FREE(fifo->items);
+    ASSERT(fifo->slots != NULL);
+    FREE(fifo->slots);
 }
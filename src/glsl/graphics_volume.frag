@@ -2,8 +2,10 @@
 #include "common.glsl"
 #include "colormaps.glsl"
 
-#define STEP_SIZE 0.005
-#define MAX_ITER 10 / STEP_SIZE
+// Specialization constants, see DvzSpecializationConstant.
+layout(constant_id = 3) const float STEP_SIZE = 0.005;
+layout(constant_id = 4) const int MAX_ITER = 2000;
+layout(constant_id = 5) const int DVZ_SPEC_VOLUME_COLORMAP = -1;
 
 layout(std140, binding = USER_BINDING) uniform Params
 {
@@ -42,7 +44,8 @@ vec4 fetch_color(vec3 uvw) {
     float v = texture(tex, uvw).r;
 
     // Color component: colormap.
-    vec4 color = colormap(params.cmap, v);
+    int cmap = DVZ_SPEC_VOLUME_COLORMAP >= 0 ? DVZ_SPEC_VOLUME_COLORMAP : params.cmap;
+    vec4 color = colormap(cmap, v);
     // vec4 color = texture(tex_cmap, vec2(v, (params.cmap + .5) / 256.0));
 
     // Alpha value: value.
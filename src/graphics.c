@@ -15,26 +15,10 @@
 /*  Utils                                                                                       */
 /*************************************************************************************************/
 
-static inline void _load_shader(
-    DvzGraphics* graphics, VkShaderStageFlagBits stage, //
-    VkDeviceSize size, const unsigned char* buffer)
-{
-    ASSERT(buffer != NULL);
-    uint32_t* code = (uint32_t*)calloc(size, 1);
-    memcpy(code, buffer, size);
-    ASSERT(size % 4 == 0);
-    dvz_graphics_shader_spirv(graphics, stage, size, code);
-    FREE(code);
-}
-
+// Builtin shader modules are shared by all graphics pipelines of the context.
 #define SHADER(stage, x)                                                                          \
-    {                                                                                             \
-        unsigned long size = 0;                                                                   \
-        const unsigned char* buffer = dvz_resource_shader(x, &size);                              \
-        ASSERT(size > 0);                                                                         \
-        ASSERT(buffer != NULL);                                                                   \
-        _load_shader(graphics, VK_SHADER_STAGE_##stage##_BIT, size, buffer);                      \
-    }
+    dvz_graphics_shader_module(                                                                   \
+        graphics, VK_SHADER_STAGE_##stage##_BIT, dvz_ctx_shader(canvas->gpu->context, x));
 
 #define PRIMITIVE(x)                                                                              \
     dvz_graphics_renderpass(graphics, &canvas->renderpass, 0);                                    \
@@ -42,7 +26,8 @@ static inline void _load_shader(
     dvz_graphics_polygon_mode(graphics, VK_POLYGON_MODE_FILL);
 
 
-#define CREATE dvz_graphics_create(graphics);
+// The pipelines are compiled in parallel just before the first refill, see dvz_canvas_pipelines().
+#define CREATE dvz_graphics_create_deferred(graphics);
 
 #define ATTR_BEGIN(t)                                                                             \
     dvz_graphics_vertex_binding(graphics, 0, sizeof(t));                                          \
@@ -718,17 +703,20 @@ void dvz_graphics_append(DvzGraphicsData* data, const void* item)
 /*  Graphics builtin                                                                             */
 /*************************************************************************************************/
 
-static DvzGraphics* _find_graphics(DvzCanvas* canvas, DvzGraphicsType type, int flags)
+static DvzGraphics* _find_graphics(
+    DvzCanvas* canvas, DvzGraphicsType type, int flags, const DvzSpecialization* spec)
 {
     ASSERT(canvas != NULL);
     ASSERT(type != DVZ_GRAPHICS_CUSTOM);
+    ASSERT(spec != NULL);
 
     DvzContainerIterator iter = dvz_container_iterator(&canvas->graphics);
     DvzGraphics* graphics = NULL;
-    if (iter.item != NULL)
+    while (iter.item != NULL)
     {
         graphics = iter.item;
-        if (graphics->type == type && graphics->flags == flags)
+        if (graphics->type == type && graphics->flags == flags &&
+            memcmp(&graphics->specialization, spec, sizeof(DvzSpecialization)) == 0)
             return graphics;
         dvz_container_iter(&iter);
     }
@@ -738,14 +726,32 @@ static DvzGraphics* _find_graphics(DvzCanvas* canvas, DvzGraphicsType type, int
 
 
 DvzGraphics* dvz_graphics_builtin(DvzCanvas* canvas, DvzGraphicsType type, int flags)
+{
+    return dvz_graphics_builtin_specialized(canvas, type, flags, NULL);
+}
+
+
+
+DvzGraphics* dvz_graphics_builtin_specialized(
+    DvzCanvas* canvas, DvzGraphicsType type, int flags, const DvzSpecialization* specialization)
 {
     ASSERT(canvas != NULL);
     ASSERT(canvas->gpu != NULL);
     ASSERT(type != DVZ_GRAPHICS_NONE);
     ASSERT(canvas->graphics.capacity > 0);
 
-    // Try to find an existing graphics with the requested type and flags.
-    DvzGraphics* graphics = _find_graphics(canvas, type, flags);
+    // NOTE: the unused constants are zeroed so that the specializations can be compared.
+    DvzSpecialization spec = {0};
+    if (specialization != NULL)
+    {
+        ASSERT(specialization->count <= DVZ_MAX_SPECIALIZATION_CONSTANTS);
+        spec.count = specialization->count;
+        memcpy(spec.ids, specialization->ids, spec.count * sizeof(uint32_t));
+        memcpy(spec.values, specialization->values, spec.count * sizeof(uint32_t));
+    }
+
+    // Try to find an existing graphics with the requested type, flags, and specialization.
+    DvzGraphics* graphics = _find_graphics(canvas, type, flags, &spec);
     if (graphics != NULL)
         return graphics;
 
@@ -756,6 +762,7 @@ DvzGraphics* dvz_graphics_builtin(DvzCanvas* canvas, DvzGraphicsType type, int f
     *graphics = dvz_graphics(canvas->gpu);
     graphics->type = type;
     graphics->flags = flags;
+    graphics->specialization = spec;
 
     switch (type)
     {
@@ -58,7 +58,7 @@ static void _imgui_enable(DvzCanvas* canvas)
     init_info.QueueFamily = gpu->queues.queue_families[DVZ_DEFAULT_QUEUE_RENDER];
     init_info.Queue = gpu->queues.queues[DVZ_DEFAULT_QUEUE_RENDER];
     init_info.DescriptorPool = gpu->dset_pool;
-    // init_info.PipelineCache = gpu->pipeline_cache;
+    init_info.PipelineCache = gpu->pipeline_cache;
     // init_info.Allocator = gpu->allocator;
     init_info.MinImageCount = canvas->swapchain.img_count;
     init_info.ImageCount = canvas->swapchain.img_count;
@@ -253,6 +253,12 @@ void dvz_gui_callback_fps(DvzCanvas* canvas, DvzEvent ev)
     ASSERT(canvas != NULL);
     dvz_gui_begin("FPS", DVZ_GUI_FLAGS_FIXED | DVZ_GUI_FLAGS_CORNER_UR);
     ImGui::Text("FPS: %.1f", canvas->fps);
+    if (canvas->profile.enabled)
+    {
+        DvzCanvasStats stats = dvz_canvas_stats(canvas);
+        ImGui::Text("GPU: %.2f ms", stats.gpu_frame);
+        ImGui::Text("Transfers: %.2f ms", stats.gpu_transfers);
+    }
     dvz_gui_end();
 }
 
@@ -0,0 +1,200 @@
+#include "../include/datoviz/profile.h"
+
+
+
+/*************************************************************************************************/
+/*  Utils                                                                                        */
+/*************************************************************************************************/
+
+#if MSVC
+#define DVZ_THREAD_LOCAL __declspec(thread)
+#else
+#define DVZ_THREAD_LOCAL _Thread_local
+#endif
+
+typedef struct DvzProfileEvent DvzProfileEvent;
+
+// A recorded scope, kept for the Chrome trace.
+struct DvzProfileEvent
+{
+    uint64_t begin, end; // in nanoseconds
+    DvzProfilePhase phase;
+    uint32_t thread;
+};
+
+// Names of the phases, in the order of DvzProfilePhase.
+static const char* _PROFILE_NAMES[] = {
+    "interact",      //
+    "frame",         //
+    "timer",         //
+    "transfers",     //
+    "refill",        //
+    "fence_wait",    //
+    "acquire",       //
+    "submit",        //
+    "visual_update", //
+    "bake",          //
+};
+
+// Most recent durations of each phase, in nanoseconds.
+static uint64_t _samples[DVZ_PROFILE_COUNT][DVZ_PROFILE_WINDOW];
+static atomic(uint64_t, _sample_count[DVZ_PROFILE_COUNT]);
+
+// Most recent scopes of all phases.
+static DvzProfileEvent _events[DVZ_PROFILE_MAX_EVENTS];
+static atomic(uint64_t, _event_count);
+
+// Small identifiers of the threads, for the Chrome trace.
+static atomic(uint32_t, _thread_count);
+static DVZ_THREAD_LOCAL uint32_t _thread_id;
+
+
+
+static uint32_t _profile_thread(void)
+{
+    if (_thread_id == 0)
+        _thread_id = atomic_fetch_add(&_thread_count, 1) + 1;
+    return _thread_id;
+}
+
+
+
+static int _compare_u64(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+
+
+static double _percentile(const uint64_t* sorted, uint32_t n, double q)
+{
+    ASSERT(n > 0);
+    uint32_t k = (uint32_t)ceil(q * n);
+    k = CLIP(k, 1, n);
+    return sorted[k - 1] * 1e-6;
+}
+
+
+
+/*************************************************************************************************/
+/*  Profiling                                                                                    */
+/*************************************************************************************************/
+
+uint64_t dvz_profile_now(void)
+{
+#if OS_WIN32
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+
+
+void dvz_profile_record(DvzProfilePhase phase, uint64_t begin, uint64_t end)
+{
+    ASSERT(phase < DVZ_PROFILE_COUNT);
+    ASSERT(end >= begin);
+
+    uint64_t i = atomic_fetch_add(&_sample_count[phase], 1);
+    _samples[phase][i % DVZ_PROFILE_WINDOW] = end - begin;
+
+    // NOTE: a slot may be overwritten while the trace is being written, which only affects
+    // the scopes that were about to be discarded anyway.
+    uint64_t j = atomic_fetch_add(&_event_count, 1);
+    DvzProfileEvent* ev = &_events[j % DVZ_PROFILE_MAX_EVENTS];
+    ev->begin = begin;
+    ev->end = end;
+    ev->phase = phase;
+    ev->thread = _profile_thread();
+}
+
+
+
+DvzProfileStats dvz_profile_stats(DvzProfilePhase phase)
+{
+    ASSERT(phase < DVZ_PROFILE_COUNT);
+    DvzProfileStats stats = {0};
+
+    uint64_t count = atomic_load(&_sample_count[phase]);
+    if (count == 0)
+        return stats;
+    stats.count = count;
+    stats.last = _samples[phase][(count - 1) % DVZ_PROFILE_WINDOW] * 1e-6;
+
+    // Sort a copy of the window, the recording threads are never blocked.
+    uint32_t n = (uint32_t)MIN(count, DVZ_PROFILE_WINDOW);
+    uint64_t* sorted = (uint64_t*)calloc(n, sizeof(uint64_t));
+    memcpy(sorted, _samples[phase], n * sizeof(uint64_t));
+    qsort(sorted, n, sizeof(uint64_t), _compare_u64);
+
+    stats.p50 = _percentile(sorted, n, .50);
+    stats.p95 = _percentile(sorted, n, .95);
+    stats.p99 = _percentile(sorted, n, .99);
+    stats.max = sorted[n - 1] * 1e-6;
+    FREE(sorted);
+    return stats;
+}
+
+
+
+const char* dvz_profile_name(DvzProfilePhase phase)
+{
+    ASSERT(phase < DVZ_PROFILE_COUNT);
+    return _PROFILE_NAMES[phase];
+}
+
+
+
+int dvz_profile_trace(const char* path)
+{
+    ASSERT(path != NULL);
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL)
+    {
+        log_error("unable to write the trace to %s", path);
+        return 1;
+    }
+
+    uint64_t count = atomic_load(&_event_count);
+    uint64_t first = count > DVZ_PROFILE_MAX_EVENTS ? count - DVZ_PROFILE_MAX_EVENTS : 0;
+
+    // The trace timestamps are relative to the oldest scope, in microseconds.
+    uint64_t origin = UINT64_MAX;
+    for (uint64_t i = first; i < count; i++)
+        origin = MIN(origin, _events[i % DVZ_PROFILE_MAX_EVENTS].begin);
+
+    fprintf(fp, "{\"traceEvents\":[");
+    DvzProfileEvent* ev = NULL;
+    for (uint64_t i = first; i < count; i++)
+    {
+        ev = &_events[i % DVZ_PROFILE_MAX_EVENTS];
+        fprintf(
+            fp,
+            "%s\n{\"name\":\"%s\",\"cat\":\"datoviz\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+            "\"pid\":1,\"tid\":%u}",
+            i > first ? "," : "", _PROFILE_NAMES[ev->phase], (ev->begin - origin) * 1e-3,
+            (ev->end - ev->begin) * 1e-3, ev->thread);
+    }
+    fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(fp);
+
+    log_debug("wrote %d profiling scopes to %s", (int)(count - first), path);
+    return 0;
+}
+
+
+
+void dvz_profile_reset(void)
+{
+    for (uint32_t i = 0; i < DVZ_PROFILE_COUNT; i++)
+        atomic_store(&_sample_count[i], 0);
+    atomic_store(&_event_count, 0);
+}
@@ -34,6 +34,10 @@ DvzScene* dvz_scene(DvzCanvas* canvas, uint32_t n_rows, uint32_t n_cols)
     // Scene update FIFO queue.
     canvas->scene->update_fifo = dvz_fifo(DVZ_MAX_FIFO_CAPACITY);
 
+    // Bake worker queues, the workers are started by dvz_scene_workers().
+    canvas->scene->bake_jobs = dvz_fifo(DVZ_MAX_FIFO_CAPACITY);
+    canvas->scene->bake_done = dvz_fifo(DVZ_MAX_FIFO_CAPACITY);
+
     // INIT callback
     dvz_event_callback(canvas, DVZ_EVENT_INIT, 0, DVZ_EVENT_MODE_SYNC, _scene_init, canvas->scene);
 
@@ -64,6 +68,30 @@ DvzScene* dvz_scene(DvzCanvas* canvas, uint32_t n_rows, uint32_t n_cols)
 
 
 
+void dvz_scene_workers(DvzScene* scene, uint32_t count)
+{
+    ASSERT(scene != NULL);
+    ASSERT(count <= DVZ_MAX_BAKE_WORKERS);
+    // A single worker would not bake the visuals in parallel.
+    if (count == 1)
+        count = 0;
+    if (count == scene->bake_workers_count)
+        return;
+
+    // Stop the current workers.
+    for (uint32_t i = 0; i < scene->bake_workers_count; i++)
+        dvz_fifo_enqueue(&scene->bake_jobs, NULL);
+    for (uint32_t i = 0; i < scene->bake_workers_count; i++)
+        dvz_thread_join(&scene->bake_workers[i]);
+
+    log_debug("starting %d bake workers", count);
+    for (uint32_t i = 0; i < count; i++)
+        scene->bake_workers[i] = dvz_thread(_bake_worker, scene);
+    scene->bake_workers_count = count;
+}
+
+
+
 /*************************************************************************************************/
 /*  Controller                                                                                   */
 /*************************************************************************************************/
@@ -429,7 +457,14 @@ void dvz_scene_destroy(DvzScene* scene)
 
     dvz_fifo_destroy(&scene->update_fifo);
 
+    // Stop the bake workers.
+    dvz_scene_workers(scene, 0);
+    dvz_fifo_destroy(&scene->bake_jobs);
+    dvz_fifo_destroy(&scene->bake_done);
+
     dvz_container_destroy(&scene->visuals);
     dvz_obj_destroyed(&scene->obj);
+    if (scene->canvas != NULL && scene->canvas->scene == scene)
+        scene->canvas->scene = NULL;
     FREE(scene);
 }
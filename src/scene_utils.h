@@ -144,9 +144,43 @@ static void _transform_pos_prop(DvzDataCoords coords, DvzProp* prop)
         return;
     }
 
+    // Single-precision POS props are normalized when they are copied to their source.
+    if (arr->dtype == DVZ_DTYPE_VEC3 || arr->dtype == DVZ_DTYPE_VEC2)
+    {
+        log_trace("deferring the normalization of a single-precision POS prop to the baking");
+        prop->normalize = true;
+        prop->coords = coords;
+        return;
+    }
+
+    // Only transform the items that have changed if the transformed array is up to date
+    // otherwise.
+    if (!prop->dirty.full && arr_tr->data != NULL && arr_tr->dtype == arr->dtype &&
+        arr_tr->item_count > 0 && arr_tr->item_count <= arr->item_count)
+    {
+        log_trace(
+            "normalizing POS prop, %d/%d items", _dirty_size(&prop->dirty, arr->item_count),
+            arr->item_count);
+        dvz_array_resize(arr_tr, arr->item_count);
+        DvzArray sub = {0};
+        DvzArray sub_tr = {0};
+        for (uint32_t k = 0; k < prop->dirty.count; k++)
+        {
+            uint32_t first = prop->dirty.first[k];
+            uint32_t last = MIN(prop->dirty.last[k], arr->item_count);
+            if (first >= last)
+                continue;
+            sub = dvz_array_wrap(last - first, arr->dtype, dvz_array_item(arr, first));
+            sub_tr = dvz_array_wrap(last - first, arr->dtype, dvz_array_item(arr_tr, first));
+            dvz_transform_pos(coords, &sub, &sub_tr, false);
+        }
+        return;
+    }
+
     // Create the transformed prop array.
     log_trace("normalizing POS prop, %d items", arr->item_count);
     // _box_print(coords.box);
+    dvz_array_destroy(arr_tr);
     *arr_tr = dvz_array(arr->item_count, arr->dtype);
     dvz_transform_pos(coords, arr, arr_tr, false);
 }
@@ -477,6 +511,8 @@ static void _process_coords_changed(DvzSceneUpdate up)
             // Transform all POS props with the panel data coordinates.
             if (prop->prop_type == DVZ_PROP_POS)
             {
+                // All items need to be transformed again.
+                _dirty_full(&prop->dirty);
                 _enqueue_prop_changed(panel, visual, prop);
             }
 
@@ -549,8 +585,9 @@ static void _process_visual_changed(DvzSceneUpdate up)
     dvz_visual_update(visual, panel->viewport, panel->data_coords, NULL);
 
     // Detect whether the number of vertices/indices has changed, in which case a command buffer
-    // refill will be needed.
-    if (_has_item_count_changed(visual))
+    // refill will be needed, unless the visual draws with indirect draw parameters which have
+    // just been uploaded by dvz_visual_update().
+    if (_has_item_count_changed(visual) && !visual->draw_indirect)
     {
         _enqueue_item_count_changed(panel, visual);
     }
@@ -570,8 +607,11 @@ static void _process_visual_changed(DvzSceneUpdate up)
 static void _process_visibility_changed(DvzSceneUpdate up)
 {
     ASSERT(up.canvas != NULL);
-    // Refill command buffer.
-    dvz_canvas_to_refill(up.canvas);
+    // Refill command buffer, only the visual's command buffers need to be recorded again.
+    if (up.visual != NULL)
+        dvz_visual_to_refill(up.visual);
+    else
+        dvz_canvas_to_refill(up.canvas);
 }
 
 
@@ -580,8 +620,11 @@ static void _process_visibility_changed(DvzSceneUpdate up)
 static void _process_item_count_changed(DvzSceneUpdate up)
 {
     ASSERT(up.canvas != NULL);
-    // Refill command buffer.
-    dvz_canvas_to_refill(up.canvas);
+    // Refill command buffer, only the visual's command buffers need to be recorded again.
+    if (up.visual != NULL)
+        dvz_visual_to_refill(up.visual);
+    else
+        dvz_canvas_to_refill(up.canvas);
 }
 
 
@@ -792,12 +835,65 @@ static DvzSceneUpdate _scene_update_dequeue(DvzScene* scene)
 
 
 
+static void* _bake_worker(void* p_scene)
+{
+    DvzScene* scene = (DvzScene*)p_scene;
+    ASSERT(scene != NULL);
+    DvzSceneUpdate* up = NULL;
+    // A NULL update stops the worker.
+    while ((up = (DvzSceneUpdate*)dvz_fifo_dequeue(&scene->bake_jobs, true)) != NULL)
+    {
+        ASSERT(up->visual != NULL);
+        ASSERT(up->panel != NULL);
+        dvz_visual_bake(up->visual, up->panel->viewport, up->panel->data_coords, NULL);
+        dvz_fifo_enqueue(&scene->bake_done, up);
+    }
+    log_trace("stopping bake worker");
+    return NULL;
+}
+
+
+
+// Bake the visuals of the VISUAL_CHANGED updates on the bake workers, and wait until they have
+// all been baked. Without workers, the visuals are baked by dvz_visual_update().
+static void _bake_jobs_run(DvzScene* scene, DvzSceneUpdate* ups, uint32_t count)
+{
+    ASSERT(scene != NULL);
+    if (scene->bake_workers_count == 0 || count <= 1)
+        return;
+    ASSERT(ups != NULL);
+
+    log_trace("bake %d visuals on %d workers", count, scene->bake_workers_count);
+    for (uint32_t i = 0; i < count; i++)
+        dvz_fifo_enqueue(&scene->bake_jobs, &ups[i]);
+    for (uint32_t i = 0; i < count; i++)
+        dvz_fifo_dequeue(&scene->bake_done, true);
+}
+
+
+
+static bool _has_visual_changed(DvzSceneUpdate* ups, uint32_t count, DvzVisual* visual)
+{
+    for (uint32_t i = 0; i < count; i++)
+        if (ups[i].visual == visual)
+            return true;
+    return false;
+}
+
+
+
 // Process all pending scene updates.
 static void _process_scene_updates(DvzScene* scene)
 {
     ASSERT(scene != NULL);
     DvzFifo* fifo = &scene->update_fifo;
 
+    // The visual changes of a pass are processed after all other updates of that pass, so that
+    // the changed visuals can be baked in parallel before being uploaded serially.
+    uint32_t capacity = 16;
+    uint32_t n_changed = 0;
+    DvzSceneUpdate* changed = (DvzSceneUpdate*)calloc(capacity, sizeof(DvzSceneUpdate));
+
     // Find all visuals that need update, and enqueue them.
     _enqueue_all_visuals_changed(scene);
 
@@ -808,19 +904,38 @@ static void _process_scene_updates(DvzScene* scene)
     {
         log_trace("scene update pass #%d", i);
 
-        // Process all pending updates.
+        // Process all pending updates, except the visual changes.
+        n_changed = 0;
         up = _scene_update_dequeue(scene);
         while (up.type != DVZ_SCENE_UPDATE_NONE)
         {
-            _process_scene_update(up);
+            if (up.type != DVZ_SCENE_UPDATE_VISUAL_CHANGED)
+            {
+                _process_scene_update(up);
+            }
+            else if (!_has_visual_changed(changed, n_changed, up.visual))
+            {
+                if (n_changed == capacity)
+                {
+                    capacity *= 2;
+                    REALLOC(changed, capacity * sizeof(DvzSceneUpdate));
+                }
+                changed[n_changed++] = up;
+            }
             up = _scene_update_dequeue(scene);
         }
 
+        // Bake the changed visuals concurrently, then upload them in this thread.
+        _bake_jobs_run(scene, changed, n_changed);
+        for (uint32_t j = 0; j < n_changed; j++)
+            _process_visual_changed(changed[j]);
+
         // Find all visuals that need update, and enqueue them.
         _enqueue_all_visuals_changed(scene);
 
         i++;
     }
+    FREE(changed);
 }
 
 
@@ -877,6 +992,7 @@ static void _scene_fill(DvzCanvas* canvas, DvzEvent ev)
 
     DvzViewport viewport = {0};
     DvzCommands* cmds = NULL;
+    DvzCommands* secondary = NULL;
     DvzPanel* panel = NULL;
     DvzContainerIterator iter;
     DvzVisual* visual = NULL;
@@ -888,8 +1004,13 @@ static void _scene_fill(DvzCanvas* canvas, DvzEvent ev)
         cmds = ev.u.rf.cmds[i];
         img_idx = ev.u.rf.img_idx;
 
+        // Each visual records its commands in its own secondary command buffers, which are only
+        // recorded again when the visual has changed. The primary command buffer just executes
+        // them.
         log_trace("visual fill cmd %d begin %d", i, img_idx);
-        dvz_visual_fill_begin(canvas, cmds, img_idx);
+        dvz_cmd_begin(cmds, img_idx);
+        dvz_cmd_begin_renderpass_secondary(
+            cmds, img_idx, &canvas->renderpass, &canvas->framebuffers);
 
         iter = dvz_container_iterator(&grid->panels);
         while (iter.item != NULL)
@@ -898,7 +1019,6 @@ static void _scene_fill(DvzCanvas* canvas, DvzEvent ev)
 
             // Find the panel viewport.
             viewport = dvz_panel_viewport(panel);
-            dvz_cmd_viewport(cmds, img_idx, viewport.viewport);
 
             // Go through all visuals in the panel.
             visual = NULL;
@@ -910,8 +1030,9 @@ static void _scene_fill(DvzCanvas* canvas, DvzEvent ev)
                     if (visual->priority != priority)
                         continue;
 
-                    dvz_visual_fill_event(
-                        visual, ev.u.rf.clear_color, cmds, img_idx, viewport, NULL);
+                    secondary = dvz_visual_fill_secondary(
+                        visual, ev.u.rf.clear_color, img_idx, cmds->count, viewport);
+                    dvz_cmd_execute(cmds, img_idx, secondary, img_idx);
                 }
             }
 
@@ -1003,6 +1124,22 @@ static void _upload_mvp(DvzCanvas* canvas, DvzEvent ev)
             // NOTE: update MVP.time here.
             interact->mvp.time = canvas->clock.elapsed;
 
+            // On-demand canvases: every transfer wakes up the canvas, which would then never
+            // be idle. Only upload the MVP when the matrices change, once per swapchain image
+            // as only the region of the current image is updated. The time is not a reason to
+            // render a new frame.
+            if (canvas->on_demand)
+            {
+                if (memcmp(&panel->mvp_last, &interact->mvp, offsetof(DvzMVP, time)) != 0)
+                {
+                    panel->mvp_last = interact->mvp;
+                    panel->mvp_pending = canvas->swapchain.img_count;
+                }
+                if (panel->mvp_pending == 0)
+                    continue;
+                panel->mvp_pending--;
+            }
+
             // NOTE: we need to update the uniform buffer at every frame
 
             // NOTE: this is implemented with a FIFO queue even when using a single thread,
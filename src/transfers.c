@@ -1,45 +1,643 @@
 #include "../include/datoviz/transfers.h"
 #include "../include/datoviz/canvas.h"
 #include "../include/datoviz/context.h"
-#include "../include/datoviz/fifo.h"
 
 
 
 /*************************************************************************************************/
-/*  FIFO                                                                                         */
+/*  Transfer queue                                                                               */
 /*************************************************************************************************/
 
-static void _transfer_enqueue(DvzFifo* fifo, DvzTransfer transfer)
+// Bounded multiple-producer multiple-consumer ring: each slot carries a sequence number telling
+// whether it is free for the enqueue position, or holds the transfer for the dequeue position.
+// Producers and consumers only contend on the head and tail counters, never on a lock.
+
+DvzTransferQueue dvz_transfer_queue(uint32_t capacity)
+{
+    log_trace("creating transfer queue with a capacity of %d transfers", capacity);
+    ASSERT(capacity >= 2);
+    ASSERT((capacity & (capacity - 1)) == 0);
+
+    DvzTransferQueue queue = {0};
+    queue.capacity = capacity;
+    queue.slots = (DvzTransferSlot*)calloc(capacity, sizeof(DvzTransferSlot));
+    for (uint32_t i = 0; i < capacity; i++)
+        atomic_init(&queue.slots[i].seq, i);
+    atomic_init(&queue.head, 0);
+    atomic_init(&queue.tail, 0);
+    return queue;
+}
+
+
+
+bool dvz_transfer_queue_enqueue(DvzTransferQueue* queue, DvzTransfer transfer)
+{
+    ASSERT(queue != NULL);
+    ASSERT(queue->slots != NULL);
+
+    uint64_t mask = queue->capacity - 1;
+    uint64_t pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    DvzTransferSlot* slot = NULL;
+    while (true)
+    {
+        slot = &queue->slots[pos & mask];
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int64_t diff = (int64_t)seq - (int64_t)pos;
+        if (diff == 0)
+        {
+            // The slot is free: try to claim it. On failure, pos is updated to the new head.
+            if (atomic_compare_exchange_weak_explicit(
+                    &queue->head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // The slot still holds a transfer from the previous lap: the queue is full.
+            return false;
+        }
+        else
+        {
+            // Another producer claimed the slot first.
+            pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        }
+    }
+
+    slot->transfer = transfer;
+    // Publish the transfer to the consumers.
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    return true;
+}
+
+
+
+bool dvz_transfer_queue_dequeue(DvzTransferQueue* queue, DvzTransfer* transfer)
+{
+    ASSERT(queue != NULL);
+    ASSERT(queue->slots != NULL);
+    ASSERT(transfer != NULL);
+
+    uint64_t mask = queue->capacity - 1;
+    uint64_t pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    DvzTransferSlot* slot = NULL;
+    while (true)
+    {
+        slot = &queue->slots[pos & mask];
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int64_t diff = (int64_t)seq - (int64_t)(pos + 1);
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(
+                    &queue->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // The slot has not been published yet: the queue is empty.
+            return false;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        }
+    }
+
+    *transfer = slot->transfer;
+    // Hand the slot back to the producers, for the next lap.
+    atomic_store_explicit(&slot->seq, pos + mask + 1, memory_order_release);
+    return true;
+}
+
+
+
+uint32_t dvz_transfer_queue_size(DvzTransferQueue* queue)
+{
+    ASSERT(queue != NULL);
+    uint64_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    return head > tail ? (uint32_t)(head - tail) : 0;
+}
+
+
+
+void dvz_transfer_queue_destroy(DvzTransferQueue* queue)
 {
-    ASSERT(fifo->capacity > 0);
-    ASSERT(0 <= fifo->head && fifo->head < fifo->capacity);
-    DvzTransfer* tr = (DvzTransfer*)calloc(1, sizeof(DvzTransfer));
-    *tr = transfer;
-    dvz_fifo_enqueue(fifo, tr);
+    ASSERT(queue != NULL);
+    FREE(queue->slots);
+    queue->capacity = 0;
 }
 
 
 
-static DvzTransfer _transfer_dequeue(DvzFifo* fifo, bool wait)
+static void _transfer_enqueue(DvzCanvas* canvas, DvzTransfer transfer)
 {
-    DvzTransfer* item = (DvzTransfer*)dvz_fifo_dequeue(fifo, wait);
-    DvzTransfer out;
+    ASSERT(canvas != NULL);
+    DvzTransferQueue* queue = &canvas->transfers;
+    ASSERT(queue->capacity > 0);
+
+    // Wake up the event loop if the canvas is idle.
+    dvz_canvas_to_render(canvas);
+    if (dvz_transfer_queue_enqueue(queue, transfer))
+        return;
+
+    // The ring is full. The thread preparing the frames, for example in a FRAME callback, would
+    // wait forever for itself: it processes the pending transfers right away instead.
+    if (!canvas->app->is_running || pthread_equal(canvas->frame_thread, pthread_self()))
+    {
+        log_debug(
+            "transfer queue is full (%d pending transfers), processing them now",
+            queue->capacity);
+        dvz_context_lock(canvas->gpu->context);
+        while (!dvz_transfer_queue_enqueue(queue, transfer))
+            dvz_process_transfers(canvas);
+        dvz_context_unlock(canvas->gpu->context);
+        return;
+    }
+
+    // Otherwise, wait for the event loop to process them.
+    log_warn(
+        "transfer queue is full (%d pending transfers), waiting for it to drain",
+        queue->capacity);
+    while (!dvz_transfer_queue_enqueue(queue, transfer))
+        dvz_sleep(1);
+}
+
+
+
+static DvzTransfer _transfer_dequeue(DvzTransferQueue* queue)
+{
+    DvzTransfer out = {0};
     out.type = DVZ_TRANSFER_NONE;
-    if (item == NULL)
-        return out;
-    ASSERT(item != NULL);
-    out = *item;
-    FREE(item);
+    dvz_transfer_queue_dequeue(queue, &out);
     return out;
 }
 
 
 
+/*************************************************************************************************/
+/*  Readback                                                                                     */
+/*************************************************************************************************/
+
+DvzReadback dvz_readback(DvzGpu* gpu)
+{
+    ASSERT(gpu != NULL);
+    DvzReadback readback = {0};
+    readback.gpu = gpu;
+    readback.cmds_compute = dvz_commands(gpu, DVZ_DEFAULT_QUEUE_COMPUTE, DVZ_READBACK_SLOTS);
+    readback.cmds_render = dvz_commands(gpu, DVZ_DEFAULT_QUEUE_RENDER, DVZ_READBACK_SLOTS);
+    // NOTE: dvz_submit_send() waits on the fence of a slot before submitting, so they start
+    // signaled.
+    readback.fences = dvz_fences(gpu, DVZ_READBACK_SLOTS, true);
+
+    // The readback buffers are created at the first download.
+    for (uint32_t i = 0; i < DVZ_READBACK_SLOTS; i++)
+        readback.slots[i].buffer = dvz_buffer(gpu);
+
+    atomic_init(&readback.last_id, 0);
+    if (pthread_mutex_init(&readback.lock, NULL) != 0)
+        log_error("mutex creation failed");
+    readback.done_capacity = DVZ_READBACK_SLOTS;
+    readback.done_ids = (uint64_t*)calloc(readback.done_capacity, sizeof(uint64_t));
+    return readback;
+}
+
+
+
+void dvz_readback_destroy(DvzReadback* readback)
+{
+    ASSERT(readback != NULL);
+    for (uint32_t i = 0; i < DVZ_READBACK_SLOTS; i++)
+    {
+        if (readback->slots[i].id != 0)
+            dvz_fences_wait(&readback->fences, i);
+        dvz_buffer_destroy(&readback->slots[i].buffer);
+    }
+    dvz_commands_destroy(&readback->cmds_compute);
+    dvz_commands_destroy(&readback->cmds_render);
+    dvz_fences_destroy(&readback->fences);
+    pthread_mutex_destroy(&readback->lock);
+    FREE(readback->done_ids);
+}
+
+
+
+// Make sure the readback buffer of a slot can hold a download.
+static void _readback_buffer(DvzReadbackSlot* slot, VkDeviceSize size)
+{
+    ASSERT(slot != NULL);
+    ASSERT(slot->id == 0);
+    DvzBuffer* buffer = &slot->buffer;
+    if (dvz_obj_is_created(&buffer->obj) && buffer->size >= size)
+        return;
+
+    VkDeviceSize new_size = dvz_next_pow2(size);
+    if (dvz_obj_is_created(&buffer->obj))
+    {
+        log_debug("reallocating readback buffer to %s", pretty_size(new_size));
+        // NOTE: no need to keep the data as the slot is free.
+        dvz_buffer_resize(buffer, new_size, NULL);
+        return;
+    }
+
+    dvz_buffer_size(buffer, new_size);
+    dvz_buffer_usage(buffer, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    dvz_buffer_memory(
+        buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    dvz_buffer_queue_access(buffer, DVZ_DEFAULT_QUEUE_COMPUTE);
+    dvz_buffer_queue_access(buffer, DVZ_DEFAULT_QUEUE_RENDER);
+    dvz_buffer_create(buffer);
+    ASSERT(dvz_obj_is_created(&buffer->obj));
+
+    // Permanently map the buffer.
+    buffer->mmap = dvz_buffer_map(buffer, 0, VK_WHOLE_SIZE);
+}
+
+
+
+// Record the completion of a download.
+static void _readback_done(DvzReadback* readback, uint64_t id)
+{
+    ASSERT(readback != NULL);
+    ASSERT(id > readback->done_id);
+    pthread_mutex_lock(&readback->lock);
+
+    // Keep the handles completed ahead of a pending download, sorted.
+    if (id > readback->done_id + 1)
+    {
+        if (readback->done_count == readback->done_capacity)
+        {
+            readback->done_capacity *= 2;
+            REALLOC(readback->done_ids, readback->done_capacity * sizeof(uint64_t));
+        }
+        uint32_t idx = readback->done_count;
+        while (idx > 0 && readback->done_ids[idx - 1] > id)
+            idx--;
+        memmove(
+            &readback->done_ids[idx + 1], &readback->done_ids[idx],
+            (readback->done_count - idx) * sizeof(uint64_t));
+        readback->done_ids[idx] = id;
+        readback->done_count++;
+    }
+    else
+    {
+        // Move the watermark past the handles that completed before this one.
+        readback->done_id = id;
+        uint32_t n = 0;
+        while (n < readback->done_count && readback->done_ids[n] == readback->done_id + 1)
+            readback->done_id = readback->done_ids[n++];
+        memmove(
+            readback->done_ids, &readback->done_ids[n],
+            (readback->done_count - n) * sizeof(uint64_t));
+        readback->done_count -= n;
+    }
+
+    pthread_mutex_unlock(&readback->lock);
+}
+
+
+
+// Copy a finished download to its destination and notify the canvas.
+static void _readback_complete(DvzCanvas* canvas, uint32_t idx)
+{
+    ASSERT(canvas != NULL);
+    DvzReadback* readback = &canvas->readback;
+    DvzReadbackSlot* slot = &readback->slots[idx];
+    ASSERT(slot->id != 0);
+    ASSERT(slot->data != NULL);
+
+    dvz_buffer_download(&slot->buffer, 0, slot->size, slot->data);
+    uint64_t id = slot->id;
+    slot->id = 0;
+    _readback_done(readback, id);
+
+    dvz_event_download(canvas, id, slot->size, slot->data);
+}
+
+
+
+// Complete the downloads whose copy has finished, oldest first, without blocking.
+static void _readback_poll(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    DvzReadback* readback = &canvas->readback;
+    uint32_t idx = 0;
+    for (uint32_t i = 0; i < DVZ_READBACK_SLOTS; i++)
+    {
+        // The slots are used in turn, so the slots in flight follow the next one.
+        idx = (readback->next + i) % DVZ_READBACK_SLOTS;
+        if (readback->slots[idx].id == 0)
+            continue;
+        if (!dvz_fences_ready(&readback->fences, idx))
+            break;
+        _readback_complete(canvas, idx);
+    }
+}
+
+
+
+// Take the next slot, waiting for the oldest download only if all slots are in flight.
+static DvzReadbackSlot* _readback_slot(DvzCanvas* canvas, VkDeviceSize size, uint32_t* idx)
+{
+    ASSERT(canvas != NULL);
+    ASSERT(idx != NULL);
+    DvzReadback* readback = &canvas->readback;
+    *idx = readback->next;
+    if (readback->slots[*idx].id != 0)
+    {
+        log_trace("all readback slots in flight, waiting for the oldest download");
+        readback->stall_count++;
+        dvz_fences_wait(&readback->fences, *idx);
+        _readback_complete(canvas, *idx);
+    }
+    readback->next = (*idx + 1) % DVZ_READBACK_SLOTS;
+
+    DvzReadbackSlot* slot = &readback->slots[*idx];
+    _readback_buffer(slot, size);
+    return slot;
+}
+
+
+
+static void _readback_submit(
+    DvzCanvas* canvas, DvzCommands* cmds, uint32_t idx, DvzTransfer* tr, VkDeviceSize size,
+    void* data)
+{
+    ASSERT(canvas != NULL);
+    ASSERT(cmds != NULL);
+    ASSERT(tr != NULL);
+    ASSERT(tr->id != 0);
+    DvzReadback* readback = &canvas->readback;
+
+    dvz_cmd_end(cmds, idx);
+    DvzSubmit submit = dvz_submit(canvas->gpu);
+    dvz_submit_commands(&submit, cmds);
+    dvz_submit_send(&submit, idx, &readback->fences, idx);
+
+    DvzReadbackSlot* slot = &readback->slots[idx];
+    slot->id = tr->id;
+    slot->size = size;
+    slot->data = data;
+}
+
+
+
+/*************************************************************************************************/
+/*  Batched buffer uploads                                                                       */
+/*************************************************************************************************/
+
+// Pending upload to a non-mappable buffer, to be packed with the others in the staging buffer.
+typedef struct DvzTransferBatchItem DvzTransferBatchItem;
+struct DvzTransferBatchItem
+{
+    DvzBuffer* buffer;
+    VkDeviceSize offset; // offset in the buffer
+    VkDeviceSize size;
+    const void* data;
+    uint32_t seq; // order of the upload in the queue, later uploads overwrite earlier ones
+};
+
+typedef struct DvzTransferBatch DvzTransferBatch;
+struct DvzTransferBatch
+{
+    uint32_t count;
+    DvzTransferBatchItem items[DVZ_MAX_TRANSFER_BATCH];
+};
+
+
+
+static int _batch_item_cmp(const void* a, const void* b)
+{
+    const DvzTransferBatchItem* ia = (const DvzTransferBatchItem*)a;
+    const DvzTransferBatchItem* ib = (const DvzTransferBatchItem*)b;
+    if (ia->buffer != ib->buffer)
+        return (uintptr_t)ia->buffer < (uintptr_t)ib->buffer ? -1 : +1;
+    if (ia->offset != ib->offset)
+        return ia->offset < ib->offset ? -1 : +1;
+    return ia->seq < ib->seq ? -1 : (ia->seq > ib->seq ? +1 : 0);
+}
+
+
+
+// Size of the range covered by the group of items [start, end), sorted by offset.
+static VkDeviceSize _batch_group_size(DvzTransferBatch* batch, uint32_t start, uint32_t end)
+{
+    ASSERT(batch != NULL);
+    ASSERT(start < end);
+    VkDeviceSize size = 0;
+    DvzTransferBatchItem* item = NULL;
+    for (uint32_t i = start; i < end; i++)
+    {
+        item = &batch->items[i];
+        size = MAX(size, item->offset + item->size - batch->items[start].offset);
+    }
+    return size;
+}
+
+
+
+// Indices of the items [start, end) in queue order, so that where several uploads overlap, the
+// latest one wins.
+static void _batch_group_order(
+    DvzTransferBatch* batch, uint32_t start, uint32_t end, uint32_t* order)
+{
+    ASSERT(batch != NULL);
+    ASSERT(order != NULL);
+    uint32_t n = end - start;
+    uint32_t k = 0, j = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        // Insertion sort, the groups are small.
+        k = start + i;
+        j = i;
+        while (j > 0 && batch->items[order[j - 1]].seq > batch->items[k].seq)
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = k;
+    }
+}
+
+
+
+// Stream a single upload through the staging buffer, in chunks of bounded size.
+static void _stream_buffer_upload(
+    DvzContext* context, DvzBuffer* buffer, VkDeviceSize offset, VkDeviceSize size,
+    const void* data)
+{
+    ASSERT(context != NULL);
+    ASSERT(buffer != NULL);
+
+    DvzBufferRegions br = dvz_buffer_regions(buffer, 1, 0, buffer->size, 0);
+    VkDeviceSize chunk_size = _staging_chunk_size(context);
+    VkDeviceSize done = 0, n = 0;
+    DvzStagingChunk chunk = {0};
+    while (done < size)
+    {
+        n = MIN(chunk_size, size - done);
+
+        // Take a chunk of the staging buffer.
+        chunk = dvz_staging_alloc(context, n);
+
+        // Memcpy into the staging buffer.
+        dvz_staging_upload(context, &chunk, n, (const uint8_t*)data + done);
+
+        // Copy from the staging buffer to the target buffer.
+        _copy_buffer_from_staging(context, &chunk, br, offset + done, n);
+
+        done += n;
+    }
+}
+
+
+
+// Record the copies of a set of merged groups of uploads, packed in a single staging chunk.
+static void _batch_submit(
+    DvzContext* context, DvzTransferBatch* batch, uint32_t* groups, uint32_t group_count,
+    VkDeviceSize size)
+{
+    ASSERT(context != NULL);
+    ASSERT(batch != NULL);
+    ASSERT(groups != NULL);
+    if (group_count == 0)
+        return;
+    ASSERT(size > 0);
+
+    DvzBuffer* staging = (DvzBuffer*)dvz_container_get(&context->buffers, DVZ_BUFFER_TYPE_STAGING);
+    DvzStagingChunk chunk = dvz_staging_alloc(context, size);
+    DvzCommands* cmds = &context->staging.cmds;
+
+    VkBufferCopy regions[DVZ_MAX_TRANSFER_BATCH] = {0};
+    uint32_t region_count = 0;
+    VkDeviceSize pos = 0;
+    uint32_t order[DVZ_MAX_TRANSFER_BATCH] = {0};
+    DvzTransferBatchItem* first = NULL;
+    DvzTransferBatchItem* item = NULL;
+    VkDeviceSize group_size = 0;
+
+    for (uint32_t g = 0; g < group_count; g++)
+    {
+        // Group g covers the items [groups[g], groups[g + 1]), sorted by offset.
+        first = &batch->items[groups[g]];
+        group_size = _batch_group_size(batch, groups[g], groups[g + 1]);
+
+        // Copy the data of the group to the staging buffer, in queue order.
+        _batch_group_order(batch, groups[g], groups[g + 1], order);
+        for (uint32_t i = 0; i < groups[g + 1] - groups[g]; i++)
+        {
+            item = &batch->items[order[i]];
+            dvz_buffer_upload(
+                staging, chunk.offset + pos + item->offset - first->offset, item->size,
+                item->data);
+        }
+
+        regions[region_count].srcOffset = chunk.offset + pos;
+        regions[region_count].dstOffset = first->offset;
+        regions[region_count].size = group_size;
+        region_count++;
+        pos += group_size;
+
+        // One copy command per destination buffer, with all the regions of that buffer.
+        if (g == group_count - 1 || batch->items[groups[g + 1]].buffer != first->buffer)
+        {
+            vkCmdCopyBuffer(
+                cmds->cmds[chunk.slot], staging->buffer, first->buffer->buffer, region_count,
+                regions);
+            region_count = 0;
+        }
+    }
+    ASSERT(pos == size);
+
+    log_debug("copy %s from staging buffer in %d regions", pretty_size(size), group_count);
+    dvz_staging_submit(context, &chunk);
+}
+
+
+
+// Pack all pending uploads in the staging buffer and copy them with as few submissions as
+// possible.
+static void _batch_flush(DvzContext* context, DvzTransferBatch* batch)
+{
+    ASSERT(context != NULL);
+    ASSERT(batch != NULL);
+    if (batch->count == 0)
+        return;
+
+    // Sort the uploads by buffer and offset.
+    qsort(batch->items, batch->count, sizeof(DvzTransferBatchItem), _batch_item_cmp);
+
+    // Merge adjacent or overlapping uploads of the same buffer in groups. groups[g] is the index
+    // of the first item of group g.
+    uint32_t groups[DVZ_MAX_TRANSFER_BATCH + 1] = {0};
+    uint32_t group_count = 0;
+    VkDeviceSize group_end = 0;
+    DvzTransferBatchItem* item = NULL;
+    for (uint32_t i = 0; i < batch->count; i++)
+    {
+        item = &batch->items[i];
+        if (i == 0 || item->buffer != batch->items[i - 1].buffer || item->offset > group_end)
+        {
+            groups[group_count++] = i;
+            group_end = 0;
+        }
+        group_end = MAX(group_end, item->offset + item->size);
+    }
+    groups[group_count] = batch->count;
+
+    // Pack the groups in staging chunks of bounded size. Most of the time, all uploads of the
+    // frame fit in a single chunk and require a single submission.
+    VkDeviceSize chunk_size = _staging_chunk_size(context);
+    VkDeviceSize packed = 0, group_size = 0;
+    uint32_t first_group = 0;
+    uint32_t order[DVZ_MAX_TRANSFER_BATCH] = {0};
+    for (uint32_t g = 0; g < group_count; g++)
+    {
+        group_size = _batch_group_size(batch, groups[g], groups[g + 1]);
+
+        // Submit the groups packed so far if this one does not fit in the current chunk.
+        if (packed > 0 && packed + group_size > chunk_size)
+        {
+            _batch_submit(context, batch, &groups[first_group], g - first_group, packed);
+            first_group = g;
+            packed = 0;
+        }
+
+        // Groups larger than a chunk are streamed on their own.
+        if (group_size > chunk_size)
+        {
+            ASSERT(packed == 0);
+            _batch_group_order(batch, groups[g], groups[g + 1], order);
+            for (uint32_t i = 0; i < groups[g + 1] - groups[g]; i++)
+            {
+                item = &batch->items[order[i]];
+                _stream_buffer_upload(context, item->buffer, item->offset, item->size, item->data);
+            }
+            first_group = g + 1;
+            continue;
+        }
+
+        packed += group_size;
+    }
+    _batch_submit(context, batch, &groups[first_group], group_count - first_group, packed);
+
+    batch->count = 0;
+}
+
+
+
 /*************************************************************************************************/
 /*  Buffer transfers                                                                             */
 /*************************************************************************************************/
 
-static void _process_buffer_upload(DvzCanvas* canvas, DvzTransfer tr)
+static bool _buffer_is_mappable(DvzBuffer* buffer)
+{
+    ASSERT(buffer != NULL);
+    return buffer->type == DVZ_BUFFER_TYPE_UNIFORM_MAPPABLE ||
+           buffer->type == DVZ_BUFFER_TYPE_VERTEX_MAPPABLE;
+}
+
+
+
+static void _process_buffer_upload(DvzCanvas* canvas, DvzTransfer tr, DvzTransferBatch* batch)
 {
     ASSERT(canvas != NULL);
     DvzGpu* gpu = canvas->gpu;
@@ -54,17 +652,18 @@ static void _process_buffer_upload(DvzCanvas* canvas, DvzTransfer tr)
     ASSERT(tr.u.buf.size > 0);
     ASSERT(tr.u.buf.regions.buffer != VK_NULL_HANDLE);
 
-    // Mappable uniforms. We only update the current swapchain image here.
+    // Mappable uniforms and vertices. We only update the current swapchain image here.
     //
-    // NOTE: mappable uniforms are expected to be updated at every frame (eg MVP)
+    // NOTE: mappable buffers are expected to be updated at every frame (eg MVP, streaming data)
     // so that every swapchain image gets the most up-to-date data.
     //
     // NOTE: this function must be called AFTER the next swapchain image has been acquired,
     // so that swapchain->img_idx corresponds to the image that will be rendered in the
     // current frame, AFTER the transfer tasks have completed. This ensures that the very
     // next frame will be up to date with the latest data and command buffer (if need
-    // refill).
-    if (br.buffer->type == DVZ_BUFFER_TYPE_UNIFORM_MAPPABLE)
+    // refill). The fence of that image has been waited upon, so that its region of the
+    // buffer is no longer in use by the GPU.
+    if (_buffer_is_mappable(br.buffer))
     {
         // The mappable buffer must be constantly mapped.
         ASSERT(br.buffer->mmap != NULL);
@@ -101,15 +700,19 @@ static void _process_buffer_upload(DvzCanvas* canvas, DvzTransfer tr)
     else
     {
         ASSERT(br.count == 1);
-
-        // Take the staging buffer and ensure it is big enough.
-        DvzBuffer* staging = staging_buffer(context, tr.u.buf.size);
-
-        // Memcpy into the staging buffer.
-        dvz_buffer_upload(staging, 0, tr.u.buf.size, tr.u.buf.data);
-
-        // Copy from the staging buffer to the target buffer.
-        _copy_buffer_from_staging(context, tr.u.buf.regions, tr.u.buf.offset, tr.u.buf.size);
+        ASSERT(batch != NULL);
+
+        // The upload is deferred and packed with the other pending uploads.
+        if (batch->count >= DVZ_MAX_TRANSFER_BATCH)
+            _batch_flush(context, batch);
+        ASSERT(batch->count < DVZ_MAX_TRANSFER_BATCH);
+        DvzTransferBatchItem* item = &batch->items[batch->count];
+        item->buffer = br.buffer;
+        item->offset = br.offsets[0] + tr.u.buf.offset;
+        item->size = tr.u.buf.size;
+        item->data = tr.u.buf.data;
+        item->seq = batch->count;
+        batch->count++;
     }
 }
 
@@ -130,9 +733,9 @@ static void _process_buffer_download(DvzCanvas* canvas, DvzTransfer tr)
     ASSERT(tr.u.buf.size > 0);
     ASSERT(tr.u.buf.regions.buffer != VK_NULL_HANDLE);
 
-    // Mappable uniforms. We only update the current swapchain image here.
+    // Mappable uniforms and vertices. We only update the current swapchain image here.
     //
-    // NOTE: mappable uniforms are expected to be updated at every frame (eg MVP)
+    // NOTE: mappable buffers are expected to be updated at every frame (eg MVP, streaming data)
     // so that every swapchain image gets the most up-to-date data.
     //
     // NOTE: this function must be called AFTER the next swapchain image has been acquired,
@@ -140,7 +743,7 @@ static void _process_buffer_download(DvzCanvas* canvas, DvzTransfer tr)
     // current frame, AFTER the transfer tasks have completed. This ensures that the very
     // next frame will be up to date with the latest data and command buffer (if need
     // refill).
-    if (br.buffer->type == DVZ_BUFFER_TYPE_UNIFORM_MAPPABLE)
+    if (_buffer_is_mappable(br.buffer))
     {
         // The mappable buffer must be constantly mapped.
         ASSERT(br.buffer->mmap != NULL);
@@ -169,19 +772,71 @@ static void _process_buffer_download(DvzCanvas* canvas, DvzTransfer tr)
     {
         ASSERT(br.count == 1);
 
-        // Take the staging buffer and ensure it is big enough.
-        DvzBuffer* staging = staging_buffer(context, tr.u.buf.size);
+        // Stream the data through the staging buffer in chunks of bounded size.
+        VkDeviceSize chunk_size = _staging_chunk_size(context);
+        VkDeviceSize size = tr.u.buf.size;
+        VkDeviceSize done = 0, n = 0;
+        uint8_t* data = (uint8_t*)tr.u.buf.data;
+        DvzStagingChunk chunk = {0};
+        while (done < size)
+        {
+            n = MIN(chunk_size, size - done);
 
-        // Copy from the source buffer to the staging buffer.
-        _copy_buffer_to_staging(context, tr.u.buf.regions, tr.u.buf.offset, tr.u.buf.size);
+            // Take a chunk of the staging buffer.
+            chunk = dvz_staging_alloc(context, n);
 
-        // Memcpy into the staging buffer.
-        dvz_buffer_download(staging, 0, tr.u.buf.size, tr.u.buf.data);
+            // Copy from the source buffer to the staging buffer.
+            _copy_buffer_to_staging(context, &chunk, br, tr.u.buf.offset + done, n);
+
+            // Memcpy from the staging buffer.
+            dvz_staging_download(context, &chunk, n, data + done);
+
+            done += n;
+        }
     }
 }
 
 
 
+static void _process_buffer_download_async(DvzCanvas* canvas, DvzTransfer tr)
+{
+    ASSERT(canvas != NULL);
+    DvzGpu* gpu = canvas->gpu;
+    ASSERT(gpu != NULL);
+    DvzContext* context = gpu->context;
+    ASSERT(tr.type == DVZ_TRANSFER_BUFFER_DOWNLOAD_ASYNC);
+    DvzBufferRegions br = tr.u.buf.regions;
+    VkDeviceSize size = tr.u.buf.size;
+    ASSERT(br.count == 1);
+    ASSERT(size > 0);
+    ASSERT(tr.u.buf.data != NULL);
+
+    // The uploads submitted before on the transfer queue must be visible to the copy.
+    dvz_staging_wait(context);
+
+    uint32_t idx = 0;
+    DvzReadbackSlot* slot = _readback_slot(canvas, size, &idx);
+    DvzCommands* cmds = &canvas->readback.cmds_compute;
+    dvz_cmd_reset(cmds, idx);
+    dvz_cmd_begin(cmds, idx);
+
+    // Wait for the compute shaders submitted before on the same queue.
+    DvzBarrier barrier = dvz_barrier(gpu);
+    dvz_barrier_stages(
+        &barrier, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    dvz_barrier_buffer(&barrier, br);
+    dvz_barrier_buffer_access(&barrier, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    dvz_cmd_barrier(cmds, idx, &barrier);
+
+    dvz_cmd_copy_buffer(
+        cmds, idx, br.buffer, br.offsets[0] + tr.u.buf.offset, &slot->buffer, 0, size);
+
+    // Submit without waiting: the download completes at a later frame.
+    _readback_submit(canvas, cmds, idx, &tr, size, tr.u.buf.data);
+}
+
+
+
 static void _process_buffer_copy(DvzCanvas* canvas, DvzTransfer tr)
 {
     ASSERT(canvas != NULL);
@@ -231,6 +886,93 @@ static void _process_buffer_copy(DvzCanvas* canvas, DvzTransfer tr)
 
 
 
+/*************************************************************************************************/
+/*  Texture transfers                                                                            */
+/*************************************************************************************************/
+
+static void _process_texture_upload(DvzCanvas* canvas, DvzTransfer tr)
+{
+    ASSERT(canvas != NULL);
+    ASSERT(canvas->gpu != NULL);
+    DvzContext* context = canvas->gpu->context;
+    ASSERT(context != NULL);
+    ASSERT(tr.type == DVZ_TRANSFER_TEXTURE_UPLOAD);
+    ASSERT(tr.u.tex.texture != NULL);
+    ASSERT(tr.u.tex.data != NULL);
+    ASSERT(tr.u.tex.size > 0);
+
+    // Unlike dvz_texture_upload(), do not wait for the copy to complete here: the next render
+    // submission waits for it on the GPU, see dvz_process_transfers().
+    _upload_texture_staging(
+        context, tr.u.tex.texture, tr.u.tex.offset, tr.u.tex.shape, tr.u.tex.size,
+        tr.u.tex.row_pitch, tr.u.tex.slice_pitch, tr.u.tex.data);
+}
+
+
+
+static void _process_texture_download_async(DvzCanvas* canvas, DvzTransfer tr)
+{
+    ASSERT(canvas != NULL);
+    DvzGpu* gpu = canvas->gpu;
+    ASSERT(gpu != NULL);
+    DvzContext* context = gpu->context;
+    ASSERT(tr.type == DVZ_TRANSFER_TEXTURE_DOWNLOAD_ASYNC);
+    DvzTexture* texture = tr.u.tex.texture;
+    ASSERT(texture != NULL);
+    ASSERT(texture->image != NULL);
+    ASSERT(tr.u.tex.data != NULL);
+    ASSERT(tr.u.tex.size > 0);
+
+    // The uploads submitted before on the transfer queue must be visible to the copy.
+    dvz_staging_wait(context);
+
+    uvec3 shape = {0};
+    _texture_shape(texture, tr.u.tex.offset, tr.u.tex.shape, shape);
+
+    uint32_t idx = 0;
+    DvzReadbackSlot* slot = _readback_slot(canvas, tr.u.tex.size, &idx);
+    DvzCommands* cmds = &canvas->readback.cmds_render;
+    dvz_cmd_reset(cmds, idx);
+    dvz_cmd_begin(cmds, idx);
+
+    // Image transition, after the commands submitted before on the same queue.
+    DvzBarrier barrier = dvz_barrier(gpu);
+    dvz_barrier_stages(
+        &barrier, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    dvz_barrier_images(&barrier, texture->image);
+    dvz_barrier_images_layout(
+        &barrier, texture->image->layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    dvz_barrier_images_access(&barrier, VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    dvz_cmd_barrier(cmds, idx, &barrier);
+
+    // Copy the region, tightly packed, at the beginning of the readback buffer.
+    VkBufferImageCopy region = {0};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset.x = (int32_t)tr.u.tex.offset[0];
+    region.imageOffset.y = (int32_t)tr.u.tex.offset[1];
+    region.imageOffset.z = (int32_t)tr.u.tex.offset[2];
+    region.imageExtent.width = shape[0];
+    region.imageExtent.height = shape[1];
+    region.imageExtent.depth = shape[2];
+    vkCmdCopyImageToBuffer(
+        cmds->cmds[idx], texture->image->images[0], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        slot->buffer.buffer, 1, &region);
+
+    // Image transition back.
+    dvz_barrier_stages(
+        &barrier, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    dvz_barrier_images_layout(
+        &barrier, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture->image->layout);
+    dvz_barrier_images_access(&barrier, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_MEMORY_READ_BIT);
+    dvz_cmd_barrier(cmds, idx, &barrier);
+
+    // Submit without waiting: the download completes at a later frame.
+    _readback_submit(canvas, cmds, idx, &tr, tr.u.tex.size, tr.u.tex.data);
+}
+
+
+
 /*************************************************************************************************/
 /*  Canvas transfers processing                                                                  */
 /*************************************************************************************************/
@@ -247,23 +989,30 @@ void dvz_process_transfers(DvzCanvas* canvas)
     ASSERT(gpu != NULL);
     DvzContext* context = canvas->gpu->context;
     ASSERT(context != NULL);
-    DvzFifo* fifo = &canvas->transfers;
+    DvzTransferQueue* queue = &canvas->transfers;
+
+    // Raise the events of the asynchronous downloads that have completed since the last call.
+    _readback_poll(canvas);
+
     // Do nothing if there are no pending transfers.
-    if (fifo->is_empty)
+    if (dvz_transfer_queue_size(queue) == 0)
         return;
 
-    // Process all pending transfer tasks.
+    // Process all pending transfer tasks. Uploads to non-mappable buffers are collected in a
+    // batch, which is flushed before any other kind of transfer to keep the queue order.
+    DvzTransferBatch batch = {0};
     DvzTransfer tr = {0};
     while (true)
     {
-        tr = _transfer_dequeue(fifo, false);
+        tr = _transfer_dequeue(queue);
         if (tr.type == DVZ_TRANSFER_NONE)
             break;
-        fifo->is_processing = true;
+        if (tr.type != DVZ_TRANSFER_BUFFER_UPLOAD)
+            _batch_flush(context, &batch);
 
         // Process buffer transfers.
         if (tr.type == DVZ_TRANSFER_BUFFER_UPLOAD)
-            _process_buffer_upload(canvas, tr);
+            _process_buffer_upload(canvas, tr, &batch);
         if (tr.type == DVZ_TRANSFER_BUFFER_DOWNLOAD)
             _process_buffer_download(canvas, tr);
         if (tr.type == DVZ_TRANSFER_BUFFER_COPY)
@@ -271,8 +1020,7 @@ void dvz_process_transfers(DvzCanvas* canvas)
 
         // Process texture transfers.
         if (tr.type == DVZ_TRANSFER_TEXTURE_UPLOAD)
-            dvz_texture_upload(
-                tr.u.tex.texture, tr.u.tex.offset, tr.u.tex.shape, tr.u.tex.size, tr.u.tex.data);
+            _process_texture_upload(canvas, tr);
         if (tr.type == DVZ_TRANSFER_TEXTURE_DOWNLOAD)
             dvz_texture_download(
                 tr.u.tex.texture, tr.u.tex.offset, tr.u.tex.shape, tr.u.tex.size, tr.u.tex.data);
@@ -281,8 +1029,19 @@ void dvz_process_transfers(DvzCanvas* canvas)
                 tr.u.tex_copy.src, tr.u.tex_copy.src_offset, tr.u.tex_copy.dst,
                 tr.u.tex_copy.dst_offset, tr.u.tex_copy.shape);
 
-        fifo->is_processing = false;
+        // Process asynchronous downloads.
+        if (tr.type == DVZ_TRANSFER_BUFFER_DOWNLOAD_ASYNC)
+            _process_buffer_download_async(canvas, tr);
+        if (tr.type == DVZ_TRANSFER_TEXTURE_DOWNLOAD_ASYNC)
+            _process_texture_download_async(canvas, tr);
     }
+    _batch_flush(context, &batch);
+
+    // When the event loop is running, the next render submission waits for the uploads on the
+    // GPU with a semaphore, see dvz_canvas_frame_submit(). Otherwise, the caller expects the data
+    // to be on the GPU when this function returns.
+    if (!canvas->app->is_running)
+        dvz_staging_wait(context);
 }
 
 
@@ -293,7 +1052,7 @@ void dvz_process_transfers(DvzCanvas* canvas)
 
 static void _enqueue_buffers_transfer(
     DvzCanvas* canvas, DvzDataTransferType type, DvzBufferRegions br, //
-    VkDeviceSize offset, VkDeviceSize size, void* data)
+    VkDeviceSize offset, VkDeviceSize size, void* data, uint64_t id)
 {
     ASSERT(canvas != NULL);
     ASSERT(canvas->gpu != NULL);
@@ -312,13 +1071,14 @@ static void _enqueue_buffers_transfer(
     tr.u.buf.offset = offset;
     tr.u.buf.size = size;
     tr.u.buf.data = data;
+    tr.id = id;
 
     // HACK: when uploading buffers when the app is not running (for example at initialization)
-    // we upload all copies of the DvzBufferRegions. This is used when using UNIFORM_MAPPABLE
-    // buffers that are not continuously updated in each frame.
+    // we upload all copies of the DvzBufferRegions. This is used when using mappable buffers
+    // that are not continuously updated in each frame.
     tr.u.buf.update_all_buffers = !canvas->app->is_running;
 
-    _transfer_enqueue(&canvas->transfers, tr);
+    _transfer_enqueue(canvas, tr);
 }
 
 
@@ -327,7 +1087,7 @@ static void _enqueue_buffers_transfer(
 void dvz_upload_buffers(
     DvzCanvas* canvas, DvzBufferRegions br, VkDeviceSize offset, VkDeviceSize size, void* data)
 {
-    _enqueue_buffers_transfer(canvas, DVZ_TRANSFER_BUFFER_UPLOAD, br, offset, size, data);
+    _enqueue_buffers_transfer(canvas, DVZ_TRANSFER_BUFFER_UPLOAD, br, offset, size, data, 0);
 
     if (!canvas->app->is_running)
         dvz_process_transfers(canvas);
@@ -338,10 +1098,25 @@ void dvz_upload_buffers(
 void dvz_download_buffers(
     DvzCanvas* canvas, DvzBufferRegions br, VkDeviceSize offset, VkDeviceSize size, void* data)
 {
-    _enqueue_buffers_transfer(canvas, DVZ_TRANSFER_BUFFER_DOWNLOAD, br, offset, size, data);
+    _enqueue_buffers_transfer(canvas, DVZ_TRANSFER_BUFFER_DOWNLOAD, br, offset, size, data, 0);
+
+    if (!canvas->app->is_running)
+        dvz_process_transfers(canvas);
+}
+
+
+
+uint64_t dvz_download_buffers_async(
+    DvzCanvas* canvas, DvzBufferRegions br, VkDeviceSize offset, VkDeviceSize size, void* data)
+{
+    ASSERT(canvas != NULL);
+    uint64_t id = atomic_fetch_add(&canvas->readback.last_id, 1) + 1;
+    _enqueue_buffers_transfer(
+        canvas, DVZ_TRANSFER_BUFFER_DOWNLOAD_ASYNC, br, offset, size, data, id);
 
     if (!canvas->app->is_running)
         dvz_process_transfers(canvas);
+    return id;
 }
 
 
@@ -368,7 +1143,7 @@ void dvz_copy_buffers(
     tr.u.buf_copy.dst_offset = dst_offset;
     tr.u.buf_copy.size = size;
 
-    _transfer_enqueue(&canvas->transfers, tr);
+    _transfer_enqueue(canvas, tr);
 
     if (!canvas->app->is_running)
         dvz_process_transfers(canvas);
@@ -382,7 +1157,8 @@ void dvz_copy_buffers(
 
 static void _enqueue_texture_transfer(
     DvzCanvas* canvas, DvzDataTransferType type, DvzTexture* texture, //
-    uvec3 offset, uvec3 shape, VkDeviceSize size, void* data)
+    uvec3 offset, uvec3 shape, VkDeviceSize size,                     //
+    VkDeviceSize row_pitch, VkDeviceSize slice_pitch, void* data, uint64_t id)
 {
     ASSERT(canvas != NULL);
     ASSERT(canvas->gpu != NULL);
@@ -410,10 +1186,13 @@ static void _enqueue_texture_transfer(
         tr.u.tex.offset[i] = offset[i];
     }
     tr.u.tex.size = size;
+    tr.u.tex.row_pitch = row_pitch;
+    tr.u.tex.slice_pitch = slice_pitch;
     tr.u.tex.data = data;
     tr.u.tex.texture = texture;
+    tr.id = id;
 
-    _transfer_enqueue(&canvas->transfers, tr);
+    _transfer_enqueue(canvas, tr);
 }
 
 
@@ -423,7 +1202,21 @@ void dvz_upload_texture(
     void* data)
 {
     _enqueue_texture_transfer(
-        canvas, DVZ_TRANSFER_TEXTURE_UPLOAD, texture, offset, shape, size, data);
+        canvas, DVZ_TRANSFER_TEXTURE_UPLOAD, texture, offset, shape, size, 0, 0, data, 0);
+
+    if (!canvas->app->is_running)
+        dvz_process_transfers(canvas);
+}
+
+
+
+void dvz_upload_texture_strided(
+    DvzCanvas* canvas, DvzTexture* texture, uvec3 offset, uvec3 shape, VkDeviceSize size,
+    VkDeviceSize row_pitch, VkDeviceSize slice_pitch, void* data)
+{
+    _enqueue_texture_transfer(
+        canvas, DVZ_TRANSFER_TEXTURE_UPLOAD, texture, offset, shape, size, row_pitch,
+        slice_pitch, data, 0);
 
     if (!canvas->app->is_running)
         dvz_process_transfers(canvas);
@@ -436,7 +1229,7 @@ void dvz_download_texture(
     void* data)
 {
     _enqueue_texture_transfer(
-        canvas, DVZ_TRANSFER_TEXTURE_DOWNLOAD, texture, offset, shape, size, data);
+        canvas, DVZ_TRANSFER_TEXTURE_DOWNLOAD, texture, offset, shape, size, 0, 0, data, 0);
 
     if (!canvas->app->is_running)
         dvz_process_transfers(canvas);
@@ -444,6 +1237,63 @@ void dvz_download_texture(
 
 
 
+uint64_t dvz_download_texture_async(
+    DvzCanvas* canvas, DvzTexture* texture, uvec3 offset, uvec3 shape, VkDeviceSize size,
+    void* data)
+{
+    ASSERT(canvas != NULL);
+    uint64_t id = atomic_fetch_add(&canvas->readback.last_id, 1) + 1;
+    _enqueue_texture_transfer(
+        canvas, DVZ_TRANSFER_TEXTURE_DOWNLOAD_ASYNC, texture, offset, shape, size, 0, 0, data,
+        id);
+
+    if (!canvas->app->is_running)
+        dvz_process_transfers(canvas);
+    return id;
+}
+
+
+
+bool dvz_download_done(DvzCanvas* canvas, uint64_t id)
+{
+    ASSERT(canvas != NULL);
+    DvzReadback* readback = &canvas->readback;
+    pthread_mutex_lock(&readback->lock);
+    bool done = id <= readback->done_id;
+    for (uint32_t i = 0; i < readback->done_count && !done; i++)
+        done = readback->done_ids[i] == id;
+    pthread_mutex_unlock(&readback->lock);
+    return done;
+}
+
+
+
+void dvz_download_wait(DvzCanvas* canvas, uint64_t id)
+{
+    ASSERT(canvas != NULL);
+    DvzReadback* readback = &canvas->readback;
+    ASSERT(id <= atomic_load(&readback->last_id));
+    uint32_t idx = 0;
+    while (!dvz_download_done(canvas, id))
+    {
+        // Record the download if it is still in the transfer queue.
+        dvz_process_transfers(canvas);
+
+        // Block on the oldest download in flight.
+        for (uint32_t i = 0; i < DVZ_READBACK_SLOTS; i++)
+        {
+            idx = (readback->next + i) % DVZ_READBACK_SLOTS;
+            if (readback->slots[idx].id == 0)
+                continue;
+            dvz_fences_wait(&readback->fences, idx);
+            _readback_complete(canvas, idx);
+            break;
+        }
+    }
+}
+
+
+
 void dvz_copy_texture(
     DvzCanvas* canvas, DvzTexture* src, uvec3 src_offset, DvzTexture* dst, uvec3 dst_offset,
     uvec3 shape, VkDeviceSize size)
@@ -468,7 +1318,7 @@ void dvz_copy_texture(
     memcpy(tr.u.tex_copy.dst_offset, dst_offset, sizeof(uvec3));
     memcpy(tr.u.tex_copy.shape, shape, sizeof(uvec3));
 
-    _transfer_enqueue(&canvas->transfers, tr);
+    _transfer_enqueue(canvas, tr);
 
     if (!canvas->app->is_running)
         dvz_process_transfers(canvas);
@@ -4,6 +4,36 @@
 
 
 
+/*************************************************************************************************/
+/*  Utils                                                                                        */
+/*************************************************************************************************/
+
+// Return the linear rescaling to NDC of the positions, once transformed by the non-cartesian
+// transformation `tr` of the data coordinates, if any.
+static DvzTransform _transform_ndc(DvzDataCoords coords, bool inverse, DvzTransform* tr)
+{
+    ASSERT(tr != NULL);
+    *tr = _transform(DVZ_TRANSFORM_CARTESIAN);
+    if (coords.transform == DVZ_TRANSFORM_EARTH_MERCATOR_WEB)
+    {
+        *tr = _transform(coords.transform);
+        if (inverse)
+            *tr = _transform_inv(tr);
+    }
+    // TODO: more non-cartesian transforms.
+
+    // Transform the box.
+    // NOTE: assuming a box is transformed to a box...
+    DvzBox box = {0};
+    _transform_apply(tr, coords.box.p0, box.p0);
+    _transform_apply(tr, coords.box.p1, box.p1);
+
+    // Then, linearly rescale to NDC, using the transformed box.
+    return _transform_interp(box, DVZ_BOX_NDC);
+}
+
+
+
 /*************************************************************************************************/
 /*  Functions                                                                                    */
 /*************************************************************************************************/
@@ -22,8 +52,9 @@ void dvz_transform_pos(DvzDataCoords coords, DvzArray* pos_in, DvzArray* pos_out
         "data normalization on %d position elements, transform %d", pos_in->item_count,
         coords.transform);
 
-    // Default transform.
-    DvzTransform tr = _transform(DVZ_TRANSFORM_CARTESIAN);
+    // Non-cartesian transform, and linear rescaling to NDC.
+    DvzTransform tr = {0};
+    DvzTransform tr_ndc = _transform_ndc(coords, inverse, &tr);
 
     // // HACK: for now we only support DVEC3. For axes we need support for FLOAT just for linear
     // so
@@ -52,31 +83,86 @@ void dvz_transform_pos(DvzDataCoords coords, DvzArray* pos_in, DvzArray* pos_out
     // First, handle non-cartesian transforms.
     if (coords.transform == DVZ_TRANSFORM_EARTH_MERCATOR_WEB)
     {
-        tr = _transform(coords.transform);
-        if (inverse)
-            tr = _transform_inv(&tr);
         _transform_array(&tr, pos_in, pos_out);
         pos_temp = pos_out;
     }
-    // TODO: more non-cartesian transforms.
-
-    // Transform the box.
-    // NOTE: assuming a box is transformed to a box...
-    DvzBox box = {0};
-    _transform_apply(&tr, coords.box.p0, box.p0);
-    _transform_apply(&tr, coords.box.p1, box.p1);
-
-    // Then, linearly rescale to NDC, using the transformed box.
-    tr = _transform_interp(box, DVZ_BOX_NDC);
 
     // Apply the transformation.
-    _transform_array(&tr, pos_temp, pos_out);
+    _transform_array(&tr_ndc, pos_temp, pos_out);
     // dvz_array_print(pos_temp);
     // dvz_array_print(pos_out);
 }
 
 
 
+void dvz_transform_pos_column(
+    DvzDataCoords coords, DvzArray* array, VkDeviceSize offset, //
+    uint32_t first_item, uint32_t item_count,                   //
+    uint32_t data_item_count, const void* data,                 //
+    DvzDataType source_dtype, DvzDataType target_dtype,         //
+    DvzArrayCopyType copy_type, uint32_t reps)                  //
+{
+    ASSERT(array != NULL);
+    ASSERT(array->data != NULL);
+    ASSERT(data != NULL);
+    ASSERT(data_item_count > 0);
+    ASSERT(item_count > 0);
+    ASSERT(first_item + item_count <= array->item_count);
+
+    if (target_dtype != DVZ_DTYPE_VEC3 && target_dtype != DVZ_DTYPE_VEC2)
+    {
+        log_error("unsupported normalized position dtype %d", target_dtype);
+        return;
+    }
+    size_t size = _get_dtype_size(target_dtype);
+    VkDeviceSize src_stride = _get_dtype_size(source_dtype);
+    VkDeviceSize dst_stride = array->item_size;
+    ASSERT(src_stride > 0);
+
+    log_debug(
+        "fused normalization of %d positions, transform %d", MIN(item_count, data_item_count),
+        coords.transform);
+
+    // The linear rescaling to NDC only has a scaling and a translation coefficient per axis.
+    DvzTransform tr = {0};
+    DvzTransform tr_ndc = _transform_ndc(coords, false, &tr);
+    bool cartesian = coords.transform != DVZ_TRANSFORM_EARTH_MERCATOR_WEB;
+    dvec3 a = {tr_ndc.mat[0][0], tr_ndc.mat[1][1], tr_ndc.mat[2][2]};
+    dvec3 b = {tr_ndc.mat[3][0], tr_ndc.mat[3][1], tr_ndc.mat[3][2]};
+
+    // Same layout as dvz_array_column(): the array items are processed by blocks of `reps`
+    // items, each block taking one data item, only written once in SINGLE mode.
+    uint32_t step = MAX(reps, 1);
+    uint32_t group = copy_type == DVZ_ARRAY_COPY_SINGLE ? 1 : step;
+    uint32_t n_blocks = (item_count + step - 1) / step;
+
+    const uint8_t* src = (const uint8_t*)data;
+    uint8_t* dst = (uint8_t*)array->data + first_item * dst_stride + offset;
+    dvec3 pos = {0}, pos_tr = {0};
+    vec3 out = {0};
+    uint32_t n = 0;
+    for (uint32_t k = 0; k < n_blocks; k++, dst += step * dst_stride)
+    {
+        // The blocks beyond the data repeat its last item, which has already been normalized.
+        if (k < data_item_count)
+        {
+            _pos_load(source_dtype, src + k * src_stride, pos);
+            if (!cartesian)
+            {
+                _transform_apply(&tr, pos, pos_tr);
+                _dvec3_copy(pos_tr, pos);
+            }
+            for (uint32_t j = 0; j < 3; j++)
+                out[j] = (float)(a[j] * pos[j] + b[j]);
+        }
+        n = MIN(group, item_count - k * step);
+        for (uint32_t r = 0; r < n; r++)
+            memcpy(dst + r * dst_stride, out, size);
+    }
+}
+
+
+
 void dvz_transform(DvzPanel* panel, DvzCDS source, dvec3 pos_in, DvzCDS target, dvec3 pos_out)
 {
     ASSERT(panel != NULL);
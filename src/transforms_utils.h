@@ -37,23 +37,60 @@ static void _box_enlarge(DvzBox* box, float rel_increase)
 
 
 
-// Return the bounding box of a set of dvec3 points.
+// Load a position stored as a dvec3, vec3, dvec2, vec2 or double, the missing coordinates being
+// zero.
+static inline void _pos_load(DvzDataType dtype, const void* item, dvec3 out)
+{
+    ASSERT(item != NULL);
+    switch (dtype)
+    {
+    case DVZ_DTYPE_DOUBLE:
+        out[0] = ((const double*)item)[0];
+        out[1] = out[2] = 0;
+        break;
+    case DVZ_DTYPE_DVEC3:
+        memcpy(out, item, sizeof(dvec3));
+        break;
+    case DVZ_DTYPE_VEC3:
+        out[0] = ((const float*)item)[0];
+        out[1] = ((const float*)item)[1];
+        out[2] = ((const float*)item)[2];
+        break;
+    case DVZ_DTYPE_DVEC2:
+        out[0] = ((const double*)item)[0];
+        out[1] = ((const double*)item)[1];
+        out[2] = 0;
+        break;
+    case DVZ_DTYPE_VEC2:
+        out[0] = ((const float*)item)[0];
+        out[1] = ((const float*)item)[1];
+        out[2] = 0;
+        break;
+    default:
+        log_error("unsupported position dtype %d", dtype);
+        out[0] = out[1] = out[2] = 0;
+        break;
+    }
+}
+
+
+
+// Return the bounding box of a set of points, see _pos_load() for the supported dtypes.
 static DvzBox _box_bounding(DvzArray* points_in)
 {
     ASSERT(points_in != NULL);
     ASSERT(points_in->item_count > 0);
     ASSERT(points_in->item_size > 0);
 
-    dvec3* pos = NULL;
+    dvec3 pos = {0};
     DvzBox box = DVZ_BOX_INF;
     for (uint32_t i = 0; i < points_in->item_count; i++)
     {
-        pos = (dvec3*)dvz_array_item(points_in, i);
-        ASSERT(pos != NULL);
+        _pos_load(points_in->dtype, dvz_array_item(points_in, i), pos);
         for (uint32_t j = 0; j < 3; j++)
         {
-            box.p0[j] = MIN(box.p0[j], (*pos)[j]);
-            box.p1[j] = MAX(box.p1[j], (*pos)[j]);
+            box.p0[j] = MIN(box.p0[j], pos[j]);
+            box.p1[j] = MAX(box.p1[j], pos[j]);
         }
     }
 
@@ -1,6 +1,7 @@
 #include "../include/datoviz/visuals.h"
 #include "../include/datoviz/canvas.h"
 #include "../include/datoviz/graphics.h"
+#include "../include/datoviz/profile.h"
 #include "visuals_utils.h"
 
 
@@ -27,6 +28,7 @@ DvzVisual dvz_visual(DvzCanvas* canvas)
     // Default callbacks.
     visual.callback_fill = _default_visual_fill;
     visual.callback_bake = _default_visual_bake;
+    visual.draw_indirect = true;
 
     dvz_obj_created(&visual.obj);
     return visual;
@@ -58,19 +60,41 @@ void dvz_visual_destroy(DvzVisual* visual)
 
     // Free the data sources.
     DvzSource* source = NULL;
+    DvzContext* ctx = visual->canvas->gpu->context;
     iter = dvz_container_iterator(&visual->sources);
     while (iter.item != NULL)
     {
         source = iter.item;
         dvz_array_destroy(&source->arr);
+        // Release the buffer regions allocated by the library.
+        if (source->source_kind < DVZ_SOURCE_KIND_TEXTURE_1D &&
+            source->origin != DVZ_SOURCE_ORIGIN_USER && source->u.br.buffer != VK_NULL_HANDLE)
+            dvz_ctx_buffers_free(ctx, &source->u.br);
         dvz_obj_destroyed(&source->obj);
         dvz_container_iter(&iter);
     }
     dvz_container_destroy(&visual->sources);
 
+    // Free the indirect draw parameters.
+    for (uint32_t i = 0; i < visual->graphics_count; i++)
+    {
+        if (visual->indirect[i].buffer != NULL)
+            dvz_ctx_buffers_free(ctx, &visual->indirect[i]);
+    }
+
     CONTAINER_DESTROY_ITEMS(DvzBindings, visual->bindings, dvz_bindings_destroy)
     CONTAINER_DESTROY_ITEMS(DvzBindings, visual->bindings_comp, dvz_bindings_destroy)
 
+    // Free the cached secondary command buffers, once the GPU no longer uses them.
+    if (visual->cmds_fill.count > 0)
+    {
+        dvz_gpu_wait(visual->canvas->gpu);
+        dvz_cmd_free(&visual->cmds_fill);
+        // dvz_cmd_free() does not reset the count, and a visual may be destroyed twice.
+        visual->cmds_fill = (DvzCommands){0};
+    }
+    dvz_canvas_profile_release(visual->canvas, visual);
+
     dvz_obj_destroyed(&visual->obj);
 }
 
@@ -133,6 +157,39 @@ void dvz_visual_source_share(
 
 
 
+void dvz_visual_source_mappable(
+    DvzVisual* visual, DvzSourceType source_type, uint32_t source_idx, bool mappable)
+{
+    ASSERT(visual != NULL);
+    DvzSource* source = dvz_source_get(visual, source_type, source_idx);
+    ASSERT(source != NULL);
+    if (source->source_kind != DVZ_SOURCE_KIND_VERTEX &&
+        source->source_kind != DVZ_SOURCE_KIND_UNIFORM)
+    {
+        log_error("only vertex and uniform sources can be mappable");
+        return;
+    }
+    if (((source->flags & DVZ_SOURCE_FLAG_MAPPABLE) != 0) == mappable)
+        return;
+
+    if (mappable)
+        source->flags |= DVZ_SOURCE_FLAG_MAPPABLE;
+    else
+        source->flags &= ~DVZ_SOURCE_FLAG_MAPPABLE;
+
+    // Release the current buffer region, a new one will be allocated in the right buffer at the
+    // next call to dvz_visual_update().
+    if (source->u.br.buffer != VK_NULL_HANDLE)
+    {
+        ASSERT(visual->canvas != NULL);
+        dvz_ctx_buffers_free(visual->canvas->gpu->context, &source->u.br);
+        if (_source_is_set(source))
+            _source_set_changed(source, true);
+    }
+}
+
+
+
 DvzProp* dvz_visual_prop(
     DvzVisual* visual, DvzPropType prop_type, uint32_t prop_idx, DvzDataType dtype,
     DvzSourceType source_type, uint32_t source_idx)
@@ -207,6 +264,63 @@ void dvz_visual_prop_cast(
 
 
 
+void dvz_visual_prop_float(DvzProp* prop)
+{
+    ASSERT(prop != NULL);
+    DvzVisual* visual = prop->source != NULL ? prop->source->visual : NULL;
+    if (prop->prop_type != DVZ_PROP_POS || visual == NULL ||
+        visual->callback_bake != _default_visual_bake)
+    {
+        log_error("only POS props of visuals with the default bake can be single-precision");
+        return;
+    }
+
+    DvzDataType dtype = DVZ_DTYPE_NONE;
+    if (prop->dtype == DVZ_DTYPE_DVEC3)
+        dtype = DVZ_DTYPE_VEC3;
+    else if (prop->dtype == DVZ_DTYPE_DVEC2)
+        dtype = DVZ_DTYPE_VEC2;
+    else if (prop->dtype == DVZ_DTYPE_VEC3 || prop->dtype == DVZ_DTYPE_VEC2)
+        return;
+    if (dtype == DVZ_DTYPE_NONE || prop->target_dtype != dtype)
+    {
+        log_error("POS prop with dtype %d cannot be single-precision", prop->dtype);
+        return;
+    }
+    log_debug("single-precision POS prop #%d", prop->prop_idx);
+
+    // Convert the data that has already been set.
+    uint32_t count = prop->arr_orig.item_count;
+    DvzArray arr = dvz_array(count, dtype);
+    if (count > 0)
+        dvz_array_column(
+            &arr, 0, prop->arr_orig.item_size, 0, count, count, prop->arr_orig.data, prop->dtype,
+            dtype, DVZ_ARRAY_COPY_SINGLE, 1);
+    if (prop->default_value != NULL)
+    {
+        float value[3] = {0};
+        for (uint32_t j = 0; j < (dtype == DVZ_DTYPE_VEC3 ? 3u : 2u); j++)
+            value[j] = (float)((double*)prop->default_value)[j];
+        memcpy(prop->default_value, value, _get_dtype_size(dtype));
+    }
+    dvz_array_destroy(&prop->arr_orig);
+    prop->arr_orig = arr;
+    prop->dtype = dtype;
+
+    // The transformed array is no longer used.
+    dvz_array_destroy(&prop->arr_trans);
+    prop->arr_trans = (DvzArray){0};
+
+    if (count > 0)
+    {
+        _dirty_full(&prop->dirty);
+        prop->obj.request = DVZ_VISUAL_REQUEST_UPLOAD;
+        _source_set_changed(prop->source, true);
+    }
+}
+
+
+
 void dvz_visual_prop_dpi(DvzProp* prop, float dpi_scaling)
 {
     ASSERT(prop != NULL);
@@ -310,6 +424,14 @@ void dvz_visual_data_partial(
         count = 1;
     }
 
+    // Keep track of the items that have changed. The items between the previous end of the array
+    // and the first item are new too.
+    uint32_t old_count = prop->arr_orig.item_count;
+    if (count < old_count || (source != NULL && source->source_kind == DVZ_SOURCE_KIND_UNIFORM))
+        _dirty_full(&prop->dirty);
+    else
+        _dirty_add(&prop->dirty, MIN(first_item, old_count), count - MIN(first_item, old_count));
+
     // Make sure the array has the right size.
     dvz_array_resize(&prop->arr_orig, count);
 
@@ -388,6 +510,13 @@ void dvz_visual_data_source(
     ASSERT(source != NULL);
     ASSERT(source->source_type == source_type);
 
+    // Keep track of the items that have changed.
+    uint32_t old_count = source->arr.item_count;
+    if (count < old_count)
+        _dirty_full(&source->dirty);
+    else
+        _dirty_add(&source->dirty, MIN(first_item, old_count), count - MIN(first_item, old_count));
+
     // Make sure the array has the right size.
     dvz_array_resize(&source->arr, count);
 
@@ -402,6 +531,131 @@ void dvz_visual_data_source(
 
 
 
+void dvz_visual_data_texture(
+    DvzVisual* visual, DvzSourceType source_type, uint32_t source_idx, //
+    uvec3 offset, uvec3 shape, const void* data)
+{
+    ASSERT(visual != NULL);
+    ASSERT(shape[0] > 0);
+    ASSERT(shape[1] > 0);
+    ASSERT(shape[2] > 0);
+    ASSERT(data != NULL);
+
+    // Get the associated source.
+    DvzSource* source = _assert_source_exists(visual, source_type, source_idx);
+    ASSERT(source != NULL);
+    ASSERT(_source_is_texture(source->source_kind));
+    DvzArray* arr = &source->arr;
+    ASSERT(arr->item_size > 0);
+
+    // Do not write into a texture that is not handled by the library, like the default one.
+    if (source->origin == DVZ_SOURCE_ORIGIN_USER)
+        source->u.tex = NULL;
+
+    // Enlarge the array if the box does not fit in it.
+    uvec3 tex_shape = {0};
+    for (uint32_t i = 0; i < 3; i++)
+        tex_shape[i] = MAX(arr->shape[i], offset[i] + shape[i]);
+    if (arr->data == NULL || tex_shape[0] != arr->shape[0] || tex_shape[1] != arr->shape[1] ||
+        tex_shape[2] != arr->shape[2])
+    {
+        dvz_array_reshape(arr, tex_shape[0], tex_shape[1], tex_shape[2]);
+        _dirty_full(&source->dirty);
+    }
+    ASSERT(arr->data != NULL);
+
+    // Copy the box row by row.
+    VkDeviceSize row_size = shape[0] * arr->item_size;
+    const uint8_t* src = (const uint8_t*)data;
+    uint32_t idx = 0;
+    for (uint32_t z = 0; z < shape[2]; z++)
+    {
+        for (uint32_t y = 0; y < shape[1]; y++)
+        {
+            idx = ((offset[2] + z) * arr->shape[1] + offset[1] + y) * arr->shape[0] + offset[0];
+            memcpy(dvz_array_item(arr, idx), src, row_size);
+            src += row_size;
+        }
+    }
+
+    // Keep track of the texels that have changed.
+    _dirty_box_add(&source->dirty, offset, shape);
+
+    source->origin = DVZ_SOURCE_ORIGIN_NOBAKE;
+    _source_set_changed(source, true);
+}
+
+
+
+uint32_t dvz_visual_data_column(
+    DvzVisual* visual, DvzSourceType source_type, uint32_t source_idx, //
+    uint32_t column_count, const void* data)
+{
+    ASSERT(visual != NULL);
+    ASSERT(column_count > 0);
+    ASSERT(data != NULL);
+
+    DvzSource* source = _assert_source_exists(visual, source_type, source_idx);
+    ASSERT(source != NULL);
+    ASSERT(source->source_kind == DVZ_SOURCE_KIND_TEXTURE_2D);
+    DvzArray* arr = &source->arr;
+    uint32_t width = arr->shape[0];
+    uint32_t height = arr->shape[1];
+    if (arr->data == NULL || width == 0)
+    {
+        log_error("the texture must be set with dvz_visual_data_texture() before writing columns");
+        return 0;
+    }
+    ASSERT(column_count <= width);
+
+    // The first time, switch the texture to a repeat address mode along its first axis.
+    if ((source->flags & DVZ_SOURCE_FLAG_CIRCULAR) == 0)
+    {
+        source->flags |= DVZ_SOURCE_FLAG_CIRCULAR;
+        // Otherwise, the texture is created with this address mode, see _source_texture().
+        if (source->u.tex != NULL && source->origin != DVZ_SOURCE_ORIGIN_USER)
+        {
+            // The sampler is recreated, so the frames in flight must not use it anymore, and
+            // the command buffers bound to the previous one must be recorded again.
+            dvz_gpu_wait(visual->canvas->gpu);
+            dvz_texture_address_mode(
+                source->u.tex, DVZ_TEXTURE_AXIS_U, VK_SAMPLER_ADDRESS_MODE_REPEAT);
+            DvzBindings* bindings = _get_bindings(visual, source);
+            dvz_bindings_texture(bindings, source->slot_idx, source->u.tex);
+            dvz_bindings_update(bindings);
+            dvz_visual_to_refill(visual);
+        }
+    }
+
+    // Write the columns in two boxes when they wrap around the right edge of the texture.
+    uint32_t head = source->column_head % width;
+    uint32_t done = 0, n = 0;
+    DvzArray box = dvz_array_3D(2, column_count, height, 1, arr->item_size);
+    while (done < column_count)
+    {
+        n = MIN(column_count - done, width - head);
+        // Extract the columns of the box from the packed input image.
+        for (uint32_t y = 0; y < height; y++)
+        {
+            memcpy(
+                dvz_array_item(&box, y * n),
+                (const uint8_t*)data + (y * column_count + done) * arr->item_size,
+                n * arr->item_size);
+        }
+        dvz_visual_data_texture(
+            visual, source_type, source_idx, (uvec3){head, 0, 0}, (uvec3){n, height, 1},
+            box.data);
+        head = (head + n) % width;
+        done += n;
+    }
+    dvz_array_destroy(&box);
+
+    source->column_head = head;
+    return head;
+}
+
+
+
 // Means that no data updates will be done by datoviz, it is up to the user to update the bound
 // buffer
 void dvz_visual_buffer(
@@ -459,6 +713,14 @@ void dvz_visual_flags(DvzVisual* visual, int flags)
     // Update the vertex buffer at the next call to dvz_visual_update().
     DvzSource* source = _get_pipeline_source(visual, DVZ_SOURCE_TYPE_VERTEX, 0);
     _source_set_changed(source, true);
+    // The whole vertex buffer needs to be baked again.
+    DvzContainerIterator iter = dvz_container_iterator(&visual->props);
+    while (iter.item != NULL)
+    {
+        if (((DvzProp*)iter.item)->source == source)
+            _dirty_full(&((DvzProp*)iter.item)->dirty);
+        dvz_container_iter(&iter);
+    }
 }
 
 
@@ -481,6 +743,9 @@ void dvz_visual_fill_callback(DvzVisual* visual, DvzVisualFillCallback callback)
     DvzCanvas* canvas = visual->canvas;
     ASSERT(canvas != NULL);
     visual->callback_fill = callback;
+    // Custom fill callbacks record their own draw commands.
+    visual->draw_indirect = false;
+    memset(visual->fill_valid, 0, sizeof(visual->fill_valid));
 }
 
 
@@ -499,7 +764,12 @@ void dvz_visual_fill_event(
     ev.viewport = viewport;
     ev.user_data = user_data;
 
+    // When the canvas is profiled, the draw calls of the visual are wrapped by GPU timestamps.
+    DvzCanvas* canvas = visual->canvas;
+    int slot = canvas->profile.enabled ? dvz_canvas_profile_slot(canvas, visual) : -1;
+    dvz_canvas_profile_timestamp(canvas, cmds, cmd_idx, slot, false);
     visual->callback_fill(visual, ev);
+    dvz_canvas_profile_timestamp(canvas, cmds, cmd_idx, slot, true);
 }
 
 
@@ -522,6 +792,70 @@ void dvz_visual_fill_end(DvzCanvas* canvas, DvzCommands* cmds, uint32_t idx)
 
 
 
+DvzCommands* dvz_visual_fill_secondary(
+    DvzVisual* visual, VkClearColorValue clear_color, uint32_t cmd_idx, uint32_t cmd_count,
+    DvzViewport viewport)
+{
+    ASSERT(visual != NULL);
+    DvzCanvas* canvas = visual->canvas;
+    ASSERT(canvas != NULL);
+    ASSERT(cmd_idx < cmd_count);
+    DvzCommands* cmds = &visual->cmds_fill;
+
+    // Allocate the command buffers at the first call, or when the number of swapchain images has
+    // changed.
+    if (cmds->count != cmd_count)
+    {
+        if (cmds->count > 0)
+            dvz_cmd_free(cmds);
+        // NOTE: the canvas command pool may be used from a frame worker thread.
+        *cmds = dvz_commands_pool(
+            canvas->gpu, DVZ_DEFAULT_QUEUE_RENDER, canvas->cmd_pool,
+            VK_COMMAND_BUFFER_LEVEL_SECONDARY, cmd_count);
+        memset(visual->fill_valid, 0, sizeof(visual->fill_valid));
+    }
+
+    // A new viewport or clear color, or toggling the GPU profiling, invalidates the command
+    // buffers of all swapchain images.
+    if (memcmp(&visual->fill_viewport, &viewport.viewport, sizeof(VkViewport)) != 0 ||
+        memcmp(&visual->fill_clear_color, &clear_color, sizeof(VkClearColorValue)) != 0 ||
+        visual->fill_profile != canvas->profile.enabled)
+    {
+        memset(visual->fill_valid, 0, sizeof(visual->fill_valid));
+        visual->fill_viewport = viewport.viewport;
+        visual->fill_clear_color = clear_color;
+        visual->fill_profile = canvas->profile.enabled;
+    }
+
+    if (visual->fill_valid[cmd_idx])
+        return cmds;
+
+    // NOTE: the caller must make sure the command buffer is not in use, the canvas waits for the
+    // fence of the swapchain image before refilling its command buffer.
+    log_trace("record secondary command buffer #%d of visual", cmd_idx);
+    dvz_cmd_reset(cmds, cmd_idx);
+    dvz_cmd_begin_secondary(cmds, cmd_idx, &canvas->renderpass);
+    // The viewport is not inherited from the primary command buffer.
+    dvz_cmd_viewport(cmds, cmd_idx, viewport.viewport);
+    dvz_visual_fill_event(visual, clear_color, cmds, cmd_idx, viewport, NULL);
+    dvz_cmd_end(cmds, cmd_idx);
+    visual->fill_valid[cmd_idx] = true;
+
+    return cmds;
+}
+
+
+
+void dvz_visual_to_refill(DvzVisual* visual)
+{
+    ASSERT(visual != NULL);
+    memset(visual->fill_valid, 0, sizeof(visual->fill_valid));
+    ASSERT(visual->canvas != NULL);
+    dvz_canvas_to_refill(visual->canvas);
+}
+
+
+
 /*************************************************************************************************/
 /*  Baking helpers                                                                               */
 /*************************************************************************************************/
@@ -618,11 +952,11 @@ void* dvz_prop_item(DvzProp* prop, uint32_t prop_idx)
 /*  Data update                                                                                  */
 /*************************************************************************************************/
 
-void dvz_visual_update(
+void dvz_visual_bake(
     DvzVisual* visual, DvzViewport viewport, DvzDataCoords coords, const void* user_data)
 {
     ASSERT(visual != NULL);
-    log_debug("visual update");
+    log_trace("visual bake");
 
     DvzVisualDataEvent ev = {0};
     ev.viewport = viewport;
@@ -638,11 +972,38 @@ void dvz_visual_update(
         // 2. Resize the VERTEX and INDEX array sources accordingly.
         // 3. Possibly resize other sources.
         // 4. Take the props and fill the array sources.
+        DVZ_PROFILE_BEGIN(DVZ_PROFILE_BAKE)
         visual->callback_bake(visual, ev);
+        DVZ_PROFILE_END(DVZ_PROFILE_BAKE)
     }
     // NOTE: we bake the UNIFORM sources here.
     _bake_uniforms(visual);
 
+    // The prop changes have been baked into the sources.
+    DvzContainerIterator iter_prop = dvz_container_iterator(&visual->props);
+    while (iter_prop.item != NULL)
+    {
+        _dirty_clear(&((DvzProp*)iter_prop.item)->dirty);
+        dvz_container_iter(&iter_prop);
+    }
+
+    // The next call to dvz_visual_update() will only upload the baked sources.
+    visual->baked = true;
+}
+
+
+
+static void _visual_update(
+    DvzVisual* visual, DvzViewport viewport, DvzDataCoords coords, const void* user_data)
+{
+    ASSERT(visual != NULL);
+    log_debug("visual update");
+
+    // The visual may have been baked beforehand, possibly in a worker thread.
+    if (!visual->baked)
+        dvz_visual_bake(visual, viewport, coords, user_data);
+    visual->baked = false;
+
     // Here, we assume that all sources are correctly allocated, which includes VERTEX and INDEX
     // arrays, and that they have their data ready for upload.
 
@@ -765,7 +1126,7 @@ void dvz_visual_update(
             ASSERT(arr->item_size > 0);
 
             // Make sure the GPU buffer exists and is allocated with the right size.
-            _source_buffer(visual, source);
+            bool allocated = _source_buffer(visual, source);
 
             ASSERT(br->size > 0);
             VkDeviceSize size = arr->item_count * arr->item_size;
@@ -779,7 +1140,34 @@ void dvz_visual_update(
                 "%d #%d", //
                 arr->item_count, br->size, source->source_type, source->source_idx);
 
-            dvz_upload_buffers(canvas, *br, 0, size, arr->data);
+            // Only upload the items that have changed, unless the buffer region is new or
+            // mappable (with one copy per swapchain image).
+            if (allocated || source->dirty.full || br->count > 1)
+            {
+                dvz_upload_buffers(canvas, *br, 0, size, arr->data);
+            }
+            else
+            {
+                log_trace(
+                    "partial upload of %d/%d items", _dirty_size(&source->dirty, arr->item_count),
+                    arr->item_count);
+                for (uint32_t k = 0; k < source->dirty.count; k++)
+                {
+                    uint32_t first = source->dirty.first[k];
+                    uint32_t last = MIN(source->dirty.last[k], arr->item_count);
+                    if (first >= last)
+                        continue;
+                    dvz_upload_buffers(
+                        canvas, *br, first * arr->item_size, (last - first) * arr->item_size,
+                        (void*)((int64_t)arr->data + (int64_t)(first * arr->item_size)));
+                }
+            }
+            // The next changes are unknown unless the source is baked with dirty ranges, or its
+            // data is set directly with dvz_visual_data_source().
+            if (source->origin == DVZ_SOURCE_ORIGIN_NOBAKE)
+                _dirty_clear(&source->dirty);
+            else
+                _dirty_full(&source->dirty);
             _source_set(source);
             // source->obj.status = DVZ_OBJECT_STATUS_CREATED;
             // visual->obj.status = DVZ_OBJECT_STATUS_CREATED;
@@ -789,7 +1177,7 @@ void dvz_visual_update(
         else if (_source_is_texture(source->source_kind))
         {
             // Make sure the GPU texture exists and is allocated with the right shape.
-            _source_texture(visual, source);
+            bool reallocated = _source_texture(visual, source);
             texture = source->u.tex;
 
             ASSERT(texture != NULL);
@@ -802,13 +1190,38 @@ void dvz_visual_update(
             ASSERT(arr->shape[1] > 0);
             ASSERT(arr->shape[2] > 0);
 
-            log_debug(
-                "upload texture for automatically-handled source %d #%d, shape %dx%dx%d", //
-                source->source_type, source->source_idx,                                  //
-                arr->shape[0], arr->shape[1], arr->shape[2]);
-            dvz_upload_texture(
-                canvas, texture, DVZ_ZERO_OFFSET, DVZ_ZERO_OFFSET,
-                arr->item_count * arr->item_size, arr->data);
+            if (reallocated || source->dirty.full || _dirty_is_clean(&source->dirty))
+            {
+                log_debug(
+                    "upload texture for automatically-handled source %d #%d, shape %dx%dx%d", //
+                    source->source_type, source->source_idx,                                  //
+                    arr->shape[0], arr->shape[1], arr->shape[2]);
+                dvz_upload_texture(
+                    canvas, texture, DVZ_ZERO_OFFSET, DVZ_ZERO_OFFSET,
+                    arr->item_count * arr->item_size, arr->data);
+            }
+            else
+            {
+                // Only upload the box that has changed, straight from the source array.
+                uint32_t* m = source->dirty.box_min;
+                uint32_t* M = source->dirty.box_max;
+                uvec3 shape = {M[0] - m[0], M[1] - m[1], M[2] - m[2]};
+                VkDeviceSize row_pitch = arr->shape[0] * arr->item_size;
+                VkDeviceSize slice_pitch = arr->shape[1] * row_pitch;
+                uint32_t first = (m[2] * arr->shape[1] + m[1]) * arr->shape[0] + m[0];
+                log_debug(
+                    "partial upload of texture source %d #%d, box %dx%dx%d at (%d, %d, %d)",
+                    source->source_type, source->source_idx, //
+                    shape[0], shape[1], shape[2], m[0], m[1], m[2]);
+                dvz_upload_texture_strided(
+                    canvas, texture, m, shape,
+                    shape[0] * shape[1] * shape[2] * arr->item_size, row_pitch, slice_pitch,
+                    dvz_array_item(arr, first));
+            }
+            if (source->origin == DVZ_SOURCE_ORIGIN_NOBAKE)
+                _dirty_clear(&source->dirty);
+            else
+                _dirty_full(&source->dirty);
             _source_set(source);
         }
 
@@ -816,13 +1229,20 @@ void dvz_visual_update(
     }
 
     // Update the bindings that need to be updated.
+    bool rebound = false;
     for (uint32_t i = 0; i < visual->graphics_count; i++)
     {
         bindings = dvz_container_get(&visual->bindings, i);
         ASSERT(bindings != NULL);
         if (bindings->obj.status == DVZ_OBJECT_STATUS_NEED_UPDATE)
+        {
             dvz_bindings_update(bindings);
+            rebound = true;
+        }
     }
+    // Updating the descriptor sets invalidates the command buffers that were recorded with them.
+    if (rebound && visual->cmds_fill.count > 0)
+        dvz_visual_to_refill(visual);
     for (uint32_t i = 0; i < visual->compute_count; i++)
     {
         bindings = dvz_container_get(&visual->bindings_comp, i);
@@ -830,4 +1250,17 @@ void dvz_visual_update(
         if (bindings->obj.status == DVZ_OBJECT_STATUS_NEED_UPDATE)
             dvz_bindings_update(bindings);
     }
+
+    // Upload the number of vertices/indices to draw, if it has changed.
+    _visual_indirect(visual);
+}
+
+
+
+void dvz_visual_update(
+    DvzVisual* visual, DvzViewport viewport, DvzDataCoords coords, const void* user_data)
+{
+    DVZ_PROFILE_BEGIN(DVZ_PROFILE_VISUAL_UPDATE)
+    _visual_update(visual, viewport, coords, user_data);
+    DVZ_PROFILE_END(DVZ_PROFILE_VISUAL_UPDATE)
 }
@@ -5,6 +5,144 @@
 
 
 
+/*************************************************************************************************/
+/*  Dirty ranges                                                                                 */
+/*************************************************************************************************/
+
+static void _dirty_clear(DvzDirtyRanges* dirty)
+{
+    ASSERT(dirty != NULL);
+    dirty->full = false;
+    dirty->count = 0;
+}
+
+
+
+static void _dirty_full(DvzDirtyRanges* dirty)
+{
+    ASSERT(dirty != NULL);
+    dirty->full = true;
+    dirty->count = 0;
+}
+
+
+
+static bool _dirty_is_clean(DvzDirtyRanges* dirty)
+{
+    ASSERT(dirty != NULL);
+    return !dirty->full && dirty->count == 0;
+}
+
+
+
+// Add a range of items, merging it with the ranges it overlaps or touches. When there are too
+// many ranges, the two closest ones are coalesced, so that the set remains small.
+static void _dirty_add(DvzDirtyRanges* dirty, uint32_t first, uint32_t count)
+{
+    ASSERT(dirty != NULL);
+    if (dirty->full || count == 0)
+        return;
+    uint32_t last = first + count;
+
+    // Skip the ranges strictly before the new one.
+    uint32_t i = 0;
+    while (i < dirty->count && dirty->last[i] < first)
+        i++;
+
+    // Merge the new range with the following ranges that overlap or touch it.
+    uint32_t j = i;
+    while (j < dirty->count && dirty->first[j] <= last)
+    {
+        first = MIN(first, dirty->first[j]);
+        last = MAX(last, dirty->last[j]);
+        j++;
+    }
+
+    // Rebuild the sorted ranges, with possibly one range in excess.
+    uint32_t firsts[DVZ_MAX_DIRTY_RANGES + 1] = {0};
+    uint32_t lasts[DVZ_MAX_DIRTY_RANGES + 1] = {0};
+    uint32_t n = 0;
+    for (uint32_t k = 0; k < i; k++, n++)
+    {
+        firsts[n] = dirty->first[k];
+        lasts[n] = dirty->last[k];
+    }
+    firsts[n] = first;
+    lasts[n] = last;
+    n++;
+    for (uint32_t k = j; k < dirty->count; k++, n++)
+    {
+        firsts[n] = dirty->first[k];
+        lasts[n] = dirty->last[k];
+    }
+
+    // Coalesce the two ranges separated by the smallest gap.
+    if (n > DVZ_MAX_DIRTY_RANGES)
+    {
+        uint32_t best = 0;
+        for (uint32_t k = 1; k < n - 1; k++)
+        {
+            if (firsts[k + 1] - lasts[k] < firsts[best + 1] - lasts[best])
+                best = k;
+        }
+        lasts[best] = lasts[best + 1];
+        for (uint32_t k = best + 1; k < n - 1; k++)
+        {
+            firsts[k] = firsts[k + 1];
+            lasts[k] = lasts[k + 1];
+        }
+        n--;
+    }
+    ASSERT(n <= DVZ_MAX_DIRTY_RANGES);
+
+    memcpy(dirty->first, firsts, n * sizeof(uint32_t));
+    memcpy(dirty->last, lasts, n * sizeof(uint32_t));
+    dirty->count = n;
+}
+
+
+
+// Add a box of texels of a texture source, growing the dirty bounding box.
+static void _dirty_box_add(DvzDirtyRanges* dirty, uvec3 offset, uvec3 shape)
+{
+    ASSERT(dirty != NULL);
+    if (dirty->full)
+        return;
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        if (dirty->count == 0)
+        {
+            dirty->box_min[i] = offset[i];
+            dirty->box_max[i] = offset[i] + shape[i];
+        }
+        else
+        {
+            dirty->box_min[i] = MIN(dirty->box_min[i], offset[i]);
+            dirty->box_max[i] = MAX(dirty->box_max[i], offset[i] + shape[i]);
+        }
+    }
+    dirty->count = 1;
+}
+
+
+
+// Number of dirty items in an array with a given number of items.
+static uint32_t _dirty_size(DvzDirtyRanges* dirty, uint32_t item_count)
+{
+    ASSERT(dirty != NULL);
+    if (dirty->full)
+        return item_count;
+    uint32_t size = 0;
+    for (uint32_t k = 0; k < dirty->count; k++)
+    {
+        if (dirty->first[k] < item_count)
+            size += MIN(dirty->last[k], item_count) - dirty->first[k];
+    }
+    return size;
+}
+
+
+
 /*************************************************************************************************/
 /*  Visual utils                                                                                 */
 /*************************************************************************************************/
@@ -84,6 +222,9 @@ static void _source_set_changed(DvzSource* source, bool value)
     ASSERT(source->visual != NULL);
     // Mark the visual as to be changed to.
     source->visual->obj.request = req;
+    // The scene picks up the change at the next frame, which an idle canvas must render.
+    if (value && source->visual->canvas != NULL)
+        dvz_canvas_to_render(source->visual->canvas);
 }
 
 
@@ -147,6 +288,25 @@ static VkFormat _get_texture_format(DvzVisual* visual, DvzSource* source)
         dvz_container_iter(&iter);
     }
 
+    // Without a texture prop, infer the format from the size of the source items.
+    if (dtype == DVZ_DTYPE_NONE)
+    {
+        switch (source->arr.item_size)
+        {
+        case 1:
+            dtype = DVZ_DTYPE_CHAR;
+            break;
+        case 2:
+            dtype = DVZ_DTYPE_USHORT;
+            break;
+        case 4:
+            dtype = DVZ_DTYPE_CVEC4;
+            break;
+        default:
+            break;
+        }
+    }
+
     ASSERT(dtype != DVZ_DTYPE_NONE);
     VkFormat format = VK_FORMAT_UNDEFINED;
     switch (dtype)
@@ -301,7 +461,7 @@ static void _create_source_buffer(DvzCanvas* canvas, DvzSource* source, VkDevice
     switch (source->source_kind)
     {
     case DVZ_SOURCE_KIND_VERTEX:
-        type = DVZ_BUFFER_TYPE_VERTEX;
+        type = mappable ? DVZ_BUFFER_TYPE_VERTEX_MAPPABLE : DVZ_BUFFER_TYPE_VERTEX;
         break;
     case DVZ_SOURCE_KIND_INDEX:
         type = DVZ_BUFFER_TYPE_INDEX;
@@ -317,13 +477,17 @@ static void _create_source_buffer(DvzCanvas* canvas, DvzSource* source, VkDevice
         return;
         break;
     }
-    uint32_t buf_count = source->source_type == mappable ? canvas->swapchain.img_count : 1;
+    // Mappable buffers have one region per swapchain image.
+    bool per_image =
+        type == DVZ_BUFFER_TYPE_UNIFORM_MAPPABLE || type == DVZ_BUFFER_TYPE_VERTEX_MAPPABLE;
+    uint32_t buf_count = per_image ? canvas->swapchain.img_count : 1;
     source->u.br = dvz_ctx_buffers(ctx, type, buf_count, size);
 }
 
 
 
-static void _source_buffer(DvzVisual* visual, DvzSource* source)
+// Return whether a new buffer region was allocated.
+static bool _source_buffer(DvzVisual* visual, DvzSource* source)
 {
     ASSERT(visual != NULL);
     ASSERT(source != NULL);
@@ -343,16 +507,27 @@ static void _source_buffer(DvzVisual* visual, DvzSource* source)
         log_debug(
             "need to %sallocate new buffer region to fit %d elements (%d bytes)",
             source->u.br.size > 0 ? "re" : "", count, size);
+        // Release the previous buffer region so that its space can be reused.
+        if (source->u.br.buffer != VK_NULL_HANDLE)
+            dvz_ctx_buffers_free(canvas->gpu->context, &source->u.br);
         _create_source_buffer(canvas, source, size);
         // Set the pipeline bindings with the source buffer.
         _set_source_bindings(visual, source);
+        ASSERT(source->u.br.buffer != VK_NULL_HANDLE);
+        // The recorded command buffers bind the previous buffer region.
+        if (source->source_kind == DVZ_SOURCE_KIND_VERTEX ||
+            source->source_kind == DVZ_SOURCE_KIND_INDEX)
+            dvz_visual_to_refill(visual);
+        return true;
     }
     ASSERT(source->u.br.buffer != VK_NULL_HANDLE);
+    return false;
 }
 
 
 
-static void _source_texture(DvzVisual* visual, DvzSource* source)
+// Return whether the texture has been created or resized, in which case it must be uploaded fully.
+static bool _source_texture(DvzVisual* visual, DvzSource* source)
 {
     ASSERT(visual != NULL);
     ASSERT(source != NULL);
@@ -384,6 +559,9 @@ static void _source_texture(DvzVisual* visual, DvzSource* source)
                 "need to create new texture with shape %dx%dx%d", //
                 shape[0], shape[1], shape[2]);
             tex = source->u.tex = dvz_ctx_texture(ctx, ndims, shape, format);
+            if ((source->flags & DVZ_SOURCE_FLAG_CIRCULAR) != 0)
+                dvz_texture_address_mode(
+                    tex, DVZ_TEXTURE_AXIS_U, VK_SAMPLER_ADDRESS_MODE_REPEAT);
         }
         else
         {
@@ -397,8 +575,10 @@ static void _source_texture(DvzVisual* visual, DvzSource* source)
         // Set bindings.
         DvzBindings* bindings = _get_bindings(visual, source);
         dvz_bindings_texture(bindings, source->slot_idx, tex);
+        return true;
     }
     ASSERT(source->u.tex != NULL);
+    return false;
 }
 
 
@@ -441,11 +621,60 @@ static void _prop_copy(DvzVisual* visual, DvzProp* prop)
     }
 
     log_debug("copy prop type %d to source buffer", prop->prop_type);
-    dvz_array_column(
-        &source->arr, prop->offset, col_size, 0, source->arr.item_count, //
-        arr->item_count, arr->data,                                      //
-        prop->arr_orig.dtype, prop->target_dtype,                        // optional cast
-        prop->copy_type, prop->reps);
+    if (prop->normalize)
+        dvz_transform_pos_column(
+            prop->coords, &source->arr, prop->offset, 0, source->arr.item_count, //
+            arr->item_count, arr->data,                                          //
+            prop->arr_orig.dtype, prop->target_dtype,                            // fused cast
+            prop->copy_type, prop->reps);
+    else
+        dvz_array_column(
+            &source->arr, prop->offset, col_size, 0, source->arr.item_count, //
+            arr->item_count, arr->data,                                      //
+            prop->arr_orig.dtype, prop->target_dtype,                        // optional cast
+            prop->copy_type, prop->reps);
+}
+
+
+
+// Copy the props to the items [first, first + count) of the source array only.
+static void _prop_copy_range(DvzProp* prop, uint32_t first, uint32_t count)
+{
+    ASSERT(prop != NULL);
+    DvzSource* source = prop->source;
+    ASSERT(source != NULL);
+    ASSERT(count > 0);
+    ASSERT(first + count <= source->arr.item_count);
+
+    DvzArray* arr = _prop_array(prop);
+    if (arr->data == NULL || prop->copy_type == DVZ_ARRAY_COPY_NONE)
+        return;
+    ASSERT(arr->item_count > 0);
+    // DPI scaling requires the whole prop to be copied.
+    ASSERT(prop->dpi_scaling == 1);
+
+    VkDeviceSize col_size = _get_dtype_size(prop->dtype);
+    ASSERT(col_size > 0);
+
+    // Start at the first source item of a prop item, so that the repeats are aligned, and find
+    // the corresponding prop item, knowing that the last prop item is repeated.
+    uint32_t reps = MAX(1, prop->reps);
+    uint32_t start = first - first % reps;
+    uint32_t item = MIN(start / reps, arr->item_count - 1);
+    const void* data = (const void*)((int64_t)arr->data + (int64_t)(item * arr->item_size));
+
+    if (prop->normalize)
+        dvz_transform_pos_column(
+            prop->coords, &source->arr, prop->offset, start, first + count - start, //
+            arr->item_count - item, data,                                            //
+            prop->arr_orig.dtype, prop->target_dtype,                                // fused cast
+            prop->copy_type, prop->reps);
+    else
+        dvz_array_column(
+            &source->arr, prop->offset, col_size, start, first + count - start, //
+            arr->item_count - item, data,                                        //
+            prop->arr_orig.dtype, prop->target_dtype,                            // optional cast
+            prop->copy_type, prop->reps);
 }
 
 
@@ -503,6 +732,79 @@ _get_pipeline_source(DvzVisual* visual, DvzSourceType source_type, uint32_t pipe
 
 
 
+static void _default_visual_bake(DvzVisual* visual, DvzVisualDataEvent ev);
+
+// Bake again only the source items that depend on the prop items that have changed. Return false
+// if the whole source needs to be baked.
+static bool _bake_source_partial(DvzVisual* visual, DvzSource* source, uint32_t count)
+{
+    ASSERT(visual != NULL);
+    ASSERT(source != NULL);
+
+    // Custom baking functions may not map prop items to source items.
+    if (visual->callback_bake != _default_visual_bake)
+        return false;
+
+    // The source must have been baked and uploaded before, and must not shrink.
+    uint32_t old_count = source->arr.item_count;
+    if (source->u.br.buffer == VK_NULL_HANDLE || old_count == 0 || count < old_count)
+        return false;
+
+    // Map the dirty prop items to dirty source items.
+    DvzDirtyRanges dirty = {0};
+    DvzArray* arr = NULL;
+    DvzProp* prop = NULL;
+    DvzContainerIterator iter = dvz_container_iterator(&visual->props);
+    while (iter.item != NULL)
+    {
+        prop = iter.item;
+        dvz_container_iter(&iter);
+        if (prop->source != source)
+            continue;
+        if (prop->dirty.full || prop->dpi_scaling != 1 || prop->arr_staging.item_count > 0)
+            return false;
+
+        arr = _prop_array(prop);
+        uint32_t reps = MAX(1, prop->reps);
+        for (uint32_t k = 0; k < prop->dirty.count; k++)
+        {
+            uint32_t first = prop->dirty.first[k] * reps;
+            uint32_t last = prop->dirty.last[k] * reps;
+            // The last prop item is repeated until the end of the source.
+            if (prop->dirty.last[k] >= arr->item_count)
+                last = count;
+            last = MIN(last, count);
+            if (first < last)
+                _dirty_add(&dirty, first, last - first);
+        }
+    }
+
+    // New source items.
+    if (count > old_count)
+        _dirty_add(&dirty, old_count, count - old_count);
+
+    log_debug(
+        "partial baking of source %d, %d/%d items", source->source_kind,
+        _dirty_size(&dirty, count), count);
+
+    _source_alloc(visual, source, count);
+    for (uint32_t k = 0; k < dirty.count; k++)
+    {
+        iter = dvz_container_iterator(&visual->props);
+        while (iter.item != NULL)
+        {
+            prop = iter.item;
+            if (prop->source == source)
+                _prop_copy_range(prop, dirty.first[k], dirty.last[k] - dirty.first[k]);
+            dvz_container_iter(&iter);
+        }
+    }
+    source->dirty = dirty;
+    return true;
+}
+
+
+
 static void _bake_source(DvzVisual* visual, DvzSource* source)
 {
     ASSERT(visual != NULL);
@@ -527,6 +829,10 @@ static void _bake_source(DvzVisual* visual, DvzSource* source)
         return;
     }
 
+    // Only bake the items that have changed, if possible.
+    if (_bake_source_partial(visual, source, count))
+        return;
+
     log_debug("baking source %d", source->source_kind);
 
     // Allocate the source array.
@@ -534,6 +840,7 @@ static void _bake_source(DvzVisual* visual, DvzSource* source)
 
     // Copy all corresponding props to the array.
     _source_fill(visual, source);
+    _dirty_full(&source->dirty);
 }
 
 
@@ -563,6 +870,7 @@ static void _bake_uniforms(DvzVisual* visual)
             ASSERT(count > 0);
             _source_alloc(visual, source, count);
             _source_fill(visual, source);
+            _dirty_full(&source->dirty);
         }
         dvz_container_iter(&iter);
     }
@@ -570,6 +878,81 @@ static void _bake_uniforms(DvzVisual* visual)
 
 
 
+/*************************************************************************************************/
+/*  Indirect draw                                                                                */
+/*************************************************************************************************/
+
+// Upload the indirect draw parameters of the graphics pipelines whose number of vertices or
+// indices has changed. A refill is only needed when the draw command itself changes.
+static void _visual_indirect(DvzVisual* visual)
+{
+    ASSERT(visual != NULL);
+    DvzCanvas* canvas = visual->canvas;
+    ASSERT(canvas != NULL);
+    DvzContext* ctx = canvas->gpu->context;
+    ASSERT(ctx != NULL);
+
+    for (uint32_t pipeline_idx = 0; pipeline_idx < visual->graphics_count; pipeline_idx++)
+    {
+        // Nothing to draw until the vertex buffer exists.
+        DvzSource* vertex_source =
+            _get_pipeline_source(visual, DVZ_SOURCE_TYPE_VERTEX, pipeline_idx);
+        if (vertex_source == NULL || vertex_source->u.br.buffer == NULL)
+            continue;
+        uint32_t vertex_count = vertex_source->arr.item_count;
+
+        DvzSource* index_source =
+            _get_pipeline_source(visual, DVZ_SOURCE_TYPE_INDEX, pipeline_idx);
+        uint32_t index_count = 0;
+        if (index_source != NULL && index_source->u.br.buffer != NULL)
+            index_count = index_source->arr.item_count;
+        bool indexed = index_count > 0;
+
+        DvzBufferRegions* br = &visual->indirect[pipeline_idx];
+        DvzIndirectArgs* args = &visual->indirect_args[pipeline_idx];
+        bool allocated = false;
+        if (br->buffer == NULL)
+        {
+            *br = dvz_ctx_buffers(
+                ctx, DVZ_BUFFER_TYPE_INDIRECT, 1, sizeof(VkDrawIndexedIndirectCommand));
+            allocated = true;
+        }
+        else if (
+            indexed == visual->indirect_indexed[pipeline_idx] &&
+            args->draw.vertexCount == (indexed ? index_count : vertex_count))
+        {
+            continue;
+        }
+
+        // NOTE: the GPU reads the parameters straight from the visual struct when the transfer
+        // is processed, which happens before the next frame is submitted.
+        memset(args, 0, sizeof(DvzIndirectArgs));
+        VkDeviceSize size = 0;
+        if (indexed)
+        {
+            log_debug("indirect draw of %d indices", index_count);
+            args->draw_indexed.indexCount = index_count;
+            args->draw_indexed.instanceCount = 1;
+            size = sizeof(VkDrawIndexedIndirectCommand);
+        }
+        else
+        {
+            log_debug("indirect draw of %d vertices", vertex_count);
+            args->draw.vertexCount = vertex_count;
+            args->draw.instanceCount = 1;
+            size = sizeof(VkDrawIndirectCommand);
+        }
+        dvz_upload_buffers(canvas, *br, 0, size, args);
+
+        // The command buffers must be recorded again if they do not draw from this region yet,
+        // or if the draw switches between indexed and non-indexed.
+        if (allocated || indexed != visual->indirect_indexed[pipeline_idx])
+            dvz_visual_to_refill(visual);
+    }
+}
+
+
+
 /*************************************************************************************************/
 /*  Visual default callbacks                                                                     */
 /*************************************************************************************************/
@@ -616,13 +999,17 @@ static void _default_visual_fill(DvzVisual* visual, DvzVisualFillEvent ev)
         ASSERT(vertex_source != NULL);
         ASSERT(vertex_source->pipeline_idx == pipeline_idx);
 
+        // NOTE: with indirect draw parameters, an empty vertex buffer may be filled later without
+        // recording the command buffer again.
+        DvzBufferRegions* indirect = &visual->indirect[pipeline_idx];
+        bool draw_indirect = visual->draw_indirect && indirect->buffer != NULL;
         uint32_t vertex_count = vertex_source->arr.item_count;
-        if (vertex_count == 0)
+        if (vertex_count == 0 && !draw_indirect)
         {
             log_warn("skip this graphics pipeline as the vertex buffer is empty");
             continue;
         }
-        ASSERT(vertex_count > 0);
+        ASSERT(vertex_count > 0 || draw_indirect);
 
         // Bind the vertex buffer.
         DvzBufferRegions* vertex_buf = &vertex_source->u.br;
@@ -648,7 +1035,18 @@ static void _default_visual_fill(DvzVisual* visual, DvzVisualFillEvent ev)
         // Draw command.
         dvz_cmd_bind_graphics(cmds, idx, visual->graphics[pipeline_idx], bindings, 0);
 
-        if (index_count == 0)
+        // Draw with the indirect draw parameters when they are available, so that the number of
+        // vertices/indices may change without recording the command buffer again.
+        if (draw_indirect)
+        {
+            ASSERT(indirect->count == 1);
+            visual->indirect_indexed[pipeline_idx] = index_count > 0;
+            if (index_count == 0)
+                dvz_cmd_draw_indirect(cmds, idx, *indirect);
+            else
+                dvz_cmd_draw_indexed_indirect(cmds, idx, *indirect);
+        }
+        else if (index_count == 0)
         {
             log_debug("draw %d vertices", vertex_count);
             // Make sure the bound vertex buffer is large enough.
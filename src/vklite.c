@@ -25,6 +25,10 @@ DvzApp* dvz_app(DvzBackend backend)
     app->windows =
         dvz_container(DVZ_CONTAINER_DEFAULT_COUNT, sizeof(DvzWindow), DVZ_OBJECT_TYPE_WINDOW);
 
+    // Queues of the frame workers, which are only started by dvz_app_workers().
+    app->frame_jobs = dvz_fifo(DVZ_MAX_FRAME_WORKERS);
+    app->frame_done = dvz_fifo(DVZ_MAX_FRAME_WORKERS);
+
     // Which extensions are required? Depends on the backend.
     uint32_t required_extension_count = 0;
     const char** required_extensions = backend_extensions(backend, &required_extension_count);
@@ -77,6 +81,11 @@ int dvz_app_destroy(DvzApp* app)
     log_debug("starting destruction of app...");
     dvz_app_wait(app);
 
+    // Stop the frame workers.
+    dvz_app_workers(app, 0);
+    dvz_fifo_destroy(&app->frame_jobs);
+    dvz_fifo_destroy(&app->frame_done);
+
     // Destroy the canvases.
     dvz_canvases_destroy(&app->canvases);
 
@@ -180,6 +189,13 @@ void dvz_gpu_create(DvzGpu* gpu, VkSurfaceKHR surface)
     // Create descriptor pool.
     create_descriptor_pool(gpu->device, &gpu->dset_pool);
 
+    // Create the pipeline cache, from the cache saved on disk by a previous run if possible.
+    if (!pipeline_cache_path(
+            &gpu->device_properties, gpu->pipeline_cache_path, sizeof(gpu->pipeline_cache_path)))
+        gpu->pipeline_cache_path[0] = 0;
+    create_pipeline_cache(
+        gpu->device, &gpu->device_properties, gpu->pipeline_cache_path, &gpu->pipeline_cache);
+
     dvz_obj_created(&gpu->obj);
     log_trace("GPU #%d created", gpu->idx);
 }
@@ -222,6 +238,14 @@ void dvz_app_wait(DvzApp* app)
 
 
 
+void dvz_gpu_pipeline_cache_save(DvzGpu* gpu)
+{
+    ASSERT(gpu != NULL);
+    save_pipeline_cache(gpu->device, gpu->pipeline_cache, gpu->pipeline_cache_path);
+}
+
+
+
 void dvz_gpu_destroy(DvzGpu* gpu)
 {
     log_trace("starting destruction of GPU #%d...", gpu->idx);
@@ -262,6 +286,15 @@ void dvz_gpu_destroy(DvzGpu* gpu)
     }
 
 
+    if (gpu->pipeline_cache != VK_NULL_HANDLE)
+    {
+        log_trace("save and destroy pipeline cache");
+        dvz_gpu_pipeline_cache_save(gpu);
+        vkDestroyPipelineCache(gpu->device, gpu->pipeline_cache, NULL);
+        gpu->pipeline_cache = VK_NULL_HANDLE;
+    }
+
+
     // Destroy the device.
     log_trace("destroy device");
     if (gpu->device != VK_NULL_HANDLE)
@@ -601,6 +634,59 @@ void dvz_swapchain_destroy(DvzSwapchain* swapchain)
 /*************************************************************************************************/
 
 DvzCommands dvz_commands(DvzGpu* gpu, uint32_t queue, uint32_t count)
+{
+    ASSERT(gpu != NULL);
+    ASSERT(queue < gpu->queues.queue_count);
+    uint32_t qf = gpu->queues.queue_families[queue];
+    ASSERT(qf < gpu->queues.queue_family_count);
+    return dvz_commands_pool(
+        gpu, queue, gpu->queues.cmd_pools[qf], VK_COMMAND_BUFFER_LEVEL_PRIMARY, count);
+}
+
+
+
+DvzCommands dvz_commands_secondary(DvzGpu* gpu, uint32_t queue, uint32_t count)
+{
+    ASSERT(gpu != NULL);
+    ASSERT(queue < gpu->queues.queue_count);
+    uint32_t qf = gpu->queues.queue_families[queue];
+    ASSERT(qf < gpu->queues.queue_family_count);
+    return dvz_commands_pool(
+        gpu, queue, gpu->queues.cmd_pools[qf], VK_COMMAND_BUFFER_LEVEL_SECONDARY, count);
+}
+
+
+
+VkCommandPool dvz_command_pool(DvzGpu* gpu, uint32_t queue)
+{
+    ASSERT(gpu != NULL);
+    ASSERT(dvz_obj_is_created(&gpu->obj));
+    ASSERT(queue < gpu->queues.queue_count);
+    uint32_t qf = gpu->queues.queue_families[queue];
+    ASSERT(qf < gpu->queues.queue_family_count);
+
+    VkCommandPool pool = VK_NULL_HANDLE;
+    create_command_pool(gpu->device, qf, &pool);
+    return pool;
+}
+
+
+
+void dvz_command_pool_destroy(DvzGpu* gpu, VkCommandPool* pool)
+{
+    ASSERT(gpu != NULL);
+    ASSERT(pool != NULL);
+    if (*pool == VK_NULL_HANDLE)
+        return;
+    log_trace("destroy command pool");
+    vkDestroyCommandPool(gpu->device, *pool, NULL);
+    *pool = VK_NULL_HANDLE;
+}
+
+
+
+DvzCommands dvz_commands_pool(
+    DvzGpu* gpu, uint32_t queue, VkCommandPool pool, VkCommandBufferLevel level, uint32_t count)
 {
     ASSERT(gpu != NULL);
     ASSERT(dvz_obj_is_created(&gpu->obj));
@@ -608,16 +694,19 @@ DvzCommands dvz_commands(DvzGpu* gpu, uint32_t queue, uint32_t count)
     ASSERT(count <= DVZ_MAX_COMMAND_BUFFERS_PER_SET);
     ASSERT(queue < gpu->queues.queue_count);
     ASSERT(count > 0);
-    uint32_t qf = gpu->queues.queue_families[queue];
-    ASSERT(qf < gpu->queues.queue_family_count);
-    ASSERT(gpu->queues.cmd_pools[qf] != VK_NULL_HANDLE);
-    log_trace("creating commands on queue #%d, queue family #%d", queue, qf);
+    ASSERT(pool != VK_NULL_HANDLE);
+    log_trace(
+        "creating %s commands on queue #%d, queue family #%d",
+        level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? "primary" : "secondary", queue,
+        gpu->queues.queue_families[queue]);
 
     DvzCommands commands = {0};
     commands.gpu = gpu;
     commands.queue_idx = queue;
+    commands.pool = pool;
+    commands.level = level;
     commands.count = count;
-    allocate_command_buffers(gpu->device, gpu->queues.cmd_pools[qf], count, commands.cmds);
+    allocate_command_buffers(gpu->device, pool, level, count, commands.cmds);
 
     dvz_obj_init(&commands.obj);
 
@@ -638,6 +727,30 @@ void dvz_cmd_begin(DvzCommands* cmds, uint32_t idx)
 
 
 
+void dvz_cmd_begin_secondary(DvzCommands* cmds, uint32_t idx, DvzRenderpass* renderpass)
+{
+    ASSERT(cmds != NULL);
+    ASSERT(cmds->count > 0);
+    ASSERT(cmds->level == VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+    ASSERT(renderpass != NULL);
+    ASSERT(renderpass->renderpass != VK_NULL_HANDLE);
+
+    // The framebuffer is left unspecified so that the command buffer remains valid when the
+    // framebuffers are recreated, for example after a resize.
+    VkCommandBufferInheritanceInfo inheritance = {0};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance.renderPass = renderpass->renderpass;
+    inheritance.subpass = 0;
+
+    VkCommandBufferBeginInfo begin_info = {0};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    begin_info.pInheritanceInfo = &inheritance;
+    VK_CHECK_RESULT(vkBeginCommandBuffer(cmds->cmds[idx], &begin_info));
+}
+
+
+
 void dvz_cmd_end(DvzCommands* cmds, uint32_t idx)
 {
     ASSERT(cmds != NULL);
@@ -671,9 +784,8 @@ void dvz_cmd_free(DvzCommands* cmds)
     ASSERT(cmds->gpu->device != VK_NULL_HANDLE);
 
     log_trace("free %d command buffer(s)", cmds->count);
-    vkFreeCommandBuffers(
-        cmds->gpu->device, cmds->gpu->queues.cmd_pools[cmds->queue_idx], //
-        cmds->count, cmds->cmds);
+    ASSERT(cmds->pool != VK_NULL_HANDLE);
+    vkFreeCommandBuffers(cmds->gpu->device, cmds->pool, cmds->count, cmds->cmds);
 
     dvz_obj_init(&cmds->obj);
 }
@@ -1787,7 +1899,7 @@ void dvz_compute_create(DvzCompute* compute)
     }
 
     create_compute_pipeline(
-        compute->gpu->device, compute->shader_module, //
+        compute->gpu->device, compute->gpu->pipeline_cache, compute->shader_module, //
         compute->slots.pipeline_layout, &compute->pipeline);
 
     dvz_obj_created(&compute->obj);
@@ -1823,11 +1935,39 @@ void dvz_compute_destroy(DvzCompute* compute)
         compute->pipeline = VK_NULL_HANDLE;
     }
 
+    dvz_queries_destroy(&compute->queries);
+
     dvz_obj_destroyed(&compute->obj);
 }
 
 
 
+void dvz_compute_timestamps(DvzCompute* compute, bool enable)
+{
+    ASSERT(compute != NULL);
+    ASSERT(compute->gpu != NULL);
+    if (enable && !dvz_obj_is_created(&compute->queries.obj))
+        compute->queries = dvz_queries(compute->gpu, VK_QUERY_TYPE_TIMESTAMP, 2);
+    else if (!enable)
+        dvz_queries_destroy(&compute->queries);
+}
+
+
+
+double dvz_compute_gpu_time(DvzCompute* compute)
+{
+    ASSERT(compute != NULL);
+    if (!dvz_obj_is_created(&compute->queries.obj))
+        return -1;
+    uint64_t results[4] = {0};
+    if (!dvz_queries_results(&compute->queries, 0, 2, results))
+        return -1;
+    return dvz_gpu_timestamps_elapsed(
+        compute->gpu, compute->queries.queue_idx, results[0], results[2]);
+}
+
+
+
 /*************************************************************************************************/
 /*  Graphics                                                                                     */
 /*************************************************************************************************/
@@ -1909,6 +2049,19 @@ void dvz_graphics_shader_spirv(
 
 
 
+void dvz_graphics_shader_module(
+    DvzGraphics* graphics, VkShaderStageFlagBits stage, VkShaderModule module)
+{
+    ASSERT(graphics != NULL);
+    ASSERT(module != VK_NULL_HANDLE);
+
+    graphics->shader_stages[graphics->shader_count] = stage;
+    graphics->shader_shared[graphics->shader_count] = true;
+    graphics->shader_modules[graphics->shader_count++] = module;
+}
+
+
+
 void dvz_graphics_vertex_binding(DvzGraphics* graphics, uint32_t binding, VkDeviceSize stride)
 {
     ASSERT(graphics != NULL);
@@ -1975,6 +2128,42 @@ void dvz_graphics_front_face(DvzGraphics* graphics, VkFrontFace front_face)
 
 
 
+void dvz_graphics_specialization(DvzGraphics* graphics, uint32_t id, const void* value)
+{
+    ASSERT(graphics != NULL);
+    ASSERT(value != NULL);
+    if (graphics->pipeline != VK_NULL_HANDLE)
+    {
+        log_error("specialization constants must be set before the pipeline is compiled");
+        return;
+    }
+    // Builtin graphics are shared by all visuals with the same type, flags, and constants.
+    if (graphics->type != DVZ_GRAPHICS_NONE && graphics->type != DVZ_GRAPHICS_CUSTOM)
+    {
+        log_error("builtin graphics are shared, use dvz_graphics_builtin_specialized() instead");
+        return;
+    }
+    DvzSpecialization* spec = &graphics->specialization;
+
+    // Replace the value of an existing constant.
+    uint32_t i = 0;
+    for (i = 0; i < spec->count; i++)
+        if (spec->ids[i] == id)
+            break;
+    if (i == spec->count)
+    {
+        if (spec->count >= DVZ_MAX_SPECIALIZATION_CONSTANTS)
+        {
+            log_error("maximum number of specialization constants reached");
+            return;
+        }
+        spec->ids[spec->count++] = id;
+    }
+    memcpy(&spec->values[i], value, sizeof(uint32_t));
+}
+
+
+
 void dvz_graphics_slot(DvzGraphics* graphics, uint32_t idx, VkDescriptorType type)
 {
     ASSERT(graphics != NULL);
@@ -1993,6 +2182,15 @@ void dvz_graphics_push(
 
 
 void dvz_graphics_create(DvzGraphics* graphics)
+{
+    ASSERT(graphics != NULL);
+    dvz_graphics_create_deferred(graphics);
+    dvz_graphics_pipeline(graphics);
+}
+
+
+
+void dvz_graphics_create_deferred(DvzGraphics* graphics)
 {
     ASSERT(graphics != NULL);
     ASSERT(graphics->gpu != NULL);
@@ -2001,6 +2199,22 @@ void dvz_graphics_create(DvzGraphics* graphics)
     if (!dvz_obj_is_created(&graphics->slots.obj))
         dvz_slots_create(&graphics->slots);
 
+    // The graphics may be bound as soon as its pipeline layout exists, the pipeline itself is
+    // compiled later.
+    dvz_obj_created(&graphics->obj);
+}
+
+
+
+void dvz_graphics_pipeline(DvzGraphics* graphics)
+{
+    ASSERT(graphics != NULL);
+    ASSERT(graphics->gpu != NULL);
+    ASSERT(graphics->gpu->device != VK_NULL_HANDLE);
+    if (graphics->pipeline != VK_NULL_HANDLE || !dvz_obj_is_created(&graphics->obj))
+        return;
+    ASSERT(dvz_obj_is_created(&graphics->slots.obj));
+
     log_trace("starting creation of graphics pipeline...");
 
     VkPipelineVertexInputStateCreateInfo vertex_input_info = {0};
@@ -2029,6 +2243,21 @@ void dvz_graphics_create(DvzGraphics* graphics)
     vertex_input_info.vertexAttributeDescriptionCount = graphics->vertex_attr_count;
     vertex_input_info.pVertexAttributeDescriptions = attrs_info;
 
+    // Specialization constants.
+    DvzSpecialization* spec = &graphics->specialization;
+    VkSpecializationMapEntry spec_entries[DVZ_MAX_SPECIALIZATION_CONSTANTS] = {0};
+    for (uint32_t i = 0; i < spec->count; i++)
+    {
+        spec_entries[i].constantID = spec->ids[i];
+        spec_entries[i].offset = i * sizeof(uint32_t);
+        spec_entries[i].size = sizeof(uint32_t);
+    }
+    VkSpecializationInfo spec_info = {0};
+    spec_info.mapEntryCount = spec->count;
+    spec_info.pMapEntries = spec_entries;
+    spec_info.dataSize = spec->count * sizeof(uint32_t);
+    spec_info.pData = spec->values;
+
     // Shaders.
     VkPipelineShaderStageCreateInfo shader_stages[DVZ_MAX_SHADERS_PER_GRAPHICS] = {0};
     for (uint32_t i = 0; i < graphics->shader_count; i++)
@@ -2039,6 +2268,9 @@ void dvz_graphics_create(DvzGraphics* graphics)
         ASSERT(graphics->shader_stages[i] != VK_NULL_HANDLE);
         ASSERT(graphics->shader_modules[i] != NULL);
         shader_stages[i].pName = "main";
+        // NOTE: constants that are not declared in a shader stage are ignored by that stage.
+        if (spec->count > 0)
+            shader_stages[i].pSpecializationInfo = &spec_info;
     }
 
     // Pipeline.
@@ -2077,11 +2309,11 @@ void dvz_graphics_create(DvzGraphics* graphics)
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
     VK_CHECK_RESULT(vkCreateGraphicsPipelines(
-        graphics->gpu->device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &graphics->pipeline));
+        graphics->gpu->device, graphics->gpu->pipeline_cache, 1, &pipelineInfo, NULL,
+        &graphics->pipeline));
     if (graphics->pipeline != VK_NULL_HANDLE)
     {
         log_trace("graphics pipeline created");
-        dvz_obj_created(&graphics->obj);
     }
     else
     {
@@ -2091,6 +2323,61 @@ void dvz_graphics_create(DvzGraphics* graphics)
 
 
 
+// Graphics pipelines compiled in parallel by dvz_graphics_pipelines().
+typedef struct DvzPipelineJobs DvzPipelineJobs;
+struct DvzPipelineJobs
+{
+    uint32_t count;
+    DvzGraphics** graphics;
+    atomic(uint32_t, next); // index of the next pipeline to compile
+};
+
+
+
+static void* _pipeline_worker(void* user_data)
+{
+    DvzPipelineJobs* jobs = (DvzPipelineJobs*)user_data;
+    ASSERT(jobs != NULL);
+    // Each thread takes the next pipeline to compile until there is none left.
+    uint32_t i = 0;
+    while ((i = atomic_fetch_add(&jobs->next, 1)) < jobs->count)
+        dvz_graphics_pipeline(jobs->graphics[i]);
+    return NULL;
+}
+
+
+
+void dvz_graphics_pipelines(uint32_t count, DvzGraphics** graphics)
+{
+    ASSERT(graphics != NULL);
+    if (count == 0)
+        return;
+    if (count == 1)
+    {
+        dvz_graphics_pipeline(graphics[0]);
+        return;
+    }
+    log_debug("compile %d graphics pipelines in parallel", count);
+
+    DvzPipelineJobs jobs = {0};
+    jobs.count = count;
+    jobs.graphics = graphics;
+    atomic_init(&jobs.next, 0);
+
+    // The calling thread compiles pipelines too.
+    uint32_t n = MIN(count, DVZ_MAX_PIPELINE_THREADS) - 1;
+    DvzThread threads[DVZ_MAX_PIPELINE_THREADS] = {0};
+    for (uint32_t i = 0; i < n; i++)
+        threads[i] = dvz_thread(_pipeline_worker, &jobs);
+    _pipeline_worker(&jobs);
+
+    // Wait until all pipelines have been compiled.
+    for (uint32_t i = 0; i < n; i++)
+        dvz_thread_join(&threads[i]);
+}
+
+
+
 void dvz_graphics_destroy(DvzGraphics* graphics)
 {
     ASSERT(graphics != NULL);
@@ -2105,11 +2392,10 @@ void dvz_graphics_destroy(DvzGraphics* graphics)
     VkDevice device = graphics->gpu->device;
     for (uint32_t i = 0; i < graphics->shader_count; i++)
     {
-        if (graphics->shader_modules[i] != VK_NULL_HANDLE)
-        {
+        // NOTE: shared shader modules are destroyed by their owner.
+        if (graphics->shader_modules[i] != VK_NULL_HANDLE && !graphics->shader_shared[i])
             vkDestroyShaderModule(device, graphics->shader_modules[i], NULL);
-            graphics->shader_modules[i] = VK_NULL_HANDLE;
-        }
+        graphics->shader_modules[i] = VK_NULL_HANDLE;
     }
     if (graphics->pipeline != VK_NULL_HANDLE)
     {
@@ -2414,6 +2700,111 @@ void dvz_fences_destroy(DvzFences* fences)
 
 
 
+/*************************************************************************************************/
+/*  Queries                                                                                      */
+/*************************************************************************************************/
+
+DvzQueries dvz_queries(DvzGpu* gpu, VkQueryType type, uint32_t count)
+{
+    ASSERT(gpu != NULL);
+    ASSERT(dvz_obj_is_created(&gpu->obj));
+
+    DvzQueries queries = {0};
+
+    ASSERT(count > 0);
+    log_trace("create pool of %d queries", count);
+
+    queries.gpu = gpu;
+    queries.type = type;
+    queries.count = count;
+
+    VkQueryPoolCreateInfo info = {0};
+    info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    info.queryType = type;
+    info.queryCount = count;
+    VK_CHECK_RESULT(vkCreateQueryPool(gpu->device, &info, NULL, &queries.pool));
+
+    dvz_obj_created(&queries.obj);
+    return queries;
+}
+
+
+
+bool dvz_queries_results(DvzQueries* queries, uint32_t first, uint32_t count, uint64_t* results)
+{
+    ASSERT(queries != NULL);
+    ASSERT(queries->pool != VK_NULL_HANDLE);
+    ASSERT(results != NULL);
+    ASSERT(count > 0);
+    ASSERT(first + count <= queries->count);
+
+    // Do not wait for the GPU: queries that are not written yet return VK_NOT_READY and a zero
+    // availability.
+    VkResult res = vkGetQueryPoolResults(
+        queries->gpu->device, queries->pool, first, count, 2 * count * sizeof(uint64_t), results,
+        2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (res != VK_SUCCESS && res != VK_NOT_READY)
+    {
+        log_error("error %d when retrieving query results", res);
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++)
+        if (results[2 * i + 1] == 0)
+            return false;
+    return true;
+}
+
+
+
+void dvz_queries_destroy(DvzQueries* queries)
+{
+    ASSERT(queries != NULL);
+    if (!dvz_obj_is_created(&queries->obj))
+    {
+        log_trace("skip destruction of already-destroyed queries");
+        return;
+    }
+    log_trace("destroy pool of %d queries", queries->count);
+
+    if (queries->pool != VK_NULL_HANDLE)
+    {
+        vkDestroyQueryPool(queries->gpu->device, queries->pool, NULL);
+        queries->pool = VK_NULL_HANDLE;
+    }
+    dvz_obj_destroyed(&queries->obj);
+}
+
+
+
+bool dvz_gpu_timestamps(DvzGpu* gpu, uint32_t queue_idx)
+{
+    ASSERT(gpu != NULL);
+    ASSERT(queue_idx < gpu->queues.queue_count);
+    uint32_t family = gpu->queues.queue_families[queue_idx];
+    return gpu->device_properties.limits.timestampPeriod > 0 &&
+           gpu->queues.timestamp_valid_bits[family] > 0;
+}
+
+
+
+double dvz_gpu_timestamps_elapsed(DvzGpu* gpu, uint32_t queue_idx, uint64_t begin, uint64_t end)
+{
+    ASSERT(gpu != NULL);
+    ASSERT(queue_idx < gpu->queues.queue_count);
+    uint32_t bits = gpu->queues.timestamp_valid_bits[gpu->queues.queue_families[queue_idx]];
+    if (bits == 0)
+        return 0;
+
+    // Only the lower bits of the timestamps are valid, and the counter may wrap around.
+    uint64_t mask = bits >= 64 ? UINT64_MAX : ((uint64_t)1 << bits) - 1;
+    uint64_t ticks = ((end & mask) - (begin & mask)) & mask;
+
+    // The timestamp period is the number of nanoseconds per tick.
+    return ticks * (double)gpu->device_properties.limits.timestampPeriod * 1e-6;
+}
+
+
+
 /*************************************************************************************************/
 /*  Renderpass                                                                                   */
 /*************************************************************************************************/
@@ -2929,7 +3320,33 @@ void dvz_cmd_begin_renderpass(
     ASSERT(framebuffers->framebuffers[iclip] != VK_NULL_HANDLE);
     begin_render_pass(
         renderpass->renderpass, cb, framebuffers->framebuffers[iclip], //
-        width, height, renderpass->clear_count, renderpass->clear_values);
+        width, height, renderpass->clear_count, renderpass->clear_values,
+        VK_SUBPASS_CONTENTS_INLINE);
+    CMD_END
+}
+
+
+
+void dvz_cmd_begin_renderpass_secondary(
+    DvzCommands* cmds, uint32_t idx, DvzRenderpass* renderpass, DvzFramebuffers* framebuffers)
+{
+    ASSERT(renderpass != NULL);
+    ASSERT(framebuffers != NULL);
+
+    ASSERT(dvz_obj_is_created(&renderpass->obj));
+    ASSERT(dvz_obj_is_created(&framebuffers->obj));
+    ASSERT(renderpass->renderpass != VK_NULL_HANDLE);
+
+    ASSERT(framebuffers->attachment_count > 0);
+    uint32_t width = framebuffers->attachments[0]->width;
+    uint32_t height = framebuffers->attachments[0]->height;
+
+    CMD_START_CLIP(cmds->count)
+    ASSERT(framebuffers->framebuffers[iclip] != VK_NULL_HANDLE);
+    begin_render_pass(
+        renderpass->renderpass, cb, framebuffers->framebuffers[iclip], //
+        width, height, renderpass->clear_count, renderpass->clear_values,
+        VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
     CMD_END
 }
 
@@ -2944,6 +3361,21 @@ void dvz_cmd_end_renderpass(DvzCommands* cmds, uint32_t idx)
 
 
 
+void dvz_cmd_execute(
+    DvzCommands* cmds, uint32_t idx, DvzCommands* secondary, uint32_t secondary_idx)
+{
+    ASSERT(secondary != NULL);
+    ASSERT(secondary->level == VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+    ASSERT(secondary_idx < secondary->count);
+    ASSERT(secondary->cmds[secondary_idx] != VK_NULL_HANDLE);
+
+    CMD_START
+    vkCmdExecuteCommands(cb, 1, &secondary->cmds[secondary_idx]);
+    CMD_END
+}
+
+
+
 void dvz_cmd_compute(DvzCommands* cmds, uint32_t idx, DvzCompute* compute, uvec3 size)
 {
     ASSERT(compute->bindings != NULL);
@@ -2957,7 +3389,48 @@ void dvz_cmd_compute(DvzCommands* cmds, uint32_t idx, DvzCompute* compute, uvec3
     vkCmdBindDescriptorSets(
         cb, VK_PIPELINE_BIND_POINT_COMPUTE, compute->slots.pipeline_layout, 0, 1,
         compute->bindings->dsets, 0, 0);
+    // Optional GPU timestamps around the dispatch.
+    bool timestamps = dvz_obj_is_created(&compute->queries.obj);
+    if (timestamps)
+    {
+        dvz_cmd_reset_queries(cmds, idx, &compute->queries, 0, 2);
+        dvz_cmd_timestamp(cmds, idx, &compute->queries, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+    }
     vkCmdDispatch(cb, size[0], size[1], size[2]);
+    if (timestamps)
+        dvz_cmd_timestamp(cmds, idx, &compute->queries, 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    CMD_END
+}
+
+
+
+void dvz_cmd_reset_queries(
+    DvzCommands* cmds, uint32_t idx, DvzQueries* queries, uint32_t first, uint32_t count)
+{
+    ASSERT(queries != NULL);
+    ASSERT(queries->pool != VK_NULL_HANDLE);
+    ASSERT(first + count <= queries->count);
+    CMD_START
+    vkCmdResetQueryPool(cb, queries->pool, first, count);
+    CMD_END
+}
+
+
+
+void dvz_cmd_timestamp(
+    DvzCommands* cmds, uint32_t idx, DvzQueries* queries, uint32_t query,
+    VkPipelineStageFlagBits stage)
+{
+    ASSERT(queries != NULL);
+    ASSERT(queries->pool != VK_NULL_HANDLE);
+    ASSERT(queries->type == VK_QUERY_TYPE_TIMESTAMP);
+    ASSERT(query < queries->count);
+    ASSERT(cmds != NULL);
+    if (!dvz_gpu_timestamps(cmds->gpu, cmds->queue_idx))
+        return;
+    queries->queue_idx = cmds->queue_idx;
+    CMD_START
+    vkCmdWriteTimestamp(cb, stage, queries->pool, query);
     CMD_END
 }
 
@@ -3181,6 +3654,9 @@ void dvz_cmd_bind_graphics(
         }
     }
 
+    // Compile the pipeline of a deferred graphics the first time it is bound.
+    dvz_graphics_pipeline(graphics);
+
     CMD_START_CLIP(bindings->dset_count)
     if (dvz_obj_is_created(&graphics->obj))
         vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics->pipeline);
@@ -4,6 +4,11 @@
 
 #include "../include/datoviz/vklite.h"
 
+#include <sys/stat.h>
+#if OS_WIN32
+#include <direct.h>
+#endif
+
 
 
 /*************************************************************************************************/
@@ -372,6 +377,37 @@ static void backend_poll_events(DvzBackend backend, DvzWindow* window)
 
 
 
+// Block until a window event occurs, or until the timeout (in seconds) expires.
+static void backend_wait_events(DvzBackend backend, double timeout)
+{
+    switch (backend)
+    {
+    case DVZ_BACKEND_GLFW:
+        glfwWaitEventsTimeout(timeout);
+        break;
+    default:
+        dvz_sleep((int)(timeout * 1000));
+        break;
+    }
+}
+
+
+
+// Wake up the thread blocked in backend_wait_events(), may be called from any thread.
+static void backend_wakeup(DvzBackend backend)
+{
+    switch (backend)
+    {
+    case DVZ_BACKEND_GLFW:
+        glfwPostEmptyEvent();
+        break;
+    default:
+        break;
+    }
+}
+
+
+
 static void
 backend_window_destroy(VkInstance instance, DvzBackend backend, void* window, VkSurfaceKHR surface)
 {
@@ -600,6 +636,7 @@ static void find_queue_families(VkPhysicalDevice device, DvzQueues* queues)
         queues->support_graphics[i] = queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT;
         queues->support_compute[i] = queue_families[i].queueFlags & VK_QUEUE_COMPUTE_BIT;
         queues->max_queue_count[i] = queue_families[i].queueCount;
+        queues->timestamp_valid_bits[i] = queue_families[i].timestampValidBits;
         log_trace(
             "queue family #%d (max %d): transfer %d, graphics %d, compute %d", //
             i, queues->max_queue_count[i],                                     //
@@ -979,7 +1016,8 @@ static void create_swapchain(
 /*************************************************************************************************/
 
 static void allocate_command_buffers(
-    VkDevice device, VkCommandPool command_pool, uint32_t count, VkCommandBuffer* cmd_bufs)
+    VkDevice device, VkCommandPool command_pool, VkCommandBufferLevel level, uint32_t count,
+    VkCommandBuffer* cmd_bufs)
 {
     ASSERT(count > 0);
     log_trace("allocate %d command buffer(s)", count);
@@ -989,7 +1027,7 @@ static void allocate_command_buffers(
     VkCommandBufferAllocateInfo alloc_info = {0};
     alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     alloc_info.commandPool = command_pool;
-    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.level = level;
     alloc_info.commandBufferCount = count;
     VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &alloc_info, cmd_bufs));
 }
@@ -1470,13 +1508,198 @@ static VkShaderModule create_shader_module_from_file(VkDevice device, const char
 
 
 
+/*************************************************************************************************/
+/*  Pipeline cache                                                                               */
+/*************************************************************************************************/
+
+// Size of the header of the pipeline cache data, as defined by the Vulkan specification.
+#define DVZ_PIPELINE_CACHE_HEADER_SIZE (16 + VK_UUID_SIZE)
+
+static void make_directory(const char* path)
+{
+    // Create a directory and its missing parents, ignoring the existing ones.
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s", path);
+    for (char* c = tmp + 1;; c++)
+    {
+        if (*c != '/' && *c != '\\' && *c != 0)
+            continue;
+        char end = *c;
+        *c = 0;
+#if OS_WIN32
+        _mkdir(tmp);
+#else
+        mkdir(tmp, 0755);
+#endif
+        *c = end;
+        if (end == 0)
+            break;
+    }
+}
+
+
+
+static bool pipeline_cache_path(VkPhysicalDeviceProperties* props, char* path, size_t size)
+{
+    ASSERT(props != NULL);
+    ASSERT(path != NULL);
+
+    // Find the cache directory. An empty DVZ_PIPELINE_CACHE_DIR disables the on-disk cache.
+    char dir[1024] = {0};
+    const char* env = getenv("DVZ_PIPELINE_CACHE_DIR");
+    if (env != NULL)
+    {
+        if (strlen(env) == 0)
+            return false;
+        snprintf(dir, sizeof(dir), "%s", env);
+    }
+#if OS_WIN32
+    else if ((env = getenv("LOCALAPPDATA")) != NULL)
+        snprintf(dir, sizeof(dir), "%s/datoviz", env);
+#endif
+    else if ((env = getenv("XDG_CACHE_HOME")) != NULL && strlen(env) > 0)
+        snprintf(dir, sizeof(dir), "%s/datoviz", env);
+    else if ((env = getenv("HOME")) != NULL)
+        snprintf(dir, sizeof(dir), "%s/.cache/datoviz", env);
+    else
+        return false;
+    make_directory(dir);
+
+    // The file name depends on the device UUID and on the driver version, so that a driver update
+    // or another GPU does not reuse a stale cache.
+    char uuid[2 * VK_UUID_SIZE + 1] = {0};
+    for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+        snprintf(&uuid[2 * i], 3, "%02x", props->pipelineCacheUUID[i]);
+    snprintf(
+        path, size, "%s/pipeline_cache_%04x_%04x_%08x_%s.bin", dir, props->vendorID,
+        props->deviceID, props->driverVersion, uuid);
+    return true;
+}
+
+
+
+static bool pipeline_cache_valid(VkPhysicalDeviceProperties* props, const void* data, size_t size)
+{
+    // Check the header of the cache data before handing it to the driver.
+    if (size < DVZ_PIPELINE_CACHE_HEADER_SIZE)
+        return false;
+    // Header: header size, header version, vendor ID, device ID, pipeline cache UUID.
+    uint32_t header[4] = {0};
+    memcpy(header, data, sizeof(header));
+    if (header[0] < DVZ_PIPELINE_CACHE_HEADER_SIZE || header[1] != 1)
+        return false;
+    if (header[2] != props->vendorID || header[3] != props->deviceID)
+        return false;
+    return memcmp((const char*)data + 16, props->pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+
+
+static void create_pipeline_cache(
+    VkDevice device, VkPhysicalDeviceProperties* props, const char* path, VkPipelineCache* cache)
+{
+    ASSERT(device != VK_NULL_HANDLE);
+
+    // Load the cache data from the previous runs, if any.
+    void* data = NULL;
+    size_t size = 0;
+    FILE* f = path != NULL && strlen(path) > 0 ? fopen(path, "rb") : NULL;
+    if (f != NULL)
+    {
+        fseek(f, 0, SEEK_END);
+        long length = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        if (length > 0)
+        {
+            data = malloc((size_t)length);
+            size = fread(data, 1, (size_t)length, f);
+        }
+        fclose(f);
+    }
+    if (data != NULL && !pipeline_cache_valid(props, data, size))
+    {
+        log_debug("discard invalid pipeline cache %s", path);
+        FREE(data);
+        size = 0;
+    }
+
+    VkPipelineCacheCreateInfo info = {0};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    info.initialDataSize = data != NULL ? size : 0;
+    info.pInitialData = data;
+    VkResult res = vkCreatePipelineCache(device, &info, NULL, cache);
+    if (res != VK_SUCCESS && data != NULL)
+    {
+        // The driver rejected the cache data: start from an empty cache.
+        log_debug("pipeline cache %s rejected by the driver", path);
+        info.initialDataSize = 0;
+        info.pInitialData = NULL;
+        res = vkCreatePipelineCache(device, &info, NULL, cache);
+    }
+    if (res != VK_SUCCESS)
+    {
+        log_warn("unable to create the pipeline cache");
+        *cache = VK_NULL_HANDLE;
+    }
+    else if (data != NULL)
+    {
+        log_debug("loaded %s from pipeline cache %s", pretty_size(size), path);
+    }
+    FREE(data);
+}
+
+
+
+static void save_pipeline_cache(VkDevice device, VkPipelineCache cache, const char* path)
+{
+    if (cache == VK_NULL_HANDLE || path == NULL || strlen(path) == 0)
+        return;
+
+    size_t size = 0;
+    VK_CHECK_RESULT(vkGetPipelineCacheData(device, cache, &size, NULL));
+    if (size == 0)
+        return;
+    void* data = malloc(size);
+    VK_CHECK_RESULT(vkGetPipelineCacheData(device, cache, &size, data));
+
+    // Write to a temporary file first, so that concurrent processes never read a partial cache.
+    char tmp[1040];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+    FILE* f = fopen(tmp, "wb");
+    if (f == NULL)
+    {
+        log_warn("unable to write the pipeline cache %s", tmp);
+        FREE(data);
+        return;
+    }
+    bool ok = fwrite(data, 1, size, f) == size;
+    ok = (fclose(f) == 0) && ok;
+#if OS_WIN32
+    // NOTE: rename() does not overwrite an existing file on Windows.
+    if (ok)
+        remove(path);
+#endif
+    if (!ok || rename(tmp, path) != 0)
+    {
+        log_warn("unable to write the pipeline cache %s", path);
+        remove(tmp);
+    }
+    else
+    {
+        log_debug("saved %s to pipeline cache %s", pretty_size(size), path);
+    }
+    FREE(data);
+}
+
+
+
 /*************************************************************************************************/
 /*  Compute                                                                                      */
 /*************************************************************************************************/
 
 static void create_compute_pipeline(
-    VkDevice device, VkShaderModule shader_module, VkPipelineLayout pipeline_layout,
-    VkPipeline* pipeline)
+    VkDevice device, VkPipelineCache cache, VkShaderModule shader_module,
+    VkPipelineLayout pipeline_layout, VkPipeline* pipeline)
 {
     // Create the shader and pipeline.
     VkComputePipelineCreateInfo pipelineInfo = {0};
@@ -1488,7 +1711,7 @@ static void create_compute_pipeline(
     pipelineInfo.stage.module = shader_module;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
     VK_CHECK_RESULT(
-        vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, pipeline));
+        vkCreateComputePipelines(device, cache, 1, &pipelineInfo, NULL, pipeline));
 }
 
 
@@ -1642,7 +1865,8 @@ static VkAttachmentReference create_attachment_ref(uint32_t attachment, VkImageL
 
 static void begin_render_pass(
     VkRenderPass renderpass, VkCommandBuffer cmd_buf, VkFramebuffer framebuffer, //
-    uint32_t width, uint32_t height, uint32_t clear_count, VkClearValue* clear_colors)
+    uint32_t width, uint32_t height, uint32_t clear_count, VkClearValue* clear_colors,
+    VkSubpassContents contents)
 {
     ASSERT(renderpass != VK_NULL_HANDLE);
     ASSERT(framebuffer != VK_NULL_HANDLE);
@@ -1657,7 +1881,7 @@ static void begin_render_pass(
     render_pass_info.renderArea = renderArea;
     render_pass_info.clearValueCount = clear_count;
     render_pass_info.pClearValues = clear_colors;
-    vkCmdBeginRenderPass(cmd_buf, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(cmd_buf, &render_pass_info, contents);
 }
 
 #endif